@@ -17,6 +17,19 @@ struct GPU_camera
     mat4 projection_view;
 };
 
+// Cascaded shadow maps for the sunlight.
+constexpr uint32_t k_num_shadow_cascades{ 4 };
+constexpr uint32_t k_shadow_cascade_resolution{ 2048 };
+
+// Virtual shadow map for the sunlight (one clipmap level that follows the
+// camera). Only the pages that visible depth samples land in are backed by
+// a physical page.
+constexpr uint32_t k_vsm_page_size{ 128 };  // Texels per page side.
+constexpr uint32_t k_vsm_num_pages_per_side{ 128 };
+constexpr uint32_t k_vsm_num_virtual_pages{ k_vsm_num_pages_per_side * k_vsm_num_pages_per_side };
+constexpr uint32_t k_vsm_virtual_resolution{ k_vsm_page_size * k_vsm_num_pages_per_side };
+constexpr uint32_t k_vsm_num_physical_pages{ 1024 };
+
 void set_aspect_ratio(uint32_t screen_width, uint32_t screen_height);
 void set_aspect_ratio_float(float_t aspect_ratio);
 void set_fov(float_t radians);
@@ -27,10 +40,32 @@ void set_view_position(vec3 cam_position);
 void set_view_direction(float_t cam_pan__rot_y, float_t cam_tilt__rot_x);
 void set_view_direction_vec3(vec3 view_direction);
 
+// @NOTE: `sun_direction` is the direction the sunlight travels in.
+void set_sun_direction(vec3 sun_direction);
+// @NOTE: Cascades cover `[near, min(far, max_shadow_distance)]`. The split
+//   lambda blends between uniform (0) and logarithmic (1) splits.
+void set_shadow_cascade_props(float_t max_shadow_distance, float_t split_lambda);
+// @NOTE: The virtual shadow map covers `extent` world units per side around
+//   the camera, and `depth_range` world units along the sunlight.
+void set_virtual_shadow_map_props(float_t extent, float_t depth_range);
+
 void fetch_matrices(mat4& out_projection,
                     mat4& out_view,
                     mat4& out_projection_view,
-                    std::vector<mat4s>& out_shadow_cascades);
+                    std::vector<mat4s>& out_shadow_cascades);  // Projection views.
+
+// Virtual shadow map window.
+// @NOTE: The window is snapped to whole pages (and the depth range to a
+//   quarter of itself), so cached pages stay valid until `light_version`
+//   changes or the depth range moves.
+struct Virtual_shadow_map_view
+{
+    mat4 projection_view;
+    int32_t page_origin[2];  // Absolute page coord of the window's first page.
+    float_t depth_center;
+    uint32_t light_version;  // Bumped when the sun direction or props change.
+};
+void fetch_virtual_shadow_map_view(Virtual_shadow_map_view& out_view);
 
 // @TODO: Add camera shake stuff.
 
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cinttypes>
+
+
+namespace gpu_geo_data
+{
+
+enum class Render_layer : uint32_t
+{
+    DEFAULT = 0,
+    INVISIBLE,
+    LEVEL_EDITOR,
+    NUM_RENDER_LAYERS
+};
+
+// Set of render layers that a view draws (one bit per `Render_layer`).
+using Render_layer_mask_t = uint32_t;
+
+constexpr Render_layer_mask_t make_render_layer_mask(Render_layer render_layer)
+{
+    return (Render_layer_mask_t(1) << static_cast<uint32_t>(render_layer));
+}
+
+// @NOTE: No view draws `INVISIBLE` by default.
+constexpr Render_layer_mask_t k_gameplay_view_render_layers{
+    make_render_layer_mask(Render_layer::DEFAULT) };
+constexpr Render_layer_mask_t k_level_editor_view_render_layers{
+    make_render_layer_mask(Render_layer::DEFAULT) |
+    make_render_layer_mask(Render_layer::LEVEL_EDITOR) };
+constexpr Render_layer_mask_t k_shadow_view_render_layers{
+    make_render_layer_mask(Render_layer::DEFAULT) };
+
+}  // namespace gpu_geo_data
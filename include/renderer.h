@@ -4,21 +4,40 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 #include "cglm/cglm.h"
+#include "geo_render_layer.h"
 #include "geo_render_pass.h"
 #include "multithreaded_job_system_public.h"
 #include "ticking_world_simulation_public.h"
+#include "transform_batch_source.h"
 
 
 class Monolithic_renderer : public Job_source
 {
 public:
+    // Frame pacing.
+    enum class Frame_pacing_mode : uint8_t
+    {
+        // Let the CPU queue up to `num_frames_in_flight` frames ahead of the GPU.
+        MAX_THROUGHPUT = 0,
+        // Wait for the GPU to release the frame (and the frame limiter) before
+        // sampling input/transforms so the sampled data is as fresh as possible.
+        LOW_LATENCY,
+    };
+
+    // @NOTE: `num_frames_in_flight` gets clamped to this range.
+    static constexpr uint32_t k_min_frames_in_flight{ 1 };
+    static constexpr uint32_t k_max_frames_in_flight{ 3 };
+
     Monolithic_renderer(std::atomic_size_t& num_job_sources_setup_incomplete,
                         const std::string& name,
                         int32_t content_width,
                         int32_t content_height,
                         int32_t fallback_content_width,
-                        int32_t fallback_content_height);
+                        int32_t fallback_content_height,
+                        uint32_t num_frames_in_flight = 2,
+                        Frame_pacing_mode frame_pacing_mode = Frame_pacing_mode::MAX_THROUGHPUT);
     ~Monolithic_renderer();
 
     bool is_renderer_requesting_close();
@@ -29,16 +48,281 @@ public:
     void notify_windowevent_uniconification();
 #endif  // _WIN64
 
+    // @NOTE: `0.0f` disables the frame limiter.
+    void set_frame_limiter_fps(float_t target_fps);
+
+    // Simulation-to-present latency.
+    // @NOTE: Measured from when input/transforms are sampled for a frame to when
+    //   that frame's render fence is observed as signaled, so it's accurate to
+    //   about the polling granularity (once per frame).
+    struct Frame_latency_stats
+    {
+        float_t last_ms{ 0.0f };
+        float_t avg_ms{ 0.0f };
+        float_t max_ms{ 0.0f };
+        uint64_t num_samples{ 0 };
+    };
+    Frame_latency_stats get_frame_latency_stats();
+
+    // Culls and writes geometry draw cmds in one dispatch (default). Turn
+    // off to use the separate culling and write draw cmds passes instead.
+    void set_use_fused_geometry_culling(bool use_fused);
+
+    // Render layers drawn by the main camera view (e.g.
+    // `k_level_editor_view_render_layers` for the level editor).
+    // @NOTE: Defaults to `k_gameplay_view_render_layers`.
+    void set_main_view_render_layers(gpu_geo_data::Render_layer_mask_t render_layers);
+
+    // Sunlight shadows.
+    enum class Shadow_technique : uint8_t
+    {
+        // Cascaded shadow maps, w/ amortized cascade updates and cached
+        // static casters (default).
+        CASCADED = 0,
+        // Virtual shadow map. Only the pages that visible geometry lands in
+        // get a physical page, and those stay cached until casters move.
+        VIRTUAL,
+    };
+    void set_shadow_technique(Shadow_technique technique);
+
+    // Shadow map work and memory of the active technique.
+    // @NOTE: Virtual shadow map page counts are read back from the GPU, so
+    //   they lag `num_frames_in_flight` frames behind.
+    struct Shadow_stats
+    {
+        Shadow_technique technique{ Shadow_technique::CASCADED };
+        uint32_t num_cascades_rendered{ 0 };
+        uint32_t num_static_caches_rendered{ 0 };
+        uint32_t num_vsm_requested_pages{ 0 };
+        uint32_t num_vsm_resident_pages{ 0 };
+        uint32_t num_vsm_rendered_pages{ 0 };
+        uint32_t num_vsm_invalidated_pages{ 0 };
+        uint32_t num_vsm_allocation_failures{ 0 };
+        uint32_t num_vsm_free_pages{ 0 };
+        uint64_t shadow_map_memory_bytes{ 0 };
+    };
+    Shadow_stats get_shadow_stats();
+
+    // Rendering counters, to track culling efficiency.
+    // @NOTE: Read back from the GPU (w/o stalling), so they lag
+    //   `num_frames_in_flight` frames behind.
+    struct Render_stats
+    {
+        // Draw counts of the opaque geometry pass.
+        uint32_t num_instances{ 0 };
+        uint32_t num_candidate_draws{ 0 };    // Per view, before culling.
+        uint32_t num_main_view_draws{ 0 };
+        uint32_t num_shadow_view_draws{ 0 };  // Summed over all shadow views.
+
+        // Whether the next frame's update data runs alongside the current
+        // frame's render (`Frame_pacing_mode::MAX_THROUGHPUT` only), and how
+        // many frames so far were prepared that way.
+        bool is_frame_pipelined{ false };
+        uint64_t num_pipelined_frames{ 0 };
+
+        // Pipeline statistics of the latest frame that recorded each pass.
+        // @NOTE: Empty if the device doesn't support pipeline statistics
+        //   queries.
+        struct Pass_pipeline_stats
+        {
+            const char* name;
+            uint64_t vertex_shader_invocations{ 0 };
+            uint64_t clipping_primitives{ 0 };
+            uint64_t fragment_shader_invocations{ 0 };
+            uint64_t compute_shader_invocations{ 0 };
+        };
+        std::vector<Pass_pipeline_stats> pass_pipeline_stats;
+    };
+    Render_stats get_render_stats();
+
+    // GPU pass timings, from timestamp queries around each pass.
+    // @NOTE: Read back `num_frames_in_flight` frames late (w/o stalling), over
+    //   the latest 512 frames that recorded the pass. Empty if the device
+    //   doesn't support timestamps.
+    struct GPU_pass_timing
+    {
+        const char* name;
+        float_t min_ms{ 0.0f };
+        float_t avg_ms{ 0.0f };
+        float_t p99_ms{ 0.0f };
+        uint32_t num_samples{ 0 };
+    };
+    std::vector<GPU_pass_timing> get_gpu_pass_timings();
+
+    // CPU profiler zone timings (every job plus the hot sections inside them),
+    // over the latest 120 frames. Empty if built w/o the `CPU_PROFILER` option.
+    struct CPU_zone_timing
+    {
+        const char* name;
+        float_t avg_ms_per_frame{ 0.0f };
+        float_t max_ms{ 0.0f };
+        float_t calls_per_frame{ 0.0f };
+    };
+    std::vector<CPU_zone_timing> get_cpu_zone_timings();
+
+    // Writes the latest GPU pass timings and CPU profiler zones as a Chrome
+    // trace JSON file (open in `chrome://tracing` or Perfetto).
+    bool export_profiler_trace(const std::string& file_path);
+
+    // GPU memory budget.
+    // @NOTE: Heap budgets get sampled every 30 frames. The pressure level
+    //   goes off the fullest device local heap's usage/budget.
+    enum class Memory_pressure_level : uint8_t
+    {
+        NORMAL = 0,
+        WARNING,
+        CRITICAL,
+    };
+
+    struct GPU_memory_stats
+    {
+        // Tracked allocations, by what they're used for.
+        struct Category_usage
+        {
+            const char* name;
+            uint64_t num_bytes{ 0 };
+            uint32_t num_allocations{ 0 };
+        };
+        std::vector<Category_usage> category_usages;
+
+        struct Heap_usage
+        {
+            uint64_t usage_bytes{ 0 };
+            uint64_t budget_bytes{ 0 };
+            bool is_device_local{ false };
+        };
+        std::vector<Heap_usage> heap_usages;
+
+        Memory_pressure_level pressure_level{ Memory_pressure_level::NORMAL };
+    };
+    GPU_memory_stats get_gpu_memory_stats();
+
+    // Fractions of the budget the pressure level goes up at (defaults to 0.8
+    // and 0.95). It only goes back down 0.05 under the threshold.
+    void set_memory_pressure_thresholds(float_t warning_fraction, float_t critical_fraction);
+
+    // Called whenever the pressure level changes, so that e.g. streaming and
+    // LOD can back off before allocations start failing.
+    // @NOTE: Called from whichever renderer job sampled the budget (not the
+    //   registering thread), w/o any renderer lock held.
+    struct Memory_pressure_event
+    {
+        Memory_pressure_level level;
+        Memory_pressure_level prev_level;
+        uint64_t usage_bytes;
+        uint64_t budget_bytes;
+    };
+    using Memory_pressure_callback_t = std::function<void(const Memory_pressure_event& event)>;
+    using memory_pressure_callback_key_t = uint32_t;
+    memory_pressure_callback_key_t register_memory_pressure_callback(Memory_pressure_callback_t&& callback);
+    void unregister_memory_pressure_callback(memory_pressure_callback_key_t key);
+
+    // GPU memory defragmentation.
+    // @NOTE: Starts on its own once the device local heaps have lots of unused
+    //   space in their blocks, and moves a bounded amount of memory per frame.
+    void request_gpu_memory_defragmentation();
+
+    // Totals over all finished runs.
+    struct GPU_defrag_stats
+    {
+        bool is_running{ false };
+        uint32_t num_runs{ 0 };
+        uint32_t num_passes{ 0 };
+        uint32_t num_allocations_moved{ 0 };
+        uint64_t num_bytes_moved{ 0 };
+        uint32_t num_blocks_freed{ 0 };
+        uint64_t num_bytes_freed{ 0 };  // Reclaimed device memory.
+    };
+    GPU_defrag_stats get_gpu_defrag_stats();
+
+    // Synthetic workload that allocates and frees random sized buffers every
+    // frame to fragment the heaps, to test defragmentation w/.
+    void set_gpu_memory_churn_workload(bool enabled);
+
+    // Number of parallel jobs that the update data chunk phases (rebucket,
+    // sort and per-frame upload) get split into. 0 picks one per hardware
+    // thread (default).
+    // @NOTE: Clamped to the max supported chunk count, and takes effect at
+    //   the next update data.
+    void set_num_update_data_chunks(uint32_t num_chunks);
+
+    // Benchmark that spawns a large set of (invisible) instances, forces a
+    // rebucket every frame and runs the update data w/ 1, 2, 4, ... chunks in
+    // turn. Prints the avg wall time of bucketing, sorting, uploading and each
+    // update data phase per chunk count. Restores the chunk count and
+    // destroys the instances once finished.
+    // @NOTE: Spawns half of `geo_instance::k_max_instances`, so the scene
+    //   can't have more than the other half registered.
+    void start_update_data_scaling_benchmark();
+
+    struct Update_data_scaling_result
+    {
+        uint32_t num_chunks{ 0 };
+        uint32_t num_measured_frames{ 0 };
+        float_t avg_total_ms{ 0.0f };
+        float_t avg_bucket_ms{ 0.0f };  // Begin rebucket + bucket chunks.
+        float_t avg_sort_ms{ 0.0f };    // Sort histogram + scatter chunks.
+        float_t avg_upload_ms{ 0.0f };  // Begin upload + upload chunks.
+
+        struct Phase_timing
+        {
+            const char* name;
+            float_t avg_ms{ 0.0f };  // Summed over all sort passes.
+        };
+        std::vector<Phase_timing> phase_timings;
+    };
+    // @NOTE: Empty until the latest benchmark finishes.
+    std::vector<Update_data_scaling_result> get_update_data_scaling_results();
+
+    // Benchmark workload that spawns a field of shadow casting boxes (w/ some
+    // of them moving, respawning and switching render layers every frame)
+    // and renders it w/ each `Shadow_technique` in turn. Prints a comparison
+    // once finished and restores the previously set technique.
+    // @NOTE: Shadow map GPU timings need the GPU profiler to be supported.
+    void start_shadow_technique_benchmark();
+
+    struct Shadow_technique_benchmark_result
+    {
+        Shadow_technique technique{ Shadow_technique::CASCADED };
+        uint32_t num_measured_frames{ 0 };
+        float_t avg_shadow_maps_gpu_ms{ 0.0f };
+        float_t max_shadow_maps_gpu_ms{ 0.0f };
+        float_t avg_cascades_rendered{ 0.0f };
+        float_t avg_static_caches_rendered{ 0.0f };
+        float_t avg_vsm_rendered_pages{ 0.0f };
+        float_t avg_vsm_invalidated_pages{ 0.0f };
+        uint64_t shadow_map_memory_bytes{ 0 };
+    };
+    // @NOTE: Empty until the latest benchmark finishes.
+    std::vector<Shadow_technique_benchmark_result> get_shadow_technique_benchmark_results();
+
     // Render geometry objects.
     using render_geo_obj_key_t = uint64_t;
     render_geo_obj_key_t create_render_geo_obj(const std::string& model_name,
                                                const std::string& material_set_name,
                                                geo_instance::Geo_render_pass render_pass,
                                                bool is_shadow_caster,
-                                               world_sim::Transform_read_ifc* transform_reader);
+                                               world_sim::Transform_read_ifc* transform_reader,
+                                               gpu_geo_data::Render_layer render_layer = gpu_geo_data::Render_layer::DEFAULT,
+                                               bool never_cull = false);
+    render_geo_obj_key_t create_render_geo_obj(const std::string& model_name,
+                                               const std::string& material_set_name,
+                                               geo_instance::Geo_render_pass render_pass,
+                                               bool is_shadow_caster,
+                                               transform_batch::Transform_ref batched_transform,
+                                               gpu_geo_data::Render_layer render_layer = gpu_geo_data::Render_layer::DEFAULT,
+                                               bool never_cull = false);
     void destroy_render_geo_obj(render_geo_obj_key_t key);
     void set_render_geo_obj_transform(render_geo_obj_key_t key,
                                       mat4 transform);
+    void set_render_geo_obj_render_layer(render_geo_obj_key_t key,
+                                         gpu_geo_data::Render_layer render_layer);
+
+    // Batched transform sources.
+    // @NOTE: Geo objects reading from a source must be destroyed before
+    //   unregistering it.
+    transform_batch::Source_key_t register_transform_batch_source(transform_batch::Source_ifc* source);
+    void unregister_transform_batch_source(transform_batch::Source_key_t key);
 
     class Impl;
 
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cinttypes>
+#include <cmath>
+
+
+namespace transform_batch
+{
+
+// Simulation side of batched transform reading.
+// @NOTE: The renderer pulls all transforms of a source with one call per
+//   frame and interpolates them in bulk, instead of a virtual call per
+//   instance like `world_sim::Transform_read_ifc`.
+class Source_ifc
+{
+public:
+    // Transforms of one simulation tick.
+    // @NOTE: Structure of arrays, each `num_transforms` long, so that they can
+    //   be interpolated with SIMD. Rotations are unit quaternions.
+    struct Tick_transforms
+    {
+        const float_t* pos_x;
+        const float_t* pos_y;
+        const float_t* pos_z;
+        const float_t* rot_x;
+        const float_t* rot_y;
+        const float_t* rot_z;
+        const float_t* rot_w;
+        const float_t* scale_x;
+        const float_t* scale_y;
+        const float_t* scale_z;
+    };
+
+    // The two most recent simulation ticks.
+    struct Tick_pair
+    {
+        uint64_t curr_tick_idx;
+        float_t tick_interval;  // Seconds between ticks.
+        uint32_t num_transforms;
+        Tick_transforms prev;
+        Tick_transforms curr;
+    };
+
+    virtual ~Source_ifc() = default;
+
+    // @NOTE: The arrays must not be written to until `release_tick_pair()`
+    //   gets called (e.g. by triple buffering the ticks).
+    // @RETURNS: false if no ticks are available yet.
+    virtual bool acquire_tick_pair(Tick_pair& out_tick_pair) = 0;
+    virtual void release_tick_pair() = 0;
+};
+
+using Source_key_t = uint32_t;
+constexpr Source_key_t k_invalid_source_key{ (Source_key_t)-1 };
+
+// Transform inside of a source.
+struct Transform_ref
+{
+    Source_key_t source_key{ k_invalid_source_key };
+    uint32_t transform_idx{ 0 };
+};
+
+}  // namespace transform_batch
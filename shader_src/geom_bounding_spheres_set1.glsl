@@ -0,0 +1,21 @@
+// Matches `GPU_bounding_sphere`.
+struct Bounding_sphere
+{
+    vec4 origin_xyz_radius_w;
+};
+layout(std140, set = 1, binding = 0) readonly buffer Bounding_sphere_buffer
+{
+    Bounding_sphere bounding_spheres[];
+} bounding_sphere_buffer;
+
+// World space bounding sphere (xyz origin, w radius) of an instance.
+// @NOTE: Needs `geom_instance_data_br.glsl` included first.
+vec4 calc_instance_world_bounding_sphere(Geo_instance_data instance)
+{
+    vec4 origin_xyz_radius_w =
+        bounding_sphere_buffer
+            .bounding_spheres[instance.bounding_sphere_idx]
+            .origin_xyz_radius_w;
+    return vec4(transform_instance_point(instance.transform, origin_xyz_radius_w.xyz),
+                origin_xyz_radius_w.w * calc_instance_max_scale(instance.transform));
+}
@@ -0,0 +1,12 @@
+// Helper functions for geometry culling.
+// @NOTE: Expects `params` to have `culling_enabled`, `instance_buffer` and
+//   `culling_views`, and `geom_culling_views_br.glsl` included first.
+bool is_visible(uint instance_idx, uint view_idx)
+{
+    Geo_instance_data instance = params.instance_buffer.instances[instance_idx];
+    return is_visible_in_view(params.culling_views.views[view_idx],
+                              instance.render_layer,
+                              instance.flags,
+                              calc_instance_world_bounding_sphere(instance),
+                              params.culling_enabled == 1);
+}
@@ -0,0 +1,60 @@
+// Matches `GPU_culling_view`.
+struct Culling_view
+{
+    vec4 frustum_planes[6];
+    uint render_layer_mask;
+    uint required_instance_flags;
+    uint excluded_instance_flags;
+    uint pad0;
+};
+layout(buffer_reference, std430) readonly buffer Culling_view_buffer
+{
+    Culling_view views[];
+};
+
+bool is_sphere_in_view(Culling_view view, vec4 sphere)
+{
+    for (uint i = 0; i < 6; i++)
+    {
+        if (dot(view.frustum_planes[i].xyz, sphere.xyz) + view.frustum_planes[i].w < -sphere.w)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// @NOTE: Needs `geom_instance_data_br.glsl` included first.
+bool is_visible_in_view(Culling_view view,
+                        uint render_layer,
+                        uint instance_flags,
+                        vec4 world_bounding_sphere,
+                        bool culling_enabled)
+{
+    // Skip render layers the view doesn't draw.
+    if (((view.render_layer_mask >> render_layer) & 1) == 0)
+    {
+        return false;
+    }
+
+    // Skip instances w/o the view's required flags (e.g. shadow casters).
+    if ((instance_flags & view.required_instance_flags) != view.required_instance_flags)
+    {
+        return false;
+    }
+
+    // Skip instances w/ any of the view's excluded flags (e.g. static casters
+    // of a cached shadow view).
+    if ((instance_flags & view.excluded_instance_flags) != 0)
+    {
+        return false;
+    }
+
+    // Skip spatial tests for never cull instances.
+    if ((instance_flags & k_instance_flag_never_cull) != 0 || !culling_enabled)
+    {
+        return true;
+    }
+
+    return is_sphere_in_view(view, world_bounding_sphere);
+}
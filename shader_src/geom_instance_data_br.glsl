@@ -1,13 +1,87 @@
+// Matches `GPU_instance_transform`.
+#ifdef GEO_COMPACT_INSTANCE_TRANSFORMS
+struct Geo_instance_transform
+{
+    vec4 rotation;
+    vec4 position;  // w unused.
+    vec4 scale;     // w unused.
+};
+#else
+struct Geo_instance_transform
+{
+    mat4 matrix;
+};
+#endif  // GEO_COMPACT_INSTANCE_TRANSFORMS
+
+// Matches `k_instance_flag_*`.
+const uint k_instance_flag_never_cull    = 1 << 0;
+const uint k_instance_flag_shadow_caster = 1 << 1;
+const uint k_instance_flag_static        = 1 << 2;
+
 // Matches `GPU_geo_instance_data`.
 struct Geo_instance_data
 {
-    mat4 transform;
+    Geo_instance_transform transform;
     uint bounding_sphere_idx;
     uint material_param_set_idx;
     uint render_layer;
-    uint never_cull;
+    uint flags;
 };
 layout(buffer_reference, std140) readonly buffer Geo_instance_buffer
 {
     Geo_instance_data instances[];
 };
+
+// Matches `GPU_draw_record`.
+// @NOTE: Culled draw cmds point `gl_BaseInstance` at their draw record.
+struct Draw_record
+{
+    uint instance_idx;
+    uint material_param_idx;
+};
+layout(buffer_reference, std430) readonly buffer Draw_record_buffer
+{
+    Draw_record records[];
+};
+
+#ifdef GEO_COMPACT_INSTANCE_TRANSFORMS
+vec3 rotate_by_quat(vec4 q, vec3 v)
+{
+    vec3 t = 2.0 * cross(q.xyz, v);
+    return v + q.w * t + cross(q.xyz, t);
+}
+#endif  // GEO_COMPACT_INSTANCE_TRANSFORMS
+
+vec3 transform_instance_point(Geo_instance_transform transform, vec3 point)
+{
+#ifdef GEO_COMPACT_INSTANCE_TRANSFORMS
+    return rotate_by_quat(transform.rotation, point * transform.scale.xyz) +
+        transform.position.xyz;
+#else
+    vec4 transformed = transform.matrix * vec4(point, 1.0);
+    return transformed.xyz / transformed.w;
+#endif  // GEO_COMPACT_INSTANCE_TRANSFORMS
+}
+
+// Largest axis scale (for scaling bounding sphere radii).
+float calc_instance_max_scale(Geo_instance_transform transform)
+{
+#ifdef GEO_COMPACT_INSTANCE_TRANSFORMS
+    return max(transform.scale.x, max(transform.scale.y, transform.scale.z));
+#else
+    return sqrt(max(dot(transform.matrix[0].xyz, transform.matrix[0].xyz),
+                    max(dot(transform.matrix[1].xyz, transform.matrix[1].xyz),
+                        dot(transform.matrix[2].xyz, transform.matrix[2].xyz))));
+#endif  // GEO_COMPACT_INSTANCE_TRANSFORMS
+}
+
+// @NOTE: Result is not normalized.
+vec3 transform_instance_normal(Geo_instance_transform transform, vec3 normal)
+{
+#ifdef GEO_COMPACT_INSTANCE_TRANSFORMS
+    // Inverse transpose of rotation * scale is rotation * inverse scale.
+    return rotate_by_quat(transform.rotation, normal / transform.scale.xyz);
+#else
+    return transpose(inverse(mat3(transform.matrix))) * normal;
+#endif  // GEO_COMPACT_INSTANCE_TRANSFORMS
+}
@@ -1,14 +1,7 @@
 // Helper functions for material sets.
+// @NOTE: The material param idx gets resolved per draw in
+//   `geom_write_draw_cmds.comp`, so this is just one lookup.
 uint get_material_param_idx()
 {
-    uint mat_param_set_idx =
-        params.geo_instance_buffer
-            .instances[gl_BaseInstance]
-            .material_param_set_idx;
-    uint mat_param_buffer_idx =
-        material_param_sets_buffer
-            .sets[mat_param_set_idx]
-            .material_param_buffer_start_idx +
-                in_primitive_idx;
-    return material_param_buffer.params[mat_param_buffer_idx].material_param_idx;
+    return params.draw_record_buffer.records[gl_BaseInstance].material_param_idx;
 }
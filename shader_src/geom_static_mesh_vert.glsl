@@ -3,4 +3,3 @@ layout (location = 0) in vec3 in_position;
 layout (location = 1) in vec3 in_normal;
 layout (location = 2) in vec2 in_uv;
 layout (location = 3) in vec4 in_color;
-layout (location = 4) in uint in_primitive_idx;
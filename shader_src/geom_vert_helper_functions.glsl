@@ -1,10 +1,14 @@
 // Helper functions for static mesh vertex.
+uint get_instance_idx()
+{
+    return params.draw_record_buffer.records[gl_BaseInstance].instance_idx;
+}
+
 vec3 calc_world_position()
 {
-    vec4 local_pos =
-        params.geo_instance_buffer.instances[gl_BaseInstance].transform *
-            vec4(in_position, 1.0);
-    return local_pos.xyz / local_pos.w;
+    return transform_instance_point(
+        params.geo_instance_buffer.instances[get_instance_idx()].transform,
+        in_position);
 }
 
 vec4 calc_projection_view_position(vec3 world_pos)
@@ -21,8 +25,8 @@ vec3 calc_normal()
 {
     return
         normalize(
-            transpose(inverse(
-                mat3(params.geo_instance_buffer.instances[gl_BaseInstance].transform)
-            )) * in_normal
+            transform_instance_normal(
+                params.geo_instance_buffer.instances[get_instance_idx()].transform,
+                in_normal)
         );
 }
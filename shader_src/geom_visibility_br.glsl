@@ -0,0 +1,11 @@
+// Bit-packed instance visibility of one view (buffer_reference).
+// @NOTE: One bit per instance. See `GPU_visibility_history`.
+layout(buffer_reference, std430) buffer Visibility_buffer
+{
+    uint words[];
+};
+
+bool is_instance_visible(Visibility_buffer visibility, uint instance_idx)
+{
+    return ((visibility.words[instance_idx >> 5] >> (instance_idx & 31)) & 1) == 1;
+}
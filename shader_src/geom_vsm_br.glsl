@@ -0,0 +1,76 @@
+// Virtual shadow map data (buffer_reference).
+// @NOTE: The page table is addressed toroidally, see `gpu_geo_data.h`.
+
+// Matches `camera::k_vsm_*`.
+const uint k_vsm_page_size          = 128;
+const uint k_vsm_num_pages_per_side = 128;
+const uint k_vsm_num_virtual_pages  = k_vsm_num_pages_per_side * k_vsm_num_pages_per_side;
+const uint k_vsm_num_physical_pages = 1024;
+const uint k_vsm_num_page_texels    = k_vsm_page_size * k_vsm_page_size;
+
+// Matches `k_vsm_page_table_entry_*`.
+const uint k_vsm_page_table_entry_rendering           = 1u << 29;
+const uint k_vsm_page_table_entry_resident            = 1u << 30;
+const uint k_vsm_page_table_entry_dirty               = 1u << 31;
+const uint k_vsm_page_table_entry_physical_page_mask  = 0xFFFF;
+
+// Matches `k_vsm_params_flag_*`.
+const uint k_vsm_params_flag_invalidate_all = 1 << 0;
+
+// Cleared physical page texel (`floatBitsToUint(1.0)`).
+const uint k_vsm_cleared_depth_bits = 0x3F800000;
+
+// Matches `GPU_vsm_page_table_entry`.
+struct Vsm_page_table_entry
+{
+    uint tag;
+    uint state;
+    uint last_requested_frame;
+    uint pad0;
+};
+layout(buffer_reference, std430) buffer Vsm_page_table_buffer
+{
+    Vsm_page_table_entry entries[];
+};
+
+// Physical page pool. Depth is stored as `floatBitsToUint()` so that it can
+// be depth tested w/ `atomicMin()` (positive floats order the same as their bits).
+layout(buffer_reference, std430) buffer Vsm_physical_pool_buffer
+{
+    uint texels[];
+};
+
+// Matches `GPU_vsm_params`.
+struct Vsm_params
+{
+    mat4 view;
+    mat4 projection_view;
+    mat4 prev_main_inv_projection_view;
+    ivec2 page_origin;
+    uint frame_idx;
+    uint flags;
+    Vsm_page_table_buffer page_table;
+    Vsm_physical_pool_buffer physical_pool;
+};
+
+// Page table slot of an absolute page coord.
+uint vsm_calc_page_table_slot(ivec2 abs_page)
+{
+    ivec2 wrapped = abs_page & int(k_vsm_num_pages_per_side - 1);
+    return uint(wrapped.y) * k_vsm_num_pages_per_side + uint(wrapped.x);
+}
+
+// Tag of an absolute page coord.
+uint vsm_calc_page_tag(ivec2 abs_page)
+{
+    return (uint(abs_page.x) & 0xFFFF) | (uint(abs_page.y) << 16);
+}
+
+// Absolute page coord of the window that maps to a page table slot.
+ivec2 vsm_calc_slot_abs_page(ivec2 page_origin, uint slot)
+{
+    ivec2 slot_coord = ivec2(slot % k_vsm_num_pages_per_side,
+                             slot / k_vsm_num_pages_per_side);
+    return page_origin +
+        ((slot_coord - page_origin) & int(k_vsm_num_pages_per_side - 1));
+}
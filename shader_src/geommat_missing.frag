@@ -1,4 +1,5 @@
 #version 460
+#extension GL_EXT_buffer_reference : require
 
 layout (location = 0) in vec3 in_normal;
 layout (location = 1) in flat uint in_material_param_idx;
@@ -23,14 +24,20 @@ struct Material_param_definition
 };
 
 // @TODO: PUT THIS INSIDE OF A HELPER THINGY.
-layout (std140, set = 2, binding = 0) readonly buffer Material_param_definitions_buffer
+layout (buffer_reference, std140) readonly buffer Material_param_definitions_buffer
 {
     Material_param_definition definitions[];
-} material_param_definitions_buffer;
+};
+
+// @NOTE: Comes after the vertex stage's instance and draw record buffers.
+layout (push_constant) uniform Params
+{
+    layout (offset = 16) Material_param_definitions_buffer material_param_definitions_buffer;
+} params;
 
 Material_param_definition get_material_param()
 {
-    return material_param_definitions_buffer
+    return params.material_param_definitions_buffer
                .definitions[in_material_param_idx];
 }
 /////////////////////////////////////////////
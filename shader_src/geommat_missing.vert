@@ -5,7 +5,6 @@
 #include "geom_static_mesh_vert.glsl"
 #include "geom_camera_set0.glsl"
 #include "geom_instance_data_br.glsl"
-#include "geom_material_sets_set1.glsl"
 
 layout (location = 0) out vec3 out_normal;
 layout (location = 1) out uint out_material_param_idx;
@@ -13,9 +12,14 @@ layout (location = 1) out uint out_material_param_idx;
 layout (push_constant) uniform Params
 {
     Geo_instance_buffer geo_instance_buffer;
+    Draw_record_buffer  draw_record_buffer;
 } params;
 
 #include "geom_vert_helper_functions.glsl"
+
+// Z prepass and material pass depth has to match exactly (equal depth test).
+invariant gl_Position;
+
 #include "geom_material_sets_helper_functions.glsl"
 
 
@@ -0,0 +1,38 @@
+#version 460
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_buffer_reference : require
+
+// Virtual shadow map data (buffer_reference).
+#include "geom_vsm_br.glsl"
+
+// Virtual shadow map camera (set = 0).
+// @NOTE: `view` and `projection_view` line up w/ `geom_camera_set0.glsl`,
+//   which the vertex shader uses.
+layout(set = 0, binding = 0) uniform Vsm_camera_buffer
+{
+    Vsm_params vsm;
+};
+
+
+void main()
+{
+    // Only write into pages that get re-rendered this frame. Every other
+    // page keeps its cached depth.
+    uvec2 virtual_texel = uvec2(gl_FragCoord.xy);
+    ivec2 abs_page = vsm.page_origin + ivec2(virtual_texel / k_vsm_page_size);
+    Vsm_page_table_entry entry =
+        vsm.page_table.entries[vsm_calc_page_table_slot(abs_page)];
+    if ((entry.state & k_vsm_page_table_entry_rendering) == 0 ||
+        entry.tag != vsm_calc_page_tag(abs_page))
+    {
+        return;
+    }
+
+    uvec2 page_texel = virtual_texel % k_vsm_page_size;
+    uint texel_idx =
+        (entry.state & k_vsm_page_table_entry_physical_page_mask) * k_vsm_num_page_texels +
+        page_texel.y * k_vsm_page_size +
+        page_texel.x;
+    atomicMin(vsm.physical_pool.texels[texel_idx],
+              floatBitsToUint(clamp(gl_FragCoord.z, 0.0, 1.0)));
+}
@@ -9,10 +9,14 @@
 layout (push_constant) uniform Params
 {
     Geo_instance_buffer geo_instance_buffer;
+    Draw_record_buffer  draw_record_buffer;
 } params;
 
 #include "geom_vert_helper_functions.glsl"
 
+// Z prepass and material pass depth has to match exactly (equal depth test).
+invariant gl_Position;
+
 
 void main()
 {
@@ -1,7 +1,10 @@
 #include "camera.h"
 
-// For camera_rig namespace.
+#include <algorithm>
 #include <array>
+#include <cmath>
+
+// For camera_rig namespace.
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include "input_handling_public.h"
@@ -27,10 +30,20 @@ static vec3 s_cam_position{ 0.0f, 0.0f, 0.0f };
 static vec3 s_cam_rot_axes{ 0.0f, 0.0f, 0.0f };
 static vec3 s_cam_view_direction{ 0.0f, 0.0f, 1.0f };
 
+static atomic_bool s_shadow_cache_invalid{ true };
+static vec3 s_sun_direction{ 0.3f, -1.0f, 0.2f };
+static float_t s_max_shadow_distance{ 100.0f };
+static float_t s_shadow_split_lambda{ 0.75f };
+static float_t s_vsm_extent{ 200.0f };
+static float_t s_vsm_depth_range{ 400.0f };
+static std::atomic_uint32_t s_sun_light_version{ 0 };
+
 void internal__set_view_direction_and_rotation_axes(vec3 view_direction,
                                                     float_t cam_pan__rot_y,
                                                     float_t cam_tilt__rot_x,
                                                     float_t cam_roll__rot_z);
+void internal__calc_sun_light_view(mat4& out_light_view);
+void internal__calc_shadow_cascade_matrices();
 
 }  // namespace camera
 
@@ -99,6 +112,27 @@ void camera::set_view_direction_vec3(vec3 view_direction)
                                                    s_cam_rot_axes[2]);
 }
 
+void camera::set_sun_direction(vec3 sun_direction)
+{
+    glm_vec3_normalize_to(sun_direction, s_sun_direction);
+    s_shadow_cache_invalid = true;
+    s_sun_light_version++;
+}
+
+void camera::set_shadow_cascade_props(float_t max_shadow_distance, float_t split_lambda)
+{
+    s_max_shadow_distance = max_shadow_distance;
+    s_shadow_split_lambda = split_lambda;
+    s_shadow_cache_invalid = true;
+}
+
+void camera::set_virtual_shadow_map_props(float_t extent, float_t depth_range)
+{
+    s_vsm_extent = extent;
+    s_vsm_depth_range = depth_range;
+    s_sun_light_version++;
+}
+
 void camera::fetch_matrices(mat4& out_projection,
                             mat4& out_view,
                             mat4& out_projection_view,
@@ -144,13 +178,13 @@ void camera::fetch_matrices(mat4& out_projection,
         glm_mat4_mul(s_calculated_projection_matrix,
                      s_calculated_view_matrix,
                      s_calculated_projection_view_matrix);
+    }
 
+    if (recalc_proj_view_matrix_and_shadows || s_shadow_cache_invalid)
+    {
         // Calculate shadow cascades.
-        s_calculated_shadow_cascade_matrices.clear();
-        // for (uint32_t i = 0; i < s_num_shadow_cascades; i++)
-        // {
-        //     // @TODO
-        // }
+        s_shadow_cache_invalid = false;
+        internal__calc_shadow_cascade_matrices();
     }
 
     glm_mat4_copy(s_calculated_projection_matrix, out_projection);
@@ -159,6 +193,49 @@ void camera::fetch_matrices(mat4& out_projection,
     out_shadow_cascades = s_calculated_shadow_cascade_matrices;
 }
 
+void camera::fetch_virtual_shadow_map_view(Virtual_shadow_map_view& out_view)
+{
+    mat4 light_view;
+    internal__calc_sun_light_view(light_view);
+
+    vec3 center;
+    glm_mat4_mulv3(light_view, s_cam_position, 1.0f, center);
+
+    // Snap the window to whole pages around the camera.
+    float_t page_world_size{ s_vsm_extent / k_vsm_num_pages_per_side };
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        out_view.page_origin[i] =
+            static_cast<int32_t>(std::floor(center[i] / page_world_size)) -
+                static_cast<int32_t>(k_vsm_num_pages_per_side / 2);
+    }
+    float_t min_x{ out_view.page_origin[0] * page_world_size };
+    float_t min_y{ out_view.page_origin[1] * page_world_size };
+
+    // @NOTE: Casters between the sun and the near plane get clamped onto it
+    //   w/ depth clamp, same as the cascades.
+    float_t depth_snap{ s_vsm_depth_range * 0.25f };
+    out_view.depth_center = std::floor(-center[2] / depth_snap) * depth_snap;
+
+    mat4 projection;
+    glm_ortho(min_x, min_x + s_vsm_extent,
+              min_y, min_y + s_vsm_extent,
+              out_view.depth_center - s_vsm_depth_range * 0.5f,
+              out_view.depth_center + s_vsm_depth_range * 0.5f,
+              projection);
+
+    // Remap depth from [-1, 1] to Vulkan's [0, 1].
+    // @NOTE: Not y flipped, so virtual texel coords increase along light
+    //   space x and y, same as the page coords.
+    for (uint32_t col = 0; col < 4; col++)
+    {
+        projection[col][2] = 0.5f * (projection[col][2] + projection[col][3]);
+    }
+
+    glm_mat4_mul(projection, light_view, out_view.projection_view);
+    out_view.light_version = s_sun_light_version;
+}
+
 // Details for Imgui.
 camera::Imgui_requesting_data camera::get_imgui_data()
 {
@@ -206,6 +283,101 @@ void camera::internal__set_view_direction_and_rotation_axes(vec3 view_direction,
     s_view_cache_invalid = true;
 }
 
+void camera::internal__calc_sun_light_view(mat4& out_light_view)
+{
+    // @NOTE: Only a rotation (eye at origin), so that moving the camera only
+    //   translates the shadow maps in light space and they can be texel snapped.
+    vec3 sun_direction;
+    glm_vec3_normalize_to(s_sun_direction, sun_direction);
+    vec3 up{ 0.0f, 1.0f, 0.0f };
+    if (std::abs(glm_vec3_dot(sun_direction, up)) > 0.99f)
+    {
+        glm_vec3_copy(vec3{ 0.0f, 0.0f, 1.0f }, up);
+    }
+    vec3 eye{ 0.0f, 0.0f, 0.0f };
+    glm_look(eye, sun_direction, up, out_light_view);
+}
+
+void camera::internal__calc_shadow_cascade_matrices()
+{
+    // Split the shadow distance w/ the practical split scheme (blend of
+    // uniform and logarithmic splits).
+    float_t shadow_far{ std::min(s_z_far, s_max_shadow_distance) };
+    std::array<float_t, k_num_shadow_cascades + 1> split_depths;
+    split_depths[0] = s_z_near;
+    for (uint32_t i = 1; i <= k_num_shadow_cascades; i++)
+    {
+        float_t t{ static_cast<float_t>(i) / k_num_shadow_cascades };
+        float_t uniform_split{ s_z_near + (shadow_far - s_z_near) * t };
+        float_t log_split{ s_z_near * std::pow(shadow_far / s_z_near, t) };
+        split_depths[i] = glm_lerp(uniform_split, log_split, s_shadow_split_lambda);
+    }
+
+    mat4 light_view;
+    internal__calc_sun_light_view(light_view);
+
+    mat4 inv_view;
+    glm_mat4_inv(s_calculated_view_matrix, inv_view);
+    float_t tan_half_fov_y{ std::tan(s_fov * 0.5f) };
+    float_t tan_half_fov_x{ tan_half_fov_y * s_aspect_ratio };
+
+    s_calculated_shadow_cascade_matrices.resize(k_num_shadow_cascades);
+    for (uint32_t i = 0; i < k_num_shadow_cascades; i++)
+    {
+        float_t slice_near{ split_depths[i] };
+        float_t slice_far{ split_depths[i + 1] };
+
+        // Bounding sphere of the cascade's slice of the view frustum.
+        // @NOTE: Fit in view space, so the radius only depends on the
+        //   projection and the cascade doesn't change size as the camera turns.
+        float_t center_depth{ (slice_near + slice_far) * 0.5f };
+        float_t radius{ 0.0f };
+        for (float_t depth : { slice_near, slice_far })
+        {
+            vec3 corner{ depth * tan_half_fov_x,
+                         depth * tan_half_fov_y,
+                         depth - center_depth };
+            radius = std::max(radius, glm_vec3_norm(corner));
+        }
+        radius = std::ceil(radius * 16.0f) / 16.0f;  // Round up so float error doesn't change the size.
+
+        vec3 center;
+        glm_mat4_mulv3(inv_view, vec3{ 0.0f, 0.0f, -center_depth }, 1.0f, center);
+        glm_mat4_mulv3(light_view, center, 1.0f, center);
+
+        // Snap to shadow map texels so that shadow edges don't shimmer as
+        // the camera moves.
+        float_t texel_size{ (2.0f * radius) / k_shadow_cascade_resolution };
+        center[0] = std::floor(center[0] / texel_size) * texel_size;
+        center[1] = std::floor(center[1] / texel_size) * texel_size;
+
+        // Snap the depth center too, so the matrix only changes in steps as
+        // the camera moves along the sun direction. The far plane gets pushed
+        // out by a step so that the sphere stays covered.
+        // @NOTE: Casters between the sun and the near plane get clamped onto
+        //   it w/ depth clamp, so the depth range only has to cover the sphere.
+        float_t depth_snap{ (2.0f * radius) * 0.25f };
+        float_t depth_center{ std::floor(-center[2] / depth_snap) * depth_snap };
+
+        mat4 projection;
+        glm_ortho(center[0] - radius, center[0] + radius,
+                  center[1] - radius, center[1] + radius,
+                  depth_center - radius, depth_center + radius + depth_snap,
+                  projection);
+
+        // Remap depth from [-1, 1] to Vulkan's [0, 1].
+        for (uint32_t col = 0; col < 4; col++)
+        {
+            projection[col][2] = 0.5f * (projection[col][2] + projection[col][3]);
+        }
+        projection[1][1] *= -1.0f;
+
+        glm_mat4_mul(projection,
+                     light_view,
+                     s_calculated_shadow_cascade_matrices[i].raw);
+    }
+}
+
 
 // Camera rig.
 // @TODO: See `camera.h`
@@ -0,0 +1,251 @@
+#include "cpu_profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+
+namespace cpu_profiler
+{
+
+#ifdef CPU_PROFILER
+struct Zone_record
+{
+    const char* name;
+    uint64_t begin_ns;
+    uint64_t end_ns;
+    uint64_t frame_number;  // Frame the zone ended in.
+};
+
+// Single writer (its thread), any number of readers.
+struct Thread_ring
+{
+    std::array<Zone_record, k_num_thread_zones> records;
+    std::atomic_uint64_t num_written{ 0 };
+};
+
+// Readers skip the oldest entries of a ring, so a writer has to record this
+// many zones during a read before it could overwrite an entry being read.
+constexpr uint32_t k_num_unread_thread_zones{ k_num_thread_zones / 4 };
+
+// @NOTE: Rings are allocated once per thread on its first zone and live for
+//   the rest of the program. Threads past `k_max_threads` don't get recorded.
+static std::array<std::atomic<Thread_ring*>, k_max_threads> s_thread_rings{};
+static std::atomic_uint32_t s_num_thread_rings{ 0 };
+static thread_local Thread_ring* t_thread_ring{ nullptr };
+static thread_local bool t_is_thread_ring_assigned{ false };
+
+static std::atomic_uint64_t s_frame_number{ 0 };
+static std::array<std::atomic_uint64_t, k_num_frame_marks> s_frame_mark_times_ns{};
+
+static Thread_ring* get_thread_ring()
+{
+    if (!t_is_thread_ring_assigned)
+    {
+        t_is_thread_ring_assigned = true;
+        uint32_t ring_idx{ s_num_thread_rings.fetch_add(1) };
+        if (ring_idx < k_max_threads)
+        {
+            t_thread_ring = new Thread_ring;
+            s_thread_rings[ring_idx].store(t_thread_ring, std::memory_order_release);
+        }
+    }
+    return t_thread_ring;
+}
+
+// Calls `func(ring_idx, record)` for every readable zone.
+template<typename Func>
+static void for_each_readable_zone(Func&& func)
+{
+    for (uint32_t ring_idx = 0; ring_idx < k_max_threads; ring_idx++)
+    {
+        Thread_ring* ring{ s_thread_rings[ring_idx].load(std::memory_order_acquire) };
+        if (ring == nullptr)
+            continue;
+
+        constexpr uint64_t k_num_readable{ k_num_thread_zones - k_num_unread_thread_zones };
+        uint64_t num_written{ ring->num_written.load(std::memory_order_acquire) };
+        uint64_t first_idx{ num_written > k_num_readable ? num_written - k_num_readable : 0 };
+        for (uint64_t i = first_idx; i < num_written; i++)
+            func(ring_idx, ring->records[i % k_num_thread_zones]);
+    }
+}
+
+void record_zone(const char* name, uint64_t begin_ns, uint64_t end_ns)
+{
+    Thread_ring* ring{ get_thread_ring() };
+    if (ring == nullptr)
+        return;
+
+    uint64_t idx{ ring->num_written.load(std::memory_order_relaxed) };
+    ring->records[idx % k_num_thread_zones] = Zone_record{
+        .name = name,
+        .begin_ns = begin_ns,
+        .end_ns = end_ns,
+        .frame_number = s_frame_number.load(std::memory_order_relaxed),
+    };
+    ring->num_written.store(idx + 1, std::memory_order_release);
+}
+#endif  // CPU_PROFILER
+
+}  // namespace cpu_profiler
+
+
+uint64_t cpu_profiler::now_ns()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void cpu_profiler::mark_frame()
+{
+#ifdef CPU_PROFILER
+    // @NOTE: Only called by one thread at a time (the submit render job).
+    uint64_t frame_number{ s_frame_number.load(std::memory_order_relaxed) };
+    s_frame_mark_times_ns[frame_number % k_num_frame_marks].store(now_ns(),
+                                                                 std::memory_order_relaxed);
+    s_frame_number.store(frame_number + 1, std::memory_order_release);
+#endif  // CPU_PROFILER
+}
+
+void cpu_profiler::collect_zone_stats(std::vector<Zone_stats>& out_stats)
+{
+    out_stats.clear();
+#ifdef CPU_PROFILER
+    uint64_t end_frame{ s_frame_number.load(std::memory_order_acquire) };
+    uint64_t num_frames{ std::min<uint64_t>(end_frame, k_num_stat_frames) };
+    if (num_frames == 0)
+        return;
+    uint64_t begin_frame{ end_frame - num_frames };
+
+    // @NOTE: Zones are grouped by name contents, since the same literal can
+    //   have different addresses in different translation units.
+    std::vector<uint64_t> total_ns;
+    std::vector<uint64_t> num_calls;
+    for_each_readable_zone([&](uint32_t, const Zone_record& record) {
+        if (record.frame_number < begin_frame || record.frame_number >= end_frame)
+            return;
+
+        size_t stat_idx{ 0 };
+        while (stat_idx < out_stats.size() &&
+               std::strcmp(out_stats[stat_idx].name, record.name) != 0)
+            stat_idx++;
+        if (stat_idx == out_stats.size())
+        {
+            out_stats.emplace_back(Zone_stats{ .name = record.name });
+            total_ns.emplace_back(0);
+            num_calls.emplace_back(0);
+        }
+
+        uint64_t duration_ns{ record.end_ns - record.begin_ns };
+        total_ns[stat_idx] += duration_ns;
+        num_calls[stat_idx]++;
+        out_stats[stat_idx].max_ms =
+            std::max(out_stats[stat_idx].max_ms, static_cast<float_t>(duration_ns / 1000000.0));
+    });
+
+    for (size_t i = 0; i < out_stats.size(); i++)
+    {
+        out_stats[i].avg_ms_per_frame =
+            static_cast<float_t>(total_ns[i] / 1000000.0 / num_frames);
+        out_stats[i].calls_per_frame =
+            static_cast<float_t>(num_calls[i]) / num_frames;
+    }
+#endif  // CPU_PROFILER
+}
+
+uint64_t cpu_profiler::get_num_frames()
+{
+#ifdef CPU_PROFILER
+    return s_frame_number.load(std::memory_order_acquire);
+#else
+    return 0;
+#endif  // CPU_PROFILER
+}
+
+uint32_t cpu_profiler::collect_frame_zones(uint64_t frame_number,
+                                           Frame_zone* out_zones,
+                                           uint32_t max_zones)
+{
+    uint32_t num_zones{ 0 };
+#ifdef CPU_PROFILER
+    // @NOTE: Walks each ring back from its newest zone, since a thread's
+    //   zones are recorded in frame order.
+    constexpr uint64_t k_num_readable{ k_num_thread_zones - k_num_unread_thread_zones };
+    for (uint32_t ring_idx = 0; ring_idx < k_max_threads; ring_idx++)
+    {
+        Thread_ring* ring{ s_thread_rings[ring_idx].load(std::memory_order_acquire) };
+        if (ring == nullptr)
+            continue;
+
+        uint64_t num_written{ ring->num_written.load(std::memory_order_acquire) };
+        uint64_t first_idx{ num_written > k_num_readable ? num_written - k_num_readable : 0 };
+        for (uint64_t i = num_written; i > first_idx && num_zones < max_zones; i--)
+        {
+            auto& record{ ring->records[(i - 1) % k_num_thread_zones] };
+            if (record.frame_number < frame_number)
+                break;
+            if (record.frame_number > frame_number)
+                continue;
+
+            out_zones[num_zones++] = Frame_zone{
+                .name = record.name,
+                .thread_idx = ring_idx,
+                .begin_ns = record.begin_ns,
+                .end_ns = record.end_ns,
+            };
+        }
+    }
+#else
+    (void)frame_number;
+    (void)out_zones;
+    (void)max_zones;
+#endif  // CPU_PROFILER
+    return num_zones;
+}
+
+void cpu_profiler::write_chrome_trace_events(std::ostream& stream,
+                                             uint32_t pid,
+                                             bool& inout_is_first_event)
+{
+#ifdef CPU_PROFILER
+    auto begin_event = [&]() -> std::ostream& {
+        stream << (inout_is_first_event ? "\n" : ",\n");
+        inout_is_first_event = false;
+        return stream;
+    };
+
+    for_each_readable_zone([&](uint32_t ring_idx, const Zone_record& record) {
+        begin_event()
+            << "{\"name\":\"" << record.name << "\","
+            << "\"cat\":\"cpu\","
+            << "\"ph\":\"X\","
+            << "\"pid\":" << pid << ","
+            << "\"tid\":" << ring_idx << ","
+            << "\"ts\":" << (record.begin_ns / 1000.0) << ","
+            << "\"dur\":" << ((record.end_ns - record.begin_ns) / 1000.0) << "}";
+    });
+
+    uint64_t end_frame{ s_frame_number.load(std::memory_order_acquire) };
+    uint64_t num_frames{ std::min<uint64_t>(end_frame, k_num_frame_marks) };
+    for (uint64_t frame = end_frame - num_frames; frame < end_frame; frame++)
+    {
+        uint64_t mark_ns{
+            s_frame_mark_times_ns[frame % k_num_frame_marks].load(std::memory_order_relaxed) };
+        begin_event()
+            << "{\"name\":\"Frame " << frame << "\","
+            << "\"cat\":\"frame\","
+            << "\"ph\":\"i\","
+            << "\"s\":\"g\","
+            << "\"pid\":" << pid << ","
+            << "\"tid\":0,"
+            << "\"ts\":" << (mark_ns / 1000.0) << "}";
+    }
+#else
+    (void)stream;
+    (void)pid;
+    (void)inout_is_first_event;
+#endif  // CPU_PROFILER
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cinttypes>
+#include <cmath>
+#include <ostream>
+#include <vector>
+
+
+// CPU profiler.
+// @NOTE: Every thread records its zones into its own ring buffer, so
+//   recording never takes a lock. The stats and trace export read the rings
+//   from any thread, and only look at the entries that are far enough behind
+//   the writer not to get overwritten mid-read.
+//   Compiled out w/o `CPU_PROFILER` (CMake option), where the macros expand
+//   to nothing and the stats/export come back empty.
+namespace cpu_profiler
+{
+
+constexpr uint32_t k_max_threads{ 64 };
+constexpr uint32_t k_num_thread_zones{ 8192 };  // Ring size per thread.
+constexpr uint32_t k_num_frame_marks{ 256 };
+constexpr uint32_t k_num_stat_frames{ 120 };    // Frames the stats are aggregated over.
+
+uint64_t now_ns();
+
+#ifdef CPU_PROFILER
+// @NOTE: `name` has to outlive the profiler (e.g. a string literal).
+void record_zone(const char* name, uint64_t begin_ns, uint64_t end_ns);
+
+class Scoped_zone
+{
+public:
+    explicit Scoped_zone(const char* name)
+        : m_name(name)
+        , m_begin_ns(now_ns())
+    {
+    }
+
+    ~Scoped_zone()
+    {
+        record_zone(m_name, m_begin_ns, now_ns());
+    }
+
+private:
+    const char* m_name;
+    uint64_t m_begin_ns;
+};
+#endif  // CPU_PROFILER
+
+// Marks the end of a frame.
+void mark_frame();
+
+struct Zone_stats
+{
+    const char* name;
+    float_t avg_ms_per_frame{ 0.0f };  // Summed over all calls (and threads) in a frame.
+    float_t max_ms{ 0.0f };            // Longest single call.
+    float_t calls_per_frame{ 0.0f };
+};
+
+// Stats of the last `k_num_stat_frames` finished frames.
+void collect_zone_stats(std::vector<Zone_stats>& out_stats);
+
+// Number of frames marked so far.
+uint64_t get_num_frames();
+
+struct Frame_zone
+{
+    const char* name;
+    uint32_t thread_idx;
+    uint64_t begin_ns;
+    uint64_t end_ns;
+};
+
+// Writes up to `max_zones` zones that ended during `frame_number` (i.e.
+// before its frame mark) into `out_zones`, w/o allocating. Returns the
+// number written.
+uint32_t collect_frame_zones(uint64_t frame_number, Frame_zone* out_zones, uint32_t max_zones);
+
+// Writes the kept zones and frame marks as comma separated Chrome trace
+// events (`"ts"` in us of `now_ns()`).
+void write_chrome_trace_events(std::ostream& stream, uint32_t pid, bool& inout_is_first_event);
+
+}  // namespace cpu_profiler
+
+#ifdef CPU_PROFILER
+#define CPU_PROFILER_CONCAT_INNER(a, b) a##b
+#define CPU_PROFILER_CONCAT(a, b) CPU_PROFILER_CONCAT_INNER(a, b)
+#define CPU_PROFILER_ZONE(name) \
+    cpu_profiler::Scoped_zone CPU_PROFILER_CONCAT(cpu_profiler_zone_, __LINE__){ name }
+#define CPU_PROFILER_FRAME_MARK() cpu_profiler::mark_frame()
+#else
+#define CPU_PROFILER_ZONE(name)
+#define CPU_PROFILER_FRAME_MARK()
+#endif  // CPU_PROFILER
@@ -5,9 +5,10 @@
 #include <atomic>
 #include <cassert>
 #include <mutex>
+#include "cpu_profiler.h"
 #include "gltf_loader.h"
 #include "material_bank.h"
-#include "timing_reporter_public.h"
+#include "radix_sort.h"
 
 
 // @THEA: This should be enough information to get to the point where you have a functioning material system.
@@ -19,35 +20,101 @@
 namespace geo_instance
 {
 
-// Access the bucket by: Geo render pass and then Pipeline idx.
-using Primitive_list_t = std::vector<Instance_primitive>;
-using Pipeline_primitive_list_map_t = std::unordered_map<Pipeline_id_t, Primitive_list_t>;
-constexpr size_t k_num_render_passes{ static_cast<uint8_t>(Geo_render_pass::NUM_GEO_RENDER_PASSES) };
-using Geo_render_pass_bucketed_primitive_list_array_t =
-    std::array<Pipeline_primitive_list_map_t, k_num_render_passes>;
+// 64-bit draw sort key.
+// | 63..48 | 47..44      | 43..32                | 31..16       | 15..0     |
+// | unused | render pass | pipeline creation idx | material idx | model idx |
+// @NOTE: Rebucketing only happens when instances get (un)registered, so
+//   there's no per-view depth to sort by. The unused bits are all 0, so the
+//   radix sort skips their passes.
+using Draw_sort_key_t = uint64_t;
+constexpr uint32_t k_sort_key_render_pass_shift{ 44 };
+constexpr uint32_t k_sort_key_pipeline_shift{ 32 };
+constexpr uint32_t k_sort_key_material_shift{ 16 };
+constexpr uint32_t k_sort_key_model_shift{ 0 };
+
+static Draw_sort_key_t make_draw_sort_key(Geo_render_pass render_pass,
+                                          uint32_t pipeline_creation_idx,
+                                          uint32_t material_idx,
+                                          uint32_t model_idx)
+{
+    assert(static_cast<uint32_t>(render_pass) < (1u << 4));
+    assert(pipeline_creation_idx < (1u << 12));
+    assert(material_idx < (1u << 16));
+    assert(model_idx < (1u << 16));
+    return (static_cast<Draw_sort_key_t>(render_pass) << k_sort_key_render_pass_shift) |
+           (static_cast<Draw_sort_key_t>(pipeline_creation_idx) << k_sort_key_pipeline_shift) |
+           (static_cast<Draw_sort_key_t>(material_idx) << k_sort_key_material_shift) |
+           (static_cast<Draw_sort_key_t>(model_idx) << k_sort_key_model_shift);
+}
+
+// Rebucketing scratch space.
+// @NOTE: Kept around so that capacities get reused between rebuckets.
+static std::vector<Instance_primitive> s_unsorted_primitives;
+static std::vector<Pipeline_id_t> s_unsorted_pipeline_idxs;
+static std::vector<radix_sort::Key_value_u64> s_sort_entries;
+static std::vector<radix_sort::Key_value_u64> s_sort_scratch;
+static radix_sort::Sort_context s_sort_context;
+
+// Rebucket in progress (between begin and end).
+static std::shared_ptr<Draw_list_snapshot> s_building_snapshot;
+static size_t s_num_rebuild_chunks{ 0 };
+static std::vector<uint32_t> s_chunk_base_instance_idxs;
+static std::vector<uint32_t> s_chunk_base_primitive_idxs;
 
-static Geo_render_pass_bucketed_primitive_list_array_t s_bucketed_instance_primitives_list;
 static std::atomic_bool s_flag_rebucketing{ false };
+
+static std::mutex s_draw_list_snapshot_mutex;
+static Draw_list_snapshot_ref_t s_draw_list_snapshot{
+    std::make_shared<const Draw_list_snapshot>() };
 #if _DEBUG
 static std::atomic_bool s_currently_rebucketing{ false };
 #endif  // _DEBUG
 
 // Instance pool.
+// @NOTE: Structure of arrays. Everything is densely packed in instance
+//   buffer order so that uploading the instance data is one straight copy.
+//   Unregistering only marks the dense entry as dead, and the dead entries
+//   get compacted out when rebucketing. This keeps dense positions stable
+//   in between rebuckets.
 // @NOTE: Could be improved. Very rudimentary.  -Thea 2025/04/10
-constexpr size_t k_num_instances{ 1024 };
+constexpr size_t k_num_instances{ k_max_instances };
+constexpr Geo_instance_key_t k_dead_instance_key{ (Geo_instance_key_t)-1 };
+constexpr uint32_t k_pending_dense_idx{ (uint32_t)-1 };
 
 class Instance_pool
 {
 public:
     struct Data
     {
-        struct Geo_instance_w_reserved_marker
-        {
-            bool is_reserved{ false };
-            Geo_instance geo_instance;
-        };
-        std::array<Geo_instance_w_reserved_marker, k_num_instances> pool;
-        std::vector<uint32_t> registered_indices;
+        // Indexed by instance key.
+        std::array<bool, k_num_instances> is_key_reserved{};
+        std::array<uint32_t, k_num_instances> key_dense_idxs;
+        uint32_t num_registered{ 0 };
+
+        // Densely packed (cold).
+        uint32_t num_dense{ 0 };
+        std::array<Geo_instance_key_t, k_num_instances> dense_keys;
+        std::array<uint32_t, k_num_instances> dense_model_idxs;
+        std::array<Geo_render_pass, k_num_instances> dense_render_passes;
+        std::array<bool, k_num_instances> dense_is_shadow_casters;
+
+        // Instances registered while the dense arrays were full (w/ dead
+        // entries). They get emplaced into the dense arrays at the next
+        // rebucket, after compacting.
+        std::vector<std::pair<Geo_instance_key_t, Geo_instance>> pending_instances;
+
+        // Dense gpu instance datas changed since the last sync to the upload
+        // copy.
+        std::vector<uint32_t> changed_dense_idxs;
+        bool is_all_dense_changed{ true };
+
+        // World bounding spheres of static shadow casters that changed since
+        // the last take.
+        std::vector<gpu_geo_data::GPU_bounding_sphere> static_shadow_caster_changes;
+
+        // Keys of shadow casters (static or not) whose render layer changed
+        // since the last take.
+        std::vector<Geo_instance_key_t> shadow_caster_layer_changes;
     };
 
     class Data_container
@@ -76,12 +143,136 @@ public:
         return Data_container{ m_mutex, m_data };
     }
 
+    // Bypasses the lock for the bucketing chunks.
+    // @NOTE: Only safe for reading dense entries `[0, num_dense)` between
+    //   the begin and end of a rebucket.
+    const Data& unsafe_peek()
+    {
+        return m_data;
+    }
+
 private:
     std::mutex m_mutex;
     Data m_data;
 };
 static Instance_pool s_instance_pool;
 
+// Densely packed (hot).
+// @NOTE: Kept outside of the pool so that uploading can read them without
+//   taking the pool lock. Only written to under the pool lock. Entries below
+//   the latest snapshot's `num_instances` only move when compacting in
+//   `begin_rebuild_bucketed_instance_list_array()`, but the gpu instance
+//   datas get changed by the setters at any time, so uploading reads the
+//   upload copy instead.
+static std::array<gpu_geo_data::GPU_geo_instance_data, k_num_instances> s_dense_gpu_instance_datas;
+static std::array<world_sim::Transform_read_ifc*, k_num_instances> s_dense_transform_reader_handles;
+static std::array<transform_batch::Transform_ref, k_num_instances> s_dense_batched_transforms;
+
+// Copy of the gpu instance datas that only uploading touches.
+// @NOTE: Synced from the dense gpu instance datas at the start of every
+//   upload, and then the upload chunks write the transforms from transform
+//   sources into it.
+static std::array<gpu_geo_data::GPU_geo_instance_data, k_num_instances> s_upload_gpu_instance_datas;
+
+// Compacts dead entries out of the dense arrays, keeping the order of the
+// live ones.
+static void compact_dense_instances(Instance_pool::Data& data)
+{
+    uint32_t write_idx{ 0 };
+    for (uint32_t read_idx = 0; read_idx < data.num_dense; read_idx++)
+    {
+        auto key{ data.dense_keys[read_idx] };
+        if (key == k_dead_instance_key)
+            continue;
+
+        if (read_idx != write_idx)
+        {
+            data.dense_keys[write_idx] = key;
+            data.dense_model_idxs[write_idx] = data.dense_model_idxs[read_idx];
+            data.dense_render_passes[write_idx] = data.dense_render_passes[read_idx];
+            data.dense_is_shadow_casters[write_idx] = data.dense_is_shadow_casters[read_idx];
+            s_dense_gpu_instance_datas[write_idx] = s_dense_gpu_instance_datas[read_idx];
+            s_dense_transform_reader_handles[write_idx] = s_dense_transform_reader_handles[read_idx];
+            s_dense_batched_transforms[write_idx] = s_dense_batched_transforms[read_idx];
+            data.key_dense_idxs[key] = write_idx;
+        }
+        write_idx++;
+    }
+    data.num_dense = write_idx;
+    data.is_all_dense_changed = true;
+    assert(data.num_dense + data.pending_instances.size() == data.num_registered);
+}
+
+// Pending instance of `key`, or nullptr if it's in the dense arrays.
+static Geo_instance* find_pending_instance(Instance_pool::Data& data, Geo_instance_key_t key)
+{
+    if (data.key_dense_idxs[key] != k_pending_dense_idx)
+        return nullptr;
+
+    for (auto& [pending_key, pending_instance] : data.pending_instances)
+    {
+        if (pending_key == key)
+            return &pending_instance;
+    }
+
+    // Pending key not in pending instances.
+    assert(false);
+    return nullptr;
+}
+
+// Records the current bounds of a static shadow caster so that shadow
+// caches overlapping it get invalidated.
+static void record_static_shadow_caster_change(Instance_pool::Data& data, uint32_t dense_idx)
+{
+    auto& gpu_instance_data{ s_dense_gpu_instance_datas[dense_idx] };
+    constexpr uint32_t k_static_shadow_caster_flags{
+        gpu_geo_data::k_instance_flag_shadow_caster | gpu_geo_data::k_instance_flag_static };
+    if ((gpu_instance_data.flags & k_static_shadow_caster_flags) != k_static_shadow_caster_flags)
+        return;
+
+    gltf_loader::Bounding_sphere model_sphere{
+        gltf_loader::get_model(data.dense_model_idxs[dense_idx]).bounding_sphere };
+    gpu_geo_data::GPU_bounding_sphere local_sphere;
+    glm_vec4(model_sphere.origin, model_sphere.radius, local_sphere.origin_xyz_radius_w);
+
+    gpu_geo_data::GPU_bounding_sphere world_sphere;
+    gpu_geo_data::calc_instance_world_bounding_sphere(gpu_instance_data.transform,
+                                                      local_sphere,
+                                                      world_sphere);
+    data.static_shadow_caster_changes.emplace_back(world_sphere);
+}
+
+// Appends a registered instance to the dense arrays.
+// @NOTE: Only appends past `num_dense`, so it doesn't disturb any dense
+//   entries that a rebucket or upload is reading.
+static void emplace_dense_instance(Instance_pool::Data& data,
+                                   Geo_instance_key_t key,
+                                   const Geo_instance& instance)
+{
+    assert(data.num_dense < k_num_instances);
+    uint32_t dense_idx{ data.num_dense++ };
+    data.key_dense_idxs[key] = dense_idx;
+
+    data.dense_keys[dense_idx] = key;
+    data.dense_model_idxs[dense_idx] = instance.model_idx;
+    data.dense_render_passes[dense_idx] = instance.render_pass;
+    data.dense_is_shadow_casters[dense_idx] = instance.is_shadow_caster;
+    s_dense_gpu_instance_datas[dense_idx] = instance.gpu_instance_data;
+    if (instance.is_shadow_caster)
+        s_dense_gpu_instance_datas[dense_idx].flags |= gpu_geo_data::k_instance_flag_shadow_caster;
+    else
+        s_dense_gpu_instance_datas[dense_idx].flags &= ~gpu_geo_data::k_instance_flag_shadow_caster;
+    if (instance.transform_reader_handle == nullptr &&
+        instance.batched_transform.source_key == transform_batch::k_invalid_source_key)
+        s_dense_gpu_instance_datas[dense_idx].flags |= gpu_geo_data::k_instance_flag_static;
+    else
+        s_dense_gpu_instance_datas[dense_idx].flags &= ~gpu_geo_data::k_instance_flag_static;
+    s_dense_transform_reader_handles[dense_idx] = instance.transform_reader_handle;
+    s_dense_batched_transforms[dense_idx] = instance.batched_transform;
+    data.changed_dense_idxs.emplace_back(dense_idx);
+    record_static_shadow_caster_change(data, dense_idx);
+}
+
 }  // namespace geo_instance
 
 
@@ -94,15 +285,30 @@ geo_instance::Geo_instance_key_t geo_instance::register_geo_instance(Geo_instanc
     Geo_instance_key_t new_instance_idx{ (Geo_instance_key_t)-1 };
 
     auto instance_pool{ s_instance_pool.access() };
+    auto& data{ instance_pool.m_data };
     for (size_t i = 0; i < k_num_instances; i++)
     {
-        auto& elem{ instance_pool.m_data.pool[i] };
-        if (!elem.is_reserved)
+        if (!data.is_key_reserved[i])
         {
             // Reserve.
-            elem.geo_instance = std::move(new_instance);
-            elem.is_reserved = true;
-            instance_pool.m_data.registered_indices.emplace_back(i);
+            data.is_key_reserved[i] = true;
+            data.num_registered++;
+
+            auto key{ static_cast<Geo_instance_key_t>(i) };
+            if (data.num_dense < k_num_instances)
+            {
+                emplace_dense_instance(data, key, new_instance);
+            }
+            else
+            {
+                // No room in the dense arrays until the dead entries get
+                // compacted out, so defer to the next rebucket.
+                // @NOTE: Compacting here would move dense entries that a
+                //   rebucket or upload is reading.
+                data.key_dense_idxs[i] = k_pending_dense_idx;
+                data.pending_instances.emplace_back(key, std::move(new_instance));
+            }
+
             new_instance_idx = i;
             break;
         }
@@ -122,13 +328,22 @@ void geo_instance::unregister_geo_instance(Geo_instance_key_t key)
     assert(key < k_num_instances);
 
     // Unreserve geo instance.
+    // @NOTE: The dense entry stays around (dead) until the next rebucket.
     auto instance_pool{ s_instance_pool.access() };
-    instance_pool.m_data.pool[key].is_reserved = false;
-
-    auto& reg_inds{ instance_pool.m_data.registered_indices };
-    reg_inds.erase(
-        std::remove(reg_inds.begin(), reg_inds.end(), static_cast<uint32_t>(key)),
-        reg_inds.end());
+    auto& data{ instance_pool.m_data };
+    assert(data.is_key_reserved[key]);
+    if (find_pending_instance(data, key) != nullptr)
+    {
+        std::erase_if(data.pending_instances,
+                      [key](const auto& pending) { return pending.first == key; });
+    }
+    else
+    {
+        record_static_shadow_caster_change(data, data.key_dense_idxs[key]);
+        data.dense_keys[data.key_dense_idxs[key]] = k_dead_instance_key;
+    }
+    data.is_key_reserved[key] = false;
+    data.num_registered--;
 
     // Flag rebucketing.
     s_flag_rebucketing = true;
@@ -140,23 +355,66 @@ void geo_instance::set_geo_instance_transform(Geo_instance_key_t key, mat4 trans
 
     // Set geo instance transform.
     auto instance_pool{ s_instance_pool.access() };
-    assert(instance_pool.m_data.pool[key].is_reserved);
+    assert(instance_pool.m_data.is_key_reserved[key]);
+
+    if (auto pending_instance{ find_pending_instance(instance_pool.m_data, key) })
+    {
+        gpu_geo_data::set_instance_transform(pending_instance->gpu_instance_data.transform,
+                                             transform);
+        return;
+    }
 
-    glm_mat4_copy(
-        transform,
-        instance_pool.m_data.pool[key].geo_instance.gpu_instance_data.transform);
+    // @NOTE: Both the old and new bounds invalidate shadow caches.
+    uint32_t dense_idx{ instance_pool.m_data.key_dense_idxs[key] };
+    record_static_shadow_caster_change(instance_pool.m_data, dense_idx);
+    gpu_geo_data::set_instance_transform(s_dense_gpu_instance_datas[dense_idx].transform,
+                                         transform);
+    instance_pool.m_data.changed_dense_idxs.emplace_back(dense_idx);
+    record_static_shadow_caster_change(instance_pool.m_data, dense_idx);
 }
 
-void geo_instance::rebuild_bucketed_instance_list_array(std::vector<vk_buffer::GPU_geo_per_frame_buffer*>& all_per_frame_buffers)
+void geo_instance::set_geo_instance_render_layer(Geo_instance_key_t key,
+                                                 gpu_geo_data::Render_layer render_layer)
 {
-    if (!s_flag_rebucketing)
+    assert(key < k_num_instances);
+
+    // Set geo instance render layer.
+    auto instance_pool{ s_instance_pool.access() };
+    assert(instance_pool.m_data.is_key_reserved[key]);
+
+    if (auto pending_instance{ find_pending_instance(instance_pool.m_data, key) })
+    {
+        pending_instance->gpu_instance_data.render_layer = static_cast<uint32_t>(render_layer);
         return;
+    }
+
+    uint32_t dense_idx{ instance_pool.m_data.key_dense_idxs[key] };
+    s_dense_gpu_instance_datas[dense_idx].render_layer = static_cast<uint32_t>(render_layer);
+    instance_pool.m_data.changed_dense_idxs.emplace_back(dense_idx);
+    record_static_shadow_caster_change(instance_pool.m_data, dense_idx);
+    if (s_dense_gpu_instance_datas[dense_idx].flags & gpu_geo_data::k_instance_flag_shadow_caster)
+        instance_pool.m_data.shadow_caster_layer_changes.emplace_back(key);
+}
+
+void geo_instance::flag_rebucket()
+{
+    s_flag_rebucketing = true;
+}
+
+bool geo_instance::begin_rebuild_bucketed_instance_list_array(std::vector<vk_buffer::GPU_geo_per_frame_buffer*>& all_per_frame_buffers,
+                                                              size_t num_chunks)
+{
+    assert(num_chunks > 0);
+
+    // @NOTE: Clear the flag up front so that a register/unregister
+    //   happening during the rebucket flags another rebucket.
+    if (!s_flag_rebucketing.exchange(false))
+        return false;
 #if _DEBUG
+    assert(!s_currently_rebucketing);
     s_currently_rebucketing = true;
 #endif  // _DEBUG
 
-    TIMING_REPORT_START(rebucket);
-
     // Insert built up changed instance indices.
     // @TODO: perhaps include something like this in the future but for now just mark a rebuild.
     // vk_buffer::set_new_changed_indices(std::move(s_changed_inst_indices),
@@ -168,31 +426,82 @@ void geo_instance::rebuild_bucketed_instance_list_array(std::vector<vk_buffer::G
     // of the instance if it's just the only thing(s) that have updated.  -Thea 2025/02/19
     vk_buffer::flag_update_all_instances(all_per_frame_buffers);
 
-    // Clear bucket.
-    for (auto& instance_list_map : s_bucketed_instance_primitives_list)  // @CHECK: does a mem leak happen here?????
+    s_building_snapshot = std::make_shared<Draw_list_snapshot>();
+
+    // Compact dense instances and emplace the pending ones.
+    // @NOTE: The only place that moves dense entries. Any (un)registering
+    //   while the chunks are bucketing only touches dense entries outside of
+    //   `[0, num_instances)` (or just marks them dead), and flags another
+    //   rebucket.
+    uint32_t num_instances;
     {
-        instance_list_map.clear();
+        auto instance_pool{ s_instance_pool.access() };
+        auto& pool_data{ instance_pool.m_data };
+        compact_dense_instances(pool_data);
+        for (auto& [key, pending_instance] : pool_data.pending_instances)
+        {
+            emplace_dense_instance(pool_data, key, pending_instance);
+        }
+        pool_data.pending_instances.clear();
+        num_instances = pool_data.num_dense;
+        s_building_snapshot->instance_keys.assign(pool_data.dense_keys.begin(),
+                                                  pool_data.dense_keys.begin() + num_instances);
     }
+    s_building_snapshot->num_instances = num_instances;
+    auto& data{ s_instance_pool.unsafe_peek() };
 
-    // Sort registered indices.
-    auto instance_pool{ s_instance_pool.access() };
-
-    std::sort(instance_pool.m_data.registered_indices.begin(),
-              instance_pool.m_data.registered_indices.end());
+    // Split instances into chunks and prefix sum where each chunk's
+    // primitives start, so every chunk writes into its own slice.
+    s_num_rebuild_chunks = num_chunks;
+    s_chunk_base_instance_idxs.resize(num_chunks + 1);
+    s_chunk_base_primitive_idxs.resize(num_chunks + 1);
 
-    // Bucket instances.
-    for (auto reg_idx : instance_pool.m_data.registered_indices)
+    uint32_t num_primitives{ 0 };
+    for (size_t chunk_idx = 0; chunk_idx < num_chunks; chunk_idx++)
     {
-        auto& pool_elem{ instance_pool.m_data.pool[reg_idx] };
+        size_t begin_idx{ num_instances * chunk_idx / num_chunks };
+        size_t end_idx{ num_instances * (chunk_idx + 1) / num_chunks };
 
-        // For some reason the pool elem is not reserved.
-        assert(pool_elem.is_reserved);
+        s_chunk_base_instance_idxs[chunk_idx] = static_cast<uint32_t>(begin_idx);
+        s_chunk_base_primitive_idxs[chunk_idx] = num_primitives;
+        for (size_t i = begin_idx; i < end_idx; i++)
+        {
+            num_primitives +=
+                static_cast<uint32_t>(gltf_loader::get_model(data.dense_model_idxs[i]).primitives.size());
+        }
+    }
+    s_chunk_base_instance_idxs[num_chunks] = num_instances;
+    s_chunk_base_primitive_idxs[num_chunks] = num_primitives;
+
+    s_unsorted_primitives.resize(num_primitives);
+    s_unsorted_pipeline_idxs.resize(num_primitives);
+    s_sort_entries.resize(num_primitives);
+    radix_sort::begin_sort(s_sort_entries, s_sort_scratch, num_chunks, s_sort_context);
+
+    return true;
+}
+
+void geo_instance::rebuild_bucketed_instance_list_array__bucket_chunk(size_t chunk_idx)
+{
+#if _DEBUG
+    assert(s_currently_rebucketing);
+#endif  // _DEBUG
+    assert(chunk_idx < s_num_rebuild_chunks);
 
-        // Place geo instance into bucket.
-        auto& instance{ pool_elem.geo_instance };
-        auto& model{ gltf_loader::get_model(instance.model_idx) };
+    auto& data{ s_instance_pool.unsafe_peek() };
+    uint32_t primitive_write_idx{ s_chunk_base_primitive_idxs[chunk_idx] };
+
+    // Bucket instances.
+    for (uint32_t inst_idx = s_chunk_base_instance_idxs[chunk_idx];
+         inst_idx < s_chunk_base_instance_idxs[chunk_idx + 1];
+         inst_idx++)
+    {
+        auto model_idx{ data.dense_model_idxs[inst_idx] };
+        auto render_pass{ data.dense_render_passes[inst_idx] };
+        auto& model{ gltf_loader::get_model(model_idx) };
         auto& material_set{
-            material_bank::get_material_set(instance.gpu_instance_data.material_param_set_idx) };
+            material_bank::get_material_set(
+                s_dense_gpu_instance_datas[inst_idx].material_param_set_idx) };
         
         // @NOTE: assert that the model's number of materials matches the number
         //        of materials in the material set.
@@ -202,159 +511,189 @@ void geo_instance::rebuild_bucketed_instance_list_array(std::vector<vk_buffer::G
         {
             auto& primitive{ model.primitives[i] };
             auto& material_idx{ material_set.material_indexes[i] };
-            auto& pipeline_idx{ material_bank::get_material(material_idx).pipeline_idx };
-            s_bucketed_instance_primitives_list
-                [static_cast<uint8_t>(instance.render_pass)]
-                [pipeline_idx]
-                    .emplace_back(&primitive, &instance);
+            auto& material{ material_bank::get_material(material_idx) };
+            auto& pipeline_idx{ material.pipeline_idx };
+            auto& pipeline{ material_bank::get_pipeline(pipeline_idx) };
+
+            s_sort_entries[primitive_write_idx] = radix_sort::Key_value_u64{
+                .key = make_draw_sort_key(render_pass,
+                                          pipeline.calculated.pipeline_creation_idx,
+                                          material_idx,
+                                          model_idx),
+                .value = primitive_write_idx,
+            };
+            s_unsorted_primitives[primitive_write_idx] =
+                Instance_primitive{ &primitive,
+                                    inst_idx,
+                                    material.cooked_material_param_local_idx };
+            s_unsorted_pipeline_idxs[primitive_write_idx] = pipeline_idx;
+            primitive_write_idx++;
         }
     }
 
-    TIMING_REPORT_END_AND_PRINT(rebucket, "Instance List Array Rebucket: ");
+    // Chunk should have filled exactly its slice.
+    assert(primitive_write_idx == s_chunk_base_primitive_idxs[chunk_idx + 1]);
 
-    // End process.
+    radix_sort::scan_chunk_keys(s_sort_context,
+                                chunk_idx,
+                                s_chunk_base_primitive_idxs[chunk_idx],
+                                s_chunk_base_primitive_idxs[chunk_idx + 1]);
+}
+
+uint32_t geo_instance::get_rebuild_num_sort_passes()
+{
 #if _DEBUG
-    s_currently_rebucketing = false;
+    assert(s_currently_rebucketing);
 #endif  // _DEBUG
-    s_flag_rebucketing = false;
+    return radix_sort::get_num_passes(s_sort_context);
 }
 
-std::vector<geo_instance::Geo_instance*> geo_instance::get_all_unique_instances()
+void geo_instance::rebuild_bucketed_instance_list_array__sort_histogram_chunk(uint32_t pass_idx,
+                                                                              size_t chunk_idx)
 {
-    std::vector<Geo_instance*> instances;
-
-    auto instance_pool{ s_instance_pool.access() };
-
-    uint32_t inst_count{
-        static_cast<uint32_t>(instance_pool.m_data.registered_indices.size()) };
-    assert(inst_count <= k_num_instances);
-
-    instances.reserve(inst_count);
-    for (auto reg_idx : instance_pool.m_data.registered_indices)
-    {
-        // Make sure geo instance is registered.
-        assert(instance_pool.m_data.pool[reg_idx].is_reserved);
-        instances.emplace_back(&instance_pool.m_data.pool[reg_idx].geo_instance);
-    }
+#if _DEBUG
+    assert(s_currently_rebucketing);
+#endif  // _DEBUG
+    radix_sort::sort_pass__histogram_chunk(s_sort_context, pass_idx, chunk_idx);
+}
 
-    return instances;
+void geo_instance::rebuild_bucketed_instance_list_array__sort_scatter_chunk(uint32_t pass_idx,
+                                                                            size_t chunk_idx)
+{
+#if _DEBUG
+    assert(s_currently_rebucketing);
+#endif  // _DEBUG
+    radix_sort::sort_pass__scatter_chunk(s_sort_context, pass_idx, chunk_idx);
 }
 
-uint32_t geo_instance::get_unique_instances_count()
+void geo_instance::end_rebuild_bucketed_instance_list_array()
 {
-    auto instance_pool{ s_instance_pool.access() };
+#if _DEBUG
+    assert(s_currently_rebucketing);
+#endif  // _DEBUG
 
-    uint32_t inst_count{
-        static_cast<uint32_t>(instance_pool.m_data.registered_indices.size()) };
-    assert(inst_count <= k_num_instances);
+    auto new_snapshot{ std::move(s_building_snapshot) };
 
-    return inst_count;
-}
+    // Primitives got sorted by key in the sort chunks.
+    radix_sort::end_sort(s_sort_context);
 
-geo_instance::Primitive_ptr_list_t geo_instance::get_all_primitives()
-{
-    Primitive_ptr_list_t inst_prims;
+    // Flatten sorted primitives into snapshot.
+    // @NOTE: A new render group starts whenever the render pass or
+    //   pipeline changes between sorted neighbors.
+    auto& primitives{ new_snapshot->primitives };
+    auto& render_groups{ new_snapshot->render_groups };
+    auto& render_passes{ new_snapshot->render_passes };
+    primitives.reserve(s_sort_entries.size());
 
-    if (!s_flag_rebucketing)
+    size_t prev_pass_idx{ (size_t)-1 };
+    for (auto& entry : s_sort_entries)
     {
-        // @INCOMPLETE: asdfasdfasdfasdfasdf
-        // @NOTE: this may be the exact way this is addressed since this is the bucket notation stuff.
-        for (auto& render_pass : s_bucketed_instance_primitives_list)
-        for (auto it = render_pass.begin(); it != render_pass.end(); it++)
-        for (auto& instance_primitive : it->second)
+        size_t pass_idx{ static_cast<size_t>(entry.key >> k_sort_key_render_pass_shift) };
+        Pipeline_id_t pipeline_idx{ s_unsorted_pipeline_idxs[entry.value] };
+        assert(pass_idx < k_num_geo_render_passes);
+
+        if (pass_idx != prev_pass_idx ||
+            render_groups.back().pipeline_idx != pipeline_idx)
         {
-            inst_prims.emplace_back(&instance_primitive);
+            render_groups.emplace_back(Draw_list_snapshot::Render_group{
+                .pipeline_idx = pipeline_idx,
+                .base_primitive_idx = static_cast<uint32_t>(primitives.size()),
+                .num_primitives = 0,
+            });
+            render_passes[pass_idx].num_render_groups++;
+            prev_pass_idx = pass_idx;
         }
-        inst_prims.shrink_to_fit();
-        ////////////////////////////////////
-    }
 
-    return inst_prims;
-}
+        render_groups.back().num_primitives++;
+        render_passes[pass_idx].num_primitives++;
+        primitives.emplace_back(s_unsorted_primitives[entry.value]);
+    }
 
-geo_instance::Per_pipeline_primitive_ptr_list_t geo_instance::get_pipeline_grouped_primitives(
-    Geo_render_pass render_pass_id)
-{
-    Per_pipeline_primitive_ptr_list_t inst_prims_grouped;
+    // Sorted by render pass first, so pass ranges are back to back.
+    uint32_t base_primitive_idx{ 0 };
+    uint32_t base_render_group_idx{ 0 };
+    for (auto& pass_range : render_passes)
+    {
+        pass_range.base_primitive_idx = base_primitive_idx;
+        pass_range.base_render_group_idx = base_render_group_idx;
+        base_primitive_idx += pass_range.num_primitives;
+        base_render_group_idx += pass_range.num_render_groups;
+    }
 
-    if (!s_flag_rebucketing)
+    // Publish snapshot.
     {
-        // @INCOMPLETE: asdfasdfasdfasdfasdf
-        // @NOTE: this may be the exact way this is addressed since this is the bucket notation stuff.
-        auto& render_pass{
-            s_bucketed_instance_primitives_list[static_cast<size_t>(render_pass_id)]
-        };
-        for (auto it = render_pass.begin(); it != render_pass.end(); it++)
-        {
-            for (auto& instance_primitive : it->second)
-            {
-                inst_prims_grouped[it->first].emplace_back(&instance_primitive);
-            }
-            inst_prims_grouped[it->first].shrink_to_fit();
-        }
-        ////////////////////////////////////
+        std::lock_guard<std::mutex> lock{ s_draw_list_snapshot_mutex };
+        new_snapshot->version = s_draw_list_snapshot->version + 1;
+        s_draw_list_snapshot = std::move(new_snapshot);
     }
 
-    return inst_prims_grouped;
+    // End process.
+#if _DEBUG
+    s_currently_rebucketing = false;
+#endif  // _DEBUG
 }
 
-geo_instance::Primitive_render_group_list_t geo_instance::get_all_base_primitive_indices()
+geo_instance::Draw_list_snapshot_ref_t geo_instance::get_draw_list_snapshot()
 {
-    Primitive_render_group_list_t render_group_list;
+    std::lock_guard<std::mutex> lock{ s_draw_list_snapshot_mutex };
+    return s_draw_list_snapshot;
+}
 
-    if (!s_flag_rebucketing)
-    {
-        // @INCOMPLETE: asdfasdfasdfasdfasdf
-        // @NOTE: this may be the exact way this is addressed since this is the bucket notation stuff.
-        uint32_t current_primitive_idx{ 0 };
-        for (auto& render_pass : s_bucketed_instance_primitives_list)
-        for (auto it = render_pass.begin(); it != render_pass.end(); it++)
-        {
-            render_group_list.emplace_back(it->first, current_primitive_idx);
-            current_primitive_idx += it->second.size();
-        }
-        render_group_list.shrink_to_fit();
-        ////////////////////////////////////
-    }
+void geo_instance::take_static_shadow_caster_changes(std::vector<gpu_geo_data::GPU_bounding_sphere>& out_world_spheres)
+{
+    auto instance_pool{ s_instance_pool.access() };
+    auto& changes{ instance_pool.m_data.static_shadow_caster_changes };
+    out_world_spheres.insert(out_world_spheres.end(), changes.begin(), changes.end());
+    changes.clear();
+}
 
-    return render_group_list;
+void geo_instance::take_shadow_caster_layer_changes(std::vector<Geo_instance_key_t>& out_keys)
+{
+    auto instance_pool{ s_instance_pool.access() };
+    auto& changes{ instance_pool.m_data.shadow_caster_layer_changes };
+    out_keys.insert(out_keys.end(), changes.begin(), changes.end());
+    changes.clear();
 }
 
-uint32_t geo_instance::get_number_primitives(Geo_render_pass render_pass_id)
+void geo_instance::sync_upload_gpu_instance_datas(const Draw_list_snapshot& draw_list)
 {
-    uint32_t count{ 0 };
+    auto instance_pool{ s_instance_pool.access() };
+    auto& data{ instance_pool.m_data };
+    uint32_t num_instances{ draw_list.num_instances };
+    assert(num_instances <= data.num_dense);
 
-    if (!s_flag_rebucketing)
+    if (data.is_all_dense_changed)
+    {
+        std::copy_n(s_dense_gpu_instance_datas.begin(),
+                    num_instances,
+                    s_upload_gpu_instance_datas.begin());
+        data.is_all_dense_changed = false;
+    }
+    else
     {
-        // @INCOMPLETE: asdfasdfasdfasdfasdf
-        // @NOTE: this may be the exact way this is addressed since this is the bucket notation stuff.
-        auto& render_pass{
-            s_bucketed_instance_primitives_list[static_cast<size_t>(render_pass_id)]
-        };
-        for (auto it = render_pass.begin(); it != render_pass.end(); it++)
+        // @NOTE: Changes past `num_instances` aren't in the snapshot yet,
+        //   and compacting flags everything as changed anyways.
+        for (uint32_t dense_idx : data.changed_dense_idxs)
         {
-            count += it->second.size();
+            if (dense_idx < num_instances)
+                s_upload_gpu_instance_datas[dense_idx] = s_dense_gpu_instance_datas[dense_idx];
         }
-        ////////////////////////////////////
     }
-
-    return count;
+    data.changed_dense_idxs.clear();
 }
 
-uint32_t geo_instance::get_num_primitive_render_groups(Geo_render_pass render_pass_id)
+gpu_geo_data::GPU_geo_instance_data* geo_instance::get_upload_gpu_instance_datas()
 {
-    uint32_t count{ 0 };
+    return s_upload_gpu_instance_datas.data();
+}
 
-    if (!s_flag_rebucketing)
-    {
-        // @INCOMPLETE: asdfasdfasdfasdfasdf
-        // @NOTE: this may be the exact way this is addressed since this is the bucket notation stuff.
-        auto& render_pass{
-            s_bucketed_instance_primitives_list[static_cast<size_t>(render_pass_id)]
-        };
-        count = render_pass.size();
-        ////////////////////////////////////
-    }
+world_sim::Transform_read_ifc* const* geo_instance::get_dense_transform_reader_handles()
+{
+    return s_dense_transform_reader_handles.data();
+}
 
-    return count;
+const transform_batch::Transform_ref* geo_instance::get_dense_batched_transforms()
+{
+    return s_dense_batched_transforms.data();
 }
+
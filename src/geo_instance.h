@@ -1,20 +1,23 @@
 #pragma once
 
+#include <array>
 #include <cinttypes>
-#include <unordered_map>
-#include <utility>  // For `std::pair`.
+#include <memory>
 #include <vector>
 #include "cglm/cglm.h"
 #include "geo_render_pass.h"
 #include "gltf_loader.h"
 #include "gpu_geo_data.h"
 #include "renderer_win64_vk_buffer.h"
+#include "transform_batch_source.h"
 namespace world_sim { class Transform_read_ifc; }
 
 
 namespace geo_instance
 {
 
+// Description of a geo instance to register.
+// @NOTE: The instance store splits this up into separate arrays.
 struct Geo_instance
 {
     uint32_t model_idx{ (uint32_t)-1 };
@@ -29,48 +32,136 @@ struct Geo_instance
     //   sure that the changed data is visible.
     world_sim::Transform_read_ifc* transform_reader_handle{ nullptr };
 
-    // Position in instance buffer where this instance
-    // is uploaded on the GPU.
-    uint32_t cooked_buffer_instance_id;
+    // Batched transform source (takes priority over the transform reader handle).
+    transform_batch::Transform_ref batched_transform;
 
     gpu_geo_data::GPU_geo_instance_data gpu_instance_data;
 };
 
-// Primitive w/ corresponding ptr to instance.
+// Primitive w/ corresponding instance.
 struct Instance_primitive  // @TODO: rename to Primitive_wc_instance
 {
     const gltf_loader::Primitive* primitive;
-    const Geo_instance* instance;
+
+    // Position in instance buffer where the instance
+    // is uploaded on the GPU.
+    uint32_t instance_idx;
+
+    // Material param idx of the primitive's material (resolved while
+    // bucketing so the GPU doesn't have to go thru the material param set).
+    uint32_t material_param_idx;
 };
 
 using Geo_instance_key_t = uint32_t;
 
+// Max registered geo instances (the instance buffer never grows past this).
+// @NOTE: The instance store and the per instance key GPU buffers (VSM
+//   instance keys and previous bounds) are allocated at this size up front.
+constexpr uint32_t k_max_instances{ 16384 };
+
 Geo_instance_key_t register_geo_instance(Geo_instance&& new_instance);
 
 void unregister_geo_instance(Geo_instance_key_t key);
 
 void set_geo_instance_transform(Geo_instance_key_t key, mat4 transform);
 
-void rebuild_bucketed_instance_list_array(std::vector<vk_buffer::GPU_geo_per_frame_buffer*>& all_per_frame_buffers);
-
-std::vector<Geo_instance*> get_all_unique_instances();
+void set_geo_instance_render_layer(Geo_instance_key_t key, gpu_geo_data::Render_layer render_layer);
 
-uint32_t get_unique_instances_count();
-
-using Primitive_ptr_list_t = std::vector<Instance_primitive*>;
-Primitive_ptr_list_t get_all_primitives();
+// Flags a rebucket w/o any instance changing (for benchmarking the rebucket).
+void flag_rebucket();
 
 using Pipeline_id_t = uint32_t;
-using Per_pipeline_primitive_ptr_list_t = std::unordered_map<uint32_t, Primitive_ptr_list_t>;
-Per_pipeline_primitive_ptr_list_t get_pipeline_grouped_primitives(Geo_render_pass render_pass_id);
-
-using Base_primitive_idx_t = uint32_t;
-using Primitive_render_group_t = std::pair<Pipeline_id_t, Base_primitive_idx_t>;
-using Primitive_render_group_list_t = std::vector<Primitive_render_group_t>;
-Primitive_render_group_list_t get_all_base_primitive_indices();  // @TODO: reorder to higher up.
-
-uint32_t get_number_primitives(Geo_render_pass render_pass_id);
-
-uint32_t get_num_primitive_render_groups(Geo_render_pass render_pass_id);
+constexpr size_t k_num_geo_render_passes{
+    static_cast<size_t>(Geo_render_pass::NUM_GEO_RENDER_PASSES) };
+
+// Immutable, flattened view of all bucketed instance primitives.
+// @NOTE: Built once per rebucket. Everything that needs the bucketed lists
+//   reads from the snapshot instead of building its own copy, and holding
+//   onto the snapshot keeps it valid even after the next rebucket.
+struct Draw_list_snapshot
+{
+    // Incremented every rebucket.
+    uint64_t version{ 0 };
+
+    // Instances `[0, num_instances)` of the dense instance data arrays.
+    uint32_t num_instances{ 0 };
+
+    // Instance key of every dense instance (`num_instances` long).
+    std::vector<Geo_instance_key_t> instance_keys;
+
+    // All primitives, ordered by render pass and then render group.
+    std::vector<Instance_primitive> primitives;
+
+    // Primitives of the same render pass that share a pipeline.
+    // @NOTE: One render group is one indirect count buffer entry.
+    struct Render_group
+    {
+        Pipeline_id_t pipeline_idx;
+        uint32_t base_primitive_idx;  // Into `primitives`.
+        uint32_t num_primitives;
+    };
+    std::vector<Render_group> render_groups;
+
+    struct Render_pass_range
+    {
+        uint32_t base_primitive_idx{ 0 };
+        uint32_t num_primitives{ 0 };
+        uint32_t base_render_group_idx{ 0 };
+        uint32_t num_render_groups{ 0 };
+    };
+    std::array<Render_pass_range, k_num_geo_render_passes> render_passes;
+
+    inline const Render_pass_range& get_render_pass(Geo_render_pass render_pass_id) const
+    {
+        return render_passes[static_cast<size_t>(render_pass_id)];
+    }
+};
+using Draw_list_snapshot_ref_t = std::shared_ptr<const Draw_list_snapshot>;
+
+// Rebucket split into phases so that bucketing and sorting can run as
+// parallel jobs.
+// @NOTE: Call begin, then bucket every chunk `[0, num_chunks)`. Then for
+//   every sort pass `[0, get_rebuild_num_sort_passes())`, histogram every
+//   chunk and then scatter every chunk. Then end. Chunks of the same phase
+//   may run concurrently. Returns false from begin if no rebucket is
+//   needed, in which case the other phases must be skipped.
+bool begin_rebuild_bucketed_instance_list_array(std::vector<vk_buffer::GPU_geo_per_frame_buffer*>& all_per_frame_buffers,
+                                                size_t num_chunks);
+void rebuild_bucketed_instance_list_array__bucket_chunk(size_t chunk_idx);
+uint32_t get_rebuild_num_sort_passes();
+void rebuild_bucketed_instance_list_array__sort_histogram_chunk(uint32_t pass_idx, size_t chunk_idx);
+void rebuild_bucketed_instance_list_array__sort_scatter_chunk(uint32_t pass_idx, size_t chunk_idx);
+void end_rebuild_bucketed_instance_list_array();
+
+// Latest draw list snapshot (never null).
+Draw_list_snapshot_ref_t get_draw_list_snapshot();
+
+// Appends the world bounding spheres of static shadow casters that got
+// (un)registered, moved or changed render layer since the last take.
+// @NOTE: Moving records both the old and new bounds.
+void take_static_shadow_caster_changes(std::vector<gpu_geo_data::GPU_bounding_sphere>& out_world_spheres);
+
+// Appends the keys of shadow casters whose render layer changed since the
+// last take.
+// @NOTE: Their bounds don't change, so the virtual shadow map gets these
+//   instead of diffing bounding spheres. Take before syncing the upload copy,
+//   so that a change never gets uploaded before its record is taken.
+void take_shadow_caster_layer_changes(std::vector<Geo_instance_key_t>& out_keys);
+
+// Copies the gpu instance datas that changed since the last sync into the
+// upload copy.
+// @NOTE: Call before the upload chunks, w/ the snapshot being uploaded.
+void sync_upload_gpu_instance_datas(const Draw_list_snapshot& draw_list);
+
+// Instance data, densely packed in instance buffer order.
+// @NOTE: The dense order only changes in
+//   `begin_rebuild_bucketed_instance_list_array()`, so in between,
+//   `[0, Draw_list_snapshot::num_instances)` of the latest snapshot is safe
+//   to read while uploading. The upload copy is only touched by uploading,
+//   so the upload chunks may write the transforms from transform sources
+//   into it.
+gpu_geo_data::GPU_geo_instance_data* get_upload_gpu_instance_datas();
+world_sim::Transform_read_ifc* const* get_dense_transform_reader_handles();
+const transform_batch::Transform_ref* get_dense_batched_transforms();
 
 }  // namespace geo_instance
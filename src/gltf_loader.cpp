@@ -120,12 +120,6 @@ gltf_loader::Vertex_input_description gltf_loader::GPU_vertex::get_static_vertex
                 .format = VK_FORMAT_R32G32B32A32_SFLOAT,
                 .offset = offsetof(GPU_vertex, color),
             },
-            VkVertexInputAttributeDescription{
-                .location = 4,
-                .binding = 0,
-                .format = VK_FORMAT_R32_UINT,
-                .offset = offsetof(GPU_vertex, primitive_idx),
-            },
         },
         .flags{ 0 },
     };
@@ -204,11 +198,6 @@ bool gltf_loader::load_gltf(const std::string& model_name, const std::string& pa
         base_vertex = base_vertex_load;
     } while (!s_indices_base_vertex.compare_exchange_weak(base_vertex_load, (uint32_t)-1));
 
-    // @NOTE: Primitive index is the primitive num inside of each individual model.
-    //        Used for finding which material to access within a material set.
-    //        See `GPU_vertex`.
-    size_t primitive_index{ 0 };
-
     // Create a new model.
     // Also, create an AABB to convert into a bounding sphere.
     // @NOTE: The resulting bounding sphere is certainly going to be
@@ -255,9 +244,7 @@ bool gltf_loader::load_gltf(const std::string& model_name, const std::string& pa
                                                       [&](vec3s vec, size_t index) {
                 auto& vert{ s_staging_vertices[base_vertex + index] };
                 glm_vec3_copy(vec.raw, vert.position);
-                vert.primitive_idx = 0;
                 glm_vec3_zero(vert.normal);
-                vert.pad0 = 0;
                 glm_vec2_zero(vert.uv);
                 glm_vec4_zero(vert.color);
 
@@ -266,10 +253,6 @@ bool gltf_loader::load_gltf(const std::string& model_name, const std::string& pa
                 glm_vec3_maxv(max_pos, vec.raw, max_pos);
             });
 
-            // Primitive index.
-            for (size_t index = 0; index < num_new_vertices; index++)
-                s_staging_vertices[base_vertex + index].primitive_idx = primitive_index;
-
             // Normal.
             auto normal_attribute{ primitive.findAttribute(k_normal_str) };
             if (normal_attribute != primitive.attributes.end())
@@ -309,7 +292,6 @@ bool gltf_loader::load_gltf(const std::string& model_name, const std::string& pa
             // @TODO: @THEA: add joints and weights.
         }
 
-        primitive_index++;
         base_vertex = s_staging_vertices.size();
         new_primitive.index_count =
             (s_staging_indices.size() - new_primitive.start_index);
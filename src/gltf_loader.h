@@ -28,9 +28,7 @@ struct Vertex_input_description
 struct GPU_vertex
 {
     vec3     position;
-    uint32_t primitive_idx;
 	vec3     normal;
-    uint32_t pad0;
 	vec2     uv;
 	vec4     color;
 
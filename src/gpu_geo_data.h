@@ -1,39 +1,273 @@
 #pragma once
 
+#include <cmath>
 #include <vector>
+#include "camera.h"
 #include "cglm/cglm.h"
+#include "geo_render_layer.h"
 
 
 namespace gpu_geo_data
 {
 
-enum class Render_layer : uint32_t
+// Instance transform.
+// @NOTE: With `GEO_COMPACT_INSTANCE_TRANSFORMS` (CMake option) the transform
+//   is stored as translation, rotation and scale (48 bytes instead of 64).
+//   The vertex shader then gets the normal transform from the rotation and
+//   inverse scale instead of inverting a mat3 for every vertex.
+#ifdef GEO_COMPACT_INSTANCE_TRANSFORMS
+struct GPU_instance_transform
 {
-    DEFAULT = 0,
-    INVISIBLE,
-    LEVEL_EDITOR,
-    NUM_RENDER_LAYERS
+    versor rotation = GLM_QUAT_IDENTITY_INIT;
+    vec4 position = GLM_VEC4_ZERO_INIT;  // w unused.
+    vec4 scale = GLM_VEC4_ONE_INIT;      // w unused.
 };
+#else
+struct GPU_instance_transform
+{
+    mat4 matrix = GLM_MAT4_IDENTITY_INIT;
+};
+#endif  // GEO_COMPACT_INSTANCE_TRANSFORMS
+
+inline void set_instance_transform(GPU_instance_transform& out_transform, mat4 matrix)
+{
+#ifdef GEO_COMPACT_INSTANCE_TRANSFORMS
+    // @NOTE: Any shear in `matrix` gets dropped.
+    vec4 position;
+    mat4 rotation;
+    vec3 scale;
+    glm_decompose(matrix, position, rotation, scale);
+    glm_mat4_quat(rotation, out_transform.rotation);
+    glm_vec4(position, 0.0f, out_transform.position);
+    glm_vec4(scale, 1.0f, out_transform.scale);
+#else
+    glm_mat4_copy(matrix, out_transform.matrix);
+#endif  // GEO_COMPACT_INSTANCE_TRANSFORMS
+}
+
+// Geo instance flags.
+constexpr uint32_t k_instance_flag_never_cull{ 1 << 0 };     // Skips spatial culling.
+constexpr uint32_t k_instance_flag_shadow_caster{ 1 << 1 };  // Drawn into shadow views.
+constexpr uint32_t k_instance_flag_static{ 1 << 2 };         // No transform reader/batched transform.
 
 struct GPU_geo_instance_data
 {
-    mat4 transform = GLM_MAT4_IDENTITY_INIT;
+    GPU_instance_transform transform;
     uint32_t bounding_sphere_idx;
     uint32_t material_param_set_idx;
     uint32_t render_layer;
-    uint32_t never_cull;
+    uint32_t flags;
 };
 
+// Per-draw record, written by `geom_write_draw_cmds.comp` alongside every
+// culled draw cmd. The culled draw cmd's `firstInstance` points to its record.
+// @NOTE: Resolving the material param idx once per draw here saves the vertex
+//   shader from chasing instance -> material param set -> material param for
+//   every vertex.
+struct GPU_draw_record
+{
+    uint32_t instance_idx;
+    uint32_t material_param_idx;
+};
+
+// Bit-packed instance visibility.
+// @NOTE: One bit per instance per view, in 32-bit words. Views are laid out
+//   one after another, each `num_words_per_view` long.
+constexpr uint32_t k_main_view_visibility_idx{ 0 };
+constexpr uint32_t k_shadow_cascade_visibility_base_idx{ 1 };
+constexpr uint32_t k_shadow_cascade_static_visibility_base_idx{
+    k_shadow_cascade_visibility_base_idx + camera::k_num_shadow_cascades };
+constexpr uint32_t k_virtual_shadow_map_visibility_idx{
+    k_shadow_cascade_static_visibility_base_idx + camera::k_num_shadow_cascades };
+constexpr uint32_t k_max_visibility_views{ 16 };
+
+// Views culled in the same dispatch (main view, then the shadow cascades,
+// then the shadow cascades' static caster caches, then the virtual shadow map).
+// @NOTE: Every view gets its own region of the culled draw cmds, draw records
+//   and draw counts, in view order.
+constexpr uint32_t k_num_culling_views{ k_virtual_shadow_map_visibility_idx + 1 };
+static_assert(k_num_culling_views <= k_max_visibility_views);
+
+inline uint32_t calc_num_visibility_words(size_t num_instances)
+{
+    return static_cast<uint32_t>((num_instances + 31) / 32);
+}
+
 struct GPU_bounding_sphere
 {
     vec4 origin_xyz_radius_w;
 };
 
+// World space bounding sphere of an instance (mirrors
+// `calc_instance_world_bounding_sphere()` in the shaders).
+inline void calc_instance_world_bounding_sphere(GPU_instance_transform transform,
+                                                GPU_bounding_sphere model_sphere,
+                                                GPU_bounding_sphere& out_world_sphere)
+{
+    vec3 origin;
+    float_t max_scale;
+#ifdef GEO_COMPACT_INSTANCE_TRANSFORMS
+    vec3 scaled_origin;
+    glm_vec3_mul(model_sphere.origin_xyz_radius_w, transform.scale, scaled_origin);
+    glm_quat_rotatev(transform.rotation, scaled_origin, origin);
+    glm_vec3_add(origin, transform.position, origin);
+    max_scale = glm_vec3_max(transform.scale);
+#else
+    glm_mat4_mulv3(transform.matrix, model_sphere.origin_xyz_radius_w, 1.0f, origin);
+    max_scale = std::sqrt(glm_max(glm_vec3_norm2(transform.matrix[0]),
+                                  glm_max(glm_vec3_norm2(transform.matrix[1]),
+                                          glm_vec3_norm2(transform.matrix[2]))));
+#endif  // GEO_COMPACT_INSTANCE_TRANSFORMS
+    glm_vec4(origin,
+             model_sphere.origin_xyz_radius_w[3] * max_scale,
+             out_world_sphere.origin_xyz_radius_w);
+}
+
+// View that instance bounding spheres get culled against.
+// @NOTE: Planes point inwards and are normalized. Unused planes are
+//   (0, 0, 0, 1), which everything passes.
+struct GPU_culling_view
+{
+    vec4 frustum_planes[6];
+    uint32_t render_layer_mask;
+    uint32_t required_instance_flags;  // Instance needs all of these flags.
+    uint32_t excluded_instance_flags;  // Instance needs none of these flags.
+    uint32_t pad0;
+};
+
+// Extracts the frustum planes of `projection_view` (Gribb/Hartmann).
+// @NOTE: Shadow views skip the near plane, since casters between the light
+//   and the near plane still cast onto the view (pancaked w/ depth clamp).
+inline void set_culling_view_frustum_planes(GPU_culling_view& out_view,
+                                            mat4 projection_view,
+                                            bool use_near_plane)
+{
+    vec4 rows[4];
+    for (uint32_t row = 0; row < 4; row++)
+    for (uint32_t col = 0; col < 4; col++)
+    {
+        rows[row][col] = projection_view[col][row];
+    }
+
+    glm_vec4_add(rows[3], rows[0], out_view.frustum_planes[0]);  // Left.
+    glm_vec4_sub(rows[3], rows[0], out_view.frustum_planes[1]);  // Right.
+    glm_vec4_add(rows[3], rows[1], out_view.frustum_planes[2]);  // Bottom.
+    glm_vec4_sub(rows[3], rows[1], out_view.frustum_planes[3]);  // Top.
+    glm_vec4_sub(rows[3], rows[2], out_view.frustum_planes[4]);  // Far.
+    glm_vec4_add(rows[3], rows[2], out_view.frustum_planes[5]);  // Near (-1 to 1 depth).
+
+    uint32_t num_planes{ use_near_plane ? 6u : 5u };
+    for (uint32_t i = 0; i < num_planes; i++)
+    {
+        auto& plane{ out_view.frustum_planes[i] };
+        glm_vec4_scale(plane, 1.0f / glm_vec3_norm(plane), plane);
+    }
+    if (!use_near_plane)
+    {
+        vec4 pass_all_plane{ 0.0f, 0.0f, 0.0f, 1.0f };
+        glm_vec4_copy(pass_all_plane, out_view.frustum_planes[5]);
+    }
+}
+
+// Mirrors `is_sphere_in_view()` in the shaders.
+inline bool is_sphere_in_culling_view(const GPU_culling_view& view,
+                                      const GPU_bounding_sphere& sphere)
+{
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        auto& plane{ view.frustum_planes[i] };
+        auto& origin{ sphere.origin_xyz_radius_w };
+        if (plane[0] * origin[0] + plane[1] * origin[1] + plane[2] * origin[2] + plane[3] <
+            -origin[3])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Virtual shadow map.
+// @NOTE: The virtual map is `k_vsm_num_pages_per_side` pages per side, and
+//   its page table is addressed toroidally (absolute page coord mod pages per
+//   side), so pages that stay in the window as it follows the camera keep
+//   their physical page (and their cached depth).
+constexpr uint32_t k_vsm_page_table_entry_resident{ 1u << 30 };   // Has a physical page.
+constexpr uint32_t k_vsm_page_table_entry_dirty{ 1u << 31 };      // Physical page contents are stale.
+constexpr uint32_t k_vsm_page_table_entry_rendering{ 1u << 29 };  // Physical page gets rendered this frame.
+constexpr uint32_t k_vsm_page_table_entry_physical_page_mask{ 0xFFFF };
+
+// Matches `Vsm_page_table_entry`.
+struct GPU_vsm_page_table_entry
+{
+    uint32_t tag;    // Absolute page coord of the physical page (x low 16 bits, y high 16 bits).
+    uint32_t state;  // `k_vsm_page_table_entry_*` flags and physical page idx.
+    uint32_t last_requested_frame;
+    uint32_t pad0;
+};
+
+// Matches `Vsm_free_page_stack`.
+struct GPU_vsm_free_page_stack_header
+{
+    int32_t num_free_pages;
+    uint32_t pad0[3];
+    // uint32_t free_pages[k_vsm_num_physical_pages] follows.
+};
+
+// Matches `Vsm_render_page_list`. Doubles as the indirect dispatch of the
+// clear phase of `geom_vsm_update_pages.comp` (one workgroup per physical
+// page to render).
+struct GPU_vsm_render_page_list_header
+{
+    uint32_t dispatch_x;  // `VkDispatchIndirectCommand`.
+    uint32_t dispatch_y;
+    uint32_t dispatch_z;
+    uint32_t pad0;
+    // uint32_t physical_pages[k_vsm_num_physical_pages] follows.
+};
+
+// Matches `Vsm_stats`.
+struct GPU_vsm_stats
+{
+    uint32_t num_requested_pages;
+    uint32_t num_resident_pages;
+    uint32_t num_rendered_pages;
+    uint32_t num_invalidated_pages;
+    uint32_t num_allocation_failures;
+    uint32_t num_free_pages;
+    uint32_t pad0[2];
+};
+
+// Matches `Vsm_params`. Also the camera uniform of virtual shadow map pipelines
+// (`view` and `projection_view` line up w/ `GPU_camera`).
+struct GPU_vsm_params
+{
+    mat4 view;  // Unused (identity).
+    mat4 projection_view;
+    mat4 prev_main_inv_projection_view;  // Reconstructs last frame's depth samples.
+    int32_t page_origin[2];  // Absolute page coord of the window's first page.
+    uint32_t frame_idx;
+    uint32_t flags;  // `k_vsm_params_flag_*`.
+    uint64_t page_table_address;
+    uint64_t physical_pool_address;
+};
+constexpr uint32_t k_vsm_params_flag_invalidate_all{ 1 << 0 };
+
+// Instance key table of the virtual shadow map's invalidate phase. One entry
+// per instance key, holding the key's dense instance idx in the frame's draw
+// list (or `k_vsm_instance_key_not_drawn`), and whether the caster's render
+// layer changed.
+// @NOTE: Lets the previous bounding spheres be kept per instance key, so
+//   they stay matched up w/ their instance when rebucketing compacts the
+//   dense instances.
+constexpr uint32_t k_vsm_instance_key_dense_idx_mask{ 0x7FFFFFFF };
+constexpr uint32_t k_vsm_instance_key_not_drawn{ k_vsm_instance_key_dense_idx_mask };
+constexpr uint32_t k_vsm_instance_key_flag_layer_changed{ 1u << 31 };
+
 // Have compute shader compute culling with all the bounding spheres write all the draw commands.
 // First, calculate if an instance's bounding sphere is included in the draw calls.
 
 // COMPUTE SHADER
-// - For every instance, take model idx and compute if the model is culled or not (render layer, never_cull, and bounding sphere (in the future occlusion cull))
+// - For every instance, take model idx and compute if the model is culled or not (render layer, flags, and bounding sphere (in the future occlusion cull))
 // - Write results in a buffer.
 //
 // SETUP FOR DRAW CALLS
@@ -42,7 +276,7 @@ struct GPU_bounding_sphere
 // 
 // COMPUTE SHADER (for each shader)
 // - Compacts draw calls by reading each instance and its corresponding culling result and writing the indirect draw command to another buffer and incrementing the count buffer for the material.
-// - @TODO: honestly, this shader can be combined with the culling compute shader. That would eliminate the need to have a culling result buffer.
+// - @NOTE: Combined w/ the culling compute shader in `geom_cull_and_write_draw_cmds.comp` (the separate passes are still there for comparison).
 //
 // DRAW COMMANDS (for each shader)
 // - Provide the count buffer and indirect command buffer and run `vkCmdDrawIndexedIndirectCount` for each shader.
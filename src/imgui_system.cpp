@@ -1,7 +1,10 @@
 #include "imgui_system.h"
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <cfloat>
+#include <cstdio>
 #include <mutex>
 #include <string>
 #include "imgui.h"
@@ -29,6 +32,14 @@ static std::atomic_bool s_imgui_visible{ false };
 
 static std::mutex s_imgui_mutex;
 
+// Performance HUD.
+static std::mutex s_perf_hud_mutex;
+static Perf_hud_frame_sample s_perf_hud_latest_sample;
+static uint32_t s_perf_hud_num_frames_written{ 0 };
+static std::array<float_t, k_perf_hud_num_frames> s_perf_hud_frame_ms{};
+static std::array<std::array<float_t, k_perf_hud_num_frames>, k_perf_hud_max_gpu_passes> s_perf_hud_gpu_pass_ms{};
+static std::array<float_t, k_perf_hud_num_frames> s_perf_hud_upload_kib{};
+
 #if _WIN64
 static VkDevice s_v_device;
 static VkDescriptorPool s_v_imgui_pool;
@@ -312,6 +323,183 @@ bool render_imgui__input_handling()
     return true;
 }
 
+bool render_imgui__perf_hud()
+{
+    using namespace imgui_system;
+    std::lock_guard<std::mutex> lock{ s_perf_hud_mutex };
+    auto& sample{ s_perf_hud_latest_sample };
+
+    // Ring buffers are plotted oldest first.
+    int32_t num_values{
+        static_cast<int32_t>(std::min(s_perf_hud_num_frames_written, k_perf_hud_num_frames)) };
+    int32_t values_offset{
+        static_cast<int32_t>(s_perf_hud_num_frames_written % k_perf_hud_num_frames) };
+    if (num_values < static_cast<int32_t>(k_perf_hud_num_frames))
+        values_offset = 0;
+
+    char overlay[64];
+    ImGui::Begin("Performance");
+
+    if (ImGui::CollapsingHeader("Frame Times", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        snprintf(overlay, sizeof(overlay), "%.2f ms", sample.frame_ms);
+        ImGui::PlotLines("frame",
+                         s_perf_hud_frame_ms.data(),
+                         num_values,
+                         values_offset,
+                         overlay,
+                         0.0f,
+                         33.3f,
+                         ImVec2(0.0f, 48.0f));
+
+        for (uint32_t i = 0; i < sample.num_gpu_passes; i++)
+        {
+            snprintf(overlay, sizeof(overlay), "%.3f ms", sample.gpu_pass_ms[i]);
+            ImGui::PlotLines(sample.gpu_pass_names[i],
+                             s_perf_hud_gpu_pass_ms[i].data(),
+                             num_values,
+                             values_offset,
+                             overlay,
+                             0.0f,
+                             FLT_MAX,
+                             ImVec2(0.0f, 32.0f));
+        }
+    }
+
+    if (ImGui::CollapsingHeader("CPU Job Timeline", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        // One row per thread, scaled to the latest finished frame.
+        float_t frame_end_ms{ 0.001f };
+        uint32_t num_rows{ 1 };
+        for (uint32_t i = 0; i < sample.num_cpu_zones; i++)
+        {
+            frame_end_ms = std::max(frame_end_ms, sample.cpu_zones[i].end_ms);
+            num_rows = std::max(num_rows, sample.cpu_zones[i].thread_idx + 1);
+        }
+
+        constexpr float_t k_row_height{ 14.0f };
+        ImVec2 origin{ ImGui::GetCursorScreenPos() };
+        float_t width{ std::max(ImGui::GetContentRegionAvail().x, 64.0f) };
+        ImGui::InvisibleButton("cpu_job_timeline", ImVec2(width, k_row_height * num_rows));
+        bool is_hovered{ ImGui::IsItemHovered() };
+        ImVec2 mouse_pos{ ImGui::GetMousePos() };
+
+        ImDrawList* draw_list{ ImGui::GetWindowDrawList() };
+        for (uint32_t i = 0; i < sample.num_cpu_zones; i++)
+        {
+            auto& zone{ sample.cpu_zones[i] };
+            ImVec2 min{ origin.x + width * zone.begin_ms / frame_end_ms,
+                        origin.y + k_row_height * zone.thread_idx };
+            ImVec2 max{ std::max(origin.x + width * zone.end_ms / frame_end_ms, min.x + 1.0f),
+                        min.y + k_row_height - 1.0f };
+
+            // Color by name, so the same zone keeps its color across frames.
+            ImU32 hash{ ImGui::GetID(zone.name) };
+            draw_list->AddRectFilled(min, max, (hash | 0xFF000000) & 0xFFBFBFBF);
+
+            if (is_hovered &&
+                mouse_pos.x >= min.x && mouse_pos.x < max.x &&
+                mouse_pos.y >= min.y && mouse_pos.y < max.y)
+            {
+                ImGui::SetTooltip("%s\n%.3f ms", zone.name, zone.end_ms - zone.begin_ms);
+            }
+        }
+        ImGui::Text("%.2f ms, %u zones", frame_end_ms, sample.num_cpu_zones);
+    }
+
+    if (ImGui::CollapsingHeader("Counts", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        ImGui::Text("instances       : %u", sample.num_instances);
+        ImGui::Text("primitives      : %u", sample.num_primitives);
+        float_t main_view_culled_pct{
+            sample.num_candidate_draws > 0 ?
+                100.0f * (sample.num_candidate_draws - sample.num_main_view_draws) /
+                    sample.num_candidate_draws :
+                0.0f };
+        ImGui::Text("main view draws : %u / %u (%.1f%% culled)",
+                    sample.num_main_view_draws,
+                    sample.num_candidate_draws,
+                    main_view_culled_pct);
+        ImGui::Text("shadow draws    : %u", sample.num_shadow_view_draws);
+        ImGui::Text("pipelined       : %s", sample.is_frame_pipelined ? "yes" : "no");
+
+        snprintf(overlay,
+                 sizeof(overlay),
+                 "%.1f KiB uploaded",
+                 sample.num_upload_bytes / 1024.0);
+        ImGui::PlotLines("upload",
+                         s_perf_hud_upload_kib.data(),
+                         num_values,
+                         values_offset,
+                         overlay,
+                         0.0f,
+                         FLT_MAX,
+                         ImVec2(0.0f, 32.0f));
+
+        if (ImGui::BeginTable("pipeline_stats", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("pass");
+            ImGui::TableSetupColumn("VS invocations");
+            ImGui::TableSetupColumn("clipping prims");
+            ImGui::TableSetupColumn("FS invocations");
+            ImGui::TableSetupColumn("CS invocations");
+            ImGui::TableHeadersRow();
+            for (uint32_t i = 0; i < sample.num_stats_passes; i++)
+            {
+                auto& pass{ sample.pipeline_stats[i] };
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(pass.name);
+                if (!sample.is_pipeline_stats_supported)
+                {
+                    for (uint32_t column = 0; column < 4; column++)
+                    {
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted("n/a");
+                    }
+                    continue;
+                }
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", static_cast<unsigned long long>(pass.vertex_shader_invocations));
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", static_cast<unsigned long long>(pass.clipping_primitives));
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", static_cast<unsigned long long>(pass.fragment_shader_invocations));
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", static_cast<unsigned long long>(pass.compute_shader_invocations));
+            }
+            ImGui::EndTable();
+        }
+    }
+
+    if (ImGui::CollapsingHeader("GPU Memory Budgets", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        for (uint32_t i = 0; i < sample.num_heaps; i++)
+        {
+            auto& heap{ sample.heap_budgets[i] };
+            if (heap.budget_bytes == 0)
+                continue;
+
+            constexpr double_t k_bytes_to_mib{ 1.0 / (1024.0 * 1024.0) };
+            snprintf(overlay,
+                     sizeof(overlay),
+                     "heap %u%s: %.0f / %.0f MiB",
+                     i,
+                     heap.is_device_local ? " (device)" : "",
+                     heap.usage_bytes * k_bytes_to_mib,
+                     heap.budget_bytes * k_bytes_to_mib);
+            ImGui::ProgressBar(static_cast<float_t>(static_cast<double_t>(heap.usage_bytes) /
+                                                    heap.budget_bytes),
+                               ImVec2(-FLT_MIN, 0.0f),
+                               overlay);
+        }
+    }
+
+    ImGui::End();  // "Performance"
+
+    return true;
+}
+
 bool imgui_system::render_imgui()
 {
     bool result{ true };
@@ -326,12 +514,26 @@ bool imgui_system::render_imgui()
         result &= render_imgui__demo_window();
         result &= render_imgui__camera_props();
         result &= render_imgui__input_handling();
+        result &= render_imgui__perf_hud();
         ImGui::Render();
     }
 
     return result;
 }
 
+void imgui_system::record_perf_hud_frame(const Perf_hud_frame_sample& sample)
+{
+    std::lock_guard<std::mutex> lock{ s_perf_hud_mutex };
+    s_perf_hud_latest_sample = sample;
+
+    uint32_t frame_idx{ s_perf_hud_num_frames_written++ % k_perf_hud_num_frames };
+    s_perf_hud_frame_ms[frame_idx] = sample.frame_ms;
+    for (uint32_t i = 0; i < k_perf_hud_max_gpu_passes; i++)
+        s_perf_hud_gpu_pass_ms[i][frame_idx] =
+            (i < sample.num_gpu_passes ? sample.gpu_pass_ms[i] : 0.0f);
+    s_perf_hud_upload_kib[frame_idx] = static_cast<float_t>(sample.num_upload_bytes / 1024.0);
+}
+
 // Actual drawing.
 #if _WIN64
 
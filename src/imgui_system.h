@@ -1,5 +1,9 @@
 #pragma once
 
+#include <array>
+#include <cinttypes>
+#include <cmath>
+
 #if _WIN64
 #include <vulkan/vulkan.h>
 struct GLFWwindow;
@@ -24,11 +28,74 @@ bool build_imgui(
 #endif  // _WIN64
 bool teardown_imgui();
 
+
 // Rendering.
 void set_imgui_enabled(bool flag);
 void set_imgui_visible(bool flag);
 bool render_imgui();
 
+// Performance HUD.
+// @NOTE: Samples get copied into fixed size ring buffers, so recording and
+//   drawing the HUD doesn't allocate.
+constexpr uint32_t k_perf_hud_num_frames{ 240 };
+constexpr uint32_t k_perf_hud_max_gpu_passes{ 16 };
+constexpr uint32_t k_perf_hud_max_stats_passes{ 8 };
+constexpr uint32_t k_perf_hud_max_cpu_zones{ 128 };
+constexpr uint32_t k_perf_hud_max_heaps{ 16 };
+
+struct Perf_hud_frame_sample
+{
+    // Graphed over the latest `k_perf_hud_num_frames` frames.
+    float_t frame_ms{ 0.0f };
+    uint32_t num_gpu_passes{ 0 };
+    std::array<const char*, k_perf_hud_max_gpu_passes> gpu_pass_names;
+    std::array<float_t, k_perf_hud_max_gpu_passes> gpu_pass_ms;
+    uint64_t num_upload_bytes{ 0 };
+
+    // Latest only.
+    uint32_t num_instances{ 0 };
+    uint32_t num_primitives{ 0 };
+    uint32_t num_candidate_draws{ 0 };
+    uint32_t num_main_view_draws{ 0 };
+    uint32_t num_shadow_view_draws{ 0 };
+    bool is_frame_pipelined{ false };
+
+    struct Pipeline_stats
+    {
+        const char* name;
+        uint64_t vertex_shader_invocations;
+        uint64_t clipping_primitives;
+        uint64_t fragment_shader_invocations;
+        uint64_t compute_shader_invocations;
+    };
+    bool is_pipeline_stats_supported{ false };  // Shows "n/a" for the stats if not.
+    uint32_t num_stats_passes{ 0 };
+    std::array<Pipeline_stats, k_perf_hud_max_stats_passes> pipeline_stats;
+
+    // CPU zones of the latest finished frame (ms from its first zone).
+    struct CPU_zone
+    {
+        const char* name;
+        uint32_t thread_idx;
+        float_t begin_ms;
+        float_t end_ms;
+    };
+    uint32_t num_cpu_zones{ 0 };
+    std::array<CPU_zone, k_perf_hud_max_cpu_zones> cpu_zones;
+
+    struct Heap_budget
+    {
+        uint64_t usage_bytes;
+        uint64_t budget_bytes;
+        bool is_device_local;
+    };
+    uint32_t num_heaps{ 0 };
+    std::array<Heap_budget, k_perf_hud_max_heaps> heap_budgets;
+};
+
+// Call once per frame (before `render_imgui()`).
+void record_perf_hud_frame(const Perf_hud_frame_sample& sample);
+
 // Actual drawing.
 #if _WIN64
 bool render_imgui_onto_swapchain(
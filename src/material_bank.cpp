@@ -1,6 +1,8 @@
 #include "material_bank.h"
 
+#include <array>
 #include <cassert>
+#include <cstddef>
 #include <iostream>
 #include <mutex>
 #include <unordered_map>
@@ -11,14 +13,12 @@
 namespace material_bank
 {
 
-// Descriptor layout references.
-static VkDescriptorSetLayout s_main_camera_descriptor_layout;
-static VkDescriptorSetLayout s_shadow_camera_descriptor_layout;
-static VkDescriptorSetLayout s_material_sets_indexing_descriptor_layout;
-static VkDescriptorSetLayout s_material_agnostic_descriptor_layout;
+// Shared pipeline layouts (indexed by `Camera_type`).
+static std::array<VkPipelineLayout, static_cast<size_t>(Camera_type::NUM_CAMERA_TYPES)> s_shared_pipeline_layouts;
 
-// Descriptor set references.
-static VkDescriptorSet s_material_sets_indexing_descriptor_set;
+// Material param datas of all pipelines.
+static vk_buffer::Allocated_buffer s_all_material_datas_buffer;
+static bool s_has_all_material_datas_buffer{ false };
 
 // Pipeline containers.
 static std::unordered_map<std::string, uint32_t> s_pipe_name_to_idx;
@@ -42,95 +42,158 @@ static std::vector<GPU_material_set> s_all_material_sets;
 static std::mutex s_all_material_sets_mutex;
 
 // Material push constant.
+// @NOTE: The instance and draw record buffers are the same for the whole pass,
+//   so only `material_param_datas_buffer` gets pushed per pipeline.
 struct GPU_material_push_constant
 {
     VkDeviceAddress geo_instance_buffer;
+    VkDeviceAddress draw_record_buffer;
+    VkDeviceAddress material_param_datas_buffer;
 };
 
+// Start of each pipeline's region in `s_all_material_datas_buffer`.
+// @NOTE: Matches the default `buffer_reference_align` of std140 blocks.
+constexpr VkDeviceSize k_material_param_datas_alignment{ 16 };
+
+static VkPipelineLayout get_shared_pipeline_layout(Camera_type camera_type)
+{
+    assert(camera_type < Camera_type::NUM_CAMERA_TYPES);
+    VkPipelineLayout pipeline_layout{
+        s_shared_pipeline_layouts[static_cast<size_t>(camera_type)] };
+    assert(pipeline_layout != VK_NULL_HANDLE);
+    return pipeline_layout;
+}
+
 }  // namespace material_bank
 
 
 // GPU_pipeline.
-void material_bank::GPU_pipeline::bind_pipeline(
-    VkCommandBuffer cmd,
-    const VkViewport& viewport,
-    const VkRect2D& scissor,
-    const VkDescriptorSet* main_view_camera_descriptor_set,
-    const VkDescriptorSet* shadow_view_camera_descriptor_set,
-    VkDeviceAddress instance_data_buffer_address) const
+void material_bank::GPU_pipeline::bind_pipeline(VkCommandBuffer cmd) const
 {
     vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-    vkCmdSetViewport(cmd, 0, 1, &viewport);
-    vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-    bool use_material_params{ !material_param_definitions.empty() };
-    std::vector<VkDescriptorSet> desc_sets;
-    desc_sets.resize(use_material_params ? 3 : 1);
+    if (!material_param_definitions.empty())
+    {
+        // Push material param datas buffer reference.
+        assert(calculated.material_param_datas_address != 0);
+        vkCmdPushConstants(cmd,
+                           pipeline_layout,
+                           VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                           offsetof(GPU_material_push_constant, material_param_datas_buffer),
+                           sizeof(VkDeviceAddress),
+                           &calculated.material_param_datas_address);
+    }
+}
 
-    // Bind camera descriptor set.
-    switch (camera_type)
+// Shared pipeline layouts.
+void material_bank::build_shared_pipeline_layouts(
+    VkDevice device,
+    VkDescriptorSetLayout main_camera_descriptor_layout,
+    VkDescriptorSetLayout shadow_camera_descriptor_layout,
+    VkDescriptorSetLayout virtual_shadow_camera_descriptor_layout)
+{
+    // @NOTE: Fragment stage reads the material param datas buffer reference.
+    VkPushConstantRange pc_range{
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+        .offset = 0,
+        .size = sizeof(GPU_material_push_constant),
+    };
+
+    for (size_t i = 0; i < s_shared_pipeline_layouts.size(); i++)
     {
-    case Camera_type::MAIN_VIEW:
-        assert(main_view_camera_descriptor_set != nullptr);
-        desc_sets[0] = *main_view_camera_descriptor_set;
-        break;
+        VkDescriptorSetLayout camera_descriptor_layout{ VK_NULL_HANDLE };
+        switch (static_cast<Camera_type>(i))
+        {
+        case Camera_type::MAIN_VIEW:
+            camera_descriptor_layout = main_camera_descriptor_layout;
+            break;
 
-    case Camera_type::SHADOW_VIEW:
-        assert(shadow_view_camera_descriptor_set != nullptr);
-        desc_sets[0] = *shadow_view_camera_descriptor_set;
-        assert(false);  // @TODO: Not implemented yet!
-        break;
+        case Camera_type::SHADOW_VIEW:
+            camera_descriptor_layout = shadow_camera_descriptor_layout;
+            break;
 
-    default:
-        assert(false);
-        break;
-    }
+        case Camera_type::VIRTUAL_SHADOW_VIEW:
+            camera_descriptor_layout = virtual_shadow_camera_descriptor_layout;
+            break;
 
-    // Bind global material set and material param descriptor set (optional).
-    if (use_material_params)
-    {
-        desc_sets[1] = s_material_sets_indexing_descriptor_set;
-        desc_sets[2] = calculated.combined_all_material_datas_descriptor_set;
+        default:
+            assert(false);
+            break;
+        }
+
+        VkPipelineLayoutCreateInfo layout_info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext = nullptr,
+            .setLayoutCount = 1,
+            .pSetLayouts = &camera_descriptor_layout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pc_range,
+        };
+        VkResult err{
+            vkCreatePipelineLayout(device, &layout_info, nullptr, &s_shared_pipeline_layouts[i]) };
+        if (err)
+        {
+            std::cerr << "ERROR: Shared pipeline layout creation failed." << std::endl;
+            assert(false);
+        }
     }
+}
+
+void material_bank::bind_geometry_pass_shared_state(
+    VkCommandBuffer cmd,
+    Camera_type camera_type,
+    const VkViewport& viewport,
+    const VkRect2D& scissor,
+    VkDescriptorSet camera_descriptor_set,
+    VkDeviceAddress instance_data_buffer_address,
+    VkDeviceAddress draw_record_buffer_address)
+{
+    VkPipelineLayout pipeline_layout{ get_shared_pipeline_layout(camera_type) };
 
-    // Bind descriptor sets.
+    // @NOTE: Dynamic state, so it stays set across pipeline binds.
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+    // Bind camera descriptor set.
     vkCmdBindDescriptorSets(cmd,
                             VK_PIPELINE_BIND_POINT_GRAPHICS,
                             pipeline_layout,
                             0,
-                            static_cast<uint32_t>(desc_sets.size()), desc_sets.data(),
+                            1, &camera_descriptor_set,
                             0, nullptr);
 
-    // Push instance buffer reference.
+    // Push instance and draw record buffer references.
     GPU_material_push_constant mat_pc{
         .geo_instance_buffer = instance_data_buffer_address,
+        .draw_record_buffer = draw_record_buffer_address,
     };
     vkCmdPushConstants(cmd,
                        pipeline_layout,
-                       VK_SHADER_STAGE_VERTEX_BIT,
-                       0, sizeof(GPU_material_push_constant),
+                       VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                       0, offsetof(GPU_material_push_constant, material_param_datas_buffer),
                        &mat_pc);
 }
 
-// Passing references.
-void material_bank::set_descriptor_references(
-    VkDescriptorSetLayout main_camera_descriptor_layout,
-    VkDescriptorSetLayout shadow_camera_descriptor_layout,
-    VkDescriptorSetLayout material_sets_indexing_descriptor_layout,
-    VkDescriptorSetLayout material_agnostic_descriptor_layout,
-    VkDescriptorSet material_sets_indexing_descriptor_set)
+void material_bank::destroy_shared_pipeline_resources(VkDevice device, VmaAllocator allocator)
 {
-    s_main_camera_descriptor_layout = main_camera_descriptor_layout;
-    s_shadow_camera_descriptor_layout = shadow_camera_descriptor_layout;
-    s_material_sets_indexing_descriptor_layout = material_sets_indexing_descriptor_layout;
-    s_material_agnostic_descriptor_layout = material_agnostic_descriptor_layout;
-    s_material_sets_indexing_descriptor_set = material_sets_indexing_descriptor_set;
+    for (auto& pipeline_layout : s_shared_pipeline_layouts)
+    {
+        vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+        pipeline_layout = VK_NULL_HANDLE;
+    }
+
+    if (s_has_all_material_datas_buffer)
+    {
+        vk_buffer::destroy_buffer(allocator, s_all_material_datas_buffer);
+        s_has_all_material_datas_buffer = false;
+    }
 }
 
 // Pipeline.
 material_bank::GPU_pipeline material_bank::create_geometry_material_pipeline(
     VkDevice device,
     VkFormat draw_format,
+    VkFormat depth_format,
     bool has_z_prepass,
     Camera_type camera_type,
     bool use_material_params,
@@ -246,54 +309,8 @@ material_bank::GPU_pipeline material_bank::create_geometry_material_pipeline(
         assert(false);
     }
 
-    // Create pipeline layout.
-    std::vector<VkDescriptorSetLayout> descriptor_layouts;
-    descriptor_layouts.resize(use_material_params ? 3 : 1);
-
-    switch (camera_type)
-    {
-    case Camera_type::MAIN_VIEW:
-        descriptor_layouts[0] = s_main_camera_descriptor_layout;
-        break;
-
-    case Camera_type::SHADOW_VIEW:
-        // @TODO: add shadow camera descriptor layout.
-        descriptor_layouts[0] = s_shadow_camera_descriptor_layout;
-        assert(false);
-        break;
-
-    default:
-        assert(false);
-        break;
-    }
-
-    if (use_material_params)
-    {
-        descriptor_layouts[1] = s_material_sets_indexing_descriptor_layout;
-        descriptor_layouts[2] = s_material_agnostic_descriptor_layout;
-    }
-
-    VkPushConstantRange pc_range{
-        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
-        .offset = 0,
-        .size = sizeof(GPU_material_push_constant),
-    };
-
-    VkPipelineLayoutCreateInfo layout_info{
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .pNext = nullptr,
-        .setLayoutCount = static_cast<uint32_t>(descriptor_layouts.size()),
-        .pSetLayouts = descriptor_layouts.data(),
-        .pushConstantRangeCount = 1,
-        .pPushConstantRanges = &pc_range,
-    };
-    VkResult err{
-        vkCreatePipelineLayout(device, &layout_info, nullptr, &new_pipeline.pipeline_layout) };
-    if (err)
-    {
-        std::cerr << "ERROR: Pipeline layout creation failed." << std::endl;
-        assert(false);
-    }
+    // Use the camera type's shared pipeline layout.
+    new_pipeline.pipeline_layout = get_shared_pipeline_layout(camera_type);
 
     // Create pipeline.
     vk_pipeline::Graphics_pipeline_builder builder;
@@ -302,17 +319,46 @@ material_bank::GPU_pipeline material_bank::create_geometry_material_pipeline(
     builder.set_vertex_input(gltf_loader::GPU_vertex::get_static_vertex_description());
     builder.set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
     builder.set_polygon_mode(VK_POLYGON_MODE_FILL);
-    builder.set_cull_mode(VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE);
     builder.set_multisampling_none();
     builder.disable_blending();
 
-    if (has_z_prepass)
-        builder.set_equal_nonwriting_depthtest();
-    else
+    switch (camera_type)
+    {
+    case Camera_type::MAIN_VIEW:
+        builder.set_cull_mode(VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE);
+        if (has_z_prepass)
+            builder.set_equal_nonwriting_depthtest();
+        else
+            builder.set_less_than_writing_depthtest();
+        builder.set_color_attachment_format(draw_format);
+        builder.set_depth_format(depth_format);
+        break;
+
+    case Camera_type::SHADOW_VIEW:
+        // Depth only.
+        // @NOTE: Depth clamp keeps casters between the sun and the cascade's
+        //   near plane (culling doesn't test against the near plane).
+        builder.set_cull_mode(VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE);
         builder.set_less_than_writing_depthtest();
+        builder.set_depth_clamp_and_bias(1.25f, 1.75f);
+        builder.set_depth_format(depth_format);
+        break;
+
+    case Camera_type::VIRTUAL_SHADOW_VIEW:
+        // No attachments. The fragment shader does the depth test itself w/
+        // atomics into the physical pages.
+        // @NOTE: The virtual shadow map projection isn't y flipped, so the
+        //   winding is flipped. Both sides get drawn anyways.
+        builder.set_cull_mode(VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE);
+        builder.disable_depthtest();
+        builder.set_depth_clamp_and_bias(0.0f, 0.0f);
+        builder.set_depth_format(VK_FORMAT_UNDEFINED);
+        break;
 
-    builder.set_color_attachment_format(draw_format);
-    builder.set_depth_format(VK_FORMAT_UNDEFINED);
+    default:
+        assert(false);
+        break;
+    }
     new_pipeline.pipeline = builder.build_pipeline(device);
 
     // Clean up shader modules.
@@ -345,6 +391,7 @@ uint32_t material_bank::register_pipeline(const std::string& pipe_name)
 void material_bank::define_pipeline(const std::string& pipe_name,
                                     const std::string& optional_z_prepass_pipe_name,
                                     const std::string& optional_shadow_pipe_name,
+                                    const std::string& optional_virtual_shadow_pipe_name,
                                     GPU_pipeline&& new_pipeline)
 {
     if (!optional_shadow_pipe_name.empty())
@@ -354,6 +401,13 @@ void material_bank::define_pipeline(const std::string& pipe_name,
                 get_pipeline_idx_from_name(optional_shadow_pipe_name));
     }
 
+    if (!optional_virtual_shadow_pipe_name.empty())
+    {
+        new_pipeline.virtual_shadow_pipeline =
+            &get_pipeline(
+                get_pipeline_idx_from_name(optional_virtual_shadow_pipe_name));
+    }
+
     if (!optional_z_prepass_pipe_name.empty())
     {
         new_pipeline.z_prepass_pipeline =
@@ -372,14 +426,19 @@ bool material_bank::cook_and_upload_pipeline_material_param_datas_to_gpu(
     const vk_util::Immediate_submit_support& support,
     VkDevice device,
     VkQueue queue,
-    VmaAllocator allocator,
-    vk_desc::Descriptor_allocator& descriptor_alloc)
+    VmaAllocator allocator)
 {
     std::lock_guard<std::mutex> lock1{ s_all_pipelines_mutex };
     std::lock_guard<std::mutex> lock2{ s_all_materials_mutex };
 
-    for (auto& pipeline : s_all_pipelines)
+    // Lay out each pipeline's region in the combined buffer.
+    std::vector<VkDeviceSize> pipeline_region_offsets;
+    pipeline_region_offsets.resize(s_all_pipelines.size(), 0);
+    VkDeviceSize all_material_datas_buffer_size{ 0 };
+
+    for (size_t i = 0; i < s_all_pipelines.size(); i++)
     {
+        auto& pipeline{ s_all_pipelines[i] };
         if (pipeline.material_param_definitions.empty())
         {
             // No cooking needed for pipeline
@@ -387,29 +446,62 @@ bool material_bank::cook_and_upload_pipeline_material_param_datas_to_gpu(
             continue;
         }
 
-        // Size buffer.
+        all_material_datas_buffer_size =
+            (all_material_datas_buffer_size + k_material_param_datas_alignment - 1) &
+                ~(k_material_param_datas_alignment - 1);
+        pipeline_region_offsets[i] = all_material_datas_buffer_size;
+        all_material_datas_buffer_size +=
+            pipeline.calculated.material_param_block_size_padded *
+                pipeline.calculated.materials_using_this_pipeline.size();
+    }
+
+    if (all_material_datas_buffer_size == 0)
+    {
+        // No pipelines w/ material customization.
+        return true;
+    }
+
+    // Create GPU and staging buffers.
+    assert(!s_has_all_material_datas_buffer);
+    s_all_material_datas_buffer =
+        vk_buffer::create_buffer(allocator,
+                                 all_material_datas_buffer_size,
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                     VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                 VMA_MEMORY_USAGE_GPU_ONLY,
+                                 vk_memory::Memory_category::MATERIAL);
+    s_has_all_material_datas_buffer = true;
+
+    auto staging_buffer{
+        vk_buffer::create_buffer(allocator,
+                                 all_material_datas_buffer_size,
+                                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                 VMA_MEMORY_USAGE_CPU_ONLY,
+                                 vk_memory::Memory_category::STAGING) };
+
+    VkBufferDeviceAddressInfo device_address_info{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+        .buffer = s_all_material_datas_buffer.buffer,
+    };
+    VkDeviceAddress all_material_datas_buffer_address{
+        vkGetBufferDeviceAddress(device, &device_address_info) };
+
+    // Fill staging buffer.
+    char* staging_buffer_data;
+    vmaMapMemory(allocator, staging_buffer.allocation, reinterpret_cast<void**>(&staging_buffer_data));
+
+    for (size_t pipeline_idx = 0; pipeline_idx < s_all_pipelines.size(); pipeline_idx++)
+    {
+        auto& pipeline{ s_all_pipelines[pipeline_idx] };
+        if (pipeline.material_param_definitions.empty())
+            continue;
+
+        pipeline.calculated.material_param_datas_address =
+            all_material_datas_buffer_address + pipeline_region_offsets[pipeline_idx];
+
         size_t definition_data_block_size{
             pipeline.calculated.material_param_block_size_padded };
-        size_t mat_param_definition_datas_buffer{
-            definition_data_block_size *
-                pipeline.calculated.materials_using_this_pipeline.size() };
-
-        // Create GPU and staging buffers.
-        pipeline.calculated.all_material_datas_buffer =
-            vk_buffer::create_buffer(allocator,
-                                     mat_param_definition_datas_buffer,
-                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-                                         VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                                     VMA_MEMORY_USAGE_GPU_ONLY);
-        auto staging_buffer{
-            vk_buffer::create_buffer(allocator,
-                                     mat_param_definition_datas_buffer,
-                                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                     VMA_MEMORY_USAGE_CPU_ONLY) };
-
-        // Fill staging buffer.
-        char* staging_buffer_data;
-        vmaMapMemory(allocator, staging_buffer.allocation, reinterpret_cast<void**>(&staging_buffer_data));
 
         for (uint32_t i = 0;
             i < static_cast<uint32_t>(
@@ -421,7 +513,8 @@ bool material_bank::cook_and_upload_pipeline_material_param_datas_to_gpu(
             // Assert ordering in global material sets buffers is correct.
             assert(material.cooked_material_param_local_idx == i);
 
-            size_t write_offset_base{ i * definition_data_block_size };
+            size_t write_offset_base{
+                pipeline_region_offsets[pipeline_idx] + i * definition_data_block_size };
 
             for (auto& data : material.material_param_datas)
             for (auto& definition : pipeline.material_param_definitions)  // Search for a match.
@@ -509,46 +602,25 @@ bool material_bank::cook_and_upload_pipeline_material_param_datas_to_gpu(
                 break;
             }
         }
+    }
 
-        vmaUnmapMemory(allocator, staging_buffer.allocation);
-
-        // Transfer staged data to GPU.
-        vk_util::immediate_submit(support, device, queue, [&](VkCommandBuffer cmd) {
-            VkBufferCopy mat_param_definition_datas_copy{
-                .srcOffset = 0,
-                .dstOffset = 0,
-                .size = mat_param_definition_datas_buffer,
-            };
-            vkCmdCopyBuffer(cmd,
-                            staging_buffer.buffer,
-                            pipeline.calculated.all_material_datas_buffer.buffer,
-                            1, &mat_param_definition_datas_copy);
-        });
-
-        // Create and write descriptor set for pipeline.
-        pipeline.calculated.combined_all_material_datas_descriptor_set =
-            descriptor_alloc.allocate(device, s_material_agnostic_descriptor_layout);
-
-        VkDescriptorBufferInfo all_material_datas_buffer_info{
-            .buffer = pipeline.calculated.all_material_datas_buffer.buffer,
-            .offset = 0,
-            .range = mat_param_definition_datas_buffer,
-        };
-        VkWriteDescriptorSet all_material_datas_buffer_write{
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .pNext = nullptr,
-            .dstSet = pipeline.calculated.combined_all_material_datas_descriptor_set,
-            .dstBinding = 0,
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-            .pBufferInfo = &all_material_datas_buffer_info,
-        };
-
-        vkUpdateDescriptorSets(device, 1, &all_material_datas_buffer_write, 0, nullptr);
+    vmaUnmapMemory(allocator, staging_buffer.allocation);
 
-        // Clean up.
-        destroy_buffer(allocator, staging_buffer);
-    }
+    // Transfer staged data to GPU.
+    vk_util::immediate_submit(support, device, queue, [&](VkCommandBuffer cmd) {
+        VkBufferCopy all_material_datas_copy{
+            .srcOffset = 0,
+            .dstOffset = 0,
+            .size = all_material_datas_buffer_size,
+        };
+        vkCmdCopyBuffer(cmd,
+                        staging_buffer.buffer,
+                        s_all_material_datas_buffer.buffer,
+                        1, &all_material_datas_copy);
+    });
+
+    // Clean up.
+    destroy_buffer(allocator, staging_buffer);
 
     return true;
 }
@@ -20,6 +20,7 @@ enum class Camera_type
 {
     MAIN_VIEW = 0,
     SHADOW_VIEW,
+    VIRTUAL_SHADOW_VIEW,  // Writes depth into virtual shadow map pages (no attachments).
     NUM_CAMERA_TYPES
 };
 
@@ -82,6 +83,7 @@ struct GPU_pipeline
     VkPipeline pipeline;
     VkPipelineLayout pipeline_layout;
     const GPU_pipeline* shadow_pipeline{ nullptr };
+    const GPU_pipeline* virtual_shadow_pipeline{ nullptr };
     const GPU_pipeline* z_prepass_pipeline{ nullptr };
 
     Camera_type camera_type;
@@ -94,16 +96,17 @@ struct GPU_pipeline
         size_t material_param_block_size_padded{ 0 };
 
         std::vector<GPU_material*> materials_using_this_pipeline;
-        vk_buffer::Allocated_buffer all_material_datas_buffer;  // @TODO: START HERE!!!! Solve this circular dependency. :(
-        VkDescriptorSet combined_all_material_datas_descriptor_set;
+
+        // This pipeline's region of the combined material param datas buffer.
+        // @NOTE: 0 if the pipeline doesn't use material params.
+        VkDeviceAddress material_param_datas_address{ 0 };
     } calculated;
 
-    void bind_pipeline(VkCommandBuffer cmd,
-                       const VkViewport& viewport,
-                       const VkRect2D& scissor,
-                       const VkDescriptorSet* main_view_camera_descriptor_set,
-                       const VkDescriptorSet* shadow_view_camera_descriptor_set,
-                       VkDeviceAddress instance_data_buffer_address) const;
+    // Binds the pipeline and pushes its material param datas address.
+    // @NOTE: Expects `bind_geometry_pass_shared_state()` w/ the pipeline's
+    //   camera type to have been called in the pass, since all pipelines of a
+    //   camera type share the same layout.
+    void bind_pipeline(VkCommandBuffer cmd) const;
 };
 
 constexpr uint32_t k_invalid_material_idx{ (uint32_t)-1 };
@@ -122,18 +125,40 @@ struct GPU_material_set
     std::vector<uint32_t> material_indexes;
 };
 
-// Passing references.
-void set_descriptor_references(
+// Shared pipeline layouts.
+// @NOTE: One layout per camera type, used by every geometry material pipeline
+//   of that type, so switching pipelines doesn't disturb the bound descriptor
+//   sets or push constants.
+void build_shared_pipeline_layouts(
+    VkDevice device,
     VkDescriptorSetLayout main_camera_descriptor_layout,
     VkDescriptorSetLayout shadow_camera_descriptor_layout,
-    VkDescriptorSetLayout material_sets_indexing_descriptor_layout,
-    VkDescriptorSetLayout material_agnostic_descriptor_layout,
-    VkDescriptorSet material_sets_indexing_descriptor_set);
+    VkDescriptorSetLayout virtual_shadow_camera_descriptor_layout);
+
+// Binds the camera descriptor set, viewport, scissor and instance/draw record
+// buffer references shared by all geometry material pipelines of
+// `camera_type`. Call once per pass before drawing.
+void bind_geometry_pass_shared_state(
+    VkCommandBuffer cmd,
+    Camera_type camera_type,
+    const VkViewport& viewport,
+    const VkRect2D& scissor,
+    VkDescriptorSet camera_descriptor_set,
+    VkDeviceAddress instance_data_buffer_address,
+    VkDeviceAddress draw_record_buffer_address);
+
+// Destroys the shared pipeline layouts and the combined material param datas
+// buffer.
+// @NOTE: The device has to be idle.
+void destroy_shared_pipeline_resources(VkDevice device, VmaAllocator allocator);
 
 // Pipeline.
+// @NOTE: Shadow view pipelines are depth only, so they ignore `draw_format`,
+//   and virtual shadow view pipelines have no attachments at all.
 GPU_pipeline create_geometry_material_pipeline(
     VkDevice device,
     VkFormat draw_format,
+    VkFormat depth_format,
     bool has_z_prepass,
     Camera_type camera_type,
     bool use_material_params,
@@ -146,14 +171,16 @@ uint32_t register_pipeline(const std::string& pipe_name);
 void define_pipeline(const std::string& pipe_name,
                      const std::string& optional_z_prepass_pipe_name,
                      const std::string& optional_shadow_pipe_name,
+                     const std::string& optional_virtual_shadow_pipe_name,
                      GPU_pipeline&& new_pipeline);
 
+// Packs every pipeline's material param datas into one buffer and hands each
+// pipeline the address of its region.
 bool cook_and_upload_pipeline_material_param_datas_to_gpu(
     const vk_util::Immediate_submit_support& support,
     VkDevice device,
     VkQueue queue,
-    VmaAllocator allocator,
-    vk_desc::Descriptor_allocator& descriptor_alloc);
+    VmaAllocator allocator);
 
 uint32_t get_pipeline_idx_from_name(const std::string& pipe_name);
 
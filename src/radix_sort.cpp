@@ -0,0 +1,185 @@
+#include "radix_sort.h"
+
+#include <algorithm>
+#include <cassert>
+
+
+namespace radix_sort
+{
+
+constexpr uint32_t k_max_passes{ 64 / k_digit_bits };
+constexpr uint64_t k_digit_mask{ k_num_buckets - 1 };
+
+// Key bits that differ between at least two keys.
+static uint64_t get_varying_key_bits(const Sort_context& context)
+{
+    uint64_t and_mask{ ~0ull };
+    uint64_t or_mask{ 0 };
+    for (size_t chunk = 0; chunk < context.num_chunks; chunk++)
+    {
+        and_mask &= context.chunk_key_and_masks[chunk];
+        or_mask |= context.chunk_key_or_masks[chunk];
+    }
+    return or_mask & ~and_mask;
+}
+
+// Shift of the `pass_idx`th digit that varies.
+static uint32_t get_pass_shift(const Sort_context& context, uint32_t pass_idx)
+{
+    uint64_t varying_key_bits{ get_varying_key_bits(context) };
+    for (uint32_t digit = 0; digit < k_max_passes; digit++)
+    {
+        uint32_t shift{ digit * k_digit_bits };
+        if (((varying_key_bits >> shift) & k_digit_mask) == 0)
+            continue;
+        if (pass_idx == 0)
+            return shift;
+        pass_idx--;
+    }
+
+    // Pass out of range.
+    assert(false);
+    return 0;
+}
+
+// Passes ping pong between `entries` and `scratch`.
+static void get_pass_buffers(const Sort_context& context,
+                             uint32_t pass_idx,
+                             const Key_value_u64*& out_src,
+                             Key_value_u64*& out_dst)
+{
+    bool is_even_pass{ pass_idx % 2 == 0 };
+    out_src = (is_even_pass ? context.entries : context.scratch)->data();
+    out_dst = (is_even_pass ? context.scratch : context.entries)->data();
+}
+
+// Range of entries that a chunk covers in the passes.
+static void calc_chunk_range(const Sort_context& context,
+                             size_t chunk_idx,
+                             size_t& out_from_idx,
+                             size_t& out_to_idx)
+{
+    size_t count{ context.entries->size() };
+    size_t chunk_size{ (count + context.num_chunks - 1) / context.num_chunks };
+    out_from_idx = std::min(chunk_idx * chunk_size, count);
+    out_to_idx = std::min(out_from_idx + chunk_size, count);
+}
+
+}  // namespace radix_sort
+
+
+void radix_sort::begin_sort(std::vector<Key_value_u64>& entries,
+                            std::vector<Key_value_u64>& scratch,
+                            size_t num_chunks,
+                            Sort_context& out_context)
+{
+    assert(num_chunks > 0);
+    scratch.resize(entries.size());
+
+    out_context.entries = &entries;
+    out_context.scratch = &scratch;
+    out_context.num_chunks = num_chunks;
+    out_context.chunk_key_and_masks.assign(num_chunks, ~0ull);
+    out_context.chunk_key_or_masks.assign(num_chunks, 0);
+    out_context.chunk_histograms.resize(num_chunks);
+}
+
+void radix_sort::scan_chunk_keys(Sort_context& context,
+                                 size_t chunk_idx,
+                                 size_t from_idx,
+                                 size_t to_idx)
+{
+    assert(chunk_idx < context.num_chunks);
+    assert(to_idx <= context.entries->size());
+
+    uint64_t and_mask{ ~0ull };
+    uint64_t or_mask{ 0 };
+    for (size_t i = from_idx; i < to_idx; i++)
+    {
+        uint64_t key{ (*context.entries)[i].key };
+        and_mask &= key;
+        or_mask |= key;
+    }
+    context.chunk_key_and_masks[chunk_idx] = and_mask;
+    context.chunk_key_or_masks[chunk_idx] = or_mask;
+}
+
+uint32_t radix_sort::get_num_passes(const Sort_context& context)
+{
+    uint64_t varying_key_bits{ get_varying_key_bits(context) };
+    uint32_t num_passes{ 0 };
+    for (uint32_t digit = 0; digit < k_max_passes; digit++)
+    {
+        if (((varying_key_bits >> (digit * k_digit_bits)) & k_digit_mask) != 0)
+            num_passes++;
+    }
+    return num_passes;
+}
+
+void radix_sort::sort_pass__histogram_chunk(Sort_context& context,
+                                            uint32_t pass_idx,
+                                            size_t chunk_idx)
+{
+    assert(chunk_idx < context.num_chunks);
+    uint32_t shift{ get_pass_shift(context, pass_idx) };
+    const Key_value_u64* src;
+    Key_value_u64* dst;
+    get_pass_buffers(context, pass_idx, src, dst);
+
+    auto& histogram{ context.chunk_histograms[chunk_idx] };
+    histogram.fill(0);
+
+    size_t from_idx;
+    size_t to_idx;
+    calc_chunk_range(context, chunk_idx, from_idx, to_idx);
+    for (size_t i = from_idx; i < to_idx; i++)
+    {
+        histogram[(src[i].key >> shift) & k_digit_mask]++;
+    }
+}
+
+void radix_sort::sort_pass__scatter_chunk(const Sort_context& context,
+                                          uint32_t pass_idx,
+                                          size_t chunk_idx)
+{
+    assert(chunk_idx < context.num_chunks);
+    uint32_t shift{ get_pass_shift(context, pass_idx) };
+    const Key_value_u64* src;
+    Key_value_u64* dst;
+    get_pass_buffers(context, pass_idx, src, dst);
+
+    // Write offsets of this chunk.
+    // @NOTE: Bucket-major, then chunk order keeps the sort stable.
+    std::array<uint32_t, k_num_buckets> write_offsets;
+    uint32_t offset{ 0 };
+    for (uint32_t bucket = 0; bucket < k_num_buckets; bucket++)
+    {
+        for (size_t chunk = 0; chunk < context.num_chunks; chunk++)
+        {
+            if (chunk == chunk_idx)
+                write_offsets[bucket] = offset;
+            offset += context.chunk_histograms[chunk][bucket];
+        }
+    }
+    assert(offset == context.entries->size());
+
+    // Scatter.
+    size_t from_idx;
+    size_t to_idx;
+    calc_chunk_range(context, chunk_idx, from_idx, to_idx);
+    for (size_t i = from_idx; i < to_idx; i++)
+    {
+        dst[write_offsets[(src[i].key >> shift) & k_digit_mask]++] = src[i];
+    }
+}
+
+void radix_sort::end_sort(Sort_context& context)
+{
+    // Move result into `entries` if last pass wrote into scratch.
+    if (get_num_passes(context) % 2 == 1)
+    {
+        context.entries->swap(*context.scratch);
+    }
+    context.entries = nullptr;
+    context.scratch = nullptr;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <cinttypes>
+#include <cstddef>
+#include <vector>
+
+
+namespace radix_sort
+{
+
+struct Key_value_u64
+{
+    uint64_t key;
+    uint32_t value;
+};
+
+constexpr uint32_t k_digit_bits{ 8 };
+constexpr uint32_t k_num_buckets{ 1 << k_digit_bits };
+
+// Stable LSD radix sort (8 bit digits) by key, split up so that every step
+// runs as a batch of parallel chunk jobs.
+// @NOTE: Call `begin_sort()`, then `scan_chunk_keys()` for every chunk. Then
+//   for every pass `[0, get_num_passes())`, `sort_pass__histogram_chunk()`
+//   for every chunk followed by `sort_pass__scatter_chunk()` for every chunk.
+//   Then `end_sort()`. Chunks of the same step may run concurrently, since
+//   each one only writes its own histogram and its own slices of the output.
+// @NOTE: Passes where every key has the same digit get left out, so sparse
+//   keys only cost the passes they use.
+struct Sort_context
+{
+    std::vector<Key_value_u64>* entries{ nullptr };
+    std::vector<Key_value_u64>* scratch{ nullptr };
+    size_t num_chunks{ 0 };
+
+    // Bits set in every / any key, per chunk.
+    std::vector<uint64_t> chunk_key_and_masks;
+    std::vector<uint64_t> chunk_key_or_masks;
+
+    // Digit counts of the current pass, per chunk.
+    std::vector<std::array<uint32_t, k_num_buckets>> chunk_histograms;
+};
+
+// @NOTE: `entries` has to be sized already (its contents get filled in
+//   before the scans).
+void begin_sort(std::vector<Key_value_u64>& entries,
+                std::vector<Key_value_u64>& scratch,
+                size_t num_chunks,
+                Sort_context& out_context);
+
+// Records which key bits `[from_idx, to_idx)` of the entries use.
+// @NOTE: The ranges of all the chunks have to cover every entry, but don't
+//   have to line up w/ the chunks of the passes.
+void scan_chunk_keys(Sort_context& context,
+                     size_t chunk_idx,
+                     size_t from_idx,
+                     size_t to_idx);
+
+// Only valid once every chunk got scanned.
+uint32_t get_num_passes(const Sort_context& context);
+
+void sort_pass__histogram_chunk(Sort_context& context,
+                                uint32_t pass_idx,
+                                size_t chunk_idx);
+
+// @NOTE: Every chunk works out its own write offsets from all the chunks'
+//   histograms, so there's no serial prefix sum step in between.
+void sort_pass__scatter_chunk(const Sort_context& context,
+                              uint32_t pass_idx,
+                              size_t chunk_idx);
+
+// Leaves the sorted entries in `entries`.
+void end_sort(Sort_context& context);
+
+}  // namespace radix_sort
@@ -18,13 +18,17 @@ Monolithic_renderer::Monolithic_renderer(
     int32_t content_width,
     int32_t content_height,
     int32_t fallback_content_width,
-    int32_t fallback_content_height)
+    int32_t fallback_content_height,
+    uint32_t num_frames_in_flight /*= 2*/,
+    Frame_pacing_mode frame_pacing_mode /*= Frame_pacing_mode::MAX_THROUGHPUT*/)
     : m_pimpl(std::make_unique<Impl>(num_job_sources_setup_incomplete,
                                      name,
                                      content_width,
                                      content_height,
                                      fallback_content_width,
                                      fallback_content_height,
+                                     num_frames_in_flight,
+                                     frame_pacing_mode,
                                      *this))
 {
     Monolithic_renderer* expected{ nullptr };
@@ -62,19 +66,159 @@ void Monolithic_renderer::notify_windowevent_uniconification()
 }
 #endif  // _WIN64
 
+void Monolithic_renderer::set_frame_limiter_fps(float_t target_fps)
+{
+    m_pimpl->set_frame_limiter_fps(target_fps);
+}
+
+Monolithic_renderer::Frame_latency_stats Monolithic_renderer::get_frame_latency_stats()
+{
+    return m_pimpl->get_frame_latency_stats();
+}
+
+void Monolithic_renderer::set_use_fused_geometry_culling(bool use_fused)
+{
+    m_pimpl->set_use_fused_geometry_culling(use_fused);
+}
+
+void Monolithic_renderer::set_main_view_render_layers(gpu_geo_data::Render_layer_mask_t render_layers)
+{
+    m_pimpl->set_main_view_render_layers(render_layers);
+}
+
+void Monolithic_renderer::set_shadow_technique(Shadow_technique technique)
+{
+    m_pimpl->set_shadow_technique(technique);
+}
+
+Monolithic_renderer::Shadow_stats Monolithic_renderer::get_shadow_stats()
+{
+    return m_pimpl->get_shadow_stats();
+}
+
+Monolithic_renderer::Render_stats Monolithic_renderer::get_render_stats()
+{
+    return m_pimpl->get_render_stats();
+}
+
+std::vector<Monolithic_renderer::GPU_pass_timing> Monolithic_renderer::get_gpu_pass_timings()
+{
+    return m_pimpl->get_gpu_pass_timings();
+}
+
+std::vector<Monolithic_renderer::CPU_zone_timing> Monolithic_renderer::get_cpu_zone_timings()
+{
+    return m_pimpl->get_cpu_zone_timings();
+}
+
+bool Monolithic_renderer::export_profiler_trace(const std::string& file_path)
+{
+    return m_pimpl->export_profiler_trace(file_path);
+}
+
+// GPU memory budget.
+Monolithic_renderer::GPU_memory_stats Monolithic_renderer::get_gpu_memory_stats()
+{
+    return m_pimpl->get_gpu_memory_stats();
+}
+
+void Monolithic_renderer::set_memory_pressure_thresholds(float_t warning_fraction,
+                                                         float_t critical_fraction)
+{
+    m_pimpl->set_memory_pressure_thresholds(warning_fraction, critical_fraction);
+}
+
+Monolithic_renderer::memory_pressure_callback_key_t Monolithic_renderer::register_memory_pressure_callback(
+    Memory_pressure_callback_t&& callback)
+{
+    return m_pimpl->register_memory_pressure_callback(std::move(callback));
+}
+
+void Monolithic_renderer::unregister_memory_pressure_callback(memory_pressure_callback_key_t key)
+{
+    m_pimpl->unregister_memory_pressure_callback(key);
+}
+
+// GPU memory defragmentation.
+void Monolithic_renderer::request_gpu_memory_defragmentation()
+{
+    m_pimpl->request_gpu_memory_defragmentation();
+}
+
+Monolithic_renderer::GPU_defrag_stats Monolithic_renderer::get_gpu_defrag_stats()
+{
+    return m_pimpl->get_gpu_defrag_stats();
+}
+
+void Monolithic_renderer::set_gpu_memory_churn_workload(bool enabled)
+{
+    m_pimpl->set_gpu_memory_churn_workload(enabled);
+}
+
+// Update data.
+void Monolithic_renderer::set_num_update_data_chunks(uint32_t num_chunks)
+{
+    m_pimpl->set_num_update_data_chunks(num_chunks);
+}
+
+void Monolithic_renderer::start_update_data_scaling_benchmark()
+{
+    m_pimpl->start_update_data_scaling_benchmark();
+}
+
+std::vector<Monolithic_renderer::Update_data_scaling_result>
+Monolithic_renderer::get_update_data_scaling_results()
+{
+    return m_pimpl->get_update_data_scaling_results();
+}
+
+// Shadow technique benchmark.
+void Monolithic_renderer::start_shadow_technique_benchmark()
+{
+    m_pimpl->start_shadow_technique_benchmark();
+}
+
+std::vector<Monolithic_renderer::Shadow_technique_benchmark_result>
+Monolithic_renderer::get_shadow_technique_benchmark_results()
+{
+    return m_pimpl->get_shadow_technique_benchmark_results();
+}
+
 // Render geometry objects.
 Monolithic_renderer::render_geo_obj_key_t Monolithic_renderer::create_render_geo_obj(
     const std::string& model_name,
     const std::string& material_set_name,
     geo_instance::Geo_render_pass render_pass,
     bool is_shadow_caster,
-    world_sim::Transform_read_ifc* transform_reader)
+    world_sim::Transform_read_ifc* transform_reader,
+    gpu_geo_data::Render_layer render_layer /*= gpu_geo_data::Render_layer::DEFAULT*/,
+    bool never_cull /*= false*/)
 {
     return m_pimpl->create_render_geo_obj(model_name,
                                           material_set_name,
                                           render_pass,
                                           is_shadow_caster,
-                                          transform_reader);
+                                          transform_reader,
+                                          render_layer,
+                                          never_cull);
+}
+
+Monolithic_renderer::render_geo_obj_key_t Monolithic_renderer::create_render_geo_obj(
+    const std::string& model_name,
+    const std::string& material_set_name,
+    geo_instance::Geo_render_pass render_pass,
+    bool is_shadow_caster,
+    transform_batch::Transform_ref batched_transform,
+    gpu_geo_data::Render_layer render_layer /*= gpu_geo_data::Render_layer::DEFAULT*/,
+    bool never_cull /*= false*/)
+{
+    return m_pimpl->create_render_geo_obj(model_name,
+                                          material_set_name,
+                                          render_pass,
+                                          is_shadow_caster,
+                                          batched_transform,
+                                          render_layer,
+                                          never_cull);
 }
 
 void Monolithic_renderer::destroy_render_geo_obj(render_geo_obj_key_t key)
@@ -88,6 +232,24 @@ void Monolithic_renderer::set_render_geo_obj_transform(render_geo_obj_key_t key,
     m_pimpl->set_render_geo_obj_transform(key, transform);
 }
 
+void Monolithic_renderer::set_render_geo_obj_render_layer(render_geo_obj_key_t key,
+                                                          gpu_geo_data::Render_layer render_layer)
+{
+    m_pimpl->set_render_geo_obj_render_layer(key, render_layer);
+}
+
+// Batched transform sources.
+transform_batch::Source_key_t Monolithic_renderer::register_transform_batch_source(
+    transform_batch::Source_ifc* source)
+{
+    return m_pimpl->register_transform_batch_source(source);
+}
+
+void Monolithic_renderer::unregister_transform_batch_source(transform_batch::Source_key_t key)
+{
+    m_pimpl->unregister_transform_batch_source(key);
+}
+
 // Fetch next jobs.
 Job_source::Job_next_jobs_return_data Monolithic_renderer::fetch_next_jobs_callback()
 {
@@ -9,10 +9,16 @@
 #include <GLFW/glfw3.h>
 #include "VkBootstrap.h"
 
+#include <algorithm>
+#include <bit>
+#include <chrono>
 #include <cinttypes>
+#include <cmath>
 #include <cstring>
 #include <iostream>
+#include <thread>
 #include "camera.h"
+#include "cpu_profiler.h"
 #include "geo_instance.h"
 #include "gltf_loader.h"
 #include "imgui_system.h"
@@ -22,6 +28,7 @@
 #include "renderer_win64_vk_pipeline_builder.h"
 #include "renderer_win64_vk_util.h"
 #include "timing_reporter_public.h"
+#include "transform_batch.h"
 
 
 // Callbacks for input.
@@ -93,12 +100,40 @@ static void window_iconify_callback(GLFWwindow* window,
 // For extern symbol.
 std::atomic<Monolithic_renderer*> s_mr_singleton_ptr{ nullptr };
 
+// Job names (also the names of their profiler trace spans).
+static constexpr std::array<const char*, k_num_update_data_phases> k_update_data_phase_names{
+    "Renderer Update Data Begin Rebucket job",
+    "Renderer Update Data Bucket Chunk job",
+    "Renderer Update Data Sort Histogram Chunk job",
+    "Renderer Update Data Sort Scatter Chunk job",
+    "Renderer Update Data Begin Upload job",
+    "Renderer Update Data Upload Chunk job",
+    "Renderer Update Data Finish job",
+};
+static constexpr std::array<const char*, k_num_update_data_phases> k_update_data_phase_timing_names{
+    "Begin Rebucket",
+    "Bucket Chunks",
+    "Sort Histogram Chunks",
+    "Sort Scatter Chunks",
+    "Begin Upload",
+    "Upload Chunks",
+    "Finish",
+};
+static constexpr std::array<const char*, k_num_render_pass_cmds> k_record_render_pass_job_names{
+    "Record Geometry Culling Cmds job",
+    "Record Sunlight Shadow Cascades Cmds job",
+    "Record Opaque Geometry Cmds job",
+    "Record Postprocess and Present Cmds job",
+};
+
 Monolithic_renderer::Impl::Impl(std::atomic_size_t& num_job_sources_setup_incomplete,
                                 const std::string& name,
                                 int32_t content_width,
                                 int32_t content_height,
                                 int32_t fallback_content_width,
                                 int32_t fallback_content_height,
+                                uint32_t num_frames_in_flight,
+                                Frame_pacing_mode frame_pacing_mode,
                                 Job_source& source)
     : m_num_job_sources_setup_incomplete(num_job_sources_setup_incomplete)
     , m_name(name)
@@ -113,10 +148,191 @@ Monolithic_renderer::Impl::Impl(std::atomic_size_t& num_job_sources_setup_incomp
         std::make_unique<Calculate_delta_time_job>(source, *this))
     , m_update_poll_window_events_job(
         std::make_unique<Update_poll_window_events_job>(source, m_delta_time))
-    , m_update_data_job(std::make_unique<Update_data_job>(source, *this))
-    , m_render_job(std::make_unique<Render_job>(source, *this))
+    , m_begin_render_job(std::make_unique<Begin_render_job>(source, *this))
+    , m_record_render_pass_jobs{
+        std::make_unique<Record_render_pass_job>(k_record_render_pass_job_names[0],
+                                                 source,
+                                                 *this,
+                                                 Render_pass_cmd::GEOMETRY_CULLING),
+        std::make_unique<Record_render_pass_job>(k_record_render_pass_job_names[1],
+                                                 source,
+                                                 *this,
+                                                 Render_pass_cmd::SUNLIGHT_SHADOW_CASCADES),
+        std::make_unique<Record_render_pass_job>(k_record_render_pass_job_names[2],
+                                                 source,
+                                                 *this,
+                                                 Render_pass_cmd::OPAQUE_GEOMETRY),
+        std::make_unique<Record_render_pass_job>(k_record_render_pass_job_names[3],
+                                                 source,
+                                                 *this,
+                                                 Render_pass_cmd::POSTPROCESS_AND_PRESENT),
+    }
+    , m_submit_render_job(std::make_unique<Submit_render_job>(source, *this))
     , m_teardown_job(std::make_unique<Teardown_job>(source, *this))
+    , m_num_frames_in_flight(std::clamp(num_frames_in_flight,
+                                        k_min_frames_in_flight,
+                                        k_max_frames_in_flight))
+    , m_frame_pacing_mode(frame_pacing_mode)
+{
+    // Frames in flight out of supported range.
+    if (m_num_frames_in_flight != num_frames_in_flight)
+    {
+        std::cerr << "WARNING: " << num_frames_in_flight << " frames in flight not supported. "
+                     "Clamped to " << m_num_frames_in_flight << "." << std::endl;
+    }
+
+    // Update data jobs.
+    // @NOTE: Enough chunk jobs for any chunk count, so it can change between frames.
+    for (size_t i = 0; i < k_num_update_data_phases; i++)
+    {
+        auto phase{ static_cast<Update_data_phase>(i) };
+        size_t num_jobs{ is_update_data_chunk_phase(phase) ? k_max_update_data_chunks : 1 };
+        for (size_t chunk_idx = 0; chunk_idx < num_jobs; chunk_idx++)
+        {
+            m_update_data_jobs[i].emplace_back(
+                std::make_unique<Update_data_job>(k_update_data_phase_names[i],
+                                                  source,
+                                                  *this,
+                                                  phase,
+                                                  chunk_idx));
+        }
+    }
+}
+
+// Frame pacing.
+Monolithic_renderer::Frame_latency_stats Monolithic_renderer::Impl::get_frame_latency_stats()
+{
+    return Frame_latency_stats{
+        .last_ms = m_latency_last_ms,
+        .avg_ms = m_latency_avg_ms,
+        .max_ms = m_latency_max_ms,
+        .num_samples = m_latency_num_samples,
+    };
+}
+
+// Shadows.
+Monolithic_renderer::Shadow_stats Monolithic_renderer::Impl::get_shadow_stats()
+{
+    std::lock_guard<std::mutex> lock{ m_shadow_stats_mutex };
+    return m_shadow_stats;
+}
+
+// Render stats.
+Monolithic_renderer::Render_stats Monolithic_renderer::Impl::get_render_stats()
+{
+    Render_stats stats;
+    {
+        std::lock_guard<std::mutex> lock{ m_render_stats_mutex };
+        stats = m_render_stats;
+    }
+    stats.is_frame_pipelined = m_is_update_data_pipelined;
+    stats.num_pipelined_frames = m_num_pipelined_update_datas;
+
+    if (!m_gpu_profiler.is_pipeline_stats_supported)
+        return stats;
+
+    stats.pass_pipeline_stats.reserve(vk_profiler::k_num_gpu_stats_passes);
+    for (size_t i = 0; i < vk_profiler::k_num_gpu_stats_passes; i++)
+    {
+        auto pass{ static_cast<vk_profiler::GPU_stats_pass>(i) };
+        auto pipeline_stats{ vk_profiler::get_pipeline_stats(m_gpu_profiler, pass) };
+        stats.pass_pipeline_stats.emplace_back(Render_stats::Pass_pipeline_stats{
+            .name = vk_profiler::get_gpu_stats_pass_name(pass),
+            .vertex_shader_invocations = pipeline_stats.vertex_shader_invocations,
+            .clipping_primitives = pipeline_stats.clipping_primitives,
+            .fragment_shader_invocations = pipeline_stats.fragment_shader_invocations,
+            .compute_shader_invocations = pipeline_stats.compute_shader_invocations,
+        });
+    }
+    return stats;
+}
+
+// Profiling.
+std::vector<Monolithic_renderer::GPU_pass_timing> Monolithic_renderer::Impl::get_gpu_pass_timings()
+{
+    std::vector<GPU_pass_timing> timings;
+    if (!m_gpu_profiler.is_supported)
+        return timings;
+
+    timings.reserve(vk_profiler::k_num_gpu_zones);
+    for (size_t i = 0; i < vk_profiler::k_num_gpu_zones; i++)
+    {
+        auto zone{ static_cast<vk_profiler::GPU_zone>(i) };
+        auto stats{ vk_profiler::get_zone_stats(m_gpu_profiler, zone) };
+        timings.emplace_back(GPU_pass_timing{
+            .name = vk_profiler::get_gpu_zone_name(zone),
+            .min_ms = stats.min_ms,
+            .avg_ms = stats.avg_ms,
+            .p99_ms = stats.p99_ms,
+            .num_samples = stats.num_samples,
+        });
+    }
+    return timings;
+}
+
+std::vector<Monolithic_renderer::CPU_zone_timing> Monolithic_renderer::Impl::get_cpu_zone_timings()
+{
+    std::vector<cpu_profiler::Zone_stats> all_stats;
+    cpu_profiler::collect_zone_stats(all_stats);
+
+    std::vector<CPU_zone_timing> timings;
+    timings.reserve(all_stats.size());
+    for (auto& stats : all_stats)
+        timings.emplace_back(CPU_zone_timing{
+            .name = stats.name,
+            .avg_ms_per_frame = stats.avg_ms_per_frame,
+            .max_ms = stats.max_ms,
+            .calls_per_frame = stats.calls_per_frame,
+        });
+    return timings;
+}
+
+// GPU memory budget.
+Monolithic_renderer::GPU_memory_stats Monolithic_renderer::Impl::get_gpu_memory_stats()
 {
+    GPU_memory_stats stats;
+
+    stats.category_usages.reserve(vk_memory::k_num_memory_categories);
+    for (size_t i = 0; i < vk_memory::k_num_memory_categories; i++)
+    {
+        auto category{ static_cast<vk_memory::Memory_category>(i) };
+        auto usage{ vk_memory::get_category_usage(category) };
+        stats.category_usages.emplace_back(GPU_memory_stats::Category_usage{
+            .name = vk_memory::get_memory_category_name(category),
+            .num_bytes = usage.num_bytes,
+            .num_allocations = usage.num_allocations,
+        });
+    }
+
+    std::vector<vk_memory::Heap_sample> heap_samples;
+    vk_memory::get_heap_samples(m_memory_budget, heap_samples);
+    stats.heap_usages.reserve(heap_samples.size());
+    for (auto& sample : heap_samples)
+        stats.heap_usages.emplace_back(GPU_memory_stats::Heap_usage{
+            .usage_bytes = sample.usage_bytes,
+            .budget_bytes = sample.budget_bytes,
+            .is_device_local = sample.is_device_local,
+        });
+
+    // @NOTE: Same values as `vk_memory::Pressure_level`.
+    stats.pressure_level =
+        static_cast<Memory_pressure_level>(vk_memory::get_pressure_level(m_memory_budget));
+    return stats;
+}
+
+Monolithic_renderer::memory_pressure_callback_key_t
+Monolithic_renderer::Impl::register_memory_pressure_callback(Memory_pressure_callback_t&& callback)
+{
+    return vk_memory::add_pressure_callback(
+        m_memory_budget,
+        [callback{ std::move(callback) }](const vk_memory::Pressure_event& event) {
+            callback(Memory_pressure_event{
+                .level = static_cast<Memory_pressure_level>(event.level),
+                .prev_level = static_cast<Memory_pressure_level>(event.prev_level),
+                .usage_bytes = event.usage_bytes,
+                .budget_bytes = event.budget_bytes,
+            });
+        });
 }
 
 // Render geometry object lifetime.
@@ -125,7 +341,9 @@ Monolithic_renderer::Impl::create_render_geo_obj(const std::string& model_name,
                                                  const std::string& material_set_name,
                                                  geo_instance::Geo_render_pass render_pass,
                                                  bool is_shadow_caster,
-                                                 world_sim::Transform_read_ifc* transform_reader)
+                                                 world_sim::Transform_read_ifc* transform_reader,
+                                                 gpu_geo_data::Render_layer render_layer,
+                                                 bool never_cull)
 {
     assert(m_all_assets_loaded);
 
@@ -136,7 +354,34 @@ Monolithic_renderer::Impl::create_render_geo_obj(const std::string& model_name,
         .is_shadow_caster = is_shadow_caster,
         .transform_reader_handle = transform_reader,
         .gpu_instance_data{
-            .material_param_set_idx = material_bank::get_mat_set_idx_from_name(material_set_name)
+            .material_param_set_idx = material_bank::get_mat_set_idx_from_name(material_set_name),
+            .render_layer = static_cast<uint32_t>(render_layer),
+            .flags = (never_cull ? gpu_geo_data::k_instance_flag_never_cull : 0u),
+        },
+    });
+}
+
+Monolithic_renderer::render_geo_obj_key_t
+Monolithic_renderer::Impl::create_render_geo_obj(const std::string& model_name,
+                                                 const std::string& material_set_name,
+                                                 geo_instance::Geo_render_pass render_pass,
+                                                 bool is_shadow_caster,
+                                                 transform_batch::Transform_ref batched_transform,
+                                                 gpu_geo_data::Render_layer render_layer,
+                                                 bool never_cull)
+{
+    assert(m_all_assets_loaded);
+    assert(batched_transform.source_key != transform_batch::k_invalid_source_key);
+
+    return geo_instance::register_geo_instance(geo_instance::Geo_instance{
+        .model_idx = gltf_loader::get_model_idx_from_name(model_name),
+        .render_pass = render_pass,
+        .is_shadow_caster = is_shadow_caster,
+        .batched_transform = batched_transform,
+        .gpu_instance_data{
+            .material_param_set_idx = material_bank::get_mat_set_idx_from_name(material_set_name),
+            .render_layer = static_cast<uint32_t>(render_layer),
+            .flags = (never_cull ? gpu_geo_data::k_instance_flag_never_cull : 0u),
         },
     });
 }
@@ -154,9 +399,29 @@ void Monolithic_renderer::Impl::set_render_geo_obj_transform(render_geo_obj_key_
     geo_instance::set_geo_instance_transform(key, transform);
 }
 
+void Monolithic_renderer::Impl::set_render_geo_obj_render_layer(render_geo_obj_key_t key,
+                                                                gpu_geo_data::Render_layer render_layer)
+{
+    assert(m_all_assets_loaded);
+    geo_instance::set_geo_instance_render_layer(key, render_layer);
+}
+
+// Batched transform sources.
+transform_batch::Source_key_t
+Monolithic_renderer::Impl::register_transform_batch_source(transform_batch::Source_ifc* source)
+{
+    return transform_batch::register_source(source);
+}
+
+void Monolithic_renderer::Impl::unregister_transform_batch_source(transform_batch::Source_key_t key)
+{
+    transform_batch::unregister_source(key);
+}
+
 // Jobs.
 int32_t Monolithic_renderer::Impl::Build_window_job::execute()
 {
+    CPU_PROFILER_ZONE("Window Build job");
     bool success{ true };
     success &= m_pimpl.build_window();
     return success ? 0 : 1;
@@ -164,6 +429,7 @@ int32_t Monolithic_renderer::Impl::Build_window_job::execute()
 
 int32_t Monolithic_renderer::Impl::Build_job::execute()
 {
+    CPU_PROFILER_ZONE("Renderer Build job");
     bool success{ true };
     success &= m_pimpl.build_vulkan_renderer();
 
@@ -183,6 +449,7 @@ int32_t Monolithic_renderer::Impl::Build_job::execute()
 
 int32_t Monolithic_renderer::Impl::Load_assets_job::execute()
 {
+    CPU_PROFILER_ZONE("Load assets job");
     // @TODO: @THEA: add these material and model constructions into the actual soranin game as a constructor param.
     // @TODO: change this into reading a json file for material info.
 
@@ -190,24 +457,28 @@ int32_t Monolithic_renderer::Impl::Load_assets_job::execute()
     TIMING_REPORT_START(reg_pipes);
     VkFormat draw_format{ m_pimpl.m_v_HDR_draw_image.image.image_format };
 
-    material_bank::set_descriptor_references(
+    material_bank::build_shared_pipeline_layouts(
+        m_pimpl.m_v_device,
         m_pimpl.m_v_geometry_graphics_pass.per_frame_datas.front().camera_data.descriptor_layout,
-        m_pimpl.m_v_geometry_graphics_pass.per_frame_datas.front().shadow_camera_data.descriptor_layout,
-        m_pimpl.m_v_geometry_graphics_pass.material_param_sets_data.descriptor_layout,
-        m_pimpl.m_v_geometry_graphics_pass.material_param_definition_descriptor_layout,
-        m_pimpl.m_v_geometry_graphics_pass.material_param_sets_data.descriptor_set);
+        m_pimpl.m_v_geometry_graphics_pass.per_frame_datas.front().shadow_camera_descriptor_layout,
+        m_pimpl.m_v_geometry_graphics_pass.per_frame_datas.front().virtual_shadow_camera_data.descriptor_layout);
 
     material_bank::register_pipeline("missing");
     material_bank::register_pipeline("opaque_z_prepass");
-    material_bank::register_pipeline("opaque_shadow");  // @TODO: IMPLEMENT SHADOWS
+    material_bank::register_pipeline("opaque_shadow");
+    material_bank::register_pipeline("opaque_virtual_shadow");
     
     auto& v_device{ m_pimpl.m_v_device };
+    VkFormat main_depth_format{ m_pimpl.m_v_main_depth_image.image.image_format };
+    VkFormat shadow_depth_format{ m_pimpl.m_v_shadow_cascade_image.image.image_format };
     material_bank::define_pipeline("missing",
                                    "opaque_z_prepass",
-                                   "", // "opaque_shadow",  // @TODO: ADD SHADOWS.
+                                   "opaque_shadow",
+                                   "opaque_virtual_shadow",
                                    material_bank::create_geometry_material_pipeline(
                                        v_device,
                                        draw_format,
+                                       main_depth_format,
                                        true,
                                        material_bank::Camera_type::MAIN_VIEW,
                                        true,
@@ -217,30 +488,47 @@ int32_t Monolithic_renderer::Impl::Load_assets_job::execute()
                                        "assets/shaders/geommat_missing.vert.spv",
                                        "assets/shaders/geommat_missing.frag.spv"));
     material_bank::define_pipeline("opaque_z_prepass",
+                                   "",
                                    "",
                                    "",
                                    material_bank::create_geometry_material_pipeline(
                                        v_device,
                                        draw_format,
+                                       main_depth_format,
                                        false,
                                        material_bank::Camera_type::MAIN_VIEW,
                                        false,
                                        {},
                                        "assets/shaders/geommat_opaque_z_prepass.vert.spv",
                                        "assets/shaders/geommat_opaque_z_prepass.frag.spv"));
-    // @TODO: IMPLEMENT SHADOWS
-    // material_bank::define_pipeline("opaque_shadow",
-    //                                "",
-    //                                "",
-    //                                material_bank::create_geometry_material_pipeline(
-    //                                    v_device,
-    //                                    draw_format,
-    //                                    false,
-    //                                    material_bank::Camera_type::SHADOW_VIEW,
-    //                                    false,
-    //                                    {},
-    //                                    "assets/shaders/geommat_opaque_shadow.vert.spv",
-    //                                    "assets/shaders/geommat_opaque_shadow.frag.spv"));
+    material_bank::define_pipeline("opaque_shadow",
+                                   "",
+                                   "",
+                                   "",
+                                   material_bank::create_geometry_material_pipeline(
+                                       v_device,
+                                       VK_FORMAT_UNDEFINED,
+                                       shadow_depth_format,
+                                       false,
+                                       material_bank::Camera_type::SHADOW_VIEW,
+                                       false,
+                                       {},
+                                       "assets/shaders/geommat_opaque_shadow.vert.spv",
+                                       "assets/shaders/geommat_opaque_shadow.frag.spv"));
+    material_bank::define_pipeline("opaque_virtual_shadow",
+                                   "",
+                                   "",
+                                   "",
+                                   material_bank::create_geometry_material_pipeline(
+                                       v_device,
+                                       VK_FORMAT_UNDEFINED,
+                                       VK_FORMAT_UNDEFINED,
+                                       false,
+                                       material_bank::Camera_type::VIRTUAL_SHADOW_VIEW,
+                                       false,
+                                       {},
+                                       "assets/shaders/geommat_opaque_shadow.vert.spv",
+                                       "assets/shaders/geommat_opaque_virtual_shadow.frag.spv"));
     TIMING_REPORT_END_AND_PRINT(reg_pipes, "Register Material Pipelines: ");
 
     // Materials.
@@ -436,56 +724,33 @@ int32_t Monolithic_renderer::Impl::Load_assets_job::execute()
 
     TIMING_REPORT_END_AND_PRINT(upload_combined_mesh, "Load All Models and Upload Combined Mesh: ");
 
-    // Upload material param indices and material sets.
-    TIMING_REPORT_START(upload_material_sets);
-    vk_buffer::upload_material_param_sets_to_gpu(m_pimpl.m_v_geo_passes_resource_buffer,
-                                                 m_pimpl.m_immediate_submit_support,
-                                                 m_pimpl.m_v_device,
-                                                 m_pimpl.m_v_graphics_queue,
-                                                 m_pimpl.m_v_vma_allocator,
-                                                 material_bank::get_all_material_sets());
-    m_pimpl.write_material_param_sets_to_descriptor_sets();
-    TIMING_REPORT_END_AND_PRINT(upload_material_sets, "Upload Material Param Indices and Material Sets: ");
-
     // Upload material param datas.
     TIMING_REPORT_START(upload_material_param_datas);
     material_bank::cook_and_upload_pipeline_material_param_datas_to_gpu(
         m_pimpl.m_immediate_submit_support,
         m_pimpl.m_v_device,
         m_pimpl.m_v_graphics_queue,
-        m_pimpl.m_v_vma_allocator,
-        m_pimpl.m_v_descriptor_alloc);
+        m_pimpl.m_v_vma_allocator);
     TIMING_REPORT_END_AND_PRINT(upload_material_param_datas, "Upload Material Param Datas for Pipeline: ");
 
     // Upload bounding sphere data.
     TIMING_REPORT_START(upload_bs);
     vk_buffer::upload_bounding_spheres_to_gpu(m_pimpl.m_v_geo_passes_resource_buffer,
+                                              m_pimpl.m_buffer_registry,
+                                              m_pimpl.m_frame_number,
                                               m_pimpl.m_immediate_submit_support,
                                               m_pimpl.m_v_device,
                                               m_pimpl.m_v_graphics_queue,
                                               m_pimpl.m_v_vma_allocator,
                                               gltf_loader::get_all_bounding_spheres());
-    m_pimpl.write_bounding_spheres_to_descriptor_sets();
     TIMING_REPORT_END_AND_PRINT(upload_bs, "Upload Bounding Spheres: ");
 
-    // Report memory heap usage.
-    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
-    vmaGetHeapBudgets(m_pimpl.m_v_vma_allocator, budgets);
-    for (uint32_t i = 0; i < m_pimpl.m_v_vma_allocator->GetMemoryHeapCount(); i++)
-    {
-        uint32_t allocs{ budgets[i].statistics.allocationCount };
-        float_t allocs_mb{ budgets[i].statistics.allocationBytes / 1024.0f / 1024.0f };
-        uint32_t blocks{ budgets[i].statistics.blockCount };
-        float_t blocks_mb{ budgets[i].statistics.blockBytes / 1024.0f / 1024.0f };
-        float_t usage_mb{ budgets[i].usage / 1024.0f / 1024.0f };
-        float_t budget_mb{ budgets[i].budget / 1024.0f / 1024.0f };
-        std::cout
-            << (i == 0 ? "-=-=- GPU Memory Report -=-=-" : "")                 << std::endl
-            << "# Memory Heap " << i                                           << std::endl
-            << "  " << allocs << " allocations (" << allocs_mb << " MB)"       << std::endl
-            << "  " << blocks << " blocks (" << blocks_mb << " MB)"            << std::endl
-            << "  " << usage_mb << " MB usage / " << budget_mb << " MB budget" << std::endl;
-    }
+    // Report memory usage.
+    vk_memory::sample_memory_budget(m_pimpl.m_memory_budget, m_pimpl.m_v_vma_allocator);
+    vk_memory::print_memory_report(m_pimpl.m_memory_budget);
+
+    // Pipelines and material data changed.
+    m_pimpl.invalidate_cached_render_pass_cmds();
 
     m_pimpl.m_all_assets_loaded = true;
 
@@ -528,9 +793,17 @@ int32_t Monolithic_renderer::Impl::Load_assets_job::execute()
 
 int32_t Monolithic_renderer::Impl::Calculate_delta_time_job::execute()
 {
+    CPU_PROFILER_ZONE("Calculate Delta Time job");
     bool success{ true };
 
+    // @NOTE: Pacing waits happen here, *before* input and transforms are
+    //   sampled for this frame, so that the sampled data is as fresh as
+    //   possible once the frame starts being built.
+    m_pimpl.poll_frame_latency_measurements();
+    m_pimpl.wait_for_frame_pacing();
+
     double_t current_time{ glfwGetTime() };
+    m_pimpl.m_input_sample_time = current_time;
 
     if (m_pimpl.m_prev_time >= 0.0)
     {
@@ -551,6 +824,7 @@ int32_t Monolithic_renderer::Impl::Calculate_delta_time_job::execute()
 
 int32_t Monolithic_renderer::Impl::Update_poll_window_events_job::execute()
 {
+    CPU_PROFILER_ZONE("Poll Window Events job");
     bool success{ true };
 
     glfwPollEvents();
@@ -563,21 +837,41 @@ int32_t Monolithic_renderer::Impl::Update_poll_window_events_job::execute()
 
 int32_t Monolithic_renderer::Impl::Update_data_job::execute()
 {
+    CPU_PROFILER_ZONE(k_update_data_phase_names[static_cast<size_t>(m_phase)]);
+    m_begin_time = glfwGetTime();
+    bool success{ true };
+    success &= m_pimpl.prepare_render_data(m_phase, m_chunk_idx);
+    m_end_time = glfwGetTime();
+    return success ? 0 : 1;
+}
+
+int32_t Monolithic_renderer::Impl::Begin_render_job::execute()
+{
+    CPU_PROFILER_ZONE("Renderer Begin Render job");
+    bool success{ true };
+    success &= m_pimpl.begin_render();
+    return success ? 0 : 1;
+}
+
+int32_t Monolithic_renderer::Impl::Record_render_pass_job::execute()
+{
+    CPU_PROFILER_ZONE(k_record_render_pass_job_names[static_cast<size_t>(m_pass)]);
     bool success{ true };
-    // @TODO: Implement.
+    success &= m_pimpl.record_render_pass_cmds(m_pass);
     return success ? 0 : 1;
 }
 
-int32_t Monolithic_renderer::Impl::Render_job::execute()
+int32_t Monolithic_renderer::Impl::Submit_render_job::execute()
 {
+    CPU_PROFILER_ZONE("Renderer Submit Render job");
     bool success{ true };
-    success &= m_pimpl.update_and_upload_render_data();
-    success &= m_pimpl.render();
+    success &= m_pimpl.submit_render();
     return success ? 0 : 1;
 }
 
 int32_t Monolithic_renderer::Impl::Teardown_job::execute()
 {
+    CPU_PROFILER_ZONE("Renderer Teardown job");
     bool success{ true };
     success &= m_pimpl.wait_for_renderer_idle();
     success &= gltf_loader::teardown_all_meshes();
@@ -644,25 +938,79 @@ Job_source::Job_next_jobs_return_data Monolithic_renderer::Impl::fetch_next_jobs
             return_data.jobs = {
                 m_calculate_delta_time_job.get(),
             };
-            m_stage = Stage::UPDATE_DATA;
+            m_stage = Stage::POLL_WINDOW_EVENTS;
             break;
 
-        case Stage::UPDATE_DATA:
+        case Stage::POLL_WINDOW_EVENTS:
             return_data.jobs = {
                 m_update_poll_window_events_job.get(),
-                m_update_data_job.get(),
             };
-            m_stage = Stage::RENDER;
+            m_stage = Stage::UPDATE_DATA;
+            break;
+
+        case Stage::UPDATE_DATA:
+            if (get_current_frame().is_render_data_prepared)
+            {
+                // Already prepared by the previous frame's pipelined update
+                // data (or prepared but not rendered, e.g. while minimized).
+                append_begin_render_jobs(return_data);
+            }
+            else
+            {
+                // Prepare the current frame in series.
+                m_is_update_data_pipelined = false;
+                start_update_data_phases(m_frame_number);
+                append_next_update_data_phase_jobs(return_data);
+                m_stage = Stage::PREPARE_RENDER_DATA;
+            }
+            break;
+
+        case Stage::PREPARE_RENDER_DATA:
+            if (append_next_update_data_phase_jobs(return_data))
+                break;
+
+            // All update data phases finished.
+            [[fallthrough]];
+
+        case Stage::BEGIN_RENDER:
+            append_begin_render_jobs(return_data);
+            break;
+
+        case Stage::RECORD_RENDER_PASSES:
+            if (m_is_render_frame_active)
+            {
+                for (auto& record_job : m_record_render_pass_jobs)
+                    return_data.jobs.emplace_back(record_job.get());
+            }
+            if (m_is_update_data_pipelined)
+            {
+                append_next_update_data_phase_jobs(return_data);
+            }
+            m_stage = Stage::SUBMIT_RENDER;
             break;
 
-        case Stage::RENDER:
+        case Stage::SUBMIT_RENDER:
             return_data.jobs = {
-                m_render_job.get(),
+                m_submit_render_job.get(),
             };
-            // @NOTE: the render job checks if a shutdown is
-            //        requested, and at that point the stage
-            //        will be set to teardown instead of update.
-            m_stage = Stage::CALCULATE_DELTA_TIME;
+            if (m_is_update_data_pipelined)
+            {
+                append_next_update_data_phase_jobs(return_data);
+            }
+            m_stage = Stage::FINISH_PIPELINED_UPDATE_DATA;
+            break;
+
+        case Stage::FINISH_PIPELINED_UPDATE_DATA:
+            if (m_is_update_data_pipelined &&
+                append_next_update_data_phase_jobs(return_data))
+                break;
+
+            // @NOTE: the submit render job checks if a shutdown
+            //        is requested, and at that point the stage
+            //        gets set to teardown instead of update.
+            m_stage = (m_is_close_requested ?
+                       Stage::TEARDOWN :
+                       Stage::CALCULATE_DELTA_TIME);
             break;
 
         case Stage::TEARDOWN:
@@ -765,7 +1113,9 @@ bool build_vulkan_renderer__vulkan(GLFWwindow* window,
                                    VkPhysicalDevice& out_physical_device,
                                    VkPhysicalDeviceProperties& out_physical_device_properties,
                                    VkDevice& out_device,
-                                   vkb::Device& out_vkb_device)
+                                   vkb::Device& out_vkb_device,
+                                   bool& out_is_memory_budget_ext_enabled,
+                                   bool& out_is_pipeline_stats_query_enabled)
 {
     VkResult err;
 
@@ -822,6 +1172,8 @@ bool build_vulkan_renderer__vulkan(GLFWwindow* window,
         .runtimeDescriptorArray = VK_TRUE,
         // For MIN/MAX sampler when creating mip chains for occlusion culling.
         .samplerFilterMinmax = VK_TRUE,
+        // For resetting GPU profiler queries w/o recording a reset cmd.
+        .hostQueryReset = VK_TRUE,
         // For buffer references in the stead of descriptor sets.
         .bufferDeviceAddress = VK_TRUE,
     };
@@ -846,6 +1198,17 @@ bool build_vulkan_renderer__vulkan(GLFWwindow* window,
             .value()
     };
     out_physical_device = physical_device.physical_device;
+
+    // For the driver's memory budget (what's left for this process) instead
+    // of VMA estimating it.
+    out_is_memory_budget_ext_enabled =
+        physical_device.enable_extension_if_present(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    // For the render stats. Optional, since they're only for profiling.
+    out_is_pipeline_stats_query_enabled =
+        physical_device.enable_features_if_present(VkPhysicalDeviceFeatures{
+            .pipelineStatisticsQuery = VK_TRUE,
+        });
     out_physical_device_properties = physical_device.properties;
 
     // Print phsyical device properties.
@@ -893,7 +1256,9 @@ bool build_vulkan_renderer__vulkan(GLFWwindow* window,
 bool build_vulkan_renderer__allocator(VkInstance instance,
                                       VkPhysicalDevice physical_device,
                                       VkDevice device,
-                                      VmaAllocator& out_allocator)
+                                      bool is_memory_budget_ext_enabled,
+                                      VmaAllocator& out_allocator,
+                                      vk_memory::Memory_budget& out_memory_budget)
 {
     // Initialize VMA.
     VmaAllocatorCreateInfo vma_allocator_info{
@@ -902,8 +1267,12 @@ bool build_vulkan_renderer__allocator(VkInstance instance,
         .device = device,
         .instance = instance,
     };
+    if (is_memory_budget_ext_enabled)
+        vma_allocator_info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
     vmaCreateAllocator(&vma_allocator_info, &out_allocator);
 
+    vk_memory::init_memory_budget(out_memory_budget, out_allocator, is_memory_budget_ext_enabled);
+
     return true;
 }
 
@@ -912,6 +1281,7 @@ bool build_vulkan_renderer__swapchain(VkSurfaceKHR surface,
                                       VkDevice device,
                                       int32_t window_width,
                                       int32_t window_height,
+                                      bool low_latency_present,
                                       VkSwapchainKHR& out_swapchain,
                                       std::vector<VkImage>& out_swapchain_images,
                                       std::vector<VkImageView>& out_swapchain_image_views,
@@ -921,11 +1291,22 @@ bool build_vulkan_renderer__swapchain(VkSurfaceKHR surface,
     // Build swapchain.
     // @TODO: Make swapchain rebuilding a thing.
     vkb::SwapchainBuilder swapchain_builder{ physical_device, device, surface };
+    if (low_latency_present)
+    {
+        swapchain_builder
+            .set_desired_present_mode(VK_PRESENT_MODE_IMMEDIATE_KHR)  // Immediate (tearing allowed, lowest latency).
+            .add_fallback_present_mode(VK_PRESENT_MODE_MAILBOX_KHR)
+            .add_fallback_present_mode(VK_PRESENT_MODE_FIFO_KHR);
+    }
+    else
+    {
+        swapchain_builder
+            .set_desired_present_mode(VK_PRESENT_MODE_MAILBOX_KHR)  // Mailbox (G-Sync/Freesync compatible).
+            .add_fallback_present_mode(VK_PRESENT_MODE_FIFO_KHR);  // FIFO (V-Sync).
+    }
     vkb::Swapchain swapchain{
         swapchain_builder
             .use_default_format_selection()
-            .set_desired_present_mode(VK_PRESENT_MODE_MAILBOX_KHR)  // Mailbox (G-Sync/Freesync compatible).
-            .add_fallback_present_mode(VK_PRESENT_MODE_FIFO_KHR)  // FIFO (V-Sync).
             .set_desired_extent(window_width, window_height)
             // @TODO: TRANSFER_DST image usage added below. Try removing once renderer is finished
             // (assuming you're not gonna have some kind of image transfer as the last step into the swapchain image).
@@ -982,6 +1363,9 @@ bool build_vulkan_renderer__hdr_image(VmaAllocator allocator,
                    &out_hdr_image.image,
                    &out_hdr_image.allocation,
                    nullptr);
+    vk_memory::track_allocation(allocator,
+                                out_hdr_image.allocation,
+                                vk_memory::Memory_category::RENDER_TARGET);
 
     VkImageViewCreateInfo image_view_info{
         vk_util::image_view_create_info(out_hdr_image.image_format,
@@ -1005,6 +1389,163 @@ bool build_vulkan_renderer__hdr_image(VmaAllocator allocator,
     return true;
 }
 
+bool build_vulkan_renderer__main_depth_image(VmaAllocator allocator,
+                                             VkDevice device,
+                                             int32_t window_width,
+                                             int32_t window_height,
+                                             vk_image::Allocated_image& out_depth_image,
+                                             VkExtent2D& out_depth_image_extent)
+{
+    // Create main view depth image.
+    VkExtent3D extent{
+        static_cast<uint32_t>(window_width),
+        static_cast<uint32_t>(window_height),
+        1
+    };
+
+    out_depth_image.image_format = VK_FORMAT_D32_SFLOAT;
+    out_depth_image.image_extent = extent;
+
+    VkImageCreateInfo image_info{
+        vk_util::image_create_info(out_depth_image.image_format,
+                                   VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                       VK_IMAGE_USAGE_SAMPLED_BIT |
+                                       VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                   extent)
+    };
+
+    VmaAllocationCreateInfo image_alloc_info{
+        .usage = VMA_MEMORY_USAGE_GPU_ONLY,
+        .requiredFlags = VkMemoryPropertyFlags{ VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT },
+    };
+    vmaCreateImage(allocator,
+                   &image_info,
+                   &image_alloc_info,
+                   &out_depth_image.image,
+                   &out_depth_image.allocation,
+                   nullptr);
+    vk_memory::track_allocation(allocator,
+                                out_depth_image.allocation,
+                                vk_memory::Memory_category::RENDER_TARGET);
+
+    VkImageViewCreateInfo image_view_info{
+        vk_util::image_view_create_info(out_depth_image.image_format,
+                                        out_depth_image.image,
+                                        VK_IMAGE_ASPECT_DEPTH_BIT)
+    };
+
+    VkResult err{
+        vkCreateImageView(device, &image_view_info, nullptr, &out_depth_image.image_view)
+    };
+    if (err)
+    {
+        std::cerr << "ERROR: Create `main_depth_image` image view failed." << std::endl;
+        assert(false);
+    }
+
+    // Set 2D extent.
+    out_depth_image_extent.width = extent.width;
+    out_depth_image_extent.height = extent.height;
+
+    return true;
+}
+
+using Shadow_cascade_image_views = std::array<VkImageView, camera::k_num_shadow_cascades>;
+// Shadow cascade image + static cache image (D32 per cascade layer).
+constexpr uint64_t k_shadow_cascade_images_memory_bytes{
+    uint64_t(2) *
+        camera::k_shadow_cascade_resolution *
+        camera::k_shadow_cascade_resolution *
+        sizeof(float_t) *
+        camera::k_num_shadow_cascades };
+
+bool build_vulkan_renderer__shadow_cascade_image(VmaAllocator allocator,
+                                                 VkDevice device,
+                                                 vk_image::Allocated_image& out_shadow_image,
+                                                 Shadow_cascade_image_views& out_cascade_image_views,
+                                                 VkExtent2D& out_shadow_image_extent)
+{
+    // Create shadow cascade depth image (one layer per cascade).
+    VkExtent3D extent{
+        camera::k_shadow_cascade_resolution,
+        camera::k_shadow_cascade_resolution,
+        1
+    };
+
+    auto& image{ out_shadow_image };
+    image.image_format = VK_FORMAT_D32_SFLOAT;
+    image.image_extent = extent;
+
+    VkImageCreateInfo image_info{
+        vk_util::image_create_info(image.image_format,
+                                   VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                       VK_IMAGE_USAGE_SAMPLED_BIT |
+                                       VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                                       VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                   extent)
+    };
+    image_info.arrayLayers = camera::k_num_shadow_cascades;
+
+    VmaAllocationCreateInfo image_alloc_info{
+        .usage = VMA_MEMORY_USAGE_GPU_ONLY,
+        .requiredFlags = VkMemoryPropertyFlags{ VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT },
+    };
+    vmaCreateImage(allocator,
+                   &image_info,
+                   &image_alloc_info,
+                   &image.image,
+                   &image.allocation,
+                   nullptr);
+    vk_memory::track_allocation(allocator,
+                                image.allocation,
+                                vk_memory::Memory_category::RENDER_TARGET);
+
+    // Array view for sampling.
+    VkImageViewCreateInfo image_view_info{
+        vk_util::image_view_create_info(image.image_format,
+                                        image.image,
+                                        VK_IMAGE_ASPECT_DEPTH_BIT)
+    };
+    image_view_info.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    image_view_info.subresourceRange.layerCount = camera::k_num_shadow_cascades;
+
+    VkResult err{
+        vkCreateImageView(device, &image_view_info, nullptr, &image.image_view)
+    };
+    if (err)
+    {
+        std::cerr << "ERROR: Create `shadow_cascade_image` image view failed." << std::endl;
+        assert(false);
+    }
+
+    // Per cascade views for rendering.
+    for (uint32_t i = 0; i < camera::k_num_shadow_cascades; i++)
+    {
+        VkImageViewCreateInfo cascade_view_info{
+            vk_util::image_view_create_info(image.image_format,
+                                            image.image,
+                                            VK_IMAGE_ASPECT_DEPTH_BIT)
+        };
+        cascade_view_info.subresourceRange.baseArrayLayer = i;
+
+        err = vkCreateImageView(device,
+                                &cascade_view_info,
+                                nullptr,
+                                &out_cascade_image_views[i]);
+        if (err)
+        {
+            std::cerr << "ERROR: Create shadow cascade image view failed." << std::endl;
+            assert(false);
+        }
+    }
+
+    // Set 2D extent.
+    out_shadow_image_extent.width = extent.width;
+    out_shadow_image_extent.height = extent.height;
+
+    return true;
+}
+
 bool build_vulkan_renderer__retrieve_queues(vkb::Device& vkb_device,
                                             VkQueue& out_graphics_queue,
                                             uint32_t& out_graphics_queue_family_idx)
@@ -1017,8 +1558,33 @@ bool build_vulkan_renderer__retrieve_queues(vkb::Device& vkb_device,
     return true;
 }
 
+bool build_vulkan_renderer__gpu_profiler(VkPhysicalDevice physical_device,
+                                        const VkPhysicalDeviceProperties& physical_device_props,
+                                        VkDevice device,
+                                        uint32_t graphics_queue_family_idx,
+                                        bool is_pipeline_stats_query_enabled,
+                                        uint32_t num_frames_in_flight,
+                                        vk_profiler::GPU_profiler& out_profiler)
+{
+    uint32_t num_queue_families;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_queue_families, nullptr);
+    std::vector<VkQueueFamilyProperties> queue_families(num_queue_families);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device,
+                                             &num_queue_families,
+                                             queue_families.data());
+
+    return vk_profiler::init_gpu_profiler(
+        out_profiler,
+        device,
+        physical_device_props,
+        queue_families[graphics_queue_family_idx].timestampValidBits,
+        is_pipeline_stats_query_enabled,
+        num_frames_in_flight);
+}
+
 bool build_vulkan_renderer__cmd_structures(uint32_t graphics_queue_family_idx,
                                            VkDevice device,
+                                           uint32_t num_frames_in_flight,
                                            Frame_data out_frames[])
 {
     VkResult err;
@@ -1030,25 +1596,26 @@ bool build_vulkan_renderer__cmd_structures(uint32_t graphics_queue_family_idx,
         .queueFamilyIndex = graphics_queue_family_idx
     };
 
-    for (uint32_t i = 0; i < k_frame_overlap; i++)
+    for (uint32_t i = 0; i < num_frames_in_flight; i++)
+    for (size_t pass = 0; pass < k_num_render_pass_cmds; pass++)
     {
-        err = vkCreateCommandPool(device, &cmd_pool_info, nullptr, &out_frames[i].command_pool);
+        err = vkCreateCommandPool(device, &cmd_pool_info, nullptr, &out_frames[i].command_pools[pass]);
         if (err)
         {
             std::cerr << "ERROR: Vulkan command pool creation failed for frame #" << i << std::endl;
             return false;
         }
 
-        // Allocate default cmd buffer for rendering.
+        // Allocate pass cmd buffer for rendering.
         VkCommandBufferAllocateInfo cmd_alloc_info{
             .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
             .pNext = nullptr,
-            .commandPool = out_frames[i].command_pool,
+            .commandPool = out_frames[i].command_pools[pass],
             .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
             .commandBufferCount = 1,
         };
 
-        err = vkAllocateCommandBuffers(device, &cmd_alloc_info, &out_frames[i].main_command_buffer);
+        err = vkAllocateCommandBuffers(device, &cmd_alloc_info, &out_frames[i].pass_command_buffers[pass]);
         if (err)
         {
             std::cerr << "ERROR: Vulkan command pool allocation failed for frame #" << i << std::endl;
@@ -1059,7 +1626,9 @@ bool build_vulkan_renderer__cmd_structures(uint32_t graphics_queue_family_idx,
     return true;
 }
 
-bool build_vulkan_renderer__sync_structures(VkDevice device, Frame_data out_frames[])
+bool build_vulkan_renderer__sync_structures(VkDevice device,
+                                            uint32_t num_frames_in_flight,
+                                            Frame_data out_frames[])
 {
     VkResult err;
 
@@ -1077,7 +1646,7 @@ bool build_vulkan_renderer__sync_structures(VkDevice device, Frame_data out_fram
         .flags = 0,
     };
 
-    for (uint32_t i = 0; i < k_frame_overlap; i++)
+    for (uint32_t i = 0; i < num_frames_in_flight; i++)
     {
         err = vkCreateFence(device, &fence_create_info, nullptr, &out_frames[i].render_fence);
         if (err)
@@ -1111,11 +1680,18 @@ bool build_vulkan_renderer__descriptors(VkDevice device,
                                         VkDescriptorSet& out_descriptor_set)
 {
     // Init allocator pool.
+    // @NOTE: Also allocates the geometry pass sets (camera, shadow cascade
+    //   camera, virtual shadow map camera, material param sets and bounding
+    //   spheres sets for every frame in flight, the virtual shadow map's main
+    //   depth set, etc.).
     std::vector<vk_desc::Descriptor_allocator::Pool_size_ratio> sizes{
         { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0.25f },
     };
 
-    out_descriptor_alloc.init_pool(device, 10, sizes);
+    out_descriptor_alloc.init_pool(device, 48, sizes);
 
     // Build layout.
     vk_desc::Descriptor_layout_builder builder;
@@ -1147,50 +1723,144 @@ bool build_vulkan_renderer__descriptors(VkDevice device,
 
 struct GPU_geometry_culling_push_constants
 {
-    float_t         z_near;
-    float_t         z_far;
-    float_t         frustum_x_x;
-    float_t         frustum_x_z;
-    float_t         frustum_y_y;
-    float_t         frustum_y_z;
     uint32_t        culling_enabled;
     uint32_t        num_instances;
+    uint32_t        num_visibility_words_per_view;
+    uint32_t        pad0;
     VkDeviceAddress instance_buffer_address;
-    VkDeviceAddress visible_result_buffer_address;
+    VkDeviceAddress culling_view_buffer_address;
+    VkDeviceAddress visibility_buffer_address;
 };
 
 struct GPU_write_draw_cmds_push_constants
 {
     uint32_t        num_primitives;
-    VkDeviceAddress visible_result_buffer_address;
+    uint32_t        num_render_groups;
+    uint32_t        num_visibility_words_per_view;
+    uint32_t        pad0;
+    VkDeviceAddress visibility_buffer_address;
     VkDeviceAddress base_indices_buffer_address;
     VkDeviceAddress count_buffer_indices_buffer_address;
     VkDeviceAddress draw_commands_input_buffer_address;
     VkDeviceAddress draw_commands_output_buffer_address;
     VkDeviceAddress draw_command_counts_buffer_address;
+    VkDeviceAddress material_param_indices_buffer_address;
+    VkDeviceAddress draw_records_output_buffer_address;
+};
+
+struct GPU_cull_and_write_draw_cmds_push_constants
+{
+    uint32_t        culling_enabled;
+    uint32_t        num_views;
+    uint32_t        num_primitives;
+    uint32_t        num_render_groups;
+    uint32_t        num_visibility_words_per_view;
+    uint32_t        pad0;
+    VkDeviceAddress instance_buffer_address;
+    VkDeviceAddress culling_view_buffer_address;
+    VkDeviceAddress visibility_buffer_address;
+    VkDeviceAddress render_group_base_indices_buffer_address;
+    VkDeviceAddress draw_commands_input_buffer_address;
+    VkDeviceAddress draw_commands_output_buffer_address;
+    VkDeviceAddress draw_command_counts_buffer_address;
+    VkDeviceAddress material_param_indices_buffer_address;
+    VkDeviceAddress draw_records_output_buffer_address;
 };
+static_assert(sizeof(GPU_cull_and_write_draw_cmds_push_constants) <= 128,
+              "Exceeds minimum guaranteed `maxPushConstantsSize`.");
 
 using Geometry_graphics_pass = Monolithic_renderer::Impl::Geometry_graphics_pass;
-bool build_vulkan_renderer__geometry_graphics_pass(VkDevice device,
-                                                   VmaAllocator allocator,
-                                                   vk_desc::Descriptor_allocator& descriptor_alloc,
-                                                   Frame_data out_frames[],
-                                                   Geometry_graphics_pass& out_geom_graphics_pass)
+
+// @NOTE: Also rewritten after defragmentation moves any of the frame's buffers.
+void write_per_frame_buffers_to_descriptor_sets(VkDevice device,
+                                                const Frame_data& frame,
+                                                VkDeviceSize shadow_camera_stride,
+                                                const Geometry_graphics_pass::Per_frame_data& frame_sets)
 {
-    // Per-frame datas.
-    for (uint32_t i = 0; i < k_frame_overlap; i++)
-    {
-        auto& camera_buffer{ out_frames[i].camera_buffer };
-        auto& frame{ out_geom_graphics_pass.per_frame_datas[i] };
-        const auto& frame_buffers{
-            out_frames[i].geo_per_frame_buffer };
+    VkDescriptorBufferInfo camera_buffer_info{
+        .buffer = frame.camera_buffer.buffer,
+        .offset = 0,
+        .range = sizeof(camera::GPU_camera),
+    };
+    VkWriteDescriptorSet camera_buffer_write{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = nullptr,
+        .dstSet = frame_sets.camera_data.descriptor_set,
+        .dstBinding = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        .pBufferInfo = &camera_buffer_info,
+    };
+    vkUpdateDescriptorSets(device, 1, &camera_buffer_write, 0, nullptr);
+
+    for (uint32_t cascade_idx = 0; cascade_idx < camera::k_num_shadow_cascades; cascade_idx++)
+    {
+        VkDescriptorBufferInfo shadow_camera_buffer_info{
+            .buffer = frame.shadow_camera_buffer.buffer,
+            .offset = shadow_camera_stride * cascade_idx,
+            .range = sizeof(camera::GPU_camera),
+        };
+        VkWriteDescriptorSet shadow_camera_buffer_write{
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext = nullptr,
+            .dstSet = frame_sets.shadow_cascade_camera_descriptor_sets[cascade_idx],
+            .dstBinding = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .pBufferInfo = &shadow_camera_buffer_info,
+        };
+        vkUpdateDescriptorSets(device, 1, &shadow_camera_buffer_write, 0, nullptr);
+    }
+
+    VkDescriptorBufferInfo vsm_params_buffer_info{
+        .buffer = frame.vsm_params_buffer.buffer,
+        .offset = 0,
+        .range = sizeof(gpu_geo_data::GPU_vsm_params),
+    };
+    VkWriteDescriptorSet vsm_params_buffer_write{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = nullptr,
+        .dstSet = frame_sets.virtual_shadow_camera_data.descriptor_set,
+        .dstBinding = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        .pBufferInfo = &vsm_params_buffer_info,
+    };
+    vkUpdateDescriptorSets(device, 1, &vsm_params_buffer_write, 0, nullptr);
+}
+
+bool build_vulkan_renderer__geometry_graphics_pass(VkPhysicalDevice physical_device,
+                                                   VkDevice device,
+                                                   VmaAllocator allocator,
+                                                   vk_desc::Descriptor_allocator& descriptor_alloc,
+                                                   uint32_t num_frames_in_flight,
+                                                   Frame_data out_frames[],
+                                                   Geometry_graphics_pass& out_geom_graphics_pass)
+{
+    // Shadow cascade cameras share one buffer per frame, so pad them out to
+    // where a descriptor is allowed to point.
+    VkPhysicalDeviceProperties physical_device_props;
+    vkGetPhysicalDeviceProperties(physical_device, &physical_device_props);
+    VkDeviceSize ubo_alignment{
+        physical_device_props.limits.minUniformBufferOffsetAlignment };
+    out_geom_graphics_pass.shadow_camera_stride =
+        (sizeof(camera::GPU_camera) + ubo_alignment - 1) / ubo_alignment * ubo_alignment;
+
+    // Per-frame datas.
+    for (uint32_t i = 0; i < num_frames_in_flight; i++)
+    {
+        auto& camera_buffer{ out_frames[i].camera_buffer };
+        auto& frame{ out_geom_graphics_pass.per_frame_datas[i] };
+        const auto& frame_buffers{
+            out_frames[i].geo_per_frame_buffer };
 
         // Camera descriptor set.
         camera_buffer =
             vk_buffer::create_buffer(allocator,
                                      sizeof(camera::GPU_camera),
                                      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                     VMA_MEMORY_USAGE_CPU_TO_GPU);
+                                     VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                     vk_memory::Memory_category::OTHER);
         
         // Build layout.
         vk_desc::Descriptor_layout_builder builder;
@@ -1202,61 +1872,110 @@ bool build_vulkan_renderer__geometry_graphics_pass(VkDevice device,
         frame.camera_data.descriptor_set =
             descriptor_alloc.allocate(device, frame.camera_data.descriptor_layout);
 
-        VkDescriptorBufferInfo camera_buffer_info{
-            .buffer = camera_buffer.buffer,
-            .offset = 0,
-            .range = sizeof(camera::GPU_camera),
-        };
-        VkWriteDescriptorSet camera_buffer_write{
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .pNext = nullptr,
-            .dstSet = frame.camera_data.descriptor_set,
-            .dstBinding = 0,
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .pBufferInfo = &camera_buffer_info,
-        };
-        vkUpdateDescriptorSets(device, 1, &camera_buffer_write, 0, nullptr);
-    }
-
-    // Material param sets data.
-    auto& material_param_sets_data{ out_geom_graphics_pass.material_param_sets_data };
-
-    // Build layout.
-    vk_desc::Descriptor_layout_builder builder;
-    builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-    builder.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-    material_param_sets_data.descriptor_layout =
-        builder.build(device, VK_SHADER_STAGE_VERTEX_BIT);
+        // Shadow cascade camera descriptor sets.
+        auto& shadow_camera_buffer{ out_frames[i].shadow_camera_buffer };
+        shadow_camera_buffer =
+            vk_buffer::create_buffer(allocator,
+                                     out_geom_graphics_pass.shadow_camera_stride *
+                                         camera::k_num_shadow_cascades,
+                                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                     VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                     vk_memory::Memory_category::OTHER);
 
-    // Build and allocate descriptor set.
-    material_param_sets_data.descriptor_set =
-        descriptor_alloc.allocate(device, material_param_sets_data.descriptor_layout);
+        // Build layout.
+        builder.clear();
+        builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+        frame.shadow_camera_descriptor_layout =
+            builder.build(device, VK_SHADER_STAGE_VERTEX_BIT);
 
-    // @NOTE: Defer write buffers to descriptor set until once they are created.
-    //        `write_material_param_sets_to_descriptor_sets()`
+        // Build and allocate descriptor sets.
+        for (auto& descriptor_set : frame.shadow_cascade_camera_descriptor_sets)
+            descriptor_set =
+                descriptor_alloc.allocate(device, frame.shadow_camera_descriptor_layout);
 
-    // Bounding spheres data.
-    auto& bounding_spheres_data{ out_geom_graphics_pass.bounding_spheres_data };
+        // Culling views (main view and shadow cascades).
+        out_frames[i].culling_view_buffer =
+            vk_buffer::create_buffer(allocator,
+                                     sizeof(gpu_geo_data::GPU_culling_view) *
+                                         gpu_geo_data::k_num_culling_views,
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                         VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                     VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                     vk_memory::Memory_category::OTHER);
+        VkBufferDeviceAddressInfo device_address_info{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+            .buffer = out_frames[i].culling_view_buffer.buffer,
+        };
+        out_frames[i].culling_view_buffer_address =
+            vkGetBufferDeviceAddress(device, &device_address_info);
+
+        // Virtual shadow map params/camera descriptor set.
+        // @NOTE: The fragment shader reads the page table and physical pool
+        //   addresses out of it too.
+        auto& vsm_params_buffer{ out_frames[i].vsm_params_buffer };
+        vsm_params_buffer =
+            vk_buffer::create_buffer(allocator,
+                                     sizeof(gpu_geo_data::GPU_vsm_params),
+                                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                                         VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                     VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                     vk_memory::Memory_category::OTHER);
+        device_address_info.buffer = vsm_params_buffer.buffer;
+        out_frames[i].vsm_params_buffer_address =
+            vkGetBufferDeviceAddress(device, &device_address_info);
+
+        // Virtual shadow map instance key table.
+        out_frames[i].vsm_instance_key_buffer =
+            vk_buffer::create_buffer(allocator,
+                                     sizeof(uint32_t) * geo_instance::k_max_instances,
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                         VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                     VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                     vk_memory::Memory_category::OTHER);
+        device_address_info.buffer = out_frames[i].vsm_instance_key_buffer.buffer;
+        out_frames[i].vsm_instance_key_buffer_address =
+            vkGetBufferDeviceAddress(device, &device_address_info);
 
-    // Build layout.
-    builder.clear();
-    builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-    bounding_spheres_data.descriptor_layout =
-        builder.build(device, VK_SHADER_STAGE_COMPUTE_BIT);
+        // Build layout.
+        builder.clear();
+        builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+        frame.virtual_shadow_camera_data.descriptor_layout =
+            builder.build(device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
 
-    // Build and allocate descriptor set.
-    bounding_spheres_data.descriptor_set =
-        descriptor_alloc.allocate(device, bounding_spheres_data.descriptor_layout);
+        // Build and allocate descriptor set.
+        frame.virtual_shadow_camera_data.descriptor_set =
+            descriptor_alloc.allocate(device, frame.virtual_shadow_camera_data.descriptor_layout);
 
-    // @NOTE: Defer write buffers to descriptor set until once they are created.
-    //        `write_bounding_spheres_to_descriptor_sets()`
+        // Virtual shadow map stats readback.
+        out_frames[i].vsm_stats_readback_buffer =
+            vk_buffer::create_buffer(allocator,
+                                     sizeof(gpu_geo_data::GPU_vsm_stats),
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                     VMA_MEMORY_USAGE_GPU_TO_CPU,
+                                     vk_memory::Memory_category::OTHER);
+
+        write_per_frame_buffers_to_descriptor_sets(device,
+                                                   out_frames[i],
+                                                   out_geom_graphics_pass.shadow_camera_stride,
+                                                   frame);
+    }
 
-    // Material param definition desc layout.
-    builder.clear();
+    // Bounding spheres data layout.
+    vk_desc::Descriptor_layout_builder builder;
     builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-    out_geom_graphics_pass.material_param_definition_descriptor_layout =
-        builder.build(device, VK_SHADER_STAGE_FRAGMENT_BIT);
+    VkDescriptorSetLayout bounding_spheres_descriptor_layout{
+        builder.build(device, VK_SHADER_STAGE_COMPUTE_BIT) };
+
+    // Allocate descriptor sets for every frame in flight.
+    // @NOTE: Written once the buffers are created, by the buffer registry
+    //   (see `build_vulkan_renderer__buffer_registry()`).
+    for (uint32_t i = 0; i < num_frames_in_flight; i++)
+    {
+        auto& frame{ out_geom_graphics_pass.per_frame_datas[i] };
+        frame.bounding_spheres_data.descriptor_layout = bounding_spheres_descriptor_layout;
+        frame.bounding_spheres_data.descriptor_set =
+            descriptor_alloc.allocate(device, bounding_spheres_descriptor_layout);
+    }
 
     {
         // Build culling pipeline layout.
@@ -1268,7 +1987,7 @@ bool build_vulkan_renderer__geometry_graphics_pass(VkDevice device,
 
         VkDescriptorSetLayout desc_layouts[]{
             out_geom_graphics_pass.per_frame_datas.front().camera_data.descriptor_layout,
-            out_geom_graphics_pass.bounding_spheres_data.descriptor_layout,
+            bounding_spheres_descriptor_layout,
         };
 
         VkPipelineLayoutCreateInfo layout_info{
@@ -1381,6 +2100,351 @@ bool build_vulkan_renderer__geometry_graphics_pass(VkDevice device,
         vkDestroyShaderModule(device, compute_draw_shader, nullptr);
     }
 
+    // Check fused culling support.
+    // @NOTE: Needs ballot and arithmetic subgroup ops in compute.
+    VkPhysicalDeviceSubgroupProperties subgroup_props{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES,
+    };
+    VkPhysicalDeviceProperties2 device_props2{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &subgroup_props,
+    };
+    vkGetPhysicalDeviceProperties2(physical_device, &device_props2);
+
+    constexpr VkSubgroupFeatureFlags k_required_subgroup_ops{
+        VK_SUBGROUP_FEATURE_BASIC_BIT |
+        VK_SUBGROUP_FEATURE_VOTE_BIT |
+        VK_SUBGROUP_FEATURE_BALLOT_BIT |
+        VK_SUBGROUP_FEATURE_ARITHMETIC_BIT };
+    out_geom_graphics_pass.is_fused_culling_supported =
+        ((subgroup_props.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+         (subgroup_props.supportedOperations & k_required_subgroup_ops) ==
+            k_required_subgroup_ops);
+    if (!out_geom_graphics_pass.is_fused_culling_supported)
+    {
+        std::cerr << "WARNING: Subgroup ops for fused culling not supported. "
+                     "Using separate culling and write draw cmds passes." << std::endl;
+    }
+    else
+    {
+        // Build cull and write draw cmds pipeline layout.
+        VkPushConstantRange pc_range{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(GPU_cull_and_write_draw_cmds_push_constants),
+        };
+
+        VkDescriptorSetLayout desc_layouts[]{
+            out_geom_graphics_pass.per_frame_datas.front().camera_data.descriptor_layout,
+            bounding_spheres_descriptor_layout,
+        };
+
+        VkPipelineLayoutCreateInfo layout_info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext = nullptr,
+            .setLayoutCount = 2,
+            .pSetLayouts = desc_layouts,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pc_range,
+        };
+        VkResult err{
+            vkCreatePipelineLayout(device,
+                                   &layout_info,
+                                   nullptr,
+                                   &out_geom_graphics_pass.cull_and_write_draw_cmds_pipeline_layout) };
+        if (err)
+        {
+            std::cerr << "ERROR: Pipeline layout creation failed." << std::endl;
+            assert(false);
+        }
+
+        // Build cull and write draw cmds pipeline.
+        VkShaderModule compute_draw_shader;
+        if (!vk_pipeline::load_shader_module(("assets/shaders/geom_cull_and_write_draw_cmds.comp.spv"),
+                                             device,
+                                             compute_draw_shader))
+        {
+            std::cerr << "ERROR: Shader module loading failed." << std::endl;
+            assert(false);
+        }
+
+        VkComputePipelineCreateInfo pipeline_info{
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .pNext = nullptr,
+            .stage = vk_util::pipeline_shader_stage_info(VK_SHADER_STAGE_COMPUTE_BIT,
+                                                         compute_draw_shader),
+            .layout = out_geom_graphics_pass.cull_and_write_draw_cmds_pipeline_layout,
+        };
+
+        err = vkCreateComputePipelines(device,
+                                       VK_NULL_HANDLE,
+                                       1, &pipeline_info,
+                                       nullptr,
+                                       &out_geom_graphics_pass.cull_and_write_draw_cmds_pipeline);
+        if (err)
+        {
+            std::cerr << "ERROR: Create compute pipeline failed." << std::endl;
+        }
+
+        // Clean up shader modules.
+        vkDestroyShaderModule(device, compute_draw_shader, nullptr);
+    }
+
+    return true;
+}
+
+bool build_vulkan_renderer__buffer_registry(uint32_t num_frames_in_flight,
+                                            const Geometry_graphics_pass& geom_graphics_pass,
+                                            vk_buffer_registry::Buffer_registry& out_registry,
+                                            vk_buffer::GPU_geo_resource_buffer& out_geo_resources)
+{
+    vk_buffer_registry::init_buffer_registry(out_registry, num_frames_in_flight);
+
+    // Geo resource buffers.
+    // @NOTE: Created (and recreated) by the upload funcs, which get the
+    //   subscribed sets rewritten.
+    out_geo_resources.bounding_sphere_buffer = vk_buffer_registry::register_buffer(out_registry);
+
+    for (uint32_t i = 0; i < num_frames_in_flight; i++)
+    {
+        auto& frame{ geom_graphics_pass.per_frame_datas[i] };
+        vk_buffer_registry::subscribe_descriptor_set(out_registry,
+                                                     out_geo_resources.bounding_sphere_buffer,
+                                                     i,
+                                                     frame.bounding_spheres_data.descriptor_set,
+                                                     0,
+                                                     VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    }
+
+    return true;
+}
+
+// Matches `k_phase_*` in `geom_vsm_update_pages.comp`.
+enum class GPU_vsm_update_pages_phase : uint32_t
+{
+    INIT = 0,
+    MARK,
+    INVALIDATE,
+    RELEASE,
+    ALLOCATE,
+    FINALIZE,
+    CLEAR,
+};
+
+struct GPU_vsm_update_pages_push_constants
+{
+    uint32_t        phase;
+    uint32_t        num_instance_keys;
+    uint32_t        num_render_groups;
+    uint32_t        draw_command_counts_base_idx;
+    VkDeviceAddress vsm_params_buffer_address;
+    VkDeviceAddress page_request_buffer_address;
+    VkDeviceAddress free_page_stack_buffer_address;
+    VkDeviceAddress render_page_list_buffer_address;
+    VkDeviceAddress stats_buffer_address;
+    VkDeviceAddress instance_buffer_address;
+    VkDeviceAddress instance_key_buffer_address;
+    VkDeviceAddress prev_bounding_spheres_buffer_address;
+    VkDeviceAddress draw_command_counts_buffer_address;
+};
+static_assert(sizeof(GPU_vsm_update_pages_push_constants) <= 128,
+              "Exceeds minimum guaranteed `maxPushConstantsSize`.");
+
+using Virtual_shadow_map = Monolithic_renderer::Impl::Virtual_shadow_map;
+bool build_vulkan_renderer__virtual_shadow_map(const vk_util::Immediate_submit_support& support,
+                                               VkDevice device,
+                                               VkQueue queue,
+                                               VmaAllocator allocator,
+                                               vk_desc::Descriptor_allocator& descriptor_alloc,
+                                               const vk_image::Allocated_image& main_depth_image,
+                                               VkDescriptorSetLayout bounding_spheres_descriptor_layout,
+                                               Virtual_shadow_map& out_vsm)
+{
+    // Page management buffers and physical page pool.
+    // @NOTE: The render page list is also the clear pass's indirect dispatch.
+    auto create_vsm_buffer = [&](size_t size, VkDeviceAddress& out_address) {
+        vk_buffer::Allocated_buffer buffer{
+            vk_buffer::create_buffer(allocator,
+                                     size,
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                         VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+                                         VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                         VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                         VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                     VMA_MEMORY_USAGE_GPU_ONLY,
+                                     vk_memory::Memory_category::RENDER_TARGET) };
+        VkBufferDeviceAddressInfo device_address_info{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+            .buffer = buffer.buffer,
+        };
+        out_address = vkGetBufferDeviceAddress(device, &device_address_info);
+        out_vsm.memory_bytes += size;
+        return buffer;
+    };
+
+    out_vsm.memory_bytes = 0;
+    out_vsm.page_table_buffer =
+        create_vsm_buffer(sizeof(gpu_geo_data::GPU_vsm_page_table_entry) *
+                              camera::k_vsm_num_virtual_pages,
+                          out_vsm.page_table_buffer_address);
+    out_vsm.page_request_buffer =
+        create_vsm_buffer(sizeof(uint32_t) * camera::k_vsm_num_virtual_pages,
+                          out_vsm.page_request_buffer_address);
+    out_vsm.free_page_stack_buffer =
+        create_vsm_buffer(sizeof(gpu_geo_data::GPU_vsm_free_page_stack_header) +
+                              sizeof(uint32_t) * camera::k_vsm_num_physical_pages,
+                          out_vsm.free_page_stack_buffer_address);
+    out_vsm.render_page_list_buffer =
+        create_vsm_buffer(sizeof(gpu_geo_data::GPU_vsm_render_page_list_header) +
+                              sizeof(uint32_t) * camera::k_vsm_num_physical_pages,
+                          out_vsm.render_page_list_buffer_address);
+    out_vsm.physical_pool_buffer =
+        create_vsm_buffer(sizeof(uint32_t) *
+                              camera::k_vsm_page_size *
+                              camera::k_vsm_page_size *
+                              camera::k_vsm_num_physical_pages,
+                          out_vsm.physical_pool_buffer_address);
+    out_vsm.stats_buffer =
+        create_vsm_buffer(sizeof(gpu_geo_data::GPU_vsm_stats),
+                          out_vsm.stats_buffer_address);
+    out_vsm.prev_bounding_spheres_buffer =
+        create_vsm_buffer(sizeof(gpu_geo_data::GPU_bounding_sphere) *
+                              geo_instance::k_max_instances,
+                          out_vsm.prev_bounding_spheres_buffer_address);
+
+    // Main depth descriptor set (for marking requested pages).
+    VkSamplerCreateInfo sampler_info{
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+    };
+    VkResult err{
+        vkCreateSampler(device, &sampler_info, nullptr, &out_vsm.main_depth_sampler) };
+    if (err)
+    {
+        std::cerr << "ERROR: Create virtual shadow map main depth sampler failed." << std::endl;
+        assert(false);
+    }
+
+    // Build layout.
+    vk_desc::Descriptor_layout_builder builder;
+    builder.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    out_vsm.main_depth_data.descriptor_layout =
+        builder.build(device, VK_SHADER_STAGE_COMPUTE_BIT);
+
+    // Build and allocate descriptor set.
+    out_vsm.main_depth_data.descriptor_set =
+        descriptor_alloc.allocate(device, out_vsm.main_depth_data.descriptor_layout);
+
+    VkDescriptorImageInfo main_depth_image_info{
+        .sampler = out_vsm.main_depth_sampler,
+        .imageView = main_depth_image.image_view,
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
+    };
+    VkWriteDescriptorSet main_depth_image_write{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = nullptr,
+        .dstSet = out_vsm.main_depth_data.descriptor_set,
+        .dstBinding = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &main_depth_image_info,
+    };
+    vkUpdateDescriptorSets(device, 1, &main_depth_image_write, 0, nullptr);
+
+    // Build update pages pipeline layout.
+    VkPushConstantRange pc_range{
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(GPU_vsm_update_pages_push_constants),
+    };
+
+    VkDescriptorSetLayout desc_layouts[]{
+        out_vsm.main_depth_data.descriptor_layout,
+        bounding_spheres_descriptor_layout,
+    };
+
+    VkPipelineLayoutCreateInfo layout_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = nullptr,
+        .setLayoutCount = 2,
+        .pSetLayouts = desc_layouts,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pc_range,
+    };
+    err = vkCreatePipelineLayout(device,
+                                 &layout_info,
+                                 nullptr,
+                                 &out_vsm.update_pages_pipeline_layout);
+    if (err)
+    {
+        std::cerr << "ERROR: Pipeline layout creation failed." << std::endl;
+        assert(false);
+    }
+
+    // Build update pages pipeline.
+    VkShaderModule compute_shader;
+    if (!vk_pipeline::load_shader_module(("assets/shaders/geom_vsm_update_pages.comp.spv"),
+                                         device,
+                                         compute_shader))
+    {
+        std::cerr << "ERROR: Shader module loading failed." << std::endl;
+        assert(false);
+    }
+
+    VkComputePipelineCreateInfo pipeline_info{
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = nullptr,
+        .stage = vk_util::pipeline_shader_stage_info(VK_SHADER_STAGE_COMPUTE_BIT,
+                                                     compute_shader),
+        .layout = out_vsm.update_pages_pipeline_layout,
+    };
+
+    err = vkCreateComputePipelines(device,
+                                   VK_NULL_HANDLE,
+                                   1, &pipeline_info,
+                                   nullptr,
+                                   &out_vsm.update_pages_pipeline);
+    if (err)
+    {
+        std::cerr << "ERROR: Create compute pipeline failed." << std::endl;
+    }
+
+    // Clean up shader modules.
+    vkDestroyShaderModule(device, compute_shader, nullptr);
+
+    // Start main depth out cleared and readable, so the first frame's page
+    // marking finds nothing.
+    vk_util::immediate_submit(support, device, queue, [&](VkCommandBuffer cmd) {
+        VkClearDepthStencilValue depth_clear{ .depth = 1.0f };
+        VkImageSubresourceRange depth_range{
+            .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
+            .baseMipLevel = 0,
+            .levelCount = VK_REMAINING_MIP_LEVELS,
+            .baseArrayLayer = 0,
+            .layerCount = VK_REMAINING_ARRAY_LAYERS,
+        };
+        vk_util::transition_image(cmd,
+                                  main_depth_image.image,
+                                  VK_IMAGE_LAYOUT_UNDEFINED,
+                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                  VK_IMAGE_ASPECT_DEPTH_BIT);
+        vkCmdClearDepthStencilImage(cmd,
+                                    main_depth_image.image,
+                                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                    &depth_clear,
+                                    1, &depth_range);
+        vk_util::transition_image(cmd,
+                                  main_depth_image.image,
+                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                  VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
+                                  VK_IMAGE_ASPECT_DEPTH_BIT);
+    });
+
     return true;
 }
 
@@ -1512,16 +2576,21 @@ bool Monolithic_renderer::Impl::build_vulkan_renderer()
                                             m_v_physical_device,
                                             m_v_physical_device_properties,
                                             m_v_device,
-                                            vkb_device);
+                                            vkb_device,
+                                            m_v_is_memory_budget_ext_enabled,
+                                            m_v_is_pipeline_stats_query_enabled);
     result &= build_vulkan_renderer__allocator(m_v_instance,
                                                m_v_physical_device,
                                                m_v_device,
-                                               m_v_vma_allocator);
+                                               m_v_is_memory_budget_ext_enabled,
+                                               m_v_vma_allocator,
+                                               m_memory_budget);
     result &= build_vulkan_renderer__swapchain(m_v_surface,
                                                m_v_physical_device,
                                                m_v_device,
                                                m_window_width,
                                                m_window_height,
+                                               (m_frame_pacing_mode == Frame_pacing_mode::LOW_LATENCY),
                                                m_v_swapchain.swapchain,
                                                m_v_swapchain.images,
                                                m_v_swapchain.image_views,
@@ -1533,23 +2602,49 @@ bool Monolithic_renderer::Impl::build_vulkan_renderer()
                                                m_window_height,
                                                m_v_HDR_draw_image.image,
                                                m_v_HDR_draw_image.extent);
+    result &= build_vulkan_renderer__main_depth_image(m_v_vma_allocator,
+                                                      m_v_device,
+                                                      m_window_width,
+                                                      m_window_height,
+                                                      m_v_main_depth_image.image,
+                                                      m_v_main_depth_image.extent);
+    result &= build_vulkan_renderer__shadow_cascade_image(m_v_vma_allocator,
+                                                          m_v_device,
+                                                          m_v_shadow_cascade_image.image,
+                                                          m_v_shadow_cascade_image.cascade_image_views,
+                                                          m_v_shadow_cascade_image.extent);
+    result &= build_vulkan_renderer__shadow_cascade_image(m_v_vma_allocator,
+                                                          m_v_device,
+                                                          m_v_shadow_cascade_image.static_cache_image,
+                                                          m_v_shadow_cascade_image.static_cache_image_views,
+                                                          m_v_shadow_cascade_image.extent);
     result &= build_vulkan_renderer__retrieve_queues(vkb_device,
                                                      m_v_graphics_queue,
                                                      m_v_graphics_queue_family_idx);
+    result &= build_vulkan_renderer__gpu_profiler(m_v_physical_device,
+                                                  m_v_physical_device_properties,
+                                                  m_v_device,
+                                                  m_v_graphics_queue_family_idx,
+                                                  m_v_is_pipeline_stats_query_enabled,
+                                                  m_num_frames_in_flight,
+                                                  m_gpu_profiler);
     vk_util::init_immediate_submit_support(m_immediate_submit_support,
                                            m_v_device,
-                                           m_v_graphics_queue_family_idx);
+                                           m_v_graphics_queue_family_idx,
+                                           &m_v_graphics_queue_mutex);
     result &= build_vulkan_renderer__cmd_structures(m_v_graphics_queue_family_idx,
                                                     m_v_device,
+                                                    m_num_frames_in_flight,
                                                     m_frames);
     result &= build_vulkan_renderer__sync_structures(m_v_device,
+                                                     m_num_frames_in_flight,
                                                      m_frames);
     result &= build_vulkan_renderer__descriptors(m_v_device,
                                                  m_v_HDR_draw_image.image.image_view,
                                                  m_v_descriptor_alloc,
                                                  m_v_sample_pass.descriptor_layout,
                                                  m_v_sample_pass.descriptor_set);
-    for (size_t i = 0; i < k_frame_overlap; i++)
+    for (size_t i = 0; i < m_num_frames_in_flight; i++)
     {
         // @TODO: add into a process func.
         //        For `__geometry_graphics_pass()`
@@ -1557,11 +2652,39 @@ bool Monolithic_renderer::Impl::build_vulkan_renderer()
                                                           m_v_vma_allocator,
                                                           m_frames[i].geo_per_frame_buffer);
     }
-    result &= build_vulkan_renderer__geometry_graphics_pass(m_v_device,
+    vk_buffer::initialize_visibility_history(m_immediate_submit_support,
+                                             m_v_device,
+                                             m_v_graphics_queue,
+                                             m_v_vma_allocator,
+                                             m_num_frames_in_flight,
+                                             m_visibility_history);
+    for (uint32_t i = 0; i < m_num_frames_in_flight; i++)
+    {
+        vk_buffer::assign_visibility_history_slots(
+            m_visibility_history,
+            i,
+            (i + m_num_frames_in_flight - 1) % m_num_frames_in_flight,
+            m_frames[i].geo_per_frame_buffer);
+    }
+    result &= build_vulkan_renderer__geometry_graphics_pass(m_v_physical_device,
+                                                            m_v_device,
                                                             m_v_vma_allocator,
                                                             m_v_descriptor_alloc,
+                                                            m_num_frames_in_flight,
                                                             m_frames,
                                                             m_v_geometry_graphics_pass);
+    result &= build_vulkan_renderer__buffer_registry(m_num_frames_in_flight,
+                                                     m_v_geometry_graphics_pass,
+                                                     m_buffer_registry,
+                                                     m_v_geo_passes_resource_buffer);
+    result &= build_vulkan_renderer__virtual_shadow_map(m_immediate_submit_support,
+                                                        m_v_device,
+                                                        m_v_graphics_queue,
+                                                        m_v_vma_allocator,
+                                                        m_v_descriptor_alloc,
+                                                        m_v_main_depth_image.image,
+                                                        m_v_geometry_graphics_pass.per_frame_datas.front().bounding_spheres_data.descriptor_layout,
+                                                        m_v_virtual_shadow_map);
     result &= build_vulkan_renderer__pipelines(m_v_device,
                                                m_v_sample_pass.descriptor_layout,
                                                m_v_sample_pass.pipeline_layout,
@@ -1615,22 +2738,85 @@ bool teardown_vulkan_renderer__hdr_image(VmaAllocator allocator,
                                          const vk_image::Allocated_image& hdr_image)
 {
     vkDestroyImageView(device, hdr_image.image_view, nullptr);
+    vk_memory::untrack_allocation(allocator, hdr_image.allocation);
     vmaDestroyImage(allocator, hdr_image.image, hdr_image.allocation);
     return true;
 }
 
-bool teardown_vulkan_renderer__cmd_structures(VkDevice device, Frame_data frames[])
+bool teardown_vulkan_renderer__main_depth_image(VmaAllocator allocator,
+                                                VkDevice device,
+                                                const vk_image::Allocated_image& depth_image)
 {
-    for (uint32_t i = 0; i < k_frame_overlap; i++)
+    vkDestroyImageView(device, depth_image.image_view, nullptr);
+
+    // @NOTE: Untrack before destroying so the render target category goes
+    //   back down.
+    vk_memory::untrack_allocation(allocator, depth_image.allocation);
+    vmaDestroyImage(allocator, depth_image.image, depth_image.allocation);
+    return true;
+}
+
+bool teardown_vulkan_renderer__shadow_cascade_image(VmaAllocator allocator,
+                                                    VkDevice device,
+                                                    const vk_image::Allocated_image& shadow_image,
+                                                    const Shadow_cascade_image_views& cascade_image_views)
+{
+    for (auto cascade_image_view : cascade_image_views)
+        vkDestroyImageView(device, cascade_image_view, nullptr);
+    vkDestroyImageView(device, shadow_image.image_view, nullptr);
+    vk_memory::untrack_allocation(allocator, shadow_image.allocation);
+    vmaDestroyImage(allocator, shadow_image.image, shadow_image.allocation);
+    return true;
+}
+
+bool teardown_vulkan_renderer__virtual_shadow_map(VkDevice device,
+                                                  VmaAllocator allocator,
+                                                  const Virtual_shadow_map& vsm,
+                                                  uint32_t num_frames_in_flight,
+                                                  const Frame_data frames[])
+{
+    for (uint32_t i = 0; i < num_frames_in_flight; i++)
+    for (auto& buffer : { frames[i].vsm_params_buffer,
+                          frames[i].vsm_instance_key_buffer,
+                          frames[i].vsm_stats_readback_buffer })
+    {
+        vk_buffer::destroy_buffer(allocator, buffer);
+    }
+
+    vkDestroyPipeline(device, vsm.update_pages_pipeline, nullptr);
+    vkDestroyPipelineLayout(device, vsm.update_pages_pipeline_layout, nullptr);
+    vkDestroyDescriptorSetLayout(device, vsm.main_depth_data.descriptor_layout, nullptr);
+    vkDestroySampler(device, vsm.main_depth_sampler, nullptr);
+    for (auto& buffer : { vsm.page_table_buffer,
+                          vsm.page_request_buffer,
+                          vsm.free_page_stack_buffer,
+                          vsm.render_page_list_buffer,
+                          vsm.physical_pool_buffer,
+                          vsm.stats_buffer,
+                          vsm.prev_bounding_spheres_buffer })
+    {
+        vk_buffer::destroy_buffer(allocator, buffer);
+    }
+    return true;
+}
+
+bool teardown_vulkan_renderer__cmd_structures(VkDevice device,
+                                              uint32_t num_frames_in_flight,
+                                              Frame_data frames[])
+{
+    for (uint32_t i = 0; i < num_frames_in_flight; i++)
+    for (size_t pass = 0; pass < k_num_render_pass_cmds; pass++)
     {
-        vkDestroyCommandPool(device, frames[i].command_pool, nullptr);
+        vkDestroyCommandPool(device, frames[i].command_pools[pass], nullptr);
     }
     return true;
 }
 
-bool teardown_vulkan_renderer__sync_structures(VkDevice device, Frame_data frames[])
+bool teardown_vulkan_renderer__sync_structures(VkDevice device,
+                                               uint32_t num_frames_in_flight,
+                                               Frame_data frames[])
 {
-    for (uint32_t i = 0; i < k_frame_overlap; i++)
+    for (uint32_t i = 0; i < num_frames_in_flight; i++)
     {
         vkDestroyFence(device, frames[i].render_fence, nullptr);
         vkDestroySemaphore(device, frames[i].render_semaphore, nullptr);
@@ -1666,16 +2852,42 @@ bool Monolithic_renderer::Impl::teardown_vulkan_renderer()
     result &= teardown_vulkan_renderer__pipelines(m_v_device,
                                                   m_v_sample_pass.pipeline_layout,
                                                   m_v_sample_pass.pipeline);
+    result &= teardown_vulkan_renderer__virtual_shadow_map(m_v_device,
+                                                           m_v_vma_allocator,
+                                                           m_v_virtual_shadow_map,
+                                                           m_num_frames_in_flight,
+                                                           m_frames);
     result &= teardown_vulkan_renderer__descriptors(m_v_device,
                                                     m_v_descriptor_alloc,
                                                     m_v_sample_pass.descriptor_layout);
-    result &= teardown_vulkan_renderer__sync_structures(m_v_device, m_frames);
-    result &= teardown_vulkan_renderer__cmd_structures(m_v_device, m_frames);
+    result &= teardown_vulkan_renderer__sync_structures(m_v_device,
+                                                        m_num_frames_in_flight,
+                                                        m_frames);
+    result &= teardown_vulkan_renderer__cmd_structures(m_v_device,
+                                                       m_num_frames_in_flight,
+                                                       m_frames);
+    vk_profiler::destroy_gpu_profiler(m_gpu_profiler, m_v_device);
+    m_is_gpu_memory_churn_enabled = false;
+    tick_gpu_memory_churn();
+    vk_defrag::destroy_defragmenter(m_defragmenter, m_v_vma_allocator);
+    vk_buffer_registry::destroy_buffer_registry(m_buffer_registry, m_v_vma_allocator);
+    material_bank::destroy_shared_pipeline_resources(m_v_device, m_v_vma_allocator);
     vk_util::destroy_immediate_submit_support(m_immediate_submit_support,
                                               m_v_device);
     result &= teardown_vulkan_renderer__hdr_image(m_v_vma_allocator,
                                                   m_v_device,
                                                   m_v_HDR_draw_image.image);
+    result &= teardown_vulkan_renderer__main_depth_image(m_v_vma_allocator,
+                                                         m_v_device,
+                                                         m_v_main_depth_image.image);
+    result &= teardown_vulkan_renderer__shadow_cascade_image(m_v_vma_allocator,
+                                                             m_v_device,
+                                                             m_v_shadow_cascade_image.image,
+                                                             m_v_shadow_cascade_image.cascade_image_views);
+    result &= teardown_vulkan_renderer__shadow_cascade_image(m_v_vma_allocator,
+                                                             m_v_device,
+                                                             m_v_shadow_cascade_image.static_cache_image,
+                                                             m_v_shadow_cascade_image.static_cache_image_views);
     result &= teardown_vulkan_renderer__swapchain(m_v_device,
                                                   m_v_swapchain.swapchain,
                                                   m_v_swapchain.image_views);
@@ -1711,94 +2923,1140 @@ bool Monolithic_renderer::Impl::setup_initial_camera_props()
     return true;
 }
 
-// Misc??????
-bool Monolithic_renderer::Impl::write_material_param_sets_to_descriptor_sets()
+// Frame pacing.
+void Monolithic_renderer::Impl::wait_for_frame_pacing()
 {
-    auto& material_param_sets_data{
-        m_v_geometry_graphics_pass.material_param_sets_data };
+    if (m_frame_pacing_mode == Frame_pacing_mode::LOW_LATENCY)
+    {
+        // Wait for the GPU to release this frame's resources now instead of
+        // inside `begin_render()`, so the wait doesn't age the sampled input.
+        // @NOTE: The fence is not reset here. `begin_render()` does that.
+        constexpr uint64_t k_10sec_as_ns{ 10000000000 };
+        auto& current_frame{ get_current_frame() };
+        VkResult err{
+            vkWaitForFences(m_v_device, 1, &current_frame.render_fence, true, k_10sec_as_ns) };
+        if (err)
+        {
+            std::cerr << "ERROR: wait for render fence timed out." << std::endl;
+            assert(false);
+        }
+        record_frame_latency_measurement(current_frame, glfwGetTime());
+    }
 
-    // Write buffers to descriptor sets from `build_vulkan_renderer__geometry_graphics_pass()`.
-    VkDescriptorBufferInfo material_param_sets_buffer_info{
-        .buffer = m_v_geo_passes_resource_buffer.material_param_set_buffer.buffer,
-        .offset = 0,
-        .range = m_v_geo_passes_resource_buffer.material_param_set_buffer_size,
-    };
-    VkWriteDescriptorSet material_param_sets_buffer_write{
-        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .pNext = nullptr,
-        .dstSet = material_param_sets_data.descriptor_set,
-        .dstBinding = 0,
-        .descriptorCount = 1,
-        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-        .pBufferInfo = &material_param_sets_buffer_info,
-    };
+    float_t limiter_fps{ m_frame_limiter_fps };
+    if (limiter_fps > 0.0f && m_prev_frame_pacing_time >= 0.0)
+    {
+        double_t target_time{ m_prev_frame_pacing_time + 1.0 / limiter_fps };
+        if (m_frame_pacing_mode == Frame_pacing_mode::LOW_LATENCY)
+        {
+            // Just-in-time: start the frame as late as possible while still
+            // finishing the CPU work before the next interval.
+            target_time -= m_avg_cpu_frame_work_time;
+        }
 
-    VkDescriptorBufferInfo material_params_buffer_info{
-        .buffer = m_v_geo_passes_resource_buffer.material_param_index_buffer.buffer,
-        .offset = 0,
-        .range = m_v_geo_passes_resource_buffer.material_param_index_buffer_size,
+        // Coarse sleep and then spin for the remainder, since OS sleep
+        // granularity can be ~1ms or worse.
+        constexpr double_t k_spin_threshold{ 0.002 };
+        double_t remaining_time{ target_time - glfwGetTime() };
+        if (remaining_time > k_spin_threshold)
+        {
+            std::this_thread::sleep_for(
+                std::chrono::duration<double_t>(remaining_time - k_spin_threshold));
+        }
+        while (glfwGetTime() < target_time)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    m_prev_frame_pacing_time = glfwGetTime();
+}
+
+void Monolithic_renderer::Impl::poll_frame_latency_measurements()
+{
+    // Check for any frames that finished since last poll.
+    double_t now{ glfwGetTime() };
+    for (uint32_t i = 0; i < m_num_frames_in_flight; i++)
+    {
+        auto& frame{ m_frames[i] };
+        if (frame.pending_latency_sample_time >= 0.0 &&
+            vkGetFenceStatus(m_v_device, frame.render_fence) == VK_SUCCESS)
+        {
+            record_frame_latency_measurement(frame, now);
+        }
+    }
+}
+
+void Monolithic_renderer::Impl::record_frame_latency_measurement(Frame_data& frame,
+                                                                 double_t observed_time)
+{
+    if (frame.pending_latency_sample_time < 0.0)
+        return;
+
+    float_t latency_ms{
+        static_cast<float_t>((observed_time - frame.pending_latency_sample_time) * 1000.0) };
+    frame.pending_latency_sample_time = -1.0;
+
+    // Exponential moving average.
+    constexpr float_t k_avg_weight{ 0.05f };
+    uint64_t num_samples{ m_latency_num_samples++ };
+    m_latency_last_ms = latency_ms;
+    m_latency_avg_ms =
+        (num_samples == 0 ?
+            latency_ms :
+            glm_lerp(m_latency_avg_ms, latency_ms, k_avg_weight));
+    if (latency_ms > m_latency_max_ms)
+        m_latency_max_ms = latency_ms;
+}
+
+// Performance HUD.
+void Monolithic_renderer::Impl::sample_perf_hud_frame(const Frame_data& frame)
+{
+    CPU_PROFILER_ZONE("Sample Perf HUD Frame");
+    auto& sample{ m_perf_hud_sample };
+    sample.frame_ms = m_delta_time * 1000.0f;
+    sample.num_upload_bytes = frame.num_upload_bytes;
+
+    // GPU pass times.
+    static_assert(vk_profiler::k_num_gpu_zones <= imgui_system::k_perf_hud_max_gpu_passes);
+    std::array<float_t, vk_profiler::k_num_gpu_zones> gpu_zone_ms;
+    vk_profiler::get_latest_zone_times(m_gpu_profiler, gpu_zone_ms);
+    sample.num_gpu_passes = (m_gpu_profiler.is_supported ? vk_profiler::k_num_gpu_zones : 0);
+    for (uint32_t i = 0; i < sample.num_gpu_passes; i++)
+    {
+        sample.gpu_pass_names[i] = vk_profiler::get_gpu_zone_name(static_cast<vk_profiler::GPU_zone>(i));
+        sample.gpu_pass_ms[i] = gpu_zone_ms[i];
+    }
+
+    // Counts.
+    sample.num_instances = frame.prepared_draw_list->num_instances;
+    sample.num_primitives = static_cast<uint32_t>(frame.prepared_draw_list->primitives.size());
+    sample.is_frame_pipelined = m_is_update_data_pipelined;
+    {
+        std::lock_guard<std::mutex> lock{ m_render_stats_mutex };
+        sample.num_candidate_draws = m_render_stats.num_candidate_draws;
+        sample.num_main_view_draws = m_render_stats.num_main_view_draws;
+        sample.num_shadow_view_draws = m_render_stats.num_shadow_view_draws;
+    }
+
+    static_assert(vk_profiler::k_num_gpu_stats_passes <= imgui_system::k_perf_hud_max_stats_passes);
+    sample.is_pipeline_stats_supported = m_gpu_profiler.is_pipeline_stats_supported;
+    sample.num_stats_passes = vk_profiler::k_num_gpu_stats_passes;
+    for (uint32_t i = 0; i < sample.num_stats_passes; i++)
+    {
+        auto pass{ static_cast<vk_profiler::GPU_stats_pass>(i) };
+        auto pipeline_stats{ vk_profiler::get_pipeline_stats(m_gpu_profiler, pass) };
+        sample.pipeline_stats[i] = {
+            .name = vk_profiler::get_gpu_stats_pass_name(pass),
+            .vertex_shader_invocations = pipeline_stats.vertex_shader_invocations,
+            .clipping_primitives = pipeline_stats.clipping_primitives,
+            .fragment_shader_invocations = pipeline_stats.fragment_shader_invocations,
+            .compute_shader_invocations = pipeline_stats.compute_shader_invocations,
+        };
+    }
+
+    // CPU zones of the latest finished frame.
+    sample.num_cpu_zones = 0;
+    uint64_t num_cpu_frames{ cpu_profiler::get_num_frames() };
+    if (num_cpu_frames > 0)
+    {
+        std::array<cpu_profiler::Frame_zone, imgui_system::k_perf_hud_max_cpu_zones> cpu_zones;
+        sample.num_cpu_zones = cpu_profiler::collect_frame_zones(num_cpu_frames - 1,
+                                                                 cpu_zones.data(),
+                                                                 imgui_system::k_perf_hud_max_cpu_zones);
+        uint64_t first_begin_ns{ ~uint64_t(0) };
+        for (uint32_t i = 0; i < sample.num_cpu_zones; i++)
+            first_begin_ns = std::min(first_begin_ns, cpu_zones[i].begin_ns);
+        for (uint32_t i = 0; i < sample.num_cpu_zones; i++)
+        {
+            auto& zone{ cpu_zones[i] };
+            sample.cpu_zones[i] = {
+                .name = zone.name,
+                .thread_idx = zone.thread_idx,
+                .begin_ms = static_cast<float_t>((zone.begin_ns - first_begin_ns) / 1000000.0),
+                .end_ms = static_cast<float_t>((zone.end_ns - first_begin_ns) / 1000000.0),
+            };
+        }
+    }
+
+    // VMA heap budgets.
+    const VkPhysicalDeviceMemoryProperties* memory_props;
+    vmaGetMemoryProperties(m_v_vma_allocator, &memory_props);
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets;
+    vmaGetHeapBudgets(m_v_vma_allocator, budgets.data());
+    sample.num_heaps = std::min<uint32_t>(memory_props->memoryHeapCount,
+                                          imgui_system::k_perf_hud_max_heaps);
+    for (uint32_t i = 0; i < sample.num_heaps; i++)
+        sample.heap_budgets[i] = {
+            .usage_bytes = budgets[i].usage,
+            .budget_bytes = budgets[i].budget,
+            .is_device_local =
+                (memory_props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0,
+        };
+
+    imgui_system::record_perf_hud_frame(sample);
+}
+
+// GPU memory defragmentation.
+void Monolithic_renderer::Impl::run_gpu_memory_defragmentation_pass(Frame_data& frame, uint32_t frame_idx)
+{
+    auto& movable_buffers{ m_defrag_movable_buffers };
+    movable_buffers.clear();
+    vk_buffer::append_movable_per_frame_buffers(frame.geo_per_frame_buffer, movable_buffers);
+    movable_buffers.insert(movable_buffers.end(), {
+        { &frame.camera_buffer },
+        { &frame.shadow_camera_buffer },
+        { &frame.culling_view_buffer },
+        { &frame.vsm_params_buffer },
+        { &frame.vsm_instance_key_buffer },
+        { &frame.vsm_stats_readback_buffer },
+    });
+    size_t num_frame_movable_buffers{ movable_buffers.size() };
+    for (auto& churn_buffer : m_churn_buffers)
+        movable_buffers.push_back({ &churn_buffer, true });
+
+    vk_defrag::run_defragmentation_pass(m_defragmenter,
+                                        m_immediate_submit_support,
+                                        m_v_device,
+                                        m_v_graphics_queue,
+                                        m_v_vma_allocator,
+                                        movable_buffers,
+                                        m_defrag_moved_buffers);
+
+    bool is_frame_buffer_moved{ false };
+    for (auto moved_buffer : m_defrag_moved_buffers)
+        for (size_t i = 0; i < num_frame_movable_buffers; i++)
+            if (movable_buffers[i].buffer == moved_buffer)
+                is_frame_buffer_moved = true;
+    if (!is_frame_buffer_moved)
+        return;
+
+    // Fix up everything pointing at the moved buffers.
+    // @NOTE: Bumping `buffers_version` re-records the frame's cached cmds,
+    //   which would be invalid after rewriting their descriptor sets anyways.
+    vk_buffer::refresh_per_frame_buffer_addresses(m_v_device, frame.geo_per_frame_buffer);
+
+    VkBufferDeviceAddressInfo device_address_info{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+        .buffer = frame.culling_view_buffer.buffer,
     };
-    VkWriteDescriptorSet material_params_buffer_write{
-        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .pNext = nullptr,
-        .dstSet = material_param_sets_data.descriptor_set,
-        .dstBinding = 1,
-        .descriptorCount = 1,
-        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-        .pBufferInfo = &material_params_buffer_info,
+    frame.culling_view_buffer_address = vkGetBufferDeviceAddress(m_v_device, &device_address_info);
+    device_address_info.buffer = frame.vsm_params_buffer.buffer;
+    frame.vsm_params_buffer_address = vkGetBufferDeviceAddress(m_v_device, &device_address_info);
+    device_address_info.buffer = frame.vsm_instance_key_buffer.buffer;
+    frame.vsm_instance_key_buffer_address = vkGetBufferDeviceAddress(m_v_device, &device_address_info);
+
+    write_per_frame_buffers_to_descriptor_sets(m_v_device,
+                                               frame,
+                                               m_v_geometry_graphics_pass.shadow_camera_stride,
+                                               m_v_geometry_graphics_pass.per_frame_datas[frame_idx]);
+}
+
+void Monolithic_renderer::Impl::tick_gpu_memory_churn()
+{
+    // @NOTE: Churn buffers never get used by the GPU, so they're safe to
+    //   destroy right away.
+    if (!m_is_gpu_memory_churn_enabled)
+    {
+        for (auto& churn_buffer : m_churn_buffers)
+            vk_buffer::destroy_buffer(m_v_vma_allocator, churn_buffer);
+        m_churn_buffers.clear();
+        return;
+    }
+
+    constexpr uint32_t k_max_churn_buffers{ 256 };
+    constexpr uint32_t k_num_churn_ops_per_frame{ 8 };
+    constexpr size_t k_min_churn_buffer_size{ 64 * 1024 };  // Up to 64x this (4 MB).
+
+    auto next_random = [&]() {
+        m_churn_random_state = m_churn_random_state * 1664525u + 1013904223u;
+        return (m_churn_random_state >> 8);
     };
 
-    VkWriteDescriptorSet writes[]{ material_param_sets_buffer_write, material_params_buffer_write };
-    vkUpdateDescriptorSets(m_v_device, 2, writes, 0, nullptr);
+    for (uint32_t i = 0; i < k_num_churn_ops_per_frame; i++)
+    {
+        bool is_free{ !m_churn_buffers.empty() &&
+                      (m_churn_buffers.size() >= k_max_churn_buffers || next_random() % 2 == 0) };
+        if (is_free)
+        {
+            size_t idx{ next_random() % m_churn_buffers.size() };
+            vk_buffer::destroy_buffer(m_v_vma_allocator, m_churn_buffers[idx]);
+            m_churn_buffers[idx] = m_churn_buffers.back();
+            m_churn_buffers.pop_back();
+        }
+        else
+        {
+            m_churn_buffers.emplace_back(
+                vk_buffer::create_buffer(m_v_vma_allocator,
+                                         k_min_churn_buffer_size << (next_random() % 7),
+                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                         VMA_MEMORY_USAGE_GPU_ONLY,
+                                         vk_memory::Memory_category::OTHER));
+        }
+    }
+}
 
-    return true;
+// Shadow technique benchmark.
+namespace
+{
+
+constexpr uint32_t k_shadow_benchmark_grid_width{ 16 };
+constexpr uint32_t k_num_shadow_benchmark_casters{
+    k_shadow_benchmark_grid_width * k_shadow_benchmark_grid_width };
+constexpr float_t k_shadow_benchmark_grid_spacing{ 3.0f };
+constexpr uint32_t k_num_shadow_benchmark_moving_casters{ 32 };
+constexpr uint32_t k_num_shadow_benchmark_respawns_per_frame{ 2 };
+constexpr uint32_t k_num_shadow_benchmark_layer_switches_per_frame{ 2 };
+
+// @NOTE: Warmup covers the stats readback lag and the caches filling up after
+//   switching techniques.
+constexpr uint32_t k_num_shadow_benchmark_warmup_frames{ 60 };
+constexpr uint32_t k_num_shadow_benchmark_measured_frames{ 600 };
+
+constexpr std::array<Monolithic_renderer::Shadow_technique, 2> k_shadow_benchmark_techniques{
+    Monolithic_renderer::Shadow_technique::CASCADED,
+    Monolithic_renderer::Shadow_technique::VIRTUAL,
+};
+
+constexpr std::array<const char*, k_shadow_benchmark_techniques.size()> k_shadow_benchmark_technique_names{
+    "Cascaded Shadow Maps",
+    "Virtual Shadow Map",
+};
+
+}  // namespace
+
+void Monolithic_renderer::Impl::get_shadow_benchmark_caster_transform(uint32_t caster_idx,
+                                                                      mat4& out_transform)
+{
+    // Grid of boxes centered on the origin, w/ the moving casters bobbing up
+    // and down (through their neighbors' shadows).
+    float_t half_extent{ 0.5f * k_shadow_benchmark_grid_spacing * (k_shadow_benchmark_grid_width - 1) };
+    vec3 position{
+        (caster_idx % k_shadow_benchmark_grid_width) * k_shadow_benchmark_grid_spacing - half_extent,
+        0.0f,
+        (caster_idx / k_shadow_benchmark_grid_width) * k_shadow_benchmark_grid_spacing - half_extent };
+    if (caster_idx < k_num_shadow_benchmark_moving_casters)
+        position[1] = 2.0f + 2.0f * std::sin(2.0f * m_shadow_benchmark.time + caster_idx);
+
+    glm_translate_make(out_transform, position);
 }
 
-bool Monolithic_renderer::Impl::write_bounding_spheres_to_descriptor_sets()
+Monolithic_renderer::render_geo_obj_key_t
+Monolithic_renderer::Impl::spawn_shadow_benchmark_caster(uint32_t caster_idx)
 {
-    auto& bounding_spheres_data{ m_v_geometry_graphics_pass.bounding_spheres_data };
+    auto key{ create_render_geo_obj("model_box",
+                                    "box_mat_set_0",
+                                    geo_instance::Geo_render_pass::OPAQUE,
+                                    true,
+                                    nullptr) };
+    mat4 transform;
+    get_shadow_benchmark_caster_transform(caster_idx, transform);
+    set_render_geo_obj_transform(key, transform);
+    return key;
+}
 
-    // Write buffers to descriptor sets from `build_vulkan_renderer__geometry_graphics_pass()`.
-    VkDescriptorBufferInfo bounding_spheres_data_buffer_info{
-        .buffer = m_v_geo_passes_resource_buffer.bounding_sphere_buffer.buffer,
-        .offset = 0,
-        .range = m_v_geo_passes_resource_buffer.bounding_sphere_buffer_size,
+void Monolithic_renderer::Impl::tick_shadow_technique_benchmark()
+{
+    auto& bench{ m_shadow_benchmark };
+    bool is_requested{ m_is_shadow_benchmark_requested.exchange(false) };
+    if (!bench.is_running)
+    {
+        if (!is_requested || !m_all_assets_loaded)
+            return;
+
+        // Start benchmark.
+        bench.is_running = true;
+        bench.technique_idx = 0;
+        bench.frame_idx = 0;
+        bench.time = 0.0f;
+        bench.prev_technique = m_shadow_technique;
+        bench.results.assign(k_shadow_benchmark_techniques.size(), Shadow_technique_benchmark_result{});
+        bench.caster_keys.resize(k_num_shadow_benchmark_casters);
+        bench.caster_layers.assign(k_num_shadow_benchmark_casters, gpu_geo_data::Render_layer::DEFAULT);
+        for (uint32_t i = 0; i < k_num_shadow_benchmark_casters; i++)
+            bench.caster_keys[i] = spawn_shadow_benchmark_caster(i);
+
+        set_shadow_technique(k_shadow_benchmark_techniques[0]);
+        std::cout << "Shadow technique benchmark: started w/ "
+                  << k_num_shadow_benchmark_casters << " casters." << std::endl;
+        return;
+    }
+
+    // Scene changes.
+    bench.time += m_delta_time;
+
+    auto next_random = [&]() {
+        bench.random_state = bench.random_state * 1664525u + 1013904223u;
+        return (bench.random_state >> 8);
     };
-    VkWriteDescriptorSet bounding_spheres_data_buffer_write{
-        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .pNext = nullptr,
-        .dstSet = bounding_spheres_data.descriptor_set,
-        .dstBinding = 0,
-        .descriptorCount = 1,
-        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-        .pBufferInfo = &bounding_spheres_data_buffer_info,
+
+    for (uint32_t i = 0; i < k_num_shadow_benchmark_moving_casters; i++)
+    {
+        mat4 transform;
+        get_shadow_benchmark_caster_transform(i, transform);
+        set_render_geo_obj_transform(bench.caster_keys[i], transform);
+    }
+
+    for (uint32_t i = 0; i < k_num_shadow_benchmark_respawns_per_frame; i++)
+    {
+        uint32_t caster_idx{ next_random() % k_num_shadow_benchmark_casters };
+        destroy_render_geo_obj(bench.caster_keys[caster_idx]);
+        bench.caster_keys[caster_idx] = spawn_shadow_benchmark_caster(caster_idx);
+        bench.caster_layers[caster_idx] = gpu_geo_data::Render_layer::DEFAULT;
+    }
+
+    for (uint32_t i = 0; i < k_num_shadow_benchmark_layer_switches_per_frame; i++)
+    {
+        uint32_t caster_idx{ next_random() % k_num_shadow_benchmark_casters };
+        auto& render_layer{ bench.caster_layers[caster_idx] };
+        render_layer = (render_layer == gpu_geo_data::Render_layer::DEFAULT ?
+                            gpu_geo_data::Render_layer::INVISIBLE :
+                            gpu_geo_data::Render_layer::DEFAULT);
+        set_render_geo_obj_render_layer(bench.caster_keys[caster_idx], render_layer);
+    }
+
+    // Measure.
+    auto& result{ bench.results[bench.technique_idx] };
+    if (bench.frame_idx >= k_num_shadow_benchmark_warmup_frames)
+    {
+        std::array<float_t, vk_profiler::k_num_gpu_zones> zone_ms;
+        vk_profiler::get_latest_zone_times(m_gpu_profiler, zone_ms);
+        float_t shadow_maps_ms{ zone_ms[static_cast<size_t>(vk_profiler::GPU_zone::SHADOW_MAPS)] };
+        auto shadow_stats{ get_shadow_stats() };
+
+        // @NOTE: Summed here, averaged once the technique finishes.
+        result.num_measured_frames++;
+        result.avg_shadow_maps_gpu_ms += shadow_maps_ms;
+        result.max_shadow_maps_gpu_ms = std::max(result.max_shadow_maps_gpu_ms, shadow_maps_ms);
+        result.avg_cascades_rendered += shadow_stats.num_cascades_rendered;
+        result.avg_static_caches_rendered += shadow_stats.num_static_caches_rendered;
+        result.avg_vsm_rendered_pages += shadow_stats.num_vsm_rendered_pages;
+        result.avg_vsm_invalidated_pages += shadow_stats.num_vsm_invalidated_pages;
+        result.shadow_map_memory_bytes =
+            std::max(result.shadow_map_memory_bytes, shadow_stats.shadow_map_memory_bytes);
+    }
+
+    bench.frame_idx++;
+    if (bench.frame_idx < k_num_shadow_benchmark_warmup_frames + k_num_shadow_benchmark_measured_frames)
+        return;
+
+    // Finish technique.
+    result.technique = k_shadow_benchmark_techniques[bench.technique_idx];
+    if (result.num_measured_frames > 0)
+    {
+        float_t num_frames{ static_cast<float_t>(result.num_measured_frames) };
+        result.avg_shadow_maps_gpu_ms /= num_frames;
+        result.avg_cascades_rendered /= num_frames;
+        result.avg_static_caches_rendered /= num_frames;
+        result.avg_vsm_rendered_pages /= num_frames;
+        result.avg_vsm_invalidated_pages /= num_frames;
+    }
+
+    bench.technique_idx++;
+    bench.frame_idx = 0;
+    if (bench.technique_idx < k_shadow_benchmark_techniques.size())
+    {
+        set_shadow_technique(k_shadow_benchmark_techniques[bench.technique_idx]);
+        return;
+    }
+
+    // Finish benchmark.
+    std::cout << "-=-=- Shadow Technique Benchmark -=-=-" << std::endl
+              << "  " << k_num_shadow_benchmark_casters << " casters ("
+              << k_num_shadow_benchmark_moving_casters << " moving, "
+              << k_num_shadow_benchmark_respawns_per_frame << " respawns and "
+              << k_num_shadow_benchmark_layer_switches_per_frame << " render layer switches per frame)"
+              << std::endl;
+    if (!m_gpu_profiler.is_supported)
+        std::cout << "  WARNING: GPU profiler not supported. Shadow map GPU timings are 0." << std::endl;
+    for (size_t i = 0; i < bench.results.size(); i++)
+    {
+        auto& technique_result{ bench.results[i] };
+        std::cout
+            << "# " << k_shadow_benchmark_technique_names[i] << std::endl
+            << "  " << technique_result.avg_shadow_maps_gpu_ms << " ms avg / "
+                    << technique_result.max_shadow_maps_gpu_ms << " ms max shadow maps GPU time" << std::endl
+            << "  " << technique_result.avg_cascades_rendered << " cascades, "
+                    << technique_result.avg_static_caches_rendered << " static caches rendered avg" << std::endl
+            << "  " << technique_result.avg_vsm_rendered_pages << " pages rendered, "
+                    << technique_result.avg_vsm_invalidated_pages << " pages invalidated avg" << std::endl
+            << "  " << (technique_result.shadow_map_memory_bytes / 1024.0f / 1024.0f)
+                    << " MB shadow map memory" << std::endl;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ m_shadow_benchmark_results_mutex };
+        m_shadow_benchmark_results = bench.results;
+    }
+
+    for (auto key : bench.caster_keys)
+        destroy_render_geo_obj(key);
+    bench.caster_keys.clear();
+    bench.caster_layers.clear();
+    set_shadow_technique(bench.prev_technique);
+    bench.is_running = false;
+}
+
+Monolithic_renderer::GPU_defrag_stats Monolithic_renderer::Impl::get_gpu_defrag_stats()
+{
+    uint32_t num_runs;
+    auto total_stats{ vk_defrag::get_total_stats(m_defragmenter, num_runs) };
+    return GPU_defrag_stats{
+        .is_running = vk_defrag::is_defragmentation_running(m_defragmenter),
+        .num_runs = num_runs,
+        .num_passes = total_stats.num_passes,
+        .num_allocations_moved = total_stats.num_allocations_moved,
+        .num_bytes_moved = total_stats.num_bytes_moved,
+        .num_blocks_freed = total_stats.num_blocks_freed,
+        .num_bytes_freed = total_stats.num_bytes_freed,
     };
+}
+
+// Tick procedures.
+bool Monolithic_renderer::Impl::is_frame_pipelining_enabled()
+{
+    // @NOTE: Pipelining needs a second frame slot to prepare into, and
+    //   low latency pacing wants input sampled right before the frame is
+    //   recorded, which pipelining would delay by a frame.
+    return (m_num_frames_in_flight >= 2 &&
+            m_frame_pacing_mode == Frame_pacing_mode::MAX_THROUGHPUT);
+}
+
+void Monolithic_renderer::Impl::append_begin_render_jobs(Job_next_jobs_return_data& return_data)
+{
+    return_data.jobs.emplace_back(m_begin_render_job.get());
+    m_stage = Stage::RECORD_RENDER_PASSES;
+
+    // Prepare the next frame while the current (already prepared) frame gets
+    // recorded and submitted.
+    // @NOTE: Update data phases ride along w/ the render stage batches and
+    //   any leftovers get finished after submit.
+    // @NOTE: Safe to overlap w/ the render stages since update data only
+    //   writes the next frame's per-frame buffers and descriptor sets (its
+    //   render fence gets waited on first), and state shared between frames
+    //   (upload context, visibility history, VSM and cascade caches, immediate
+    //   submits, defragmentation) is only touched by update data, which
+    //   prepares one frame at a time and in frame order.
+    auto& next_frame{ m_frames[(m_frame_number + 1) % m_num_frames_in_flight] };
+    bool is_pipelined{ is_frame_pipelining_enabled() && !next_frame.is_render_data_prepared };
+    m_is_update_data_pipelined = is_pipelined;
+    if (is_pipelined)
+    {
+        m_num_pipelined_update_datas++;
+        start_update_data_phases(m_frame_number + 1);
+        append_next_update_data_phase_jobs(return_data);
+    }
+}
+
+void Monolithic_renderer::Impl::start_update_data_phases(size_t frame_number)
+{
+    // Previous update data should've finished all its phases.
+    assert(m_next_update_data_phase == Update_data_phase::NUM_UPDATE_DATA_PHASES);
+
+    m_update_data_frame_number = frame_number;
+    m_next_update_data_sort_pass_idx = 0;
+    m_next_update_data_phase = Update_data_phase::BEGIN_REBUCKET;
+
+    // @NOTE: Latched here so every phase of this update data splits into
+    //   the same chunks.
+    uint32_t requested_num_chunks{ m_requested_num_update_data_chunks };
+    m_num_update_data_chunks =
+        std::clamp<size_t>((requested_num_chunks == 0 ?
+                                std::thread::hardware_concurrency() :
+                                requested_num_chunks),
+                           1,
+                           k_max_update_data_chunks);
+    m_update_data_phase_times.fill(0.0);
+}
+
+bool Monolithic_renderer::Impl::append_next_update_data_phase_jobs(Job_next_jobs_return_data& return_data)
+{
+    // The previously fetched phase's jobs are all finished by now.
+    bool was_phase_fetched{ m_timed_update_data_phase != Update_data_phase::NUM_UPDATE_DATA_PHASES };
+    if (was_phase_fetched)
+        record_update_data_phase_time();
 
-    vkUpdateDescriptorSets(m_v_device, 1, &bounding_spheres_data_buffer_write, 0, nullptr);
+    auto phase{ m_next_update_data_phase.load() };
 
+    // Skip bucketing and sorting if the begin phase found nothing to rebucket.
+    if (phase == Update_data_phase::BUCKET_CHUNKS && !m_is_update_data_rebucketing)
+        phase = Update_data_phase::BEGIN_UPLOAD;
+
+    // Start the next sort pass, or move on once all passes are done.
+    // @NOTE: Only happens once the previous phase's jobs all finished, so
+    //   the pass idx doesn't change under any running sort job.
+    if (phase == Update_data_phase::SORT_HISTOGRAM_CHUNKS)
+    {
+        uint32_t pass_idx{ m_next_update_data_sort_pass_idx++ };
+        if (pass_idx < geo_instance::get_rebuild_num_sort_passes())
+            m_update_data_sort_pass_idx = pass_idx;
+        else
+            phase = Update_data_phase::BEGIN_UPLOAD;
+    }
+
+    if (phase == Update_data_phase::NUM_UPDATE_DATA_PHASES)
+    {
+        // All phases finished.
+        if (was_phase_fetched)
+            tick_update_data_scaling_benchmark();
+        return false;
+    }
+
+    auto& phase_jobs{ m_update_data_jobs[static_cast<size_t>(phase)] };
+    size_t num_jobs{ is_update_data_chunk_phase(phase) ? m_num_update_data_chunks : 1 };
+    for (size_t i = 0; i < num_jobs; i++)
+        return_data.jobs.emplace_back(phase_jobs[i].get());
+    m_timed_update_data_phase = phase;
+
+    m_next_update_data_phase =
+        (phase == Update_data_phase::SORT_SCATTER_CHUNKS ?
+            Update_data_phase::SORT_HISTOGRAM_CHUNKS :
+            static_cast<Update_data_phase>(static_cast<size_t>(phase) + 1));
     return true;
 }
 
-// Tick procedures.
-bool Monolithic_renderer::Impl::update_and_upload_render_data()
-{
-    // Update.
-    TIMING_REPORT_START(rebucket);
-    std::vector<vk_buffer::GPU_geo_per_frame_buffer*> all_per_frame_buffers;
-    all_per_frame_buffers.reserve(k_frame_overlap);
-    for (size_t i = 0; i < k_frame_overlap; i++)
-        all_per_frame_buffers.emplace_back(&m_frames[i].geo_per_frame_buffer);
-    geo_instance::rebuild_bucketed_instance_list_array(all_per_frame_buffers);
-    TIMING_REPORT_END_AND_PRINT(rebucket, "Rebucket Instance Data: ");
-
-    // Upload.
-    TIMING_REPORT_START(upload_per_frame);
-    vk_buffer::upload_changed_per_frame_data(m_immediate_submit_support,
-                                             m_v_device,
-                                             m_v_graphics_queue,
-                                             m_v_vma_allocator,
-                                             get_current_frame().geo_per_frame_buffer);
-    TIMING_REPORT_END_AND_PRINT(upload_per_frame, "Upload Changed Per-frame Data: ");
+void Monolithic_renderer::Impl::record_update_data_phase_time()
+{
+    // Wall time from the first job starting to the last job finishing.
+    // @NOTE: The sort phases add up over all their passes.
+    auto phase{ m_timed_update_data_phase };
+    auto& phase_jobs{ m_update_data_jobs[static_cast<size_t>(phase)] };
+    size_t num_jobs{ is_update_data_chunk_phase(phase) ? m_num_update_data_chunks : 1 };
+
+    double_t begin_time{ phase_jobs[0]->m_begin_time };
+    double_t end_time{ phase_jobs[0]->m_end_time };
+    for (size_t i = 1; i < num_jobs; i++)
+    {
+        begin_time = std::min(begin_time, phase_jobs[i]->m_begin_time);
+        end_time = std::max(end_time, phase_jobs[i]->m_end_time);
+    }
+    m_update_data_phase_times[static_cast<size_t>(phase)] += (end_time - begin_time);
+    m_timed_update_data_phase = Update_data_phase::NUM_UPDATE_DATA_PHASES;
+}
+
+void Monolithic_renderer::Impl::tick_update_data_scaling_benchmark()
+{
+    constexpr uint32_t k_num_warmup_frames{ 30 };
+    constexpr uint32_t k_num_measured_frames{ 300 };
+    constexpr uint32_t k_num_steps{ std::bit_width(k_max_update_data_chunks) };  // 1, 2, 4, ... chunks.
+    constexpr uint32_t k_num_instances{ geo_instance::k_max_instances / 2 };
+    constexpr uint32_t k_instance_grid_width{ 128 };
+    constexpr float_t k_instance_grid_spacing{ 3.0f };
+
+    auto& bench{ m_update_data_scaling };
+    bool is_requested{ m_is_update_data_scaling_benchmark_requested.exchange(false) };
+    if (!bench.is_running)
+    {
+        if (!is_requested || !m_all_assets_loaded)
+            return;
+
+        // Start benchmark.
+        bench.is_running = true;
+        bench.step_idx = 0;
+        bench.frame_idx = 0;
+        bench.prev_requested_num_chunks = m_requested_num_update_data_chunks;
+        bench.prev_draw_list_version = geo_instance::get_draw_list_snapshot()->version;
+
+        // @NOTE: Invisible and not casting shadows so that only the update
+        //   data gets loaded up, not the GPU.
+        bench.instance_keys.resize(k_num_instances);
+        for (uint32_t i = 0; i < k_num_instances; i++)
+        {
+            bench.instance_keys[i] =
+                create_render_geo_obj("model_box",
+                                      "box_mat_set_0",
+                                      geo_instance::Geo_render_pass::OPAQUE,
+                                      false,
+                                      nullptr,
+                                      gpu_geo_data::Render_layer::INVISIBLE);
+            vec3 position{
+                (i % k_instance_grid_width) * k_instance_grid_spacing,
+                -10.0f,
+                (i / k_instance_grid_width) * k_instance_grid_spacing };
+            mat4 transform;
+            glm_translate_make(transform, position);
+            set_render_geo_obj_transform(bench.instance_keys[i], transform);
+        }
+        bench.results.assign(k_num_steps, Update_data_scaling_result{});
+        for (uint32_t i = 0; i < k_num_steps; i++)
+        {
+            auto& result{ bench.results[i] };
+            result.num_chunks = (1u << i);
+            result.phase_timings.reserve(k_num_update_data_phases);
+            for (size_t phase_idx = 0; phase_idx < k_num_update_data_phases; phase_idx++)
+                result.phase_timings.emplace_back(Update_data_scaling_result::Phase_timing{
+                    .name = k_update_data_phase_timing_names[phase_idx],
+                });
+        }
+
+        m_requested_num_update_data_chunks = bench.results[0].num_chunks;
+        std::cout << "Update data scaling benchmark: started w/ "
+                  << k_num_instances << " instances." << std::endl;
+        return;
+    }
+
+    // Measure.
+    // @NOTE: Skips frames that didn't rebucket (e.g. the first update data
+    //   after starting is already in flight) and frames w/ the chunk count
+    //   changed from outside.
+    uint64_t draw_list_version{ geo_instance::get_draw_list_snapshot()->version };
+    bool is_rebucketed{ draw_list_version != bench.prev_draw_list_version };
+    bench.prev_draw_list_version = draw_list_version;
+
+    auto& result{ bench.results[bench.step_idx] };
+    if (bench.frame_idx >= k_num_warmup_frames &&
+        is_rebucketed &&
+        m_num_update_data_chunks == result.num_chunks)
+    {
+        auto get_phase_ms = [&](Update_data_phase phase) {
+            return static_cast<float_t>(m_update_data_phase_times[static_cast<size_t>(phase)] * 1000.0);
+        };
+
+        // @NOTE: Summed here, averaged once the step finishes.
+        result.num_measured_frames++;
+        result.avg_bucket_ms += get_phase_ms(Update_data_phase::BEGIN_REBUCKET) +
+                                get_phase_ms(Update_data_phase::BUCKET_CHUNKS);
+        result.avg_sort_ms += get_phase_ms(Update_data_phase::SORT_HISTOGRAM_CHUNKS) +
+                              get_phase_ms(Update_data_phase::SORT_SCATTER_CHUNKS);
+        result.avg_upload_ms += get_phase_ms(Update_data_phase::BEGIN_UPLOAD) +
+                                get_phase_ms(Update_data_phase::UPLOAD_CHUNKS);
+        for (size_t i = 0; i < k_num_update_data_phases; i++)
+        {
+            float_t phase_ms{ get_phase_ms(static_cast<Update_data_phase>(i)) };
+            result.phase_timings[i].avg_ms += phase_ms;
+            result.avg_total_ms += phase_ms;
+        }
+    }
+
+    // Force rebucketing the next update data.
+    geo_instance::flag_rebucket();
+
+    bench.frame_idx++;
+    if (bench.frame_idx < k_num_warmup_frames + k_num_measured_frames)
+        return;
+
+    // Finish step.
+    if (result.num_measured_frames > 0)
+    {
+        float_t num_frames{ static_cast<float_t>(result.num_measured_frames) };
+        result.avg_total_ms /= num_frames;
+        result.avg_bucket_ms /= num_frames;
+        result.avg_sort_ms /= num_frames;
+        result.avg_upload_ms /= num_frames;
+        for (auto& phase_timing : result.phase_timings)
+            phase_timing.avg_ms /= num_frames;
+    }
+
+    bench.step_idx++;
+    bench.frame_idx = 0;
+    if (bench.step_idx < k_num_steps)
+    {
+        m_requested_num_update_data_chunks = bench.results[bench.step_idx].num_chunks;
+        return;
+    }
+
+    // Finish benchmark.
+    std::cout << "-=-=- Update Data Scaling Benchmark -=-=-" << std::endl
+              << "  " << std::thread::hardware_concurrency() << " hardware threads, "
+                      << k_num_instances << " instances" << std::endl;
+    for (auto& step_result : bench.results)
+    {
+        std::cout << "# " << step_result.num_chunks << " chunks: "
+                  << step_result.avg_total_ms << " ms avg total ("
+                  << step_result.num_measured_frames << " frames)" << std::endl
+                  << "  Bucket: " << step_result.avg_bucket_ms << " ms, "
+                  << "Sort: " << step_result.avg_sort_ms << " ms, "
+                  << "Upload: " << step_result.avg_upload_ms << " ms" << std::endl;
+        for (auto& phase_timing : step_result.phase_timings)
+            std::cout << "  " << phase_timing.name << ": " << phase_timing.avg_ms << " ms" << std::endl;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ m_update_data_scaling_results_mutex };
+        m_update_data_scaling_results = bench.results;
+    }
+
+    for (auto key : bench.instance_keys)
+        destroy_render_geo_obj(key);
+    bench.instance_keys.clear();
+    m_requested_num_update_data_chunks = bench.prev_requested_num_chunks;
+    bench.is_running = false;
+}
+
+bool Monolithic_renderer::Impl::prepare_render_data(Update_data_phase phase, size_t chunk_idx)
+{
+    auto& frame{ m_frames[m_update_data_frame_number % m_num_frames_in_flight] };
+
+    switch (phase)
+    {
+        case Update_data_phase::BEGIN_REBUCKET:
+        {
+            // Wait until GPU is finished with this frame's buffers.
+            // @NOTE: The fence is reset by `begin_render()` before recording.
+            constexpr uint64_t k_10sec_as_ns{ 10000000000 };
+            VkResult err;
+            {
+                CPU_PROFILER_ZONE("Wait for Render Fence");
+                err = vkWaitForFences(m_v_device, 1, &frame.render_fence, true, k_10sec_as_ns);
+            }
+            if (err)
+            {
+                std::cerr << "ERROR: wait for render fence timed out." << std::endl;
+                assert(false);
+                return false;
+            }
+
+            frame.input_sample_time = m_input_sample_time;
+
+            // Read back virtual shadow map stats of this frame's last render.
+            if (frame.is_vsm_stats_readback_pending)
+            {
+                gpu_geo_data::GPU_vsm_stats vsm_stats;
+                vmaInvalidateAllocation(m_v_vma_allocator,
+                                        frame.vsm_stats_readback_buffer.allocation,
+                                        0,
+                                        VK_WHOLE_SIZE);
+                void* data;
+                vmaMapMemory(m_v_vma_allocator, frame.vsm_stats_readback_buffer.allocation, &data);
+                memcpy(&vsm_stats, data, sizeof(gpu_geo_data::GPU_vsm_stats));
+                vmaUnmapMemory(m_v_vma_allocator, frame.vsm_stats_readback_buffer.allocation);
+
+                std::lock_guard<std::mutex> lock{ m_shadow_stats_mutex };
+                m_shadow_stats.num_vsm_requested_pages = vsm_stats.num_requested_pages;
+                m_shadow_stats.num_vsm_resident_pages = vsm_stats.num_resident_pages;
+                m_shadow_stats.num_vsm_rendered_pages = vsm_stats.num_rendered_pages;
+                m_shadow_stats.num_vsm_invalidated_pages = vsm_stats.num_invalidated_pages;
+                m_shadow_stats.num_vsm_allocation_failures = vsm_stats.num_allocation_failures;
+                m_shadow_stats.num_vsm_free_pages = vsm_stats.num_free_pages;
+                frame.is_vsm_stats_readback_pending = false;
+            }
+
+            // Read back draw counts of this frame's last render.
+            // @NOTE: `prepared_draw_list` is still the one that got rendered.
+            if (frame.is_draw_counts_readback_pending)
+            {
+                auto& opaque_pass_range{
+                    frame.prepared_draw_list->get_render_pass(geo_instance::Geo_render_pass::OPAQUE) };
+                auto& readback_buffer{ frame.geo_per_frame_buffer.indirect_counts_readback_buffer };
+                vmaInvalidateAllocation(m_v_vma_allocator,
+                                        readback_buffer.allocation,
+                                        0,
+                                        VK_WHOLE_SIZE);
+                uint32_t* counts;
+                vmaMapMemory(m_v_vma_allocator,
+                             readback_buffer.allocation,
+                             reinterpret_cast<void**>(&counts));
+                Render_stats draw_count_stats{
+                    .num_instances = frame.prepared_draw_list->num_instances,
+                    .num_candidate_draws = opaque_pass_range.num_primitives,
+                };
+                for (uint32_t view_idx = 0; view_idx < gpu_geo_data::k_num_culling_views; view_idx++)
+                {
+                    uint32_t num_view_draws{ 0 };
+                    for (uint32_t i = 0; i < opaque_pass_range.num_render_groups; i++)
+                        num_view_draws += counts[view_idx * opaque_pass_range.num_render_groups + i];
+
+                    if (view_idx == gpu_geo_data::k_main_view_visibility_idx)
+                        draw_count_stats.num_main_view_draws = num_view_draws;
+                    else
+                        draw_count_stats.num_shadow_view_draws += num_view_draws;
+                }
+                vmaUnmapMemory(m_v_vma_allocator, readback_buffer.allocation);
+
+                std::lock_guard<std::mutex> lock{ m_render_stats_mutex };
+                m_render_stats = std::move(draw_count_stats);
+                frame.is_draw_counts_readback_pending = false;
+            }
+
+            std::vector<vk_buffer::GPU_geo_per_frame_buffer*> all_per_frame_buffers;
+            all_per_frame_buffers.reserve(m_num_frames_in_flight);
+            for (size_t i = 0; i < m_num_frames_in_flight; i++)
+                all_per_frame_buffers.emplace_back(&m_frames[i].geo_per_frame_buffer);
+            m_is_update_data_rebucketing =
+                geo_instance::begin_rebuild_bucketed_instance_list_array(all_per_frame_buffers,
+                                                                         m_num_update_data_chunks);
+            break;
+        }
+
+        case Update_data_phase::BUCKET_CHUNKS:
+            geo_instance::rebuild_bucketed_instance_list_array__bucket_chunk(chunk_idx);
+            break;
+
+        case Update_data_phase::SORT_HISTOGRAM_CHUNKS:
+            geo_instance::rebuild_bucketed_instance_list_array__sort_histogram_chunk(
+                m_update_data_sort_pass_idx,
+                chunk_idx);
+            break;
+
+        case Update_data_phase::SORT_SCATTER_CHUNKS:
+            geo_instance::rebuild_bucketed_instance_list_array__sort_scatter_chunk(
+                m_update_data_sort_pass_idx,
+                chunk_idx);
+            break;
+
+        case Update_data_phase::BEGIN_UPLOAD:
+            if (m_is_update_data_rebucketing)
+            {
+                geo_instance::end_rebuild_bucketed_instance_list_array();
+                m_is_update_data_rebucketing = false;
+            }
+            frame.prepared_draw_list = geo_instance::get_draw_list_snapshot();
+
+            // Interpolate batched transforms for the upload chunks to pull from.
+            transform_batch::interpolate_all_sources(m_delta_time);
+
+            // Benchmark scene changes land in this frame.
+            tick_shadow_technique_benchmark();
+
+            // Churn and defragment memory while this frame's buffers are
+            // idle (fence waited on, and not mapped for the upload yet).
+            tick_gpu_memory_churn();
+            run_gpu_memory_defragmentation_pass(
+                frame,
+                static_cast<uint32_t>(m_update_data_frame_number % m_num_frames_in_flight));
+
+            // @NOTE: Captured here so that the upload and the recorded
+            //   culling pass agree even if the setting changes in between.
+            frame.is_geometry_culling_fused = is_fused_geometry_culling_active();
+            m_vsm_cache_state.caster_layer_changes.clear();
+            geo_instance::take_shadow_caster_layer_changes(m_vsm_cache_state.caster_layer_changes);
+            vk_buffer::begin_upload_changed_per_frame_data(m_immediate_submit_support,
+                                                           m_v_device,
+                                                           m_v_graphics_queue,
+                                                           m_v_vma_allocator,
+                                                           *frame.prepared_draw_list,
+                                                           frame.geo_per_frame_buffer,
+                                                           !frame.is_geometry_culling_fused,
+                                                           m_num_update_data_chunks,
+                                                           m_per_frame_upload_context);
+
+            // Each frame in flight writes its own visibility history slot.
+            {
+                uint32_t slot_idx{
+                    static_cast<uint32_t>(m_update_data_frame_number % m_num_frames_in_flight) };
+                vk_buffer::reserve_visibility_history(m_immediate_submit_support,
+                                                      m_v_device,
+                                                      m_v_graphics_queue,
+                                                      m_v_vma_allocator,
+                                                      frame.prepared_draw_list->num_instances,
+                                                      m_update_data_frame_number,
+                                                      m_num_frames_in_flight,
+                                                      m_visibility_history);
+                vk_buffer::assign_visibility_history_slots(
+                    m_visibility_history,
+                    slot_idx,
+                    static_cast<uint32_t>((slot_idx + m_num_frames_in_flight - 1) %
+                                          m_num_frames_in_flight),
+                    frame.geo_per_frame_buffer);
+            }
+            break;
+
+        case Update_data_phase::UPLOAD_CHUNKS:
+            vk_buffer::upload_changed_per_frame_data__chunk(m_per_frame_upload_context,
+                                                            chunk_idx);
+            break;
+
+        case Update_data_phase::FINISH:
+        {
+            size_t num_upload_bytes{ m_per_frame_upload_context.num_upload_bytes };
+            vk_buffer::end_upload_changed_per_frame_data(m_v_vma_allocator,
+                                                         m_per_frame_upload_context);
+
+            // Upload camera information.
+            mat4 projection;
+            std::vector<mat4s> shadow_cascades;
+            camera::GPU_camera camera_data;
+            camera::fetch_matrices(projection,
+                                   camera_data.view,
+                                   camera_data.projection_view,
+                                   shadow_cascades);
+
+            void* data;
+            vmaMapMemory(m_v_vma_allocator, frame.camera_buffer.allocation, &data);
+            memcpy(data, &camera_data, sizeof(camera::GPU_camera));
+            vmaUnmapMemory(m_v_vma_allocator, frame.camera_buffer.allocation);
+            num_upload_bytes += sizeof(camera::GPU_camera);
+
+            // Upload shadow cascade cameras.
+            // @NOTE: Shadow shaders only use `projection_view`. Cascades use
+            //   the matrix they were last rendered with, not the latest one.
+            frame.shadow_technique = m_shadow_technique;
+            bool is_vsm_active{
+                frame.shadow_technique == Monolithic_renderer::Shadow_technique::VIRTUAL };
+            if (is_vsm_active)
+                skip_shadow_cascade_updates(frame);
+            else
+                schedule_shadow_cascade_updates(frame, shadow_cascades);
+            auto& scheduled_cascades{ m_shadow_cascade_schedule.cascades };
+            char* shadow_camera_data;
+            vmaMapMemory(m_v_vma_allocator,
+                         frame.shadow_camera_buffer.allocation,
+                         reinterpret_cast<void**>(&shadow_camera_data));
+            for (uint32_t i = 0; i < camera::k_num_shadow_cascades; i++)
+            {
+                camera::GPU_camera shadow_camera;
+                glm_mat4_identity(shadow_camera.view);
+                glm_mat4_copy(scheduled_cascades[i].projection_view, shadow_camera.projection_view);
+                memcpy(shadow_camera_data + m_v_geometry_graphics_pass.shadow_camera_stride * i,
+                       &shadow_camera,
+                       sizeof(camera::GPU_camera));
+            }
+            vmaUnmapMemory(m_v_vma_allocator, frame.shadow_camera_buffer.allocation);
+            num_upload_bytes += sizeof(camera::GPU_camera) * camera::k_num_shadow_cascades;
+
+            // Upload virtual shadow map params.
+            auto& vsm_cache{ m_vsm_cache_state };
+            camera::Virtual_shadow_map_view vsm_view;
+            if (is_vsm_active)
+            {
+                camera::fetch_virtual_shadow_map_view(vsm_view);
+
+                // @NOTE: Page tags only track the window position, so anything
+                //   that changes what a page's texels mean drops all cached pages.
+                //   Added, moved and removed casters only invalidate their own
+                //   pages (see the instance key table below).
+                bool invalidate_all{
+                    !vsm_cache.was_active ||
+                        vsm_cache.light_version != vsm_view.light_version ||
+                        vsm_cache.depth_center != vsm_view.depth_center };
+                vsm_cache.was_active = true;
+                vsm_cache.light_version = vsm_view.light_version;
+                vsm_cache.depth_center = vsm_view.depth_center;
+
+                gpu_geo_data::GPU_vsm_params vsm_params;
+                glm_mat4_identity(vsm_params.view);
+                glm_mat4_copy(vsm_view.projection_view, vsm_params.projection_view);
+                glm_mat4_inv(vsm_cache.prev_main_projection_view,
+                             vsm_params.prev_main_inv_projection_view);
+                vsm_params.page_origin[0] = vsm_view.page_origin[0];
+                vsm_params.page_origin[1] = vsm_view.page_origin[1];
+                vsm_params.frame_idx = ++vsm_cache.frame_idx;
+                vsm_params.flags =
+                    invalidate_all ? gpu_geo_data::k_vsm_params_flag_invalidate_all : 0;
+                vsm_params.page_table_address =
+                    m_v_virtual_shadow_map.page_table_buffer_address;
+                vsm_params.physical_pool_address =
+                    m_v_virtual_shadow_map.physical_pool_buffer_address;
+
+                vmaMapMemory(m_v_vma_allocator, frame.vsm_params_buffer.allocation, &data);
+                memcpy(data, &vsm_params, sizeof(gpu_geo_data::GPU_vsm_params));
+                vmaUnmapMemory(m_v_vma_allocator, frame.vsm_params_buffer.allocation);
+                num_upload_bytes += sizeof(gpu_geo_data::GPU_vsm_params);
+
+                // Upload instance key table.
+                // @NOTE: Keys not in the draw list get their previous bounds
+                //   invalidated, so removed casters don't leave shadows behind.
+                uint32_t* instance_key_entries;
+                vmaMapMemory(m_v_vma_allocator,
+                             frame.vsm_instance_key_buffer.allocation,
+                             reinterpret_cast<void**>(&instance_key_entries));
+                std::fill_n(instance_key_entries,
+                            geo_instance::k_max_instances,
+                            gpu_geo_data::k_vsm_instance_key_not_drawn);
+                auto& instance_keys{ frame.prepared_draw_list->instance_keys };
+                for (uint32_t dense_idx = 0; dense_idx < instance_keys.size(); dense_idx++)
+                    instance_key_entries[instance_keys[dense_idx]] = dense_idx;
+                for (auto key : vsm_cache.caster_layer_changes)
+                    instance_key_entries[key] |= gpu_geo_data::k_vsm_instance_key_flag_layer_changed;
+                vmaUnmapMemory(m_v_vma_allocator, frame.vsm_instance_key_buffer.allocation);
+                num_upload_bytes += sizeof(uint32_t) * geo_instance::k_max_instances;
+            }
+            else
+                vsm_cache.was_active = false;
+
+            // @NOTE: Page requests of the next frame come from this frame's depth.
+            glm_mat4_copy(camera_data.projection_view, vsm_cache.prev_main_projection_view);
+
+            // Upload culling views.
+            gpu_geo_data::GPU_culling_view* culling_views;
+            vmaMapMemory(m_v_vma_allocator,
+                         frame.culling_view_buffer.allocation,
+                         reinterpret_cast<void**>(&culling_views));
+            {
+                auto& main_view{ culling_views[gpu_geo_data::k_main_view_visibility_idx] };
+                gpu_geo_data::set_culling_view_frustum_planes(main_view,
+                                                              camera_data.projection_view,
+                                                              true);
+                main_view.render_layer_mask = m_main_view_render_layers;
+                main_view.required_instance_flags = 0;
+                main_view.excluded_instance_flags = 0;
+            }
+            for (uint32_t i = 0; i < camera::k_num_shadow_cascades; i++)
+            {
+                // @NOTE: Views of cascades that don't get rendered this frame
+                //   draw no layers, so they don't write any draw cmds.
+                auto& shadow_view{
+                    culling_views[gpu_geo_data::k_shadow_cascade_visibility_base_idx + i] };
+                gpu_geo_data::set_culling_view_frustum_planes(shadow_view,
+                                                              scheduled_cascades[i].projection_view,
+                                                              false);
+                shadow_view.render_layer_mask =
+                    ((frame.shadow_cascade_update_mask >> i) & 1) ?
+                        gpu_geo_data::k_shadow_view_render_layers :
+                        0;
+                shadow_view.required_instance_flags = gpu_geo_data::k_instance_flag_shadow_caster;
+                shadow_view.excluded_instance_flags = gpu_geo_data::k_instance_flag_static;
+
+                auto& static_shadow_view{
+                    culling_views[gpu_geo_data::k_shadow_cascade_static_visibility_base_idx + i] };
+                static_shadow_view = shadow_view;
+                static_shadow_view.render_layer_mask =
+                    ((frame.shadow_cascade_static_update_mask >> i) & 1) ?
+                        gpu_geo_data::k_shadow_view_render_layers :
+                        0;
+                static_shadow_view.required_instance_flags =
+                    gpu_geo_data::k_instance_flag_shadow_caster |
+                        gpu_geo_data::k_instance_flag_static;
+                static_shadow_view.excluded_instance_flags = 0;
+            }
+            {
+                auto& vsm_culling_view{
+                    culling_views[gpu_geo_data::k_virtual_shadow_map_visibility_idx] };
+                if (is_vsm_active)
+                {
+                    gpu_geo_data::set_culling_view_frustum_planes(vsm_culling_view,
+                                                                  vsm_view.projection_view,
+                                                                  false);
+                    vsm_culling_view.render_layer_mask = gpu_geo_data::k_shadow_view_render_layers;
+                }
+                else
+                {
+                    mat4 identity = GLM_MAT4_IDENTITY_INIT;
+                    gpu_geo_data::set_culling_view_frustum_planes(vsm_culling_view,
+                                                                  identity,
+                                                                  false);
+                    vsm_culling_view.render_layer_mask = 0;
+                }
+                vsm_culling_view.required_instance_flags =
+                    gpu_geo_data::k_instance_flag_shadow_caster;
+                vsm_culling_view.excluded_instance_flags = 0;
+            }
+            vmaUnmapMemory(m_v_vma_allocator, frame.culling_view_buffer.allocation);
+            num_upload_bytes += sizeof(gpu_geo_data::GPU_culling_view) * gpu_geo_data::k_num_culling_views;
+
+            // Update shadow stats (GPU page counts come from the readback).
+            {
+                std::lock_guard<std::mutex> lock{ m_shadow_stats_mutex };
+                m_shadow_stats.technique = frame.shadow_technique;
+                m_shadow_stats.num_cascades_rendered =
+                    std::popcount(frame.shadow_cascade_update_mask);
+                m_shadow_stats.num_static_caches_rendered =
+                    std::popcount(frame.shadow_cascade_static_update_mask);
+                m_shadow_stats.shadow_map_memory_bytes =
+                    is_vsm_active ?
+                        m_v_virtual_shadow_map.memory_bytes :
+                        k_shadow_cascade_images_memory_bytes;
+            }
+
+            frame.num_upload_bytes = num_upload_bytes;
+            frame.is_render_data_prepared = true;
+            break;
+        }
+
+        default:
+            assert(false);
+            return false;
+    }
 
     return true;
 }
@@ -1813,7 +4071,10 @@ void render__wait_until_current_frame_is_ready_to_render(VkDevice device,
     // Wait until GPU has finished rendering last frame.
     constexpr uint64_t k_10sec_as_ns{ 10000000000 };
 
-    err = vkWaitForFences(device, 1, &current_frame.render_fence, true, k_10sec_as_ns);
+    {
+        CPU_PROFILER_ZONE("Wait for Render Fence");
+        err = vkWaitForFences(device, 1, &current_frame.render_fence, true, k_10sec_as_ns);
+    }
     if (err)
     {
         std::cerr << "ERROR: wait for render fence timed out." << std::endl;
@@ -1828,12 +4089,15 @@ void render__wait_until_current_frame_is_ready_to_render(VkDevice device,
     }
 
     // Request image from swapchain.
-    err = vkAcquireNextImageKHR(device,
-                                swapchain,
-                                k_10sec_as_ns,
-                                current_frame.swapchain_semaphore,
-                                nullptr,
-                                &out_swapchain_image_idx);
+    {
+        CPU_PROFILER_ZONE("Acquire Swapchain Image");
+        err = vkAcquireNextImageKHR(device,
+                                    swapchain,
+                                    k_10sec_as_ns,
+                                    current_frame.swapchain_semaphore,
+                                    nullptr,
+                                    &out_swapchain_image_idx);
+    }
     if (err)
     {
         std::cerr << "ERROR: Acquire next swapchain image failed." << std::endl;
@@ -1841,7 +4105,7 @@ void render__wait_until_current_frame_is_ready_to_render(VkDevice device,
     }
 }
 
-void render__begin_command_buffer(VkCommandBuffer cmd)
+void render__begin_command_buffer(VkCommandBuffer cmd, bool one_time_submit)
 {
 
     VkResult err{ vkResetCommandBuffer(cmd, 0) };
@@ -1854,7 +4118,8 @@ void render__begin_command_buffer(VkCommandBuffer cmd)
     VkCommandBufferBeginInfo cmd_begin_info{
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
         .pNext = nullptr,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .flags = static_cast<VkCommandBufferUsageFlags>(
+            one_time_submit ? VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT : 0),
         .pInheritanceInfo = nullptr,
     };
 
@@ -1895,35 +4160,596 @@ void render__run_sample_pass(VkCommandBuffer cmd,
 {
     vkCmdBindPipeline(cmd,
                       VK_PIPELINE_BIND_POINT_COMPUTE,
-                      pipeline);
+                      pipeline);
+    vkCmdBindDescriptorSets(cmd,
+                            VK_PIPELINE_BIND_POINT_COMPUTE,
+                            pipeline_layout,
+                            0,
+                            1, &descriptor_set,
+                            0, nullptr);
+    vkCmdDispatch(cmd,
+                  std::ceil(draw_extent.width / 16.0f),
+                  std::ceil(draw_extent.height / 16.0f),
+                  1);
+}
+
+void render__draw_shadow_view_render_groups(VkCommandBuffer cmd,
+                                            const VkViewport& viewport,
+                                            const VkRect2D& scissor,
+                                            bool is_virtual_shadow_view,
+                                            VkDescriptorSet shadow_camera_descriptor_set,
+                                            uint32_t view_idx,
+                                            VkDeviceAddress instance_data_buffer_address,
+                                            VkDeviceAddress draw_record_buffer_address,
+                                            const geo_instance::Draw_list_snapshot& draw_list,
+                                            VkBuffer indirect_draw_buffer,
+                                            VkBuffer indirect_draw_count_buffer)
+{
+    gltf_loader::bind_combined_mesh(cmd);
+    material_bank::bind_geometry_pass_shared_state(cmd,
+                                                   (is_virtual_shadow_view ?
+                                                       material_bank::Camera_type::VIRTUAL_SHADOW_VIEW :
+                                                       material_bank::Camera_type::SHADOW_VIEW),
+                                                   viewport,
+                                                   scissor,
+                                                   shadow_camera_descriptor_set,
+                                                   instance_data_buffer_address,
+                                                   draw_record_buffer_address);
+    uint32_t prev_pipeline_cidx{ (uint32_t)-1 };
+
+    // @NOTE: Culled draw cmds and counts have a region per culling view,
+    //   each the size of the opaque pass.
+    auto& pass_range{ draw_list.get_render_pass(geo_instance::Geo_render_pass::OPAQUE) };
+    for (uint32_t group_idx = pass_range.base_render_group_idx;
+         group_idx < pass_range.base_render_group_idx + pass_range.num_render_groups;
+         group_idx++)
+    {
+        auto& render_group{ draw_list.render_groups[group_idx] };
+        auto& material_pipeline{ material_bank::get_pipeline(render_group.pipeline_idx) };
+        const material_bank::GPU_pipeline* pipeline{
+            is_virtual_shadow_view ?
+                material_pipeline.virtual_shadow_pipeline :
+                material_pipeline.shadow_pipeline };
+        if (pipeline == nullptr)
+        {
+            // Material doesn't cast shadows.
+            continue;
+        }
+
+        if (pipeline->calculated.pipeline_creation_idx != prev_pipeline_cidx)
+        {
+            pipeline->bind_pipeline(cmd);
+            prev_pipeline_cidx = pipeline->calculated.pipeline_creation_idx;
+        }
+
+        vkCmdDrawIndexedIndirectCount(cmd,
+                                      indirect_draw_buffer,
+                                      sizeof(VkDrawIndexedIndirectCommand) *
+                                          (view_idx * pass_range.num_primitives +
+                                              render_group.base_primitive_idx),
+                                      indirect_draw_count_buffer,
+                                      sizeof(uint32_t) *
+                                          (view_idx * pass_range.num_render_groups +
+                                              group_idx),
+                                      render_group.num_primitives,
+                                      sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
+
+void render__draw_shadow_cascade_view(VkCommandBuffer cmd,
+                                      VkImageView cascade_image_view,
+                                      VkExtent2D cascade_extent,
+                                      bool clear,
+                                      VkDescriptorSet cascade_camera_descriptor_set,
+                                      uint32_t view_idx,
+                                      VkDeviceAddress instance_data_buffer_address,
+                                      VkDeviceAddress draw_record_buffer_address,
+                                      const geo_instance::Draw_list_snapshot& draw_list,
+                                      VkBuffer indirect_draw_buffer,
+                                      VkBuffer indirect_draw_count_buffer)
+{
+    VkClearValue depth_clear{ .depthStencil{ .depth = 1.0f } };
+    VkRenderingAttachmentInfo depth_attachment{
+        vk_util::attachment_info(cascade_image_view,
+                                 (clear ? &depth_clear : nullptr),
+                                 VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL) };
+    VkRenderingInfo render_info{
+        vk_util::rendering_info(cascade_extent, nullptr, &depth_attachment) };
+
+    VkViewport viewport{
+        .x = 0,
+        .y = 0,
+        .width = static_cast<float_t>(cascade_extent.width),
+        .height = static_cast<float_t>(cascade_extent.height),
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f,
+    };
+
+    VkRect2D scissor{
+        .offset{ .x = 0, .y = 0 },
+        .extent{ cascade_extent },
+    };
+
+    vkCmdBeginRendering(cmd, &render_info);
+    render__draw_shadow_view_render_groups(cmd,
+                                           viewport,
+                                           scissor,
+                                           false,
+                                           cascade_camera_descriptor_set,
+                                           view_idx,
+                                           instance_data_buffer_address,
+                                           draw_record_buffer_address,
+                                           draw_list,
+                                           indirect_draw_buffer,
+                                           indirect_draw_count_buffer);
+    vkCmdEndRendering(cmd);
+}
+
+void render__run_sunlight_shadow_cascades_pass(
+    VkCommandBuffer cmd,
+    VkImage shadow_cascade_image,
+    const Shadow_cascade_image_views& cascade_image_views,
+    VkImage static_cache_image,
+    const Shadow_cascade_image_views& static_cache_image_views,
+    VkExtent2D cascade_extent,
+    bool& inout_has_contents,
+    uint32_t cascade_update_mask,
+    uint32_t cascade_static_update_mask,
+    const std::array<VkDescriptorSet, camera::k_num_shadow_cascades>& cascade_camera_descriptor_sets,
+    VkDeviceAddress instance_data_buffer_address,
+    VkDeviceAddress draw_record_buffer_address,
+    const geo_instance::Draw_list_snapshot& draw_list,
+    VkBuffer indirect_draw_buffer,
+    VkBuffer indirect_draw_count_buffer)
+{
+    if (!inout_has_contents)
+    {
+        // Clear everything once, since cascades and caches that aren't due
+        // keep their contents from then on.
+        VkClearDepthStencilValue depth_clear{ .depth = 1.0f };
+        VkImageSubresourceRange all_layers{
+            .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
+            .baseMipLevel = 0,
+            .levelCount = VK_REMAINING_MIP_LEVELS,
+            .baseArrayLayer = 0,
+            .layerCount = VK_REMAINING_ARRAY_LAYERS,
+        };
+        for (VkImage image : { static_cache_image, shadow_cascade_image })
+        {
+            vk_util::transition_image(cmd,
+                                      image,
+                                      VK_IMAGE_LAYOUT_UNDEFINED,
+                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                      VK_IMAGE_ASPECT_DEPTH_BIT);
+            vkCmdClearDepthStencilImage(cmd,
+                                        image,
+                                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                        &depth_clear,
+                                        1, &all_layers);
+        }
+        vk_util::transition_image(cmd,
+                                  static_cache_image,
+                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                  VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+                                  VK_IMAGE_ASPECT_DEPTH_BIT);
+        vk_util::transition_image(cmd,
+                                  shadow_cascade_image,
+                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                  VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
+                                  VK_IMAGE_ASPECT_DEPTH_BIT);
+        inout_has_contents = true;
+    }
+
+    // @NOTE: Cascades that aren't due keep last render's depth.
+    if (cascade_update_mask == 0)
+        return;
+
+    // Re-render invalidated static caster caches.
+    if (cascade_static_update_mask != 0)
+    {
+        for (uint32_t i = 0; i < camera::k_num_shadow_cascades; i++)
+        {
+            if (((cascade_static_update_mask >> i) & 1) == 0)
+                continue;
+
+            render__draw_shadow_cascade_view(
+                cmd,
+                static_cache_image_views[i],
+                cascade_extent,
+                true,
+                cascade_camera_descriptor_sets[i],
+                gpu_geo_data::k_shadow_cascade_static_visibility_base_idx + i,
+                instance_data_buffer_address,
+                draw_record_buffer_address,
+                draw_list,
+                indirect_draw_buffer,
+                indirect_draw_count_buffer);
+        }
+    }
+
+    // Start due cascades from their static caster cache.
+    vk_util::transition_image(cmd,
+                              static_cache_image,
+                              VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+                              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                              VK_IMAGE_ASPECT_DEPTH_BIT);
+    vk_util::transition_image(cmd,
+                              shadow_cascade_image,
+                              VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                              VK_IMAGE_ASPECT_DEPTH_BIT);
+
+    std::array<VkImageCopy, camera::k_num_shadow_cascades> copy_regions;
+    uint32_t num_copy_regions{ 0 };
+    for (uint32_t i = 0; i < camera::k_num_shadow_cascades; i++)
+    {
+        if (((cascade_update_mask >> i) & 1) == 0)
+            continue;
+
+        VkImageSubresourceLayers layer{
+            .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = i,
+            .layerCount = 1,
+        };
+        copy_regions[num_copy_regions++] = VkImageCopy{
+            .srcSubresource = layer,
+            .srcOffset = { 0, 0, 0 },
+            .dstSubresource = layer,
+            .dstOffset = { 0, 0, 0 },
+            .extent = { cascade_extent.width, cascade_extent.height, 1 },
+        };
+    }
+    vkCmdCopyImage(cmd,
+                   static_cache_image,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   shadow_cascade_image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   num_copy_regions,
+                   copy_regions.data());
+
+    vk_util::transition_image(cmd,
+                              static_cache_image,
+                              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                              VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+                              VK_IMAGE_ASPECT_DEPTH_BIT);
+    vk_util::transition_image(cmd,
+                              shadow_cascade_image,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                              VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+                              VK_IMAGE_ASPECT_DEPTH_BIT);
+
+    // Composite dynamic casters on top.
+    for (uint32_t i = 0; i < camera::k_num_shadow_cascades; i++)
+    {
+        if (((cascade_update_mask >> i) & 1) == 0)
+            continue;
+
+        render__draw_shadow_cascade_view(
+            cmd,
+            cascade_image_views[i],
+            cascade_extent,
+            false,
+            cascade_camera_descriptor_sets[i],
+            gpu_geo_data::k_shadow_cascade_visibility_base_idx + i,
+            instance_data_buffer_address,
+            draw_record_buffer_address,
+            draw_list,
+            indirect_draw_buffer,
+            indirect_draw_count_buffer);
+    }
+
+    // @NOTE: Nothing samples the cascades yet.
+    vk_util::transition_image(cmd,
+                              shadow_cascade_image,
+                              VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+                              VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL);
+}
+
+void render__global_memory_barrier(VkCommandBuffer cmd,
+                                   VkPipelineStageFlags src_stage_mask,
+                                   VkAccessFlags src_access_mask,
+                                   VkPipelineStageFlags dst_stage_mask,
+                                   VkAccessFlags dst_access_mask)
+{
+    VkMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = src_access_mask,
+        .dstAccessMask = dst_access_mask,
+    };
+    vkCmdPipelineBarrier(cmd,
+                         src_stage_mask,
+                         dst_stage_mask,
+                         0,
+                         1, &barrier,
+                         0, nullptr,
+                         0, nullptr);
+}
+
+void render__copy_draw_counts_for_readback(VkCommandBuffer cmd,
+                                           VkBuffer indirect_draw_count_buffer,
+                                           VkBuffer readback_buffer,
+                                           VkDeviceSize size)
+{
+    // @NOTE: Counts were written by culling, write draw cmds and the virtual
+    //   shadow map pass, all in earlier cmd buffers of this frame.
+    render__global_memory_barrier(cmd,
+                                  VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                  VK_ACCESS_MEMORY_WRITE_BIT,
+                                  VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                  VK_ACCESS_TRANSFER_READ_BIT);
+    VkBufferCopy counts_copy{
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = size,
+    };
+    vkCmdCopyBuffer(cmd, indirect_draw_count_buffer, readback_buffer, 1, &counts_copy);
+    render__global_memory_barrier(cmd,
+                                  VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                  VK_ACCESS_TRANSFER_WRITE_BIT,
+                                  VK_PIPELINE_STAGE_HOST_BIT,
+                                  VK_ACCESS_HOST_READ_BIT);
+}
+
+void render__run_virtual_shadow_map_pass(VkCommandBuffer cmd,
+                                         Virtual_shadow_map& vsm,
+                                         VkExtent2D main_depth_extent,
+                                         VkDescriptorSet bounding_spheres_descriptor_set,
+                                         VkDescriptorSet vsm_camera_descriptor_set,
+                                         VkDeviceAddress vsm_params_buffer_address,
+                                         VkDeviceAddress vsm_instance_key_buffer_address,
+                                         VkBuffer vsm_stats_readback_buffer,
+                                         VkDeviceAddress instance_data_buffer_address,
+                                         VkDeviceAddress draw_record_buffer_address,
+                                         const geo_instance::Draw_list_snapshot& draw_list,
+                                         VkBuffer indirect_draw_buffer,
+                                         VkBuffer indirect_draw_count_buffer,
+                                         VkDeviceAddress indirect_draw_count_buffer_address)
+{
+    auto& pass_range{ draw_list.get_render_pass(geo_instance::Geo_render_pass::OPAQUE) };
+
+    // Wait for last frame's page work, then reset this frame's requests,
+    // render page list and stats.
+    render__global_memory_barrier(cmd,
+                                  VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                  VK_ACCESS_MEMORY_WRITE_BIT,
+                                  VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                  VK_ACCESS_TRANSFER_WRITE_BIT);
+    gpu_geo_data::GPU_vsm_render_page_list_header render_page_list_header{
+        .dispatch_x = 0,
+        .dispatch_y = 1,
+        .dispatch_z = 1,
+        .pad0 = 0,
+    };
+    vkCmdUpdateBuffer(cmd,
+                      vsm.render_page_list_buffer.buffer,
+                      0,
+                      sizeof(gpu_geo_data::GPU_vsm_render_page_list_header),
+                      &render_page_list_header);
+    vkCmdFillBuffer(cmd, vsm.page_request_buffer.buffer, 0, VK_WHOLE_SIZE, 0);
+    vkCmdFillBuffer(cmd, vsm.stats_buffer.buffer, 0, VK_WHOLE_SIZE, 0);
+    render__global_memory_barrier(cmd,
+                                  VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                  VK_ACCESS_TRANSFER_WRITE_BIT,
+                                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                  VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    // Update pages.
+    vkCmdBindPipeline(cmd,
+                      VK_PIPELINE_BIND_POINT_COMPUTE,
+                      vsm.update_pages_pipeline);
+    VkDescriptorSet descriptor_sets[]{
+        vsm.main_depth_data.descriptor_set,
+        bounding_spheres_descriptor_set,
+    };
     vkCmdBindDescriptorSets(cmd,
                             VK_PIPELINE_BIND_POINT_COMPUTE,
-                            pipeline_layout,
+                            vsm.update_pages_pipeline_layout,
                             0,
-                            1, &descriptor_set,
+                            2, descriptor_sets,
                             0, nullptr);
-    vkCmdDispatch(cmd,
-                  std::ceil(draw_extent.width / 16.0f),
-                  std::ceil(draw_extent.height / 16.0f),
-                  1);
+
+    GPU_vsm_update_pages_push_constants pc{
+        .phase = 0,
+        .num_instance_keys = geo_instance::k_max_instances,
+        .num_render_groups = pass_range.num_render_groups,
+        .draw_command_counts_base_idx =
+            gpu_geo_data::k_virtual_shadow_map_visibility_idx * pass_range.num_render_groups,
+        .vsm_params_buffer_address = vsm_params_buffer_address,
+        .page_request_buffer_address = vsm.page_request_buffer_address,
+        .free_page_stack_buffer_address = vsm.free_page_stack_buffer_address,
+        .render_page_list_buffer_address = vsm.render_page_list_buffer_address,
+        .stats_buffer_address = vsm.stats_buffer_address,
+        .instance_buffer_address = instance_data_buffer_address,
+        .instance_key_buffer_address = vsm_instance_key_buffer_address,
+        .prev_bounding_spheres_buffer_address = vsm.prev_bounding_spheres_buffer_address,
+        .draw_command_counts_buffer_address = indirect_draw_count_buffer_address,
+    };
+
+    auto run_phase = [&](GPU_vsm_update_pages_phase phase, uint32_t num_invocations) {
+        pc.phase = static_cast<uint32_t>(phase);
+        vkCmdPushConstants(cmd,
+                           vsm.update_pages_pipeline_layout,
+                           VK_SHADER_STAGE_COMPUTE_BIT,
+                           0,
+                           sizeof(GPU_vsm_update_pages_push_constants),
+                           &pc);
+        vkCmdDispatch(cmd, std::ceil(num_invocations / 128.0f), 1, 1);
+        render__global_memory_barrier(cmd,
+                                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                      VK_ACCESS_SHADER_WRITE_BIT,
+                                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                                          VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                                      VK_ACCESS_SHADER_READ_BIT |
+                                          VK_ACCESS_SHADER_WRITE_BIT |
+                                          VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    };
+
+    if (!vsm.has_contents)
+    {
+        run_phase(GPU_vsm_update_pages_phase::INIT,
+                  std::max({ camera::k_vsm_num_virtual_pages,
+                             camera::k_vsm_num_physical_pages,
+                             geo_instance::k_max_instances }));
+        vsm.has_contents = true;
+    }
+    run_phase(GPU_vsm_update_pages_phase::MARK,
+              main_depth_extent.width * main_depth_extent.height);
+    run_phase(GPU_vsm_update_pages_phase::INVALIDATE, geo_instance::k_max_instances);
+    run_phase(GPU_vsm_update_pages_phase::RELEASE, camera::k_vsm_num_virtual_pages);
+    run_phase(GPU_vsm_update_pages_phase::ALLOCATE, camera::k_vsm_num_virtual_pages);
+    run_phase(GPU_vsm_update_pages_phase::FINALIZE,
+              std::max(pass_range.num_render_groups, 1u));
+
+    // Clear the pages that get rendered.
+    pc.phase = static_cast<uint32_t>(GPU_vsm_update_pages_phase::CLEAR);
+    vkCmdPushConstants(cmd,
+                       vsm.update_pages_pipeline_layout,
+                       VK_SHADER_STAGE_COMPUTE_BIT,
+                       0,
+                       sizeof(GPU_vsm_update_pages_push_constants),
+                       &pc);
+    vkCmdDispatchIndirect(cmd, vsm.render_page_list_buffer.buffer, 0);
+    render__global_memory_barrier(cmd,
+                                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                  VK_ACCESS_SHADER_WRITE_BIT,
+                                  VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                                      VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                  VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                                      VK_ACCESS_SHADER_READ_BIT |
+                                      VK_ACCESS_SHADER_WRITE_BIT);
+
+    // Render shadow casters into the listed pages.
+    // @NOTE: No attachments. The fragment shader depth tests into the
+    //   physical pool itself, so the render area is the whole virtual map.
+    VkExtent2D virtual_extent{
+        .width = camera::k_vsm_virtual_resolution,
+        .height = camera::k_vsm_virtual_resolution,
+    };
+    VkRenderingInfo render_info{
+        vk_util::rendering_info(virtual_extent, nullptr, nullptr) };
+
+    VkViewport viewport{
+        .x = 0,
+        .y = 0,
+        .width = static_cast<float_t>(virtual_extent.width),
+        .height = static_cast<float_t>(virtual_extent.height),
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f,
+    };
+
+    VkRect2D scissor{
+        .offset{ .x = 0, .y = 0 },
+        .extent{ virtual_extent },
+    };
+
+    vkCmdBeginRendering(cmd, &render_info);
+    render__draw_shadow_view_render_groups(cmd,
+                                           viewport,
+                                           scissor,
+                                           true,
+                                           vsm_camera_descriptor_set,
+                                           gpu_geo_data::k_virtual_shadow_map_visibility_idx,
+                                           instance_data_buffer_address,
+                                           draw_record_buffer_address,
+                                           draw_list,
+                                           indirect_draw_buffer,
+                                           indirect_draw_count_buffer);
+    vkCmdEndRendering(cmd);
+
+    // Copy stats for reading back once this frame's fence signals.
+    render__global_memory_barrier(cmd,
+                                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                  VK_ACCESS_SHADER_WRITE_BIT,
+                                  VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                  VK_ACCESS_TRANSFER_READ_BIT);
+    VkBufferCopy stats_copy{
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = sizeof(gpu_geo_data::GPU_vsm_stats),
+    };
+    vkCmdCopyBuffer(cmd, vsm.stats_buffer.buffer, vsm_stats_readback_buffer, 1, &stats_copy);
+    render__global_memory_barrier(cmd,
+                                  VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                  VK_ACCESS_TRANSFER_WRITE_BIT,
+                                  VK_PIPELINE_STAGE_HOST_BIT,
+                                  VK_ACCESS_HOST_READ_BIT);
 }
 
-void render__run_sunlight_shadow_cascades_pass()
+void render__prepare_visibility_for_writing(VkCommandBuffer cmd,
+                                            VkBuffer visibility_buffer,
+                                            VkDeviceSize visibility_offset,
+                                            VkDeviceSize visibility_size,
+                                            bool clear,
+                                            uint32_t graphics_queue_family_idx)
 {
+    // Wait for passes of earlier frames that read last frame's visibility
+    // from this slot before overwriting it.
+    VkBufferMemoryBarrier prev_readers_barrier{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        .srcQueueFamilyIndex = graphics_queue_family_idx,
+        .dstQueueFamilyIndex = graphics_queue_family_idx,
+        .buffer = visibility_buffer,
+        .offset = visibility_offset,
+        .size = visibility_size,
+    };
+    vkCmdPipelineBarrier(cmd,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0,
+                         0, nullptr,
+                         1, &prev_readers_barrier,
+                         0, nullptr);
+
+    if (clear)
+    {
+        vkCmdFillBuffer(cmd, visibility_buffer, visibility_offset, visibility_size, 0);
+
+        VkBufferMemoryBarrier clear_barrier{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+            .srcQueueFamilyIndex = graphics_queue_family_idx,
+            .dstQueueFamilyIndex = graphics_queue_family_idx,
+            .buffer = visibility_buffer,
+            .offset = visibility_offset,
+            .size = visibility_size,
+        };
+        vkCmdPipelineBarrier(cmd,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0,
+                             0, nullptr,
+                             1, &clear_barrier,
+                             0, nullptr);
+    }
 }
 
 void render__run_camera_view_geometry_culling(VkCommandBuffer cmd,
                                               VkDescriptorSet camera_desc_set,
                                               VkDescriptorSet bounding_sphere_desc_set,
                                               const GPU_geometry_culling_push_constants& params,
+                                              uint32_t num_views,
                                               VkPipeline geom_culling_pipeline,
                                               VkPipelineLayout geom_culling_pipeline_layout,
-                                              VkBuffer visible_result_data_buffer,
-                                              VkDeviceSize visible_result_data_buffer_size,
+                                              VkBuffer visibility_buffer,
+                                              VkDeviceSize visibility_offset,
+                                              VkDeviceSize visibility_size,
                                               uint32_t graphics_queue_family_idx)
 {
     assert(params.num_instances > 0);
 
+    // @NOTE: Every visibility word gets fully written, so no clear needed.
+    render__prepare_visibility_for_writing(cmd,
+                                           visibility_buffer,
+                                           visibility_offset,
+                                           visibility_size,
+                                           false,
+                                           graphics_queue_family_idx);
+
     // @NOTE: Visibility is calculated at a per-instance level here.
     vkCmdBindPipeline(cmd,
                       VK_PIPELINE_BIND_POINT_COMPUTE,
@@ -1948,7 +4774,7 @@ void render__run_camera_view_geometry_culling(VkCommandBuffer cmd,
                        &params);
     vkCmdDispatch(cmd,
                   std::ceil(params.num_instances / 128.0f),
-                  1,
+                  num_views,
                   1);
 
     // Memory barrier for `geom_write_draw_cmds.comp`.
@@ -1958,9 +4784,9 @@ void render__run_camera_view_geometry_culling(VkCommandBuffer cmd,
         .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
         .srcQueueFamilyIndex = graphics_queue_family_idx,
         .dstQueueFamilyIndex = graphics_queue_family_idx,
-        .buffer = visible_result_data_buffer,
-        .offset = 0,
-        .size = visible_result_data_buffer_size,
+        .buffer = visibility_buffer,
+        .offset = visibility_offset,
+        .size = visibility_size,
     };
     vkCmdPipelineBarrier(cmd,
                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
@@ -1971,20 +4797,11 @@ void render__run_camera_view_geometry_culling(VkCommandBuffer cmd,
                          0, nullptr);
 }
 
-void render__run_write_camera_view_geometry_draw_cmds(
-    VkCommandBuffer cmd,
-    const GPU_write_draw_cmds_push_constants& params,
-    uint32_t num_primitive_render_groups,
-    VkPipeline geom_write_draw_cmds_pipeline,
-    VkPipelineLayout geom_write_draw_cmds_pipeline_layout,
-    VkBuffer indirect_draw_cmds_buffer,
-    VkBuffer indirect_draw_cmd_counts_buffer,
-    uint32_t graphics_queue_family_idx)
+void render__reset_geometry_draw_cmd_counts(VkCommandBuffer cmd,
+                                            VkBuffer indirect_draw_cmd_counts_buffer,
+                                            uint32_t num_primitive_render_groups,
+                                            uint32_t graphics_queue_family_idx)
 {
-    // @TODO: Figure out if you wanna move the write draw cmds step to
-    //        its own thing so that the resulting buffer can be reused
-    //        for other rendering steps.
-
     assert(num_primitive_render_groups > 0);
 
     // Reset count buffer to 0.
@@ -1994,21 +4811,34 @@ void render__run_write_camera_view_geometry_draw_cmds(
                     sizeof(uint32_t) * num_primitive_render_groups,
                     0);
 
-    // Write draw commands, pulling from instance visibility buffer.
-    vkCmdBindPipeline(cmd,
-                      VK_PIPELINE_BIND_POINT_COMPUTE,
-                      geom_write_draw_cmds_pipeline);
-    vkCmdPushConstants(cmd,
-                       geom_write_draw_cmds_pipeline_layout,
-                       VK_SHADER_STAGE_COMPUTE_BIT,
-                       0,
-                       sizeof(GPU_write_draw_cmds_push_constants),
-                       &params);
-    vkCmdDispatch(cmd,
-                  std::ceil(params.num_primitives / 128.0f),
-                  1,
-                  1);
+    // Memory barrier so that the write draw cmds dispatch sees the reset counts.
+    VkBufferMemoryBarrier counts_buffer_barrier{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        .srcQueueFamilyIndex = graphics_queue_family_idx,
+        .dstQueueFamilyIndex = graphics_queue_family_idx,
+        .buffer = indirect_draw_cmd_counts_buffer,
+        .offset = 0,
+        .size = sizeof(uint32_t) * num_primitive_render_groups,
+    };
+    vkCmdPipelineBarrier(cmd,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0,
+                         0, nullptr,
+                         1, &counts_buffer_barrier,
+                         0, nullptr);
+}
 
+void render__barrier_written_geometry_draw_cmds(VkCommandBuffer cmd,
+                                                uint32_t num_primitives,
+                                                uint32_t num_primitive_render_groups,
+                                                VkBuffer indirect_draw_cmds_buffer,
+                                                VkBuffer indirect_draw_cmd_counts_buffer,
+                                                VkBuffer draw_records_buffer,
+                                                uint32_t graphics_queue_family_idx)
+{
     // Memory buffer barrier to make sure indirect commands are written before vertex shaders run.
     VkBufferMemoryBarrier buffer_barriers[]{
         {
@@ -2019,7 +4849,7 @@ void render__run_write_camera_view_geometry_draw_cmds(
             .dstQueueFamilyIndex = graphics_queue_family_idx,
             .buffer = indirect_draw_cmds_buffer,
             .offset = 0,
-            .size = sizeof(VkDrawIndexedIndirectCommand) * params.num_primitives,
+            .size = sizeof(VkDrawIndexedIndirectCommand) * num_primitives,
         },
         {
             .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
@@ -2032,31 +4862,166 @@ void render__run_write_camera_view_geometry_draw_cmds(
             .size = sizeof(uint32_t) * num_primitive_render_groups,
             // @NOTE: ^^ Instead of instances or primitives, these are primitive render
             //   groups, grouped by shader idx.
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+            .srcQueueFamilyIndex = graphics_queue_family_idx,
+            .dstQueueFamilyIndex = graphics_queue_family_idx,
+            .buffer = draw_records_buffer,
+            .offset = 0,
+            .size = sizeof(gpu_geo_data::GPU_draw_record) * num_primitives,
         }
     };
     vkCmdPipelineBarrier(cmd,
                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                             VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
                          0,
                          0, nullptr,
-                         2, buffer_barriers,
+                         3, buffer_barriers,
                          0, nullptr);
 }
 
+void render__run_write_camera_view_geometry_draw_cmds(
+    VkCommandBuffer cmd,
+    const GPU_write_draw_cmds_push_constants& params,
+    uint32_t num_views,
+    VkPipeline geom_write_draw_cmds_pipeline,
+    VkPipelineLayout geom_write_draw_cmds_pipeline_layout,
+    VkBuffer indirect_draw_cmds_buffer,
+    VkBuffer indirect_draw_cmd_counts_buffer,
+    VkBuffer draw_records_buffer,
+    uint32_t graphics_queue_family_idx)
+{
+    // @TODO: Figure out if you wanna move the write draw cmds step to
+    //        its own thing so that the resulting buffer can be reused
+    //        for other rendering steps.
+
+    render__reset_geometry_draw_cmd_counts(cmd,
+                                           indirect_draw_cmd_counts_buffer,
+                                           params.num_render_groups * num_views,
+                                           graphics_queue_family_idx);
+
+    // Write draw commands, pulling from instance visibility buffer.
+    vkCmdBindPipeline(cmd,
+                      VK_PIPELINE_BIND_POINT_COMPUTE,
+                      geom_write_draw_cmds_pipeline);
+    vkCmdPushConstants(cmd,
+                       geom_write_draw_cmds_pipeline_layout,
+                       VK_SHADER_STAGE_COMPUTE_BIT,
+                       0,
+                       sizeof(GPU_write_draw_cmds_push_constants),
+                       &params);
+    vkCmdDispatch(cmd,
+                  std::ceil(params.num_primitives / 128.0f),
+                  num_views,
+                  1);
+
+    render__barrier_written_geometry_draw_cmds(cmd,
+                                               params.num_primitives * num_views,
+                                               params.num_render_groups * num_views,
+                                               indirect_draw_cmds_buffer,
+                                               indirect_draw_cmd_counts_buffer,
+                                               draw_records_buffer,
+                                               graphics_queue_family_idx);
+}
+
+void render__run_camera_view_geometry_cull_and_write_draw_cmds(
+    VkCommandBuffer cmd,
+    VkDescriptorSet camera_desc_set,
+    VkDescriptorSet bounding_sphere_desc_set,
+    const GPU_cull_and_write_draw_cmds_push_constants& params,
+    VkPipeline geom_cull_and_write_draw_cmds_pipeline,
+    VkPipelineLayout geom_cull_and_write_draw_cmds_pipeline_layout,
+    VkBuffer indirect_draw_cmds_buffer,
+    VkBuffer indirect_draw_cmd_counts_buffer,
+    VkBuffer draw_records_buffer,
+    VkBuffer visibility_buffer,
+    VkDeviceSize visibility_offset,
+    VkDeviceSize visibility_size,
+    uint32_t graphics_queue_family_idx)
+{
+    assert(params.num_primitives > 0);
+
+    // @NOTE: Visibility bits get OR'd in per primitive, so clear first.
+    render__prepare_visibility_for_writing(cmd,
+                                           visibility_buffer,
+                                           visibility_offset,
+                                           visibility_size,
+                                           true,
+                                           graphics_queue_family_idx);
+    render__reset_geometry_draw_cmd_counts(cmd,
+                                           indirect_draw_cmd_counts_buffer,
+                                           params.num_render_groups * params.num_views,
+                                           graphics_queue_family_idx);
+
+    // @NOTE: Visibility is calculated at a per-primitive level here, so
+    //   there's no visible result buffer to wait on.
+    vkCmdBindPipeline(cmd,
+                      VK_PIPELINE_BIND_POINT_COMPUTE,
+                      geom_cull_and_write_draw_cmds_pipeline);
+    VkDescriptorSet desc_sets[]{
+        camera_desc_set,
+        bounding_sphere_desc_set,
+    };
+    vkCmdBindDescriptorSets(cmd,
+                            VK_PIPELINE_BIND_POINT_COMPUTE,
+                            geom_cull_and_write_draw_cmds_pipeline_layout,
+                            0,
+                            2, desc_sets,
+                            0, nullptr);
+    vkCmdPushConstants(cmd,
+                       geom_cull_and_write_draw_cmds_pipeline_layout,
+                       VK_SHADER_STAGE_COMPUTE_BIT,
+                       0,
+                       sizeof(GPU_cull_and_write_draw_cmds_push_constants),
+                       &params);
+    vkCmdDispatch(cmd,
+                  std::ceil(params.num_primitives / 128.0f),
+                  1,
+                  1);
+
+    render__barrier_written_geometry_draw_cmds(cmd,
+                                               params.num_primitives * params.num_views,
+                                               params.num_render_groups * params.num_views,
+                                               indirect_draw_cmds_buffer,
+                                               indirect_draw_cmd_counts_buffer,
+                                               draw_records_buffer,
+                                               graphics_queue_family_idx);
+}
+
 void render__run_opaque_geometry_pass(VkCommandBuffer cmd,
                                       VkImageView image_view,
+                                      VkImage depth_image,
+                                      VkImageView depth_image_view,
                                       VkExtent2D draw_extent,
                                       VkDescriptorSet main_view_camera_descriptor_set,
                                       VkDeviceAddress instance_data_buffer_address,
+                                      VkDeviceAddress draw_record_buffer_address,
+                                      const geo_instance::Draw_list_snapshot& draw_list,
                                       VkBuffer indirect_draw_buffer,
-                                      VkBuffer indirect_draw_count_buffer)
+                                      VkBuffer indirect_draw_count_buffer,
+                                      const vk_profiler::GPU_profiler& profiler,
+                                      uint32_t frame_idx)
 {
+    vk_util::transition_image(cmd,
+                              depth_image,
+                              VK_IMAGE_LAYOUT_UNDEFINED,
+                              VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+
     VkRenderingAttachmentInfo color_attachment{
         vk_util::attachment_info(image_view,
                                  nullptr,
                                  VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) };
+    VkClearValue depth_clear{ .depthStencil{ .depth = 1.0f } };
+    VkRenderingAttachmentInfo depth_attachment{
+        vk_util::attachment_info(depth_image_view,
+                                 &depth_clear,
+                                 VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL) };
     VkRenderingInfo render_info{
-        vk_util::rendering_info(draw_extent, &color_attachment, nullptr) };
+        vk_util::rendering_info(draw_extent, &color_attachment, &depth_attachment) };
     
     VkViewport viewport{
         .x = 0,
@@ -2072,14 +5037,19 @@ void render__run_opaque_geometry_pass(VkCommandBuffer cmd,
         .extent{ draw_extent },
     };
 
-    auto grouped_primitives{
-        geo_instance::get_pipeline_grouped_primitives(geo_instance::Geo_render_pass::OPAQUE)
-    };
-
     vkCmdBeginRendering(cmd, &render_info);
 
     // Set initial values.
+    // @NOTE: Z prepass and material pipelines all share the main view
+    //   layout, so this is bound once for both passes.
     gltf_loader::bind_combined_mesh(cmd);
+    material_bank::bind_geometry_pass_shared_state(cmd,
+                                                   material_bank::Camera_type::MAIN_VIEW,
+                                                   viewport,
+                                                   scissor,
+                                                   main_view_camera_descriptor_set,
+                                                   instance_data_buffer_address,
+                                                   draw_record_buffer_address);
     uint32_t prev_pipeline_cidx{ (uint32_t)-1 };
 
     // Draw all opaque primitives.
@@ -2088,15 +5058,22 @@ void render__run_opaque_geometry_pass(VkCommandBuffer cmd,
         DRAW_MATERIAL_BASED_PASS,
         NUM_PASSES
     };
+    auto& pass_range{ draw_list.get_render_pass(geo_instance::Geo_render_pass::OPAQUE) };
+    constexpr vk_profiler::GPU_zone k_pass_zones[NUM_PASSES]{
+        vk_profiler::GPU_zone::Z_PREPASS,
+        vk_profiler::GPU_zone::MATERIAL_PASS,
+    };
     for (uint8_t pass = 0; pass < NUM_PASSES; pass++)
     {
+        vk_profiler::cmd_begin_zone(cmd, profiler, frame_idx, k_pass_zones[pass]);
+
         // Z prepass and then Material-based draw.
-        VkDeviceSize drawn_primitive_count{ 0 };
-        VkDeviceSize render_primitive_group_idx{ 0 };
-        for (auto& it : grouped_primitives)
+        for (uint32_t group_idx = pass_range.base_render_group_idx;
+             group_idx < pass_range.base_render_group_idx + pass_range.num_render_groups;
+             group_idx++)
         {
-            auto pipeline_idx{ it.first };
-            auto& primitive_ptr_list{ it.second };
+            auto& render_group{ draw_list.render_groups[group_idx] };
+            auto pipeline_idx{ render_group.pipeline_idx };
 
             const material_bank::GPU_pipeline* pipeline{ nullptr };
             switch (pass)
@@ -2120,33 +5097,37 @@ void render__run_opaque_geometry_pass(VkCommandBuffer cmd,
             // Skip drawing if no pipeline was selected
             // (could be ignored z prepass texture or something).
             assert(pipeline != nullptr);
+            assert(pipeline->camera_type == material_bank::Camera_type::MAIN_VIEW);
 
             // Bind material pipeline.
             if (pipeline->calculated.pipeline_creation_idx != prev_pipeline_cidx)
             {
-                pipeline->bind_pipeline(cmd,
-                                        viewport,
-                                        scissor,
-                                        &main_view_camera_descriptor_set,
-                                        nullptr,
-                                        instance_data_buffer_address);
+                pipeline->bind_pipeline(cmd);
                 prev_pipeline_cidx = pipeline->calculated.pipeline_creation_idx;
             }
 
             // 描け～！！
+            // @NOTE: Offsets are in bytes.
             vkCmdDrawIndexedIndirectCount(cmd,
                                           indirect_draw_buffer,
-                                          drawn_primitive_count,
+                                          sizeof(VkDrawIndexedIndirectCommand) *
+                                              render_group.base_primitive_idx,
                                           indirect_draw_count_buffer,
-                                          render_primitive_group_idx,
-                                          static_cast<uint32_t>(primitive_ptr_list.size()),
+                                          sizeof(uint32_t) * group_idx,
+                                          render_group.num_primitives,
                                           sizeof(VkDrawIndexedIndirectCommand));
-            drawn_primitive_count += primitive_ptr_list.size();
-            render_primitive_group_idx++;
         }
+
+        vk_profiler::cmd_end_zone(cmd, profiler, frame_idx, k_pass_zones[pass]);
     }
 
     vkCmdEndRendering(cmd);
+
+    // Next frame's virtual shadow map page marking reads this.
+    vk_util::transition_image(cmd,
+                              depth_image,
+                              VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+                              VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL);
 }
 
 void render__run_sample_geometry_pass(VkCommandBuffer cmd,
@@ -2239,12 +5220,17 @@ void render__end_command_buffer(VkCommandBuffer cmd)
     }
 }
 
-void render__submit_commands_to_queue(VkCommandBuffer cmd,
+void render__submit_commands_to_queue(const VkCommandBuffer (&cmds)[k_num_render_pass_cmds],
                                       VkQueue graphics_queue,
+                                      std::mutex& graphics_queue_mutex,
                                       Frame_data& current_frame)
 {
     // Prep submission to the queue.
-    VkCommandBufferSubmitInfo cmd_info{ vk_util::command_buffer_submit_info(cmd) };
+    // @NOTE: Pass cmds execute in `Render_pass_cmd` order, so barriers
+    //   recorded in one pass cmd cover work recorded in the later ones.
+    VkCommandBufferSubmitInfo cmd_infos[k_num_render_pass_cmds];
+    for (size_t i = 0; i < k_num_render_pass_cmds; i++)
+        cmd_infos[i] = vk_util::command_buffer_submit_info(cmds[i]);
     VkSemaphoreSubmitInfo wait_info{
         vk_util::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
                                        current_frame.swapchain_semaphore)
@@ -2253,9 +5239,11 @@ void render__submit_commands_to_queue(VkCommandBuffer cmd,
         vk_util::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
                                        current_frame.render_semaphore)
     };
-    VkSubmitInfo2 submit_info{ vk_util::submit_info(&cmd_info, &signal_info, &wait_info) };
+    VkSubmitInfo2 submit_info{ vk_util::submit_info(cmd_infos, &signal_info, &wait_info) };
+    submit_info.commandBufferInfoCount = static_cast<uint32_t>(k_num_render_pass_cmds);
 
     // Submit command buffer to queue and execute it.
+    std::lock_guard<std::mutex> lock{ graphics_queue_mutex };
     VkResult err{
         vkQueueSubmit2(graphics_queue, 1, &submit_info, current_frame.render_fence)
     };
@@ -2268,6 +5256,7 @@ void render__submit_commands_to_queue(VkCommandBuffer cmd,
 
 void render__present_image(VkSwapchainKHR swapchain,
                            VkQueue graphics_queue,
+                           std::mutex& graphics_queue_mutex,
                            const uint32_t& swapchain_image_idx,
                            const Frame_data& current_frame,
                            std::atomic_bool& out_is_swapchain_out_of_date)
@@ -2282,8 +5271,11 @@ void render__present_image(VkSwapchainKHR swapchain,
         .pSwapchains = &swapchain,
         .pImageIndices = &swapchain_image_idx,
     };
-    VkResult err{
-        vkQueuePresentKHR(graphics_queue, &present_info) };
+    VkResult err;
+    {
+        std::lock_guard<std::mutex> lock{ graphics_queue_mutex };
+        err = vkQueuePresentKHR(graphics_queue, &present_info);
+    }
     if (err)
     {
         // Check if swapchain is out of date when presenting, due to window
@@ -2302,53 +5294,189 @@ void render__present_image(VkSwapchainKHR swapchain,
     }
 }
 
-bool Monolithic_renderer::Impl::render()
+void Monolithic_renderer::Impl::schedule_shadow_cascade_updates(
+    Frame_data& frame,
+    const std::vector<mat4s>& latest_shadow_cascades)
+{
+    assert(latest_shadow_cascades.size() == camera::k_num_shadow_cascades);
+    auto& schedule{ m_shadow_cascade_schedule };
+
+    // Invalidate static caches that static caster changes overlap.
+    // @NOTE: Tested against the matrix each cache was rendered with.
+    schedule.static_caster_changes.clear();
+    geo_instance::take_static_shadow_caster_changes(schedule.static_caster_changes);
+    for (auto& cascade : schedule.cascades)
+    {
+        if (!cascade.is_static_cache_valid)
+            continue;
+
+        gpu_geo_data::GPU_culling_view cascade_view;
+        gpu_geo_data::set_culling_view_frustum_planes(cascade_view,
+                                                      cascade.projection_view,
+                                                      false);
+        for (auto& changed_sphere : schedule.static_caster_changes)
+            if (gpu_geo_data::is_sphere_in_culling_view(cascade_view, changed_sphere))
+            {
+                cascade.is_static_cache_valid = false;
+                break;
+            }
+    }
+
+    // Cascade k is due every 2^k frames.
+    frame.shadow_cascade_update_mask = 0;
+    frame.shadow_cascade_static_update_mask = 0;
+    for (uint32_t i = 0; i < camera::k_num_shadow_cascades; i++)
+    {
+        auto& cascade{ schedule.cascades[i] };
+        bool is_due{
+            !cascade.has_rendered ||
+                (m_update_data_frame_number & ((size_t(1) << i) - 1)) == 0 };
+        if (!is_due)
+            continue;
+
+        // @NOTE: Cascade matrices are snapped to texels in x/y and to depth
+        //   steps along the sun direction (see
+        //   `camera::internal__calc_shadow_cascade_matrices()`), so they stay
+        //   bit for bit the same until the camera crosses a snap step (or the
+        //   sun moves).
+        if (std::memcmp(cascade.projection_view,
+                        latest_shadow_cascades[i].raw,
+                        sizeof(mat4)) != 0)
+        {
+            std::memcpy(cascade.projection_view,
+                        latest_shadow_cascades[i].raw,
+                        sizeof(mat4));
+            cascade.is_static_cache_valid = false;
+        }
+
+        frame.shadow_cascade_update_mask |= (1u << i);
+        if (!cascade.is_static_cache_valid)
+        {
+            frame.shadow_cascade_static_update_mask |= (1u << i);
+            cascade.is_static_cache_valid = true;
+        }
+        cascade.has_rendered = true;
+    }
+}
+
+void Monolithic_renderer::Impl::skip_shadow_cascade_updates(Frame_data& frame)
+{
+    auto& schedule{ m_shadow_cascade_schedule };
+
+    // Drop static caster changes (the caches get rebuilt once the cascades
+    // are back on).
+    schedule.static_caster_changes.clear();
+    geo_instance::take_static_shadow_caster_changes(schedule.static_caster_changes);
+    for (auto& cascade : schedule.cascades)
+    {
+        cascade.has_rendered = false;
+        cascade.is_static_cache_valid = false;
+    }
+
+    frame.shadow_cascade_update_mask = 0;
+    frame.shadow_cascade_static_update_mask = 0;
+}
+
+bool Monolithic_renderer::Impl::begin_render()
 {
+    m_is_render_frame_active = false;
+
     // Recreate swapchain.
     if (m_request_swapchain_creation)
     {
         std::cerr << "TODO: This would be where you recreate the swapchain. But that functionality isn't created yet. So heh haha" << std::endl;
         // m_is_swapchain_out_of_date = false;  // @TODO: uncomment when finish the swapchain recreation.
+        invalidate_cached_render_pass_cmds();
     }
 
     // Do not render unless window is shown.
     if (m_is_swapchain_out_of_date)
         return true;
 
-    // Ready command buffer and swapchain for this frame.
+    // Ready command buffers and swapchain for this frame.
     auto& current_frame{ get_current_frame() };
-    uint32_t swapchain_image_idx;
     render__wait_until_current_frame_is_ready_to_render(m_v_device,
                                                         m_v_swapchain.swapchain,
                                                         current_frame,
-                                                        swapchain_image_idx);
-    auto& v_current_swapchain_image{ m_v_swapchain.images[swapchain_image_idx] };
-    auto& v_current_swapchain_image_view{ m_v_swapchain.image_views[swapchain_image_idx] };
+                                                        m_current_swapchain_image_idx);
+    record_frame_latency_measurement(current_frame, glfwGetTime());
+
+    // Read back this frame's GPU timings from `num_frames_in_flight` frames ago.
+    vk_profiler::collect_frame_results(m_gpu_profiler, m_v_device, get_current_frame_idx());
+    sample_perf_hud_frame(current_frame);
+    vk_memory::tick_memory_budget(m_memory_budget,
+                                  m_v_vma_allocator,
+                                  static_cast<uint32_t>(m_frame_number));
+
+    // Point this frame's descriptor sets at any reallocated buffers.
+    bool is_any_set_rewritten{
+        vk_buffer_registry::flush_frame_descriptor_sets(m_buffer_registry,
+                                                        m_v_device,
+                                                        m_v_vma_allocator,
+                                                        get_current_frame_idx(),
+                                                        m_frame_number) };
+    if (is_any_set_rewritten)
+        invalidate_cached_render_pass_cmds();
 
-    // Upload camera information.
-    {
-        mat4 projection;
-        std::vector<mat4s> shadow_cascades;
-        camera::GPU_camera camera_data;
-        camera::fetch_matrices(projection,
-                               camera_data.view,
-                               camera_data.projection_view,
-                               shadow_cascades);
+    // Render Imgui.
+    // @NOTE: Builds the imgui draw data that the post process pass records.
+    imgui_system::render_imgui();
+
+    m_is_render_frame_active = true;
+    return true;
+}
+
+bool Monolithic_renderer::Impl::is_render_pass_cmd_cacheable(Render_pass_cmd pass)
+{
+    // @NOTE: Postprocess and present changes swapchain image and imgui
+    //   draw data every frame, and sunlight shadow cascades change which
+    //   cascades get drawn every frame, so they're always re-recorded.
+    return (pass != Render_pass_cmd::POSTPROCESS_AND_PRESENT &&
+            pass != Render_pass_cmd::SUNLIGHT_SHADOW_CASCADES);
+}
 
-        void* data;
-        vmaMapMemory(m_v_vma_allocator, current_frame.camera_buffer.allocation, &data);
-        memcpy(data, &camera_data, sizeof(camera::GPU_camera));
-        vmaUnmapMemory(m_v_vma_allocator, current_frame.camera_buffer.allocation);
+bool Monolithic_renderer::Impl::record_render_pass_cmds(Render_pass_cmd pass)
+{
+    auto& current_frame{ get_current_frame() };
+    const auto& current_geo_frame{ current_frame.geo_per_frame_buffer };
+    auto& current_per_frame_data{ get_current_geom_per_frame_data() };
+    const auto& draw_list{ *current_frame.prepared_draw_list };
+    auto& opaque_pass_range{ draw_list.get_render_pass(geo_instance::Geo_render_pass::OPAQUE) };
+    uint32_t unique_instances_count{ draw_list.num_instances };
+
+    // @NOTE: Cached opaque geometry cmds copy the draw counts too, so this
+    //   gets set before checking the cache.
+    if (pass == Render_pass_cmd::OPAQUE_GEOMETRY)
+        current_frame.is_draw_counts_readback_pending = (unique_instances_count > 0);
+
+    // Reuse cached cmd buffer if nothing it was recorded with changed.
+    bool is_cacheable{ is_render_pass_cmd_cacheable(pass) };
+    auto& recorded_inputs{ current_frame.recorded_pass_cmd_inputs[static_cast<size_t>(pass)] };
+    uint64_t invalidation_version{ m_render_pass_cmds_invalidation_version };
+    if (is_cacheable &&
+        recorded_inputs.invalidation_version == invalidation_version &&
+        recorded_inputs.buffers_version == current_geo_frame.buffers_version &&
+        recorded_inputs.draw_list_version == draw_list.version &&
+        recorded_inputs.is_geometry_culling_fused == current_frame.is_geometry_culling_fused)
+    {
+        return true;
     }
 
-    // Render Imgui.
-    imgui_system::render_imgui();
+    VkCommandBuffer cmd{ current_frame.pass_command_buffers[static_cast<size_t>(pass)] };
+    render__begin_command_buffer(cmd, !is_cacheable);
 
-    // Write commands.
-    VkCommandBuffer cmd{ current_frame.main_command_buffer };
-    render__begin_command_buffer(cmd);
+    // @NOTE: Cached cmd buffers keep writing into their own frame's queries,
+    //   which get host reset before every reuse.
+    uint32_t frame_idx{ get_current_frame_idx() };
+    using vk_profiler::GPU_zone;
+    using vk_profiler::GPU_stats_pass;
+
+    switch (pass)
+    {
+    case Render_pass_cmd::GEOMETRY_CULLING:
     {
         // General rendering.
+        vk_profiler::cmd_begin_zone(cmd, m_gpu_profiler, frame_idx, GPU_zone::CLEAR_BACKGROUND);
         vk_util::transition_image(cmd,
                                   m_v_HDR_draw_image.image.image,
                                   VK_IMAGE_LAYOUT_UNDEFINED,
@@ -2365,116 +5493,300 @@ bool Monolithic_renderer::Impl::render()
                                   m_v_HDR_draw_image.image.image,
                                   VK_IMAGE_LAYOUT_GENERAL,
                                   VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        vk_profiler::cmd_end_zone(cmd, m_gpu_profiler, frame_idx, GPU_zone::CLEAR_BACKGROUND);
 
-        uint32_t unique_instances_count{ geo_instance::get_unique_instances_count() };
         if (unique_instances_count > 0)
         {
-            render__run_sunlight_shadow_cascades_pass();
+            vk_profiler::cmd_begin_pipeline_stats(cmd, m_gpu_profiler, frame_idx, GPU_stats_pass::GEOMETRY_CULLING);
+            constexpr bool k_culling_enabled{ true };
 
-            auto& current_per_frame_data{ get_current_geom_per_frame_data() };
+            // @NOTE: Opaque is bucketed first, so its primitives and
+            //   render groups start at 0 in the draw list.
+            assert(opaque_pass_range.base_primitive_idx == 0);
+            assert(opaque_pass_range.base_render_group_idx == 0);
 
-            constexpr bool k_culling_enabled{ true };
+            // Every view's visibility bits in this frame's visibility history slot.
+            VkDeviceSize view_visibility_size{
+                sizeof(uint32_t) * current_geo_frame.num_visibility_words_per_view };
 
-            const auto& current_geo_frame{ current_frame.geo_per_frame_buffer };
-
-            GPU_geometry_culling_push_constants geom_culling_pc{
-                .z_near = 0.0f,  // @TODO: Calculate frustum!
-                .z_far = 0.0f,
-                .frustum_x_x = 0.0f,
-                .frustum_x_z = 0.0f,
-                .frustum_y_y = 0.0f,
-                .frustum_y_z = 0.0f,
-                .culling_enabled = (k_culling_enabled ? 1 : 0),
-                .num_instances = unique_instances_count,
-                .instance_buffer_address = current_geo_frame.instance_data_buffer_address,
-                .visible_result_buffer_address = current_geo_frame.visible_result_buffer_address,
-            };
+            if (current_frame.is_geometry_culling_fused)
+            {
+                GPU_cull_and_write_draw_cmds_push_constants cull_and_write_draw_cmds_pc{
+                    .culling_enabled = (k_culling_enabled ? 1u : 0u),
+                    .num_views = gpu_geo_data::k_num_culling_views,
+                    .num_primitives = opaque_pass_range.num_primitives,
+                    .num_render_groups = opaque_pass_range.num_render_groups,
+                    .num_visibility_words_per_view = current_geo_frame.num_visibility_words_per_view,
+                    .pad0 = 0,
+                    .instance_buffer_address = current_geo_frame.instance_data_buffer_address,
+                    .culling_view_buffer_address = current_frame.culling_view_buffer_address,
+                    .visibility_buffer_address = current_geo_frame.visibility_slot_address,
+                    .render_group_base_indices_buffer_address = current_geo_frame.render_group_base_index_buffer_address,
+                    .draw_commands_input_buffer_address = current_geo_frame.indirect_command_buffer_address,
+                    .draw_commands_output_buffer_address = current_geo_frame.culled_indirect_command_buffer_address,
+                    .draw_command_counts_buffer_address = current_geo_frame.indirect_counts_buffer_address,
+                    .material_param_indices_buffer_address = current_geo_frame.material_param_index_per_primitive_buffer_address,
+                    .draw_records_output_buffer_address = current_geo_frame.culled_draw_record_buffer_address,
+                };
+
+                // @NOTE: this culls and writes draw cmds for just opaque geo pass,
+                //   for the main view and all shadow cascades at once.
+                vk_profiler::cmd_begin_zone(cmd, m_gpu_profiler, frame_idx, GPU_zone::GEOMETRY_CULLING);
+                render__run_camera_view_geometry_cull_and_write_draw_cmds(
+                    cmd,
+                    current_per_frame_data.camera_data.descriptor_set,
+                    current_per_frame_data.bounding_spheres_data.descriptor_set,
+                    cull_and_write_draw_cmds_pc,
+                    m_v_geometry_graphics_pass.cull_and_write_draw_cmds_pipeline,
+                    m_v_geometry_graphics_pass.cull_and_write_draw_cmds_pipeline_layout,
+                    current_geo_frame.culled_indirect_command_buffer.buffer,
+                    current_geo_frame.indirect_counts_buffer.buffer,
+                    current_geo_frame.culled_draw_record_buffer.buffer,
+                    current_geo_frame.visibility_history_buffer,
+                    current_geo_frame.visibility_slot_offset,
+                    view_visibility_size * gpu_geo_data::k_num_culling_views,
+                    m_v_graphics_queue_family_idx);
+                vk_profiler::cmd_end_zone(cmd, m_gpu_profiler, frame_idx, GPU_zone::GEOMETRY_CULLING);
+            }
+            else
+            {
+                GPU_geometry_culling_push_constants geom_culling_pc{
+                    .culling_enabled = (k_culling_enabled ? 1u : 0u),
+                    .num_instances = unique_instances_count,
+                    .num_visibility_words_per_view = current_geo_frame.num_visibility_words_per_view,
+                    .pad0 = 0,
+                    .instance_buffer_address = current_geo_frame.instance_data_buffer_address,
+                    .culling_view_buffer_address = current_frame.culling_view_buffer_address,
+                    .visibility_buffer_address = current_geo_frame.visibility_slot_address,
+                };
+
+                // @NOTE: Culls the instances for the main view and all shadow
+                //   cascades at once, like the fused pass.
+                vk_profiler::cmd_begin_zone(cmd, m_gpu_profiler, frame_idx, GPU_zone::GEOMETRY_CULLING);
+                render__run_camera_view_geometry_culling(
+                    cmd,
+                    current_per_frame_data.camera_data.descriptor_set,
+                    current_per_frame_data.bounding_spheres_data.descriptor_set,
+                    geom_culling_pc,
+                    gpu_geo_data::k_num_culling_views,
+                    m_v_geometry_graphics_pass.culling_pipeline,
+                    m_v_geometry_graphics_pass.culling_pipeline_layout,
+                    current_geo_frame.visibility_history_buffer,
+                    current_geo_frame.visibility_slot_offset,
+                    view_visibility_size * gpu_geo_data::k_num_culling_views,
+                    m_v_graphics_queue_family_idx);
+                vk_profiler::cmd_end_zone(cmd, m_gpu_profiler, frame_idx, GPU_zone::GEOMETRY_CULLING);
+
+                GPU_write_draw_cmds_push_constants write_draw_cmds_pc{
+                    .num_primitives = opaque_pass_range.num_primitives,
+                    .num_render_groups = opaque_pass_range.num_render_groups,
+                    .num_visibility_words_per_view = current_geo_frame.num_visibility_words_per_view,
+                    .pad0 = 0,
+                    .visibility_buffer_address = current_geo_frame.visibility_slot_address,
+                    .base_indices_buffer_address = current_geo_frame.primitive_group_base_index_buffer_address,
+                    .count_buffer_indices_buffer_address = current_geo_frame.count_buffer_index_buffer_address,
+                    .draw_commands_input_buffer_address = current_geo_frame.indirect_command_buffer_address,
+                    .draw_commands_output_buffer_address = current_geo_frame.culled_indirect_command_buffer_address,
+                    .draw_command_counts_buffer_address = current_geo_frame.indirect_counts_buffer_address,
+                    .material_param_indices_buffer_address = current_geo_frame.material_param_index_per_primitive_buffer_address,
+                    .draw_records_output_buffer_address = current_geo_frame.culled_draw_record_buffer_address,
+                };
+
+                // @NOTE: this writes draw cmds for just opaque geo pass,
+                //   for the main view and all shadow cascades at once.
+                vk_profiler::cmd_begin_zone(cmd, m_gpu_profiler, frame_idx, GPU_zone::WRITE_DRAW_CMDS);
+                render__run_write_camera_view_geometry_draw_cmds(cmd,
+                                                                 write_draw_cmds_pc,
+                                                                 gpu_geo_data::k_num_culling_views,
+                                                                 m_v_geometry_graphics_pass.write_draw_cmds_pipeline,
+                                                                 m_v_geometry_graphics_pass.write_draw_cmds_pipeline_layout,
+                                                                 current_geo_frame.culled_indirect_command_buffer.buffer,
+                                                                 current_geo_frame.indirect_counts_buffer.buffer,
+                                                                 current_geo_frame.culled_draw_record_buffer.buffer,
+                                                                 m_v_graphics_queue_family_idx);
+                vk_profiler::cmd_end_zone(cmd, m_gpu_profiler, frame_idx, GPU_zone::WRITE_DRAW_CMDS);
+            }
+            vk_profiler::cmd_end_pipeline_stats(cmd, m_gpu_profiler, frame_idx, GPU_stats_pass::GEOMETRY_CULLING);
+        }
+        break;
+    }
 
-            render__run_camera_view_geometry_culling(
+    case Render_pass_cmd::SUNLIGHT_SHADOW_CASCADES:
+        // @NOTE: Recorded even w/o instances, since the cascade schedule
+        //   (and cached static casters) expects every due cascade to be drawn.
+        vk_profiler::cmd_begin_zone(cmd, m_gpu_profiler, frame_idx, GPU_zone::SHADOW_MAPS);
+        vk_profiler::cmd_begin_pipeline_stats(cmd, m_gpu_profiler, frame_idx, GPU_stats_pass::SHADOW_MAPS);
+        if (current_frame.shadow_technique == Shadow_technique::VIRTUAL)
+        {
+            current_frame.is_vsm_stats_readback_pending = false;
+            if (unique_instances_count > 0)
+            {
+                render__run_virtual_shadow_map_pass(
+                    cmd,
+                    m_v_virtual_shadow_map,
+                    m_v_main_depth_image.extent,
+                    current_per_frame_data.bounding_spheres_data.descriptor_set,
+                    current_per_frame_data.virtual_shadow_camera_data.descriptor_set,
+                    current_frame.vsm_params_buffer_address,
+                    current_frame.vsm_instance_key_buffer_address,
+                    current_frame.vsm_stats_readback_buffer.buffer,
+                    current_geo_frame.instance_data_buffer_address,
+                    current_geo_frame.culled_draw_record_buffer_address,
+                    draw_list,
+                    current_geo_frame.culled_indirect_command_buffer.buffer,
+                    current_geo_frame.indirect_counts_buffer.buffer,
+                    current_geo_frame.indirect_counts_buffer_address);
+                current_frame.is_vsm_stats_readback_pending = true;
+            }
+        }
+        else
+        {
+            render__run_sunlight_shadow_cascades_pass(
                 cmd,
-                current_per_frame_data.camera_data.descriptor_set,
-                m_v_geometry_graphics_pass.bounding_spheres_data.descriptor_set,
-                geom_culling_pc,
-                m_v_geometry_graphics_pass.culling_pipeline,
-                m_v_geometry_graphics_pass.culling_pipeline_layout,
-                current_geo_frame.visible_result_buffer.buffer,
-                sizeof(uint32_t) * current_geo_frame.num_visible_result_elems,
-                m_v_graphics_queue_family_idx);
-
-            GPU_write_draw_cmds_push_constants write_draw_cmds_pc{
-                .num_primitives =
-                    geo_instance::get_number_primitives(geo_instance::Geo_render_pass::OPAQUE),
-                .visible_result_buffer_address = current_geo_frame.visible_result_buffer_address,
-                .base_indices_buffer_address = current_geo_frame.primitive_group_base_index_buffer_address,
-                .count_buffer_indices_buffer_address = current_geo_frame.count_buffer_index_buffer_address,
-                .draw_commands_input_buffer_address = current_geo_frame.indirect_command_buffer_address,
-                .draw_commands_output_buffer_address = current_geo_frame.culled_indirect_command_buffer_address,
-                .draw_command_counts_buffer_address = current_geo_frame.indirect_counts_buffer_address,
-            };
+                m_v_shadow_cascade_image.image.image,
+                m_v_shadow_cascade_image.cascade_image_views,
+                m_v_shadow_cascade_image.static_cache_image.image,
+                m_v_shadow_cascade_image.static_cache_image_views,
+                m_v_shadow_cascade_image.extent,
+                m_v_shadow_cascade_image.has_contents,
+                current_frame.shadow_cascade_update_mask,
+                current_frame.shadow_cascade_static_update_mask,
+                current_per_frame_data.shadow_cascade_camera_descriptor_sets,
+                current_geo_frame.instance_data_buffer_address,
+                current_geo_frame.culled_draw_record_buffer_address,
+                draw_list,
+                current_geo_frame.culled_indirect_command_buffer.buffer,
+                current_geo_frame.indirect_counts_buffer.buffer);
+        }
+        vk_profiler::cmd_end_pipeline_stats(cmd, m_gpu_profiler, frame_idx, GPU_stats_pass::SHADOW_MAPS);
+        vk_profiler::cmd_end_zone(cmd, m_gpu_profiler, frame_idx, GPU_zone::SHADOW_MAPS);
+        break;
 
-            // @NOTE: this writes draw cmds for just opaque geo pass.
-            render__run_write_camera_view_geometry_draw_cmds(cmd,
-                                                             write_draw_cmds_pc,
-                                                             geo_instance::get_num_primitive_render_groups(
-                                                                 geo_instance::Geo_render_pass::OPAQUE),
-                                                             m_v_geometry_graphics_pass.write_draw_cmds_pipeline,
-                                                             m_v_geometry_graphics_pass.write_draw_cmds_pipeline_layout,
-                                                             current_geo_frame.culled_indirect_command_buffer.buffer,
-                                                             current_geo_frame.indirect_counts_buffer.buffer,
-                                                             m_v_graphics_queue_family_idx);
+    case Render_pass_cmd::OPAQUE_GEOMETRY:
+        if (unique_instances_count > 0)
+        {
+            vk_profiler::cmd_begin_pipeline_stats(cmd, m_gpu_profiler, frame_idx, GPU_stats_pass::OPAQUE_GEOMETRY);
             render__run_opaque_geometry_pass(cmd,
                                              m_v_HDR_draw_image.image.image_view,
+                                             m_v_main_depth_image.image.image,
+                                             m_v_main_depth_image.image.image_view,
                                              m_v_HDR_draw_image.extent,
                                              current_per_frame_data.camera_data.descriptor_set,
                                              current_geo_frame.instance_data_buffer_address,
+                                             current_geo_frame.culled_draw_record_buffer_address,
+                                             draw_list,
                                              current_geo_frame.culled_indirect_command_buffer.buffer,
-                                             current_geo_frame.indirect_counts_buffer.buffer);
+                                             current_geo_frame.indirect_counts_buffer.buffer,
+                                             m_gpu_profiler,
+                                             frame_idx);
+            vk_profiler::cmd_end_pipeline_stats(cmd, m_gpu_profiler, frame_idx, GPU_stats_pass::OPAQUE_GEOMETRY);
+
+            // Every view's draw counts are final by now.
+            render__copy_draw_counts_for_readback(
+                cmd,
+                current_geo_frame.indirect_counts_buffer.buffer,
+                current_geo_frame.indirect_counts_readback_buffer.buffer,
+                sizeof(uint32_t) * opaque_pass_range.num_render_groups *
+                    gpu_geo_data::k_num_culling_views);
 
             // render__run_sample_geometry_pass(cmd,
             //                                  m_v_HDR_draw_image.image.image_view,
             //                                  m_v_HDR_draw_image.extent,
             //                                  m_v_sample_graphics_pass.pipeline);
         }
+        break;
+
+    case Render_pass_cmd::POSTPROCESS_AND_PRESENT:
+    {
+        auto& v_current_swapchain_image{ m_v_swapchain.images[m_current_swapchain_image_idx] };
+        auto& v_current_swapchain_image_view{ m_v_swapchain.image_views[m_current_swapchain_image_idx] };
 
         // Swapchain.
+        vk_profiler::cmd_begin_zone(cmd, m_gpu_profiler, frame_idx, GPU_zone::BLIT_TO_SWAPCHAIN);
         render__blit_HDR_image_to_swapchain(cmd,
                                             m_v_HDR_draw_image.image.image,
                                             m_v_HDR_draw_image.extent,
                                             v_current_swapchain_image,
                                             m_v_swapchain.extent);
+        vk_profiler::cmd_end_zone(cmd, m_gpu_profiler, frame_idx, GPU_zone::BLIT_TO_SWAPCHAIN);
         // @TODO: In the future if imgui is disabled only transition image once.
         //   @BLOCKING: I want there to be an image transitioner that keeps previous
         //     state so that only necessary transitions will happen, and you only have
         //     to do a TO field for what you want to transition.
+        vk_profiler::cmd_begin_zone(cmd, m_gpu_profiler, frame_idx, GPU_zone::IMGUI);
         render__prep_swapchain_image_for_draw_imgui(cmd,
                                                     v_current_swapchain_image);
         imgui_system::render_imgui_onto_swapchain(cmd,
                                                   m_v_swapchain.extent,
                                                   v_current_swapchain_image_view);
+        vk_profiler::cmd_end_zone(cmd, m_gpu_profiler, frame_idx, GPU_zone::IMGUI);
         render__prep_swapchain_image_for_presentation(cmd,
                                                       v_current_swapchain_image,
                                                       VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        break;
+    }
+
+    default:
+        assert(false);
+        break;
     }
+
     render__end_command_buffer(cmd);
 
-    // Finish frame.
-    render__submit_commands_to_queue(cmd,
-                                     m_v_graphics_queue,
-                                     current_frame);
-    render__present_image(m_v_swapchain.swapchain,
-                          m_v_graphics_queue,
-                          swapchain_image_idx,
-                          current_frame,
-                          m_is_swapchain_out_of_date);
+    if (is_cacheable)
+    {
+        recorded_inputs.invalidation_version = invalidation_version;
+        recorded_inputs.buffers_version = current_geo_frame.buffers_version;
+        recorded_inputs.draw_list_version = draw_list.version;
+        recorded_inputs.is_geometry_culling_fused = current_frame.is_geometry_culling_fused;
+    }
+
+    return true;
+}
+
+bool Monolithic_renderer::Impl::submit_render()
+{
+    if (m_is_render_frame_active)
+    {
+        auto& current_frame{ get_current_frame() };
+
+        // Finish frame.
+        render__submit_commands_to_queue(current_frame.pass_command_buffers,
+                                         m_v_graphics_queue,
+                                         m_v_graphics_queue_mutex,
+                                         current_frame);
+        vk_profiler::mark_frame_submitted(m_gpu_profiler, get_current_frame_idx(), m_frame_number);
 
-    // End frame.
-    m_frame_number++;
+        // Track CPU work time for just-in-time pacing and mark frame for latency measurement.
+        if (current_frame.input_sample_time >= 0.0)
+        {
+            constexpr double_t k_avg_weight{ 0.1 };
+            double_t cpu_work_time{ glfwGetTime() - current_frame.input_sample_time };
+            m_avg_cpu_frame_work_time =
+                m_avg_cpu_frame_work_time * (1.0 - k_avg_weight) + cpu_work_time * k_avg_weight;
+            current_frame.pending_latency_sample_time = current_frame.input_sample_time;
+            current_frame.input_sample_time = -1.0;
+        }
+        render__present_image(m_v_swapchain.swapchain,
+                              m_v_graphics_queue,
+                              m_v_graphics_queue_mutex,
+                              m_current_swapchain_image_idx,
+                              current_frame,
+                              m_is_swapchain_out_of_date);
+
+        // End frame.
+        current_frame.is_render_data_prepared = false;
+        m_frame_number++;
+        m_is_render_frame_active = false;
+        CPU_PROFILER_FRAME_MARK();
+    }
 
     // Check if window should close.
+    // @NOTE: Teardown happens once any pipelined update data has finished.
     if (is_requesting_close() || m_shutdown_flag)
     {
         //glfwHideWindow(m_window);
-        m_stage = Stage::TEARDOWN;
+        m_is_close_requested = true;
     }
 
     return true;
@@ -15,24 +15,128 @@
 #include <cinttypes>
 #include <cstring>
 #include <iostream>
+#include <mutex>
+#include <vector>
+#include "camera.h"
+#include "geo_instance.h"
+#include "imgui_system.h"
 #include "renderer_win64_vk_buffer.h"
+#include "renderer_win64_vk_defragmenter.h"
 #include "renderer_win64_vk_descriptor_layout_builder.h"
+#include "renderer_win64_vk_gpu_profiler.h"
 #include "renderer_win64_vk_image.h"
 #include "renderer_win64_vk_immediate_submit.h"
+#include "renderer_win64_vk_memory_budget.h"
 
 namespace vk_util { struct Immediate_submit_support; }
 
 
+// Per-pass cmd buffers, recorded in parallel and submitted in this order.
+enum class Render_pass_cmd : uint8_t
+{
+    GEOMETRY_CULLING = 0,
+    SUNLIGHT_SHADOW_CASCADES,
+    OPAQUE_GEOMETRY,
+    POSTPROCESS_AND_PRESENT,
+    NUM_RENDER_PASS_CMDS
+};
+constexpr size_t k_num_render_pass_cmds{
+    static_cast<size_t>(Render_pass_cmd::NUM_RENDER_PASS_CMDS) };
+
+// Phases of preparing render data, each fetched as one batch of jobs.
+// @NOTE: The chunk phases run `m_num_update_data_chunks` jobs in parallel,
+//   each writing only to its own slice of the output.
+// @NOTE: The sort phases repeat once per radix sort pass.
+enum class Update_data_phase : uint8_t
+{
+    BEGIN_REBUCKET = 0,
+    BUCKET_CHUNKS,
+    SORT_HISTOGRAM_CHUNKS,
+    SORT_SCATTER_CHUNKS,
+    BEGIN_UPLOAD,
+    UPLOAD_CHUNKS,
+    FINISH,
+    NUM_UPDATE_DATA_PHASES
+};
+constexpr size_t k_num_update_data_phases{
+    static_cast<size_t>(Update_data_phase::NUM_UPDATE_DATA_PHASES) };
+constexpr size_t k_max_update_data_chunks{ 16 };
+
+constexpr bool is_update_data_chunk_phase(Update_data_phase phase)
+{
+    return (phase == Update_data_phase::BUCKET_CHUNKS ||
+            phase == Update_data_phase::SORT_HISTOGRAM_CHUNKS ||
+            phase == Update_data_phase::SORT_SCATTER_CHUNKS ||
+            phase == Update_data_phase::UPLOAD_CHUNKS);
+}
+
 struct Frame_data
 {
-    VkCommandPool command_pool;
-    VkCommandBuffer main_command_buffer;
+    // @NOTE: Each pass cmd buffer has its own pool so that the
+    //   record jobs can run on separate threads at the same time.
+    VkCommandPool command_pools[k_num_render_pass_cmds];
+    VkCommandBuffer pass_command_buffers[k_num_render_pass_cmds];
     VkSemaphore swapchain_semaphore;
     VkSemaphore render_semaphore;
     VkFence render_fence;
 
     vk_buffer::Allocated_buffer camera_buffer;
+    vk_buffer::Allocated_buffer shadow_camera_buffer;  // One `GPU_camera` per cascade.
+    vk_buffer::Allocated_buffer culling_view_buffer;   // `k_num_culling_views` views.
+    VkDeviceAddress culling_view_buffer_address;
     vk_buffer::GPU_geo_per_frame_buffer geo_per_frame_buffer;
+
+    // Virtual shadow map.
+    vk_buffer::Allocated_buffer vsm_params_buffer;  // `GPU_vsm_params` (also its camera).
+    VkDeviceAddress vsm_params_buffer_address;
+    vk_buffer::Allocated_buffer vsm_instance_key_buffer;  // `k_max_instances` entries (`k_vsm_instance_key_*`).
+    VkDeviceAddress vsm_instance_key_buffer_address;
+    vk_buffer::Allocated_buffer vsm_stats_readback_buffer;  // `GPU_vsm_stats` of this frame.
+    bool is_vsm_stats_readback_pending{ false };
+
+    // Bytes written into this frame's host visible buffers while preparing it.
+    size_t num_upload_bytes{ 0 };
+
+    // Draw counts of every culling view, copied into
+    // `geo_per_frame_buffer.indirect_counts_readback_buffer`.
+    bool is_draw_counts_readback_pending{ false };
+
+    // Latency measurement.
+    // @NOTE: Negative means that no measurement is pending for this frame.
+    double_t input_sample_time{ -1.0 };
+    double_t pending_latency_sample_time{ -1.0 };
+
+    // Render data prepared by the update data job.
+    // @NOTE: Everything that recording the pass cmds needs from the
+    //   instance/camera systems is captured here, so that preparing the next
+    //   frame can run at the same time as recording this one.
+    std::atomic_bool is_render_data_prepared{ false };
+    geo_instance::Draw_list_snapshot_ref_t prepared_draw_list;
+
+    // Shadow cascades (bits) rendered this frame, and the ones of those
+    // whose static caster cache gets re-rendered first.
+    uint32_t shadow_cascade_update_mask{ 0 };
+    uint32_t shadow_cascade_static_update_mask{ 0 };
+
+    // Shadow technique this frame got prepared for.
+    Monolithic_renderer::Shadow_technique shadow_technique{
+        Monolithic_renderer::Shadow_technique::CASCADED };
+
+    // Whether this frame got prepared for the fused geometry culling pass
+    // (the separate passes need the primitive group indices uploaded).
+    bool is_geometry_culling_fused{ true };
+
+    // Inputs that the cached pass cmd buffers were recorded with.
+    // @NOTE: Geometry pass cmds read their actual draw counts from the indirect
+    //   count buffers, so they only get re-recorded when these inputs change.
+    struct Recorded_pass_cmd_inputs
+    {
+        uint64_t invalidation_version{ (uint64_t)-1 };
+        uint64_t buffers_version{ 0 };
+        uint64_t draw_list_version{ 0 };
+        bool is_geometry_culling_fused{ true };
+    };
+    Recorded_pass_cmd_inputs recorded_pass_cmd_inputs[k_num_render_pass_cmds];
 };
 
 struct Descriptor_set_w_layout
@@ -41,7 +145,9 @@ struct Descriptor_set_w_layout
     VkDescriptorSetLayout descriptor_layout;
 };
 
-constexpr uint32_t k_frame_overlap{ 2 };
+// @NOTE: Per-frame resources are allocated for the max, but only the
+//   first `m_num_frames_in_flight` are created and cycled through.
+constexpr uint32_t k_max_frame_overlap{ Monolithic_renderer::k_max_frames_in_flight };
 
 extern std::atomic<Monolithic_renderer*> s_mr_singleton_ptr;
 
@@ -54,6 +160,8 @@ public:
          int32_t content_height,
          int32_t fallback_content_width,
          int32_t fallback_content_height,
+         uint32_t num_frames_in_flight,
+         Frame_pacing_mode frame_pacing_mode,
          Job_source& source);
 
     enum class Stage : uint32_t
@@ -63,8 +171,13 @@ public:
         LOAD_ASSETS,
         WAIT_FOR_GLOBAL_SETUP_COMPLETION,
         CALCULATE_DELTA_TIME,
+        POLL_WINDOW_EVENTS,
         UPDATE_DATA,
-        RENDER,
+        PREPARE_RENDER_DATA,
+        BEGIN_RENDER,
+        RECORD_RENDER_PASSES,
+        SUBMIT_RENDER,
+        FINISH_PIPELINED_UPDATE_DATA,
         TEARDOWN,
         END_OF_LIFE,
     };
@@ -74,6 +187,7 @@ public:
 
     void notify_uniconification()
     {
+        invalidate_cached_render_pass_cmds();
         m_request_swapchain_creation = true;  // @TODO: USE THIS FLAG AND RECREATE THAT SWAPCHAINNNNNNNNNNNNNNNN
     }
 
@@ -92,15 +206,120 @@ public:
         return m_finished_shutdown;
     }
 
+    // Frame pacing.
+    void set_frame_limiter_fps(float_t target_fps)
+    {
+        m_frame_limiter_fps = target_fps;
+    }
+
+    Frame_latency_stats get_frame_latency_stats();
+
+    // Shadows.
+    void set_shadow_technique(Shadow_technique technique)
+    {
+        m_shadow_technique = technique;
+        invalidate_cached_render_pass_cmds();
+    }
+
+    Shadow_stats get_shadow_stats();
+
+    // Render stats.
+    Render_stats get_render_stats();
+
+    // Profiling.
+    std::vector<GPU_pass_timing> get_gpu_pass_timings();
+    std::vector<CPU_zone_timing> get_cpu_zone_timings();
+    bool export_profiler_trace(const std::string& file_path)
+    {
+        return vk_profiler::export_chrome_trace(m_gpu_profiler, file_path);
+    }
+
+    // GPU memory budget.
+    GPU_memory_stats get_gpu_memory_stats();
+    void set_memory_pressure_thresholds(float_t warning_fraction, float_t critical_fraction)
+    {
+        vk_memory::set_pressure_thresholds(m_memory_budget, warning_fraction, critical_fraction);
+    }
+    memory_pressure_callback_key_t register_memory_pressure_callback(Memory_pressure_callback_t&& callback);
+    void unregister_memory_pressure_callback(memory_pressure_callback_key_t key)
+    {
+        vk_memory::remove_pressure_callback(m_memory_budget, key);
+    }
+
+    // GPU memory defragmentation.
+    void request_gpu_memory_defragmentation()
+    {
+        vk_defrag::request_defragmentation(m_defragmenter);
+    }
+    GPU_defrag_stats get_gpu_defrag_stats();
+    void set_gpu_memory_churn_workload(bool enabled)
+    {
+        m_is_gpu_memory_churn_enabled = enabled;
+    }
+
+    // Update data.
+    void set_num_update_data_chunks(uint32_t num_chunks)
+    {
+        m_requested_num_update_data_chunks = num_chunks;
+    }
+    void start_update_data_scaling_benchmark()
+    {
+        m_is_update_data_scaling_benchmark_requested = true;
+    }
+    std::vector<Update_data_scaling_result> get_update_data_scaling_results()
+    {
+        std::lock_guard<std::mutex> lock{ m_update_data_scaling_results_mutex };
+        return m_update_data_scaling_results;
+    }
+
+    // Shadow technique benchmark.
+    void start_shadow_technique_benchmark()
+    {
+        m_is_shadow_benchmark_requested = true;
+    }
+    std::vector<Shadow_technique_benchmark_result> get_shadow_technique_benchmark_results()
+    {
+        std::lock_guard<std::mutex> lock{ m_shadow_benchmark_results_mutex };
+        return m_shadow_benchmark_results;
+    }
+
+    // Geometry culling.
+    void set_use_fused_geometry_culling(bool use_fused)
+    {
+        m_use_fused_geometry_culling = use_fused;
+        invalidate_cached_render_pass_cmds();
+    }
+
+    void set_main_view_render_layers(gpu_geo_data::Render_layer_mask_t render_layers)
+    {
+        m_main_view_render_layers = render_layers;
+        invalidate_cached_render_pass_cmds();
+    }
+
     // Render geometry object lifetime.
     render_geo_obj_key_t create_render_geo_obj(const std::string& model_name,
                                                const std::string& material_set_name,
                                                geo_instance::Geo_render_pass render_pass,
                                                bool is_shadow_caster,
-                                               world_sim::Transform_read_ifc* transform_reader);
+                                               world_sim::Transform_read_ifc* transform_reader,
+                                               gpu_geo_data::Render_layer render_layer = gpu_geo_data::Render_layer::DEFAULT,
+                                               bool never_cull = false);
+    render_geo_obj_key_t create_render_geo_obj(const std::string& model_name,
+                                               const std::string& material_set_name,
+                                               geo_instance::Geo_render_pass render_pass,
+                                               bool is_shadow_caster,
+                                               transform_batch::Transform_ref batched_transform,
+                                               gpu_geo_data::Render_layer render_layer = gpu_geo_data::Render_layer::DEFAULT,
+                                               bool never_cull = false);
     void destroy_render_geo_obj(render_geo_obj_key_t key);
     void set_render_geo_obj_transform(render_geo_obj_key_t key,
                                       mat4 transform);
+    void set_render_geo_obj_render_layer(render_geo_obj_key_t key,
+                                         gpu_geo_data::Render_layer render_layer);
+
+    // Batched transform sources.
+    transform_batch::Source_key_t register_transform_batch_source(transform_batch::Source_ifc* source);
+    void unregister_transform_batch_source(transform_batch::Source_key_t key);
 
     // Jobs.
     inline static const uint32_t k_glfw_window_job_key{ 0xB00B1E55 };
@@ -183,23 +402,72 @@ public:
     class Update_data_job : public Job_ifc
     {
     public:
-        Update_data_job(Job_source& source, Monolithic_renderer::Impl& pimpl)
-            : Job_ifc("Renderer Update Data job", source)
+        Update_data_job(const std::string& name,
+                        Job_source& source,
+                        Monolithic_renderer::Impl& pimpl,
+                        Update_data_phase phase,
+                        size_t chunk_idx)
+            : Job_ifc(name, source)
+            , m_pimpl(pimpl)
+            , m_phase(phase)
+            , m_chunk_idx(chunk_idx)
+        {
+        }
+
+        int32_t execute() override;
+
+        Monolithic_renderer::Impl& m_pimpl;
+        const Update_data_phase m_phase;
+        const size_t m_chunk_idx;
+
+        // For the update data phase timings.
+        double_t m_begin_time{ 0.0 };
+        double_t m_end_time{ 0.0 };
+    };
+    // @NOTE: Chunk phases have `k_max_update_data_chunks` jobs, of which the
+    //   first `m_num_update_data_chunks` get fetched. The rest have one.
+    std::array<std::vector<std::unique_ptr<Update_data_job>>, k_num_update_data_phases> m_update_data_jobs;
+
+    class Begin_render_job : public Job_ifc
+    {
+    public:
+        Begin_render_job(Job_source& source, Monolithic_renderer::Impl& pimpl)
+            : Job_ifc("Renderer Begin Render job", source)
+            , m_pimpl(pimpl)
+        {
+        }
+
+        int32_t execute() override;
+
+        Monolithic_renderer::Impl& m_pimpl;
+    };
+    std::unique_ptr<Begin_render_job> m_begin_render_job;
+
+    class Record_render_pass_job : public Job_ifc
+    {
+    public:
+        Record_render_pass_job(const std::string& name,
+                               Job_source& source,
+                               Monolithic_renderer::Impl& pimpl,
+                               Render_pass_cmd pass)
+            : Job_ifc(name, source)
             , m_pimpl(pimpl)
+            , m_pass(pass)
         {
         }
 
         int32_t execute() override;
 
         Monolithic_renderer::Impl& m_pimpl;
+        const Render_pass_cmd m_pass;
     };
-    std::unique_ptr<Update_data_job> m_update_data_job;
+    std::array<std::unique_ptr<Record_render_pass_job>, k_num_render_pass_cmds> m_record_render_pass_jobs;
 
-    class Render_job : public Job_ifc
+    class Submit_render_job : public Job_ifc
     {
     public:
-        Render_job(Job_source& source, Monolithic_renderer::Impl& pimpl)
-            : Job_ifc("Renderer Render job", source)
+        Submit_render_job(Job_source& source, Monolithic_renderer::Impl& pimpl)
+            : Job_ifc("Renderer Submit Render job", source)
             , m_pimpl(pimpl)
         {
         }
@@ -208,7 +476,7 @@ public:
 
         Monolithic_renderer::Impl& m_pimpl;
     };
-    std::unique_ptr<Render_job> m_render_job;
+    std::unique_ptr<Submit_render_job> m_submit_render_job;
 
     class Teardown_job : public Job_ifc
     {
@@ -234,20 +502,60 @@ public:
         struct Per_frame_data
         {
             Descriptor_set_w_layout camera_data;
-            Descriptor_set_w_layout shadow_camera_data;  // @TODO: IMPLEMENT THIS!!!!!!
-        };
-        std::array<Per_frame_data, k_frame_overlap> per_frame_datas;
-        Descriptor_set_w_layout material_param_sets_data;
-        Descriptor_set_w_layout bounding_spheres_data;
 
-        std::vector<VkDescriptorSet> material_param_definition_descriptor_sets;  // @CHECK: Maybe this should be held by the material bank???
-        VkDescriptorSetLayout material_param_definition_descriptor_layout;
+            // One shadow camera set per cascade, all w/ the same layout.
+            VkDescriptorSetLayout shadow_camera_descriptor_layout;
+            std::array<VkDescriptorSet, camera::k_num_shadow_cascades> shadow_cascade_camera_descriptor_sets;
+
+            // Virtual shadow map camera (`GPU_vsm_params`).
+            Descriptor_set_w_layout virtual_shadow_camera_data;
+
+            // Subscribed to the geo resource buffers (see `m_buffer_registry`).
+            // @NOTE: All frames share the same layout.
+            Descriptor_set_w_layout bounding_spheres_data;
+        };
+        std::array<Per_frame_data, k_max_frame_overlap> per_frame_datas;
+        VkDeviceSize shadow_camera_stride;  // `GPU_camera` padded to the min uniform buffer offset alignment.
 
         VkPipeline culling_pipeline;
         VkPipelineLayout culling_pipeline_layout;
 
         VkPipeline write_draw_cmds_pipeline;
         VkPipelineLayout write_draw_cmds_pipeline_layout;
+
+        // Culling and write draw cmds in one dispatch.
+        bool is_fused_culling_supported{ false };
+        VkPipeline cull_and_write_draw_cmds_pipeline{ VK_NULL_HANDLE };
+        VkPipelineLayout cull_and_write_draw_cmds_pipeline_layout{ VK_NULL_HANDLE };
+    };
+
+    // Sunlight virtual shadow map.
+    // @NOTE: Everything here is shared by all frames in flight, since frames
+    //   run in submission order on the one graphics queue.
+    struct Virtual_shadow_map
+    {
+        vk_buffer::Allocated_buffer page_table_buffer;         // `GPU_vsm_page_table_entry` per virtual page.
+        vk_buffer::Allocated_buffer page_request_buffer;       // Request bits per virtual page.
+        vk_buffer::Allocated_buffer free_page_stack_buffer;    // `GPU_vsm_free_page_stack_header` + physical page idxs.
+        vk_buffer::Allocated_buffer render_page_list_buffer;   // `GPU_vsm_render_page_list_header` + physical page idxs.
+        vk_buffer::Allocated_buffer physical_pool_buffer;      // Depth bits of every physical page.
+        vk_buffer::Allocated_buffer stats_buffer;              // `GPU_vsm_stats`.
+        vk_buffer::Allocated_buffer prev_bounding_spheres_buffer;  // Per instance key, for invalidation.
+        VkDeviceAddress page_table_buffer_address;
+        VkDeviceAddress page_request_buffer_address;
+        VkDeviceAddress free_page_stack_buffer_address;
+        VkDeviceAddress render_page_list_buffer_address;
+        VkDeviceAddress physical_pool_buffer_address;
+        VkDeviceAddress stats_buffer_address;
+        VkDeviceAddress prev_bounding_spheres_buffer_address;
+        VkDeviceSize memory_bytes{ 0 };
+
+        VkSampler main_depth_sampler;
+        Descriptor_set_w_layout main_depth_data;
+        VkPipeline update_pages_pipeline;
+        VkPipelineLayout update_pages_pipeline_layout;
+
+        bool has_contents{ false };  // @NOTE: Only touched by the shadow pass recording.
     };
 
 private:
@@ -263,13 +571,57 @@ private:
     // Setup jobs.
     bool setup_initial_camera_props();
 
-    // Misc?????
-    bool write_material_param_sets_to_descriptor_sets();
-    bool write_bounding_spheres_to_descriptor_sets();
+    // Frame pacing.
+    void wait_for_frame_pacing();
+    void poll_frame_latency_measurements();
+    void record_frame_latency_measurement(Frame_data& frame, double_t observed_time);
+
+    // Performance HUD.
+    void sample_perf_hud_frame(const Frame_data& frame);
+
+    // GPU memory defragmentation.
+    // @NOTE: Only moves the given frame's buffers (and the churn buffers), so
+    //   it has to run while that frame isn't in flight or mapped for upload.
+    void run_gpu_memory_defragmentation_pass(Frame_data& frame, uint32_t frame_idx);
+    void tick_gpu_memory_churn();
+
+    // Shadow technique benchmark.
+    // @NOTE: Ticked by the update data job, so the scene changes land in the
+    //   frame being prepared.
+    void tick_shadow_technique_benchmark();
+    render_geo_obj_key_t spawn_shadow_benchmark_caster(uint32_t caster_idx);
+    void get_shadow_benchmark_caster_transform(uint32_t caster_idx, mat4& out_transform);
 
     // Tick procedures.
-    bool update_and_upload_render_data();
-    bool render();
+    bool is_frame_pipelining_enabled();
+    void append_begin_render_jobs(Job_next_jobs_return_data& return_data);
+    void start_update_data_phases(size_t frame_number);
+    bool append_next_update_data_phase_jobs(Job_next_jobs_return_data& return_data);
+    void record_update_data_phase_time();
+    void tick_update_data_scaling_benchmark();
+    bool prepare_render_data(Update_data_phase phase, size_t chunk_idx);
+    void schedule_shadow_cascade_updates(Frame_data& frame,
+                                         const std::vector<mat4s>& latest_shadow_cascades);
+    void skip_shadow_cascade_updates(Frame_data& frame);
+    bool begin_render();
+    bool record_render_pass_cmds(Render_pass_cmd pass);
+    bool is_render_pass_cmd_cacheable(Render_pass_cmd pass);
+
+    // Forces all cached pass cmds to be re-recorded (e.g. swapchain or
+    // pipeline changes).
+    void invalidate_cached_render_pass_cmds()
+    {
+        m_render_pass_cmds_invalidation_version++;
+    }
+    bool submit_render();
+
+    // @NOTE: Falls back to the separate culling and write draw cmds passes if
+    //   the device doesn't support the subgroup ops.
+    bool is_fused_geometry_culling_active()
+    {
+        return (m_use_fused_geometry_culling &&
+                m_v_geometry_graphics_pass.is_fused_culling_supported);
+    }
 
     std::atomic_size_t& m_num_job_sources_setup_incomplete;
     std::string m_name;
@@ -294,7 +646,10 @@ private:
     VkDevice m_v_device{ nullptr };
     VkQueue m_v_graphics_queue{ nullptr };
     uint32_t m_v_graphics_queue_family_idx;
+    std::mutex m_v_graphics_queue_mutex;  // Update data and render jobs both submit.
     VmaAllocator m_v_vma_allocator{ nullptr };
+    bool m_v_is_memory_budget_ext_enabled{ false };
+    bool m_v_is_pipeline_stats_query_enabled{ false };
 
     struct Swapchain
     {
@@ -311,8 +666,64 @@ private:
         VkExtent2D                extent;
     } m_v_HDR_draw_image;
 
+    // Main view depth.
+    // @NOTE: Left in `DEPTH_READ_ONLY_OPTIMAL` after the opaque pass, so the
+    //   next frame's virtual shadow map page marking can read it.
+    struct Main_depth_image
+    {
+        vk_image::Allocated_image image;
+        VkExtent2D                extent;
+    } m_v_main_depth_image;
+
+    // Sunlight shadow cascades (one layer per cascade).
+    // @NOTE: `image.image_view` views all the layers (for sampling).
+    //   Static shadow casters are cached in `static_cache_image` and copied
+    //   into `image` before the dynamic casters get drawn on top.
+    struct Shadow_cascade_image
+    {
+        vk_image::Allocated_image image;
+        std::array<VkImageView, camera::k_num_shadow_cascades> cascade_image_views;
+        vk_image::Allocated_image static_cache_image;
+        std::array<VkImageView, camera::k_num_shadow_cascades> static_cache_image_views;
+        VkExtent2D extent;
+        bool has_contents{ false };  // @NOTE: Only touched by the shadow pass recording.
+    } m_v_shadow_cascade_image;
+
+    // Amortized shadow cascade updates.
+    // @NOTE: Cascade k gets re-rendered every 2^k frames, w/ the matrix it
+    //   was last rendered with kept for the frames in between. Only touched
+    //   by the update data jobs.
+    struct Shadow_cascade_schedule
+    {
+        struct Cascade
+        {
+            mat4 projection_view;
+            bool has_rendered{ false };
+            bool is_static_cache_valid{ false };
+        };
+        std::array<Cascade, camera::k_num_shadow_cascades> cascades;
+        std::vector<gpu_geo_data::GPU_bounding_sphere> static_caster_changes;
+    } m_shadow_cascade_schedule;
+
+    // Sunlight virtual shadow map (used instead of the cascades w/
+    // `Shadow_technique::VIRTUAL`).
+    Virtual_shadow_map m_v_virtual_shadow_map;
+
+    // What the virtual shadow map's cached pages were rendered with.
+    // @NOTE: Only touched by the update data jobs.
+    struct Virtual_shadow_map_cache_state
+    {
+        bool was_active{ false };
+        uint32_t light_version{ 0 };
+        float_t depth_center{ 0.0f };
+        mat4 prev_main_projection_view = GLM_MAT4_IDENTITY_INIT;
+        uint32_t frame_idx{ 0 };
+        std::vector<geo_instance::Geo_instance_key_t> caster_layer_changes;  // Of the frame being prepared.
+    } m_vsm_cache_state;
+
     vk_desc::Descriptor_allocator m_v_descriptor_alloc;
 
+    vk_buffer_registry::Buffer_registry m_buffer_registry;
     vk_buffer::GPU_geo_resource_buffer m_v_geo_passes_resource_buffer;
     Geometry_graphics_pass m_v_geometry_graphics_pass;
 
@@ -321,7 +732,7 @@ private:
     inline Geometry_graphics_pass::Per_frame_data& get_current_geom_per_frame_data()
     {
         return m_v_geometry_graphics_pass
-            .per_frame_datas[m_frame_number % k_frame_overlap];
+            .per_frame_datas[m_frame_number % m_num_frames_in_flight];
     }
 
     struct Sample_pass
@@ -338,16 +749,116 @@ private:
         VkPipelineLayout pipeline_layout;
     } m_v_sample_graphics_pass;
 
-    Frame_data m_frames[k_frame_overlap];
+    const uint32_t m_num_frames_in_flight;
+    Frame_data m_frames[k_max_frame_overlap];
     std::atomic_size_t m_frame_number{ 0 };
+    std::atomic_size_t m_update_data_frame_number{ 0 };  // Frame the update data job prepares.
+    std::atomic_bool m_is_update_data_pipelined{ false };
+    std::atomic_uint64_t m_num_pipelined_update_datas{ 0 };
+    std::atomic_uint32_t m_requested_num_update_data_chunks{ 0 };  // 0 is one per hardware thread.
+    size_t m_num_update_data_chunks{ 1 };  // Latched at the start of each update data.
+    std::atomic<Update_data_phase> m_next_update_data_phase{ Update_data_phase::NUM_UPDATE_DATA_PHASES };
+    std::atomic_bool m_is_update_data_rebucketing{ false };
+    std::atomic_uint32_t m_update_data_sort_pass_idx{ 0 };  // Pass the sort phases run.
+    std::atomic_uint32_t m_next_update_data_sort_pass_idx{ 0 };
+    vk_buffer::Per_frame_upload_context m_per_frame_upload_context;
+    std::atomic_bool m_is_close_requested{ false };
+    std::atomic_bool m_is_render_frame_active{ false };  // Set once the swapchain image is acquired.
+    uint32_t m_current_swapchain_image_idx{ 0 };
+    std::atomic_uint64_t m_render_pass_cmds_invalidation_version{ 0 };
+    std::atomic_bool m_use_fused_geometry_culling{ true };
+    std::atomic<gpu_geo_data::Render_layer_mask_t> m_main_view_render_layers{
+        gpu_geo_data::k_gameplay_view_render_layers };
+    std::atomic<Shadow_technique> m_shadow_technique{ Shadow_technique::CASCADED };
+    vk_buffer::GPU_visibility_history m_visibility_history;  // @NOTE: Only touched by the update data jobs after setup.
     
     inline Frame_data& get_current_frame()
     {
-        return m_frames[m_frame_number % k_frame_overlap];
+        return m_frames[m_frame_number % m_num_frames_in_flight];
     }
 
     float_t m_delta_time{ 0.0f };
     double_t m_prev_time{ -6942.0 };
+    double_t m_input_sample_time{ -1.0 };
+
+    // Frame pacing.
+    const Frame_pacing_mode m_frame_pacing_mode;
+    std::atomic<float_t> m_frame_limiter_fps{ 0.0f };
+    double_t m_prev_frame_pacing_time{ -1.0 };
+    double_t m_avg_cpu_frame_work_time{ 0.0 };  // From input sample to queue submit.
+
+    // Latency stats.
+    std::atomic<float_t> m_latency_last_ms{ 0.0f };
+    std::atomic<float_t> m_latency_avg_ms{ 0.0f };
+    std::atomic<float_t> m_latency_max_ms{ 0.0f };
+    std::atomic_uint64_t m_latency_num_samples{ 0 };
+
+    // Shadow stats.
+    std::mutex m_shadow_stats_mutex;
+    Shadow_stats m_shadow_stats;
+
+    // Render stats (w/o the pipeline stats, which the GPU profiler keeps).
+    std::mutex m_render_stats_mutex;
+    Render_stats m_render_stats;
+
+    // Profiling.
+    vk_profiler::GPU_profiler m_gpu_profiler;
+    imgui_system::Perf_hud_frame_sample m_perf_hud_sample;  // Kept around since it's big.
+
+    // GPU memory budget.
+    vk_memory::Memory_budget m_memory_budget;
+
+    // GPU memory defragmentation.
+    vk_defrag::Defragmenter m_defragmenter;
+    std::vector<vk_defrag::Movable_buffer> m_defrag_movable_buffers;
+    std::vector<vk_buffer::Allocated_buffer*> m_defrag_moved_buffers;
+
+    std::atomic_bool m_is_gpu_memory_churn_enabled{ false };
+    std::vector<vk_buffer::Allocated_buffer> m_churn_buffers;
+    uint32_t m_churn_random_state{ 1 };
+
+    // Update data phase timings.
+    // @NOTE: Only touched when fetching jobs, once the previous phase's jobs
+    //   all finished.
+    Update_data_phase m_timed_update_data_phase{ Update_data_phase::NUM_UPDATE_DATA_PHASES };
+    std::array<double_t, k_num_update_data_phases> m_update_data_phase_times{};  // Secs.
+
+    // Update data scaling benchmark.
+    std::atomic_bool m_is_update_data_scaling_benchmark_requested{ false };
+    struct Update_data_scaling_state
+    {
+        bool is_running{ false };
+        uint32_t step_idx{ 0 };
+        uint32_t frame_idx{ 0 };  // Within the current step.
+        uint32_t prev_requested_num_chunks{ 0 };
+        uint64_t prev_draw_list_version{ 0 };
+        std::vector<render_geo_obj_key_t> instance_keys;
+        std::vector<Update_data_scaling_result> results;
+    } m_update_data_scaling;
+    std::mutex m_update_data_scaling_results_mutex;
+    std::vector<Update_data_scaling_result> m_update_data_scaling_results;
+
+    // Shadow technique benchmark.
+    std::atomic_bool m_is_shadow_benchmark_requested{ false };
+    struct Shadow_benchmark_state
+    {
+        bool is_running{ false };
+        uint32_t technique_idx{ 0 };
+        uint32_t frame_idx{ 0 };  // Within the current technique.
+        float_t time{ 0.0f };
+        Shadow_technique prev_technique{ Shadow_technique::CASCADED };
+        std::vector<render_geo_obj_key_t> caster_keys;
+        std::vector<gpu_geo_data::Render_layer> caster_layers;
+        std::vector<Shadow_technique_benchmark_result> results;
+        uint32_t random_state{ 1 };
+    } m_shadow_benchmark;  // @NOTE: Only touched by the update data jobs.
+    std::mutex m_shadow_benchmark_results_mutex;
+    std::vector<Shadow_technique_benchmark_result> m_shadow_benchmark_results;
+
+    inline uint32_t get_current_frame_idx()
+    {
+        return static_cast<uint32_t>(m_frame_number % m_num_frames_in_flight);
+    }
 };
 
 #endif  // _WIN64
@@ -1,13 +1,16 @@
 #include "renderer_win64_vk_buffer.h"
 
+#include <algorithm>
 #if _DEBUG
 #include <atomic>
 #endif  // _DEBUG
 #include <cassert>
 #include <iostream>
 #include <vk_mem_alloc.h>
+#include "cpu_profiler.h"
 #include "geo_instance.h"
 #include "renderer_win64_vk_immediate_submit.h"
+#include "transform_batch.h"
 #include "transform_read_ifc.h"  // From ticking_world_simulation component.
 
 
@@ -19,9 +22,9 @@ namespace vk_buffer
 
 #if _DEBUG
     // Since these should be immutable, assert that they aren't being attempted to change.
+    // @NOTE: Bounding spheres can get uploaded again
+    //   (see `GPU_geo_resource_buffer`).
     std::atomic_uint32_t s_num_times_uploaded_mesh{ 0 };
-    std::atomic_uint32_t s_num_times_uploaded_material_param_sets{ 0 };
-    std::atomic_uint32_t s_num_times_uploaded_bounding_spheres{ 0 };
 #endif  // _DEBUG
 
 }  // namespace vk_buffer
@@ -30,7 +33,8 @@ namespace vk_buffer
 vk_buffer::Allocated_buffer vk_buffer::create_buffer(VmaAllocator allocator,
                                                      size_t size,
                                                      VkBufferUsageFlags usage,
-                                                     VmaMemoryUsage memory_usage)
+                                                     VmaMemoryUsage memory_usage,
+                                                     vk_memory::Memory_category category)
 {
     VkBufferCreateInfo buffer_info{
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
@@ -44,7 +48,10 @@ vk_buffer::Allocated_buffer vk_buffer::create_buffer(VmaAllocator allocator,
         .usage = memory_usage,
     };
 
-    Allocated_buffer new_buffer;
+    Allocated_buffer new_buffer{
+        .size = size,
+        .usage = usage,
+    };
     VkResult err{
         vmaCreateBuffer(allocator,
                         &buffer_info,
@@ -54,9 +61,13 @@ vk_buffer::Allocated_buffer vk_buffer::create_buffer(VmaAllocator allocator,
                         &new_buffer.info) };
     if (err)
     {
-        std::cerr << "ERROR: Buffer creation failed." << std::endl;
+        std::cerr << "ERROR: Buffer creation failed ("
+                  << vk_memory::get_memory_category_name(category) << ", "
+                  << size << " bytes)." << std::endl;
         assert(false);
+        return new_buffer;
     }
+    vk_memory::track_allocation(allocator, new_buffer.allocation, category);
 
     return new_buffer;
 }
@@ -64,6 +75,7 @@ vk_buffer::Allocated_buffer vk_buffer::create_buffer(VmaAllocator allocator,
 void vk_buffer::destroy_buffer(VmaAllocator allocator,
                                const Allocated_buffer& buffer)
 {
+    vk_memory::untrack_allocation(allocator, buffer.allocation);
     vmaDestroyBuffer(allocator, buffer.buffer, buffer.allocation);
 }
 
@@ -75,7 +87,8 @@ bool vk_buffer::expand_buffer(const vk_util::Immediate_submit_support& support,
                               size_t old_size,
                               size_t new_size,
                               VkBufferUsageFlags usage,
-                              VmaMemoryUsage memory_usage)
+                              VmaMemoryUsage memory_usage,
+                              vk_memory::Memory_category category)
 {
     if (new_size < old_size)
     {
@@ -86,7 +99,7 @@ bool vk_buffer::expand_buffer(const vk_util::Immediate_submit_support& support,
 
     // Create new buffer, copy contents of old to new, and delete old buffer.
     Allocated_buffer new_buffer{
-        create_buffer(allocator, new_size, usage, memory_usage) };
+        create_buffer(allocator, new_size, usage, memory_usage, category) };
     
     vk_util::immediate_submit(support, device, queue, [&](VkCommandBuffer cmd) {
         VkBufferCopy old_to_new_copy{
@@ -123,14 +136,16 @@ vk_buffer::GPU_mesh_buffer vk_buffer::upload_mesh_to_gpu(const vk_util::Immediat
                           index_buffer_size,
                           VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
                               VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                          VMA_MEMORY_USAGE_GPU_ONLY)
+                          VMA_MEMORY_USAGE_GPU_ONLY,
+                          vk_memory::Memory_category::MESH)
         },
         .vertex_buffer{
             create_buffer(allocator,
                           vertex_buffer_size,
                           VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
                               VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                          VMA_MEMORY_USAGE_GPU_ONLY)
+                          VMA_MEMORY_USAGE_GPU_ONLY,
+                          vk_memory::Memory_category::MESH)
         },
     };
 
@@ -139,7 +154,8 @@ vk_buffer::GPU_mesh_buffer vk_buffer::upload_mesh_to_gpu(const vk_util::Immediat
         create_buffer(allocator,
                       index_buffer_size + vertex_buffer_size,
                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                      VMA_MEMORY_USAGE_CPU_ONLY) };
+                      VMA_MEMORY_USAGE_CPU_ONLY,
+                      vk_memory::Memory_category::STAGING) };
 
     // Copy index buffer and vertex buffer.
     void* data;
@@ -168,128 +184,36 @@ vk_buffer::GPU_mesh_buffer vk_buffer::upload_mesh_to_gpu(const vk_util::Immediat
     return new_mesh;
 }
 
-bool vk_buffer::upload_material_param_sets_to_gpu(
-    GPU_geo_resource_buffer& out_resources,
-    const vk_util::Immediate_submit_support& support,
-    VkDevice device,
-    VkQueue queue,
-    VmaAllocator allocator,
-    const std::vector<material_bank::GPU_material_set>& all_material_sets)
-{
-    assert((s_num_times_uploaded_material_param_sets++) == 0);
-
-    // Write material param indices (`cooked_material_param_local_idx`)
-    // (@NOTE: different from material idx)
-    size_t num_mat_param_indices{ 0 };
-    for (auto& mat_set : all_material_sets)
-        num_mat_param_indices += mat_set.material_indexes.size();
-
-    std::vector<uint32_t> flat_mat_param_indices;
-    flat_mat_param_indices.reserve(num_mat_param_indices);
-
-    std::vector<uint32_t> mat_param_set_start_indices;
-    mat_param_set_start_indices.reserve(all_material_sets.size());
-
-    for (auto& mat_set : all_material_sets)
-    {
-        mat_param_set_start_indices.emplace_back(flat_mat_param_indices.size());
-        for (auto mat_idx : mat_set.material_indexes)
-        {
-            auto& material{ material_bank::get_material(mat_idx) };
-            flat_mat_param_indices.emplace_back(
-                material.cooked_material_param_local_idx);
-        }
-    }
-
-    // Write to GPU.
-    size_t mat_param_indices_buffer_size{
-        sizeof(uint32_t) * flat_mat_param_indices.size() };
-    auto& mat_param_indices_buffer{ out_resources.material_param_index_buffer };
-    mat_param_indices_buffer =
-        create_buffer(allocator,
-                      mat_param_indices_buffer_size,
-                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-                          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                      VMA_MEMORY_USAGE_GPU_ONLY);
-
-    out_resources.material_param_index_buffer_size =
-        mat_param_indices_buffer_size;
-
-    size_t mat_param_sets_buffer_size{
-        sizeof(uint32_t) * mat_param_set_start_indices.size() };
-    auto& mat_param_sets_buffer{ out_resources.material_param_set_buffer };
-    mat_param_sets_buffer =
-        create_buffer(allocator,
-                      mat_param_sets_buffer_size,
-                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-                          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                      VMA_MEMORY_USAGE_GPU_ONLY);
-
-    out_resources.material_param_set_buffer_size =
-        mat_param_sets_buffer_size;
-
-    auto staging_buffer{
-        create_buffer(allocator,
-                      mat_param_indices_buffer_size + mat_param_sets_buffer_size,
-                      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                      VMA_MEMORY_USAGE_CPU_ONLY) };
-
-    void* data;
-    vmaMapMemory(allocator, staging_buffer.allocation, &data);
-    memcpy(data, flat_mat_param_indices.data(), mat_param_indices_buffer_size);
-    memcpy((char*)data + mat_param_indices_buffer_size, mat_param_set_start_indices.data(), mat_param_sets_buffer_size);
-    vmaUnmapMemory(allocator, staging_buffer.allocation);
-
-    vk_util::immediate_submit(support, device, queue, [&](VkCommandBuffer cmd) {
-        VkBufferCopy mat_params_copy{
-            .srcOffset = 0,
-            .dstOffset = 0,
-            .size = mat_param_indices_buffer_size,
-        };
-        vkCmdCopyBuffer(cmd, staging_buffer.buffer, mat_param_indices_buffer.buffer, 1, &mat_params_copy);
-        VkBufferCopy mat_sets_copy{
-            .srcOffset = mat_param_indices_buffer_size,
-            .dstOffset = 0,
-            .size = mat_param_sets_buffer_size,
-        };
-        vkCmdCopyBuffer(cmd, staging_buffer.buffer, mat_param_sets_buffer.buffer, 1, &mat_sets_copy);
-    });
-
-    destroy_buffer(allocator, staging_buffer);
-
-    return true;
-}
-
 bool vk_buffer::upload_bounding_spheres_to_gpu(
-    GPU_geo_resource_buffer& out_resources,
+    const GPU_geo_resource_buffer& resources,
+    vk_buffer_registry::Buffer_registry& buffer_registry,
+    uint64_t frame_number,
     const vk_util::Immediate_submit_support& support,
     VkDevice device,
     VkQueue queue,
     VmaAllocator allocator,
     const std::vector<gpu_geo_data::GPU_bounding_sphere>& all_bounding_spheres)
 {
-    assert((s_num_times_uploaded_bounding_spheres++) == 0);
     static_assert(sizeof(gpu_geo_data::GPU_bounding_sphere) == sizeof(vec4));
 
     size_t bs_buffer_size{
         sizeof(gpu_geo_data::GPU_bounding_sphere) * all_bounding_spheres.size() };
 
     // Write to GPU.
-    out_resources.bounding_sphere_buffer =
+    auto bounding_sphere_buffer{
         create_buffer(allocator,
                       bs_buffer_size,
                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
                           VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                      VMA_MEMORY_USAGE_GPU_ONLY);
-
-    out_resources.bounding_sphere_buffer_size =
-        bs_buffer_size;
+                      VMA_MEMORY_USAGE_GPU_ONLY,
+                      vk_memory::Memory_category::MESH) };
 
     auto staging_buffer{
         create_buffer(allocator,
                       bs_buffer_size,
                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                      VMA_MEMORY_USAGE_CPU_ONLY) };
+                      VMA_MEMORY_USAGE_CPU_ONLY,
+                      vk_memory::Memory_category::STAGING) };
 
     void* data;
     vmaMapMemory(allocator, staging_buffer.allocation, &data);
@@ -302,11 +226,17 @@ bool vk_buffer::upload_bounding_spheres_to_gpu(
             .dstOffset = 0,
             .size = bs_buffer_size,
         };
-        vkCmdCopyBuffer(cmd, staging_buffer.buffer, out_resources.bounding_sphere_buffer.buffer, 1, &bounding_spheres_copy);
+        vkCmdCopyBuffer(cmd, staging_buffer.buffer, bounding_sphere_buffer.buffer, 1, &bounding_spheres_copy);
     });
 
     destroy_buffer(allocator, staging_buffer);
 
+    vk_buffer_registry::replace_buffer(buffer_registry,
+                                       device,
+                                       resources.bounding_sphere_buffer,
+                                       bounding_sphere_buffer,
+                                       frame_number);
+
     return true;
 }
 
@@ -328,33 +258,22 @@ void vk_buffer::initialize_base_sized_per_frame_buffer(VkDevice device,
                       sizeof(gpu_geo_data::GPU_geo_instance_data) * capacity,
                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
                           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                      VMA_MEMORY_USAGE_CPU_TO_GPU);
+                      VMA_MEMORY_USAGE_CPU_TO_GPU,
+                      vk_memory::Memory_category::INSTANCE);
     device_address_info.buffer = frame_buffer.instance_data_buffer.buffer;
     frame_buffer.instance_data_buffer_address =
         vkGetBufferDeviceAddress(device, &device_address_info);
     frame_buffer.num_instance_data_elems = 0;
     frame_buffer.num_instance_data_elem_capacity = capacity;
 
-    // Visible result buffer.
-    frame_buffer.visible_result_buffer =
-        create_buffer(allocator,
-                      sizeof(uint32_t) * capacity,
-                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-                          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                      VMA_MEMORY_USAGE_GPU_ONLY);
-    device_address_info.buffer = frame_buffer.visible_result_buffer.buffer;
-    frame_buffer.visible_result_buffer_address =
-        vkGetBufferDeviceAddress(device, &device_address_info);
-    frame_buffer.num_visible_result_elems = 0;
-    frame_buffer.num_visible_result_elem_capacity = capacity;
-
     // Primitive group base indices buffer.
     frame_buffer.primitive_group_base_index_buffer =
         create_buffer(allocator,
                       sizeof(uint32_t) * capacity,
                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
                           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                      VMA_MEMORY_USAGE_CPU_TO_GPU);
+                      VMA_MEMORY_USAGE_CPU_TO_GPU,
+                      vk_memory::Memory_category::INDIRECT);
     device_address_info.buffer = frame_buffer.primitive_group_base_index_buffer.buffer;
     frame_buffer.primitive_group_base_index_buffer_address =
         vkGetBufferDeviceAddress(device, &device_address_info);
@@ -367,7 +286,8 @@ void vk_buffer::initialize_base_sized_per_frame_buffer(VkDevice device,
                       sizeof(uint32_t) * capacity,
                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
                           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                      VMA_MEMORY_USAGE_CPU_TO_GPU);
+                      VMA_MEMORY_USAGE_CPU_TO_GPU,
+                      vk_memory::Memory_category::INDIRECT);
     device_address_info.buffer = frame_buffer.count_buffer_index_buffer.buffer;
     frame_buffer.count_buffer_index_buffer_address =
         vkGetBufferDeviceAddress(device, &device_address_info);
@@ -380,39 +300,241 @@ void vk_buffer::initialize_base_sized_per_frame_buffer(VkDevice device,
                       sizeof(VkDrawIndexedIndirectCommand) * capacity,
                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
                           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                      VMA_MEMORY_USAGE_CPU_TO_GPU);
+                      VMA_MEMORY_USAGE_CPU_TO_GPU,
+                      vk_memory::Memory_category::INDIRECT);
     device_address_info.buffer = frame_buffer.indirect_command_buffer.buffer;
     frame_buffer.indirect_command_buffer_address =
         vkGetBufferDeviceAddress(device, &device_address_info);
+    // @NOTE: Culled buffers have a region per culling view.
     frame_buffer.culled_indirect_command_buffer =
         create_buffer(allocator,
-                      sizeof(VkDrawIndexedIndirectCommand) * capacity,
+                      sizeof(VkDrawIndexedIndirectCommand) * capacity *
+                          gpu_geo_data::k_num_culling_views,
                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
                           VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
                           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                      VMA_MEMORY_USAGE_GPU_ONLY);
+                      VMA_MEMORY_USAGE_GPU_ONLY,
+                      vk_memory::Memory_category::INDIRECT);
     device_address_info.buffer = frame_buffer.culled_indirect_command_buffer.buffer;
     frame_buffer.culled_indirect_command_buffer_address =
         vkGetBufferDeviceAddress(device, &device_address_info);
+    frame_buffer.material_param_index_per_primitive_buffer =
+        create_buffer(allocator,
+                      sizeof(uint32_t) * capacity,
+                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                      VMA_MEMORY_USAGE_CPU_TO_GPU,
+                      vk_memory::Memory_category::INDIRECT);
+    device_address_info.buffer = frame_buffer.material_param_index_per_primitive_buffer.buffer;
+    frame_buffer.material_param_index_per_primitive_buffer_address =
+        vkGetBufferDeviceAddress(device, &device_address_info);
+    frame_buffer.culled_draw_record_buffer =
+        create_buffer(allocator,
+                      sizeof(gpu_geo_data::GPU_draw_record) * capacity *
+                          gpu_geo_data::k_num_culling_views,
+                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                      VMA_MEMORY_USAGE_GPU_ONLY,
+                      vk_memory::Memory_category::INDIRECT);
+    device_address_info.buffer = frame_buffer.culled_draw_record_buffer.buffer;
+    frame_buffer.culled_draw_record_buffer_address =
+        vkGetBufferDeviceAddress(device, &device_address_info);
     frame_buffer.num_indirect_cmd_elems = 0;
     frame_buffer.num_indirect_cmd_elem_capacity = capacity;
 
     // Indirect draw cmd counts buffer.
     frame_buffer.indirect_counts_buffer =
         create_buffer(allocator,
-                      sizeof(uint32_t) * count_capacity,
+                      sizeof(uint32_t) * count_capacity *
+                          gpu_geo_data::k_num_culling_views,
                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
                           VK_BUFFER_USAGE_TRANSFER_DST_BIT |
                           VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
                           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                      VMA_MEMORY_USAGE_GPU_ONLY);
+                      VMA_MEMORY_USAGE_GPU_ONLY,
+                      vk_memory::Memory_category::INDIRECT);
     device_address_info.buffer = frame_buffer.indirect_counts_buffer.buffer;
     frame_buffer.indirect_counts_buffer_address =
         vkGetBufferDeviceAddress(device, &device_address_info);
+    frame_buffer.render_group_base_index_buffer =
+        create_buffer(allocator,
+                      sizeof(uint32_t) * count_capacity,
+                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                      VMA_MEMORY_USAGE_CPU_TO_GPU,
+                      vk_memory::Memory_category::INDIRECT);
+    device_address_info.buffer = frame_buffer.render_group_base_index_buffer.buffer;
+    frame_buffer.render_group_base_index_buffer_address =
+        vkGetBufferDeviceAddress(device, &device_address_info);
+    frame_buffer.indirect_counts_readback_buffer =
+        create_buffer(allocator,
+                      sizeof(uint32_t) * count_capacity *
+                          gpu_geo_data::k_num_culling_views,
+                      VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      VMA_MEMORY_USAGE_GPU_TO_CPU,
+                      vk_memory::Memory_category::INDIRECT);
     frame_buffer.num_indirect_counts_elems = 0;
     frame_buffer.num_indirect_counts_elem_capacity = count_capacity;
 }
 
+void vk_buffer::append_movable_per_frame_buffers(GPU_geo_per_frame_buffer& frame_buffer,
+                                                 std::vector<vk_defrag::Movable_buffer>& out_movable_buffers)
+{
+    // @NOTE: Culling writes the culled buffers and counts from scratch every
+    //   frame, so those don't need their contents moved.
+    out_movable_buffers.insert(out_movable_buffers.end(), {
+        { &frame_buffer.instance_data_buffer },
+        { &frame_buffer.primitive_group_base_index_buffer },
+        { &frame_buffer.count_buffer_index_buffer },
+        { &frame_buffer.indirect_command_buffer },
+        { &frame_buffer.culled_indirect_command_buffer, true },
+        { &frame_buffer.material_param_index_per_primitive_buffer },
+        { &frame_buffer.culled_draw_record_buffer, true },
+        { &frame_buffer.indirect_counts_buffer, true },
+        { &frame_buffer.render_group_base_index_buffer },
+        { &frame_buffer.indirect_counts_readback_buffer },
+    });
+}
+
+void vk_buffer::refresh_per_frame_buffer_addresses(VkDevice device,
+                                                   GPU_geo_per_frame_buffer& frame_buffer)
+{
+    auto get_address = [device](const Allocated_buffer& buffer) {
+        VkBufferDeviceAddressInfo device_address_info{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+            .buffer = buffer.buffer,
+        };
+        return vkGetBufferDeviceAddress(device, &device_address_info);
+    };
+
+    frame_buffer.instance_data_buffer_address =
+        get_address(frame_buffer.instance_data_buffer);
+    frame_buffer.primitive_group_base_index_buffer_address =
+        get_address(frame_buffer.primitive_group_base_index_buffer);
+    frame_buffer.count_buffer_index_buffer_address =
+        get_address(frame_buffer.count_buffer_index_buffer);
+    frame_buffer.indirect_command_buffer_address =
+        get_address(frame_buffer.indirect_command_buffer);
+    frame_buffer.culled_indirect_command_buffer_address =
+        get_address(frame_buffer.culled_indirect_command_buffer);
+    frame_buffer.material_param_index_per_primitive_buffer_address =
+        get_address(frame_buffer.material_param_index_per_primitive_buffer);
+    frame_buffer.culled_draw_record_buffer_address =
+        get_address(frame_buffer.culled_draw_record_buffer);
+    frame_buffer.indirect_counts_buffer_address =
+        get_address(frame_buffer.indirect_counts_buffer);
+    frame_buffer.render_group_base_index_buffer_address =
+        get_address(frame_buffer.render_group_base_index_buffer);
+    frame_buffer.buffers_version++;
+}
+
+void vk_buffer::initialize_visibility_history(const vk_util::Immediate_submit_support& support,
+                                              VkDevice device,
+                                              VkQueue queue,
+                                              VmaAllocator allocator,
+                                              uint32_t num_slots,
+                                              GPU_visibility_history& out_history)
+{
+    out_history.num_slots = num_slots;
+    out_history.num_words_per_view = 0;
+    reserve_visibility_history(support,
+                               device,
+                               queue,
+                               allocator,
+                               1024,
+                               0,
+                               0,
+                               out_history);
+}
+
+void vk_buffer::reserve_visibility_history(const vk_util::Immediate_submit_support& support,
+                                           VkDevice device,
+                                           VkQueue queue,
+                                           VmaAllocator allocator,
+                                           size_t num_instances,
+                                           size_t frame_number,
+                                           size_t num_frames_in_flight,
+                                           GPU_visibility_history& history)
+{
+    // Destroy retired buffers that no frame in flight can be using anymore.
+    std::erase_if(history.retired_buffers, [&](const auto& retired) {
+        if (frame_number >= retired.retired_frame_number + num_frames_in_flight)
+        {
+            destroy_buffer(allocator, retired.buffer);
+            return true;
+        }
+        return false;
+    });
+
+    uint32_t num_words_needed{ gpu_geo_data::calc_num_visibility_words(num_instances) };
+    if (num_words_needed <= history.num_words_per_view)
+        return;
+
+    // Grow in chunks of 1024 instances.
+    constexpr uint32_t k_expand_words_interval{ 1024 / 32 };
+    uint32_t new_num_words_per_view{
+        ((num_words_needed + k_expand_words_interval - 1) / k_expand_words_interval) *
+            k_expand_words_interval };
+    size_t new_size{
+        sizeof(uint32_t) *
+            gpu_geo_data::k_max_visibility_views *
+            new_num_words_per_view *
+            history.num_slots };
+
+    if (history.num_words_per_view > 0)
+    {
+        history.retired_buffers.push_back({ history.buffer, frame_number });
+    }
+
+    history.buffer =
+        create_buffer(allocator,
+                      new_size,
+                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                          VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                      VMA_MEMORY_USAGE_GPU_ONLY,
+                      vk_memory::Memory_category::INSTANCE);
+    VkBufferDeviceAddressInfo device_address_info{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+        .buffer = history.buffer.buffer,
+    };
+    history.buffer_address = vkGetBufferDeviceAddress(device, &device_address_info);
+    history.num_words_per_view = new_num_words_per_view;
+
+    // Start off w/ nothing visible.
+    // @NOTE: Since the view layout changed, the old bits aren't copied over.
+    vk_util::immediate_submit(support, device, queue, [&](VkCommandBuffer cmd) {
+        vkCmdFillBuffer(cmd, history.buffer.buffer, 0, VK_WHOLE_SIZE, 0);
+    });
+}
+
+void vk_buffer::assign_visibility_history_slots(const GPU_visibility_history& history,
+                                                uint32_t slot_idx,
+                                                uint32_t prev_slot_idx,
+                                                GPU_geo_per_frame_buffer& frame_buffer)
+{
+    assert(slot_idx < history.num_slots);
+    assert(prev_slot_idx < history.num_slots);
+
+    VkDeviceSize slot_offset{ get_visibility_slot_offset(history, slot_idx) };
+    if (frame_buffer.visibility_history_buffer == history.buffer.buffer &&
+        frame_buffer.visibility_slot_offset == slot_offset &&
+        frame_buffer.num_visibility_words_per_view == history.num_words_per_view)
+    {
+        // Already assigned.
+        return;
+    }
+
+    frame_buffer.visibility_history_buffer = history.buffer.buffer;
+    frame_buffer.visibility_slot_offset = slot_offset;
+    frame_buffer.visibility_slot_address = history.buffer_address + slot_offset;
+    frame_buffer.prev_visibility_slot_address =
+        history.buffer_address + get_visibility_slot_offset(history, prev_slot_idx);
+    frame_buffer.num_visibility_words_per_view = history.num_words_per_view;
+    frame_buffer.buffers_version++;
+}
+
 // bool vk_buffer::set_new_changed_indices(std::vector<uint32_t>&& changed_indices,
 //                                         std::vector<GPU_geo_per_frame_buffer*>& all_per_frame_buffers)
 // {
@@ -459,12 +581,17 @@ void vk_buffer::flag_update_all_instances(std::vector<GPU_geo_per_frame_buffer*>
     //////////////////////////////////////////////////////////////
 }
 
-void vk_buffer::upload_changed_per_frame_data(const vk_util::Immediate_submit_support& support,
-                                              VkDevice device,
-                                              VkQueue queue,
-                                              VmaAllocator allocator,
-                                              GPU_geo_per_frame_buffer& frame_buffer)
+void vk_buffer::begin_upload_changed_per_frame_data(const vk_util::Immediate_submit_support& support,
+                                                    VkDevice device,
+                                                    VkQueue queue,
+                                                    VmaAllocator allocator,
+                                                    const geo_instance::Draw_list_snapshot& draw_list,
+                                                    GPU_geo_per_frame_buffer& frame_buffer,
+                                                    bool upload_primitive_group_indices,
+                                                    size_t num_chunks,
+                                                    Per_frame_upload_context& out_context)
 {
+    CPU_PROFILER_ZONE("Begin Upload Changed Per Frame Data");
     // @NOTE: @TODO: @NOCHECKIN: Complete the incomplete `changes_processed` system. For now, just simply run every time.  -Thea 2025/04/06
     //assert(false);  // @INCOMPLETE: (Line 524) Need to set `changes_processed = false;` when a tranform reader handle wants to update the transform information.  -Thea 2025/04/04
 
@@ -481,21 +608,14 @@ void vk_buffer::upload_changed_per_frame_data(const vk_util::Immediate_submit_su
         .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
     };
 
-    // Assign ids to all instances.
-    auto unique_instances{ geo_instance::get_all_unique_instances() };
-    for (size_t i = 0; i < unique_instances.size(); i++)
-    {
-        auto& inst{ unique_instances[i] };
-        inst->cooked_buffer_instance_id = static_cast<uint32_t>(i);
-    }
-
     // Update instance data buffer sizing.
-    frame_buffer.num_instance_data_elems = unique_instances.size();
-    if (unique_instances.size() > frame_buffer.num_instance_data_elem_capacity)
+    size_t num_instances{ draw_list.num_instances };
+    frame_buffer.num_instance_data_elems = num_instances;
+    if (num_instances > frame_buffer.num_instance_data_elem_capacity)
     {
         size_t new_capacity{
-            unique_instances.size() +
-                (unique_instances.size() % frame_buffer.expand_elems_interval) };
+            num_instances +
+                (num_instances % frame_buffer.expand_elems_interval) };
         expand_buffer(support,
                       device,
                       queue,
@@ -506,112 +626,32 @@ void vk_buffer::upload_changed_per_frame_data(const vk_util::Immediate_submit_su
                       sizeof(gpu_geo_data::GPU_geo_instance_data) * new_capacity,
                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
                           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                      VMA_MEMORY_USAGE_CPU_TO_GPU);
+                      VMA_MEMORY_USAGE_CPU_TO_GPU,
+                      vk_memory::Memory_category::INSTANCE);
         device_address_info.buffer = frame_buffer.instance_data_buffer.buffer;
         frame_buffer.instance_data_buffer_address =
             vkGetBufferDeviceAddress(device, &device_address_info);
         frame_buffer.num_instance_data_elem_capacity = new_capacity;
+        frame_buffer.buffers_version++;
     }
 
-    // Upload instance data.
-    {
-        gpu_geo_data::GPU_geo_instance_data* data;
-        vmaMapMemory(allocator,
-                     frame_buffer.instance_data_buffer.allocation,
-                     reinterpret_cast<void**>(&data));
-        for (auto inst : unique_instances)
-        {
-            // Update gpu transform data if there is a transform reader.
-            if (inst->transform_reader_handle != nullptr)
-            {
-                inst->transform_reader_handle->read_current_transform(
-                    inst->gpu_instance_data.transform, 0.5f);  // @HARDCODE
-            }
-
-            memcpy(data,
-                   &inst->gpu_instance_data,
-                   sizeof(gpu_geo_data::GPU_geo_instance_data));
-            data++;
-        }
-        vmaUnmapMemory(allocator,
-                       frame_buffer.instance_data_buffer.allocation);
-    }
-
-    // Update visible result buffer sizing.
-    frame_buffer.num_visible_result_elems = unique_instances.size();
-    if (unique_instances.size() > frame_buffer.num_visible_result_elem_capacity)
-    {
-        size_t new_capacity{
-            unique_instances.size() +
-                (unique_instances.size() % frame_buffer.expand_elems_interval) };
-        expand_buffer(support,  // @TODO: @NOTE: Change this to the non-copying buffer expansion bc everything gets calculated on the GPU.
-                      device,
-                      queue,
-                      allocator,
-                      frame_buffer.visible_result_buffer,
-                      sizeof(uint32_t) * frame_buffer.num_visible_result_elem_capacity,
-                      sizeof(uint32_t) * new_capacity,
-                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-                          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                      VMA_MEMORY_USAGE_GPU_ONLY);
-        device_address_info.buffer = frame_buffer.visible_result_buffer.buffer;
-        frame_buffer.visible_result_buffer_address =
-            vkGetBufferDeviceAddress(device, &device_address_info);
-        frame_buffer.num_visible_result_elem_capacity = new_capacity;
-    }
-    // @NOTE: Don't upload visible result data bc it all gets calculated on GPU.
-
-    // Collect primitive group indices and count buffer indices.
-    using Primitive_group_index_t = uint32_t;
-    using Count_buffer_index_t = uint32_t;
-    std::vector<Primitive_group_index_t> primitive_group_base_indices;
-    std::vector<Count_buffer_index_t> count_buffer_indices;
-
-    auto all_primitives{ geo_instance::get_all_primitives() };
-    auto all_base_primitive_groups{ geo_instance::get_all_base_primitive_indices() };
-
-    primitive_group_base_indices.resize(all_primitives.size());
-    count_buffer_indices.resize(all_primitives.size());
-    size_t num_primitives_written{ 0 };
-
-    Count_buffer_index_t current_cnt_buf_idx{ 0 };
-    for (size_t i = 0; i < all_base_primitive_groups.size(); i++)
-    {
-        auto& primitive_group{ all_base_primitive_groups[i] };
-        uint32_t from_idx{ primitive_group.second };
-        uint32_t to_idx{ static_cast<uint32_t>(all_primitives.size()) };
-        if (i < all_base_primitive_groups.size() - 1)
-        {
-            to_idx = all_base_primitive_groups[i + 1].second;
-        }
-
-        for (uint32_t j = from_idx; j < to_idx; j++)
-        {
-            primitive_group_base_indices[j] = primitive_group.second;
-            count_buffer_indices[j]         = current_cnt_buf_idx;
-            num_primitives_written++;
-        }
-
-        current_cnt_buf_idx++;
-    }
-    assert(num_primitives_written == all_primitives.size());
-    assert(num_primitives_written == primitive_group_base_indices.size());
-    assert(num_primitives_written == count_buffer_indices.size());
+    // @NOTE: Visibility is in `GPU_visibility_history` and gets calculated
+    //   on GPU, so nothing to upload.
 
     // Update primitive group base indices buffer
     // and count buffer indices buffer sizing.
-    assert(primitive_group_base_indices.size() == count_buffer_indices.size());
+    // @NOTE: Contents get written per chunk.
+    auto& all_primitives{ draw_list.primitives };
 
-    frame_buffer.num_primitive_group_base_index_elems =
-        primitive_group_base_indices.size();
-    frame_buffer.num_count_buffer_index_elems = count_buffer_indices.size();
+    frame_buffer.num_primitive_group_base_index_elems = all_primitives.size();
+    frame_buffer.num_count_buffer_index_elems = all_primitives.size();
 
-    if (primitive_group_base_indices.size() >
+    if (all_primitives.size() >
         frame_buffer.num_primitive_group_base_index_elem_capacity)
     {
         size_t new_capacity{
-            primitive_group_base_indices.size() +
-                (primitive_group_base_indices.size() %
+            all_primitives.size() +
+                (all_primitives.size() %
                     frame_buffer.expand_elems_interval) };
 
         expand_buffer(support,
@@ -623,11 +663,13 @@ void vk_buffer::upload_changed_per_frame_data(const vk_util::Immediate_submit_su
                       sizeof(uint32_t) * new_capacity,
                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
                           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                      VMA_MEMORY_USAGE_CPU_TO_GPU);
+                      VMA_MEMORY_USAGE_CPU_TO_GPU,
+                      vk_memory::Memory_category::INDIRECT);
         device_address_info.buffer = frame_buffer.primitive_group_base_index_buffer.buffer;
         frame_buffer.primitive_group_base_index_buffer_address =
             vkGetBufferDeviceAddress(device, &device_address_info);
         frame_buffer.num_primitive_group_base_index_elem_capacity = new_capacity;
+        frame_buffer.buffers_version++;
 
         expand_buffer(support,
                       device,
@@ -638,37 +680,13 @@ void vk_buffer::upload_changed_per_frame_data(const vk_util::Immediate_submit_su
                       sizeof(uint32_t) * new_capacity,
                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
                           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                      VMA_MEMORY_USAGE_CPU_TO_GPU);
+                      VMA_MEMORY_USAGE_CPU_TO_GPU,
+                      vk_memory::Memory_category::INDIRECT);
         device_address_info.buffer = frame_buffer.count_buffer_index_buffer.buffer;
         frame_buffer.count_buffer_index_buffer_address =
             vkGetBufferDeviceAddress(device, &device_address_info);
         frame_buffer.num_count_buffer_index_elem_capacity = new_capacity;
-    }
-
-    // Upload primitive group base indices.
-    {
-        void* data;
-        vmaMapMemory(allocator,
-                     frame_buffer.primitive_group_base_index_buffer.allocation,
-                     &data);
-        memcpy(data,
-               primitive_group_base_indices.data(),
-               sizeof(Primitive_group_index_t) * primitive_group_base_indices.size());
-        vmaUnmapMemory(allocator,
-                       frame_buffer.primitive_group_base_index_buffer.allocation);
-    }
-
-    // Upload count buffer indices.
-    {
-        void* data;
-        vmaMapMemory(allocator,
-                     frame_buffer.count_buffer_index_buffer.allocation,
-                     &data);
-        memcpy(data,
-               count_buffer_indices.data(),
-               sizeof(Count_buffer_index_t) * count_buffer_indices.size());
-        vmaUnmapMemory(allocator,
-                       frame_buffer.count_buffer_index_buffer.allocation);
+        frame_buffer.buffers_version++;
     }
 
     // Update indirect cmd buffer sizing.
@@ -689,7 +707,8 @@ void vk_buffer::upload_changed_per_frame_data(const vk_util::Immediate_submit_su
                       sizeof(VkDrawIndexedIndirectCommand) * new_capacity,
                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
                           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                      VMA_MEMORY_USAGE_CPU_TO_GPU);
+                      VMA_MEMORY_USAGE_CPU_TO_GPU,
+                      vk_memory::Memory_category::INDIRECT);
         device_address_info.buffer = frame_buffer.indirect_command_buffer.buffer;
         frame_buffer.indirect_command_buffer_address =
             vkGetBufferDeviceAddress(device, &device_address_info);
@@ -698,47 +717,53 @@ void vk_buffer::upload_changed_per_frame_data(const vk_util::Immediate_submit_su
         destroy_buffer(allocator, frame_buffer.culled_indirect_command_buffer);
         frame_buffer.culled_indirect_command_buffer =
             create_buffer(allocator,
-                          sizeof(VkDrawIndexedIndirectCommand) * new_capacity,
+                          sizeof(VkDrawIndexedIndirectCommand) * new_capacity *
+                              gpu_geo_data::k_num_culling_views,
                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
                               VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
                               VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                          VMA_MEMORY_USAGE_GPU_ONLY);
+                          VMA_MEMORY_USAGE_GPU_ONLY,
+                          vk_memory::Memory_category::INDIRECT);
         device_address_info.buffer =
             frame_buffer.culled_indirect_command_buffer.buffer;
         frame_buffer.culled_indirect_command_buffer_address =
             vkGetBufferDeviceAddress(device, &device_address_info);
 
-        frame_buffer.num_indirect_cmd_elem_capacity = new_capacity;
-    }
+        // Material param indices get rewritten every upload, so no copying
+        // needed either.
+        destroy_buffer(allocator, frame_buffer.material_param_index_per_primitive_buffer);
+        frame_buffer.material_param_index_per_primitive_buffer =
+            create_buffer(allocator,
+                          sizeof(uint32_t) * new_capacity,
+                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                              VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                          VMA_MEMORY_USAGE_CPU_TO_GPU,
+                          vk_memory::Memory_category::INDIRECT);
+        device_address_info.buffer =
+            frame_buffer.material_param_index_per_primitive_buffer.buffer;
+        frame_buffer.material_param_index_per_primitive_buffer_address =
+            vkGetBufferDeviceAddress(device, &device_address_info);
 
-    // Upload indirect cmds data.
-    std::vector<VkDrawIndexedIndirectCommand> new_indirect_cmds;
-    new_indirect_cmds.reserve(all_primitives.size());
-    for (auto prim : all_primitives)
-    {
-        new_indirect_cmds.emplace_back(                // VkDrawIndexedIndirectCommand
-            prim->primitive->index_count,              // .indexCount
-            1,                                         // .instanceCount
-            prim->primitive->start_index,              // .firstIndex
-            0,                                         // .vertexOffset
-            prim->instance->cooked_buffer_instance_id  // .firstInstance
-        );
-    }
-    {
-        void* data;
-        vmaMapMemory(allocator,
-                     frame_buffer.indirect_command_buffer.allocation,
-                     &data);
-        memcpy(data,
-               new_indirect_cmds.data(),
-               sizeof(VkDrawIndexedIndirectCommand) * new_indirect_cmds.size());
-        vmaUnmapMemory(allocator,
-                       frame_buffer.indirect_command_buffer.allocation);
+        destroy_buffer(allocator, frame_buffer.culled_draw_record_buffer);
+        frame_buffer.culled_draw_record_buffer =
+            create_buffer(allocator,
+                          sizeof(gpu_geo_data::GPU_draw_record) * new_capacity *
+                              gpu_geo_data::k_num_culling_views,
+                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                              VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                          VMA_MEMORY_USAGE_GPU_ONLY,
+                          vk_memory::Memory_category::INDIRECT);
+        device_address_info.buffer = frame_buffer.culled_draw_record_buffer.buffer;
+        frame_buffer.culled_draw_record_buffer_address =
+            vkGetBufferDeviceAddress(device, &device_address_info);
+
+        frame_buffer.num_indirect_cmd_elem_capacity = new_capacity;
+        frame_buffer.buffers_version++;
     }
 
     // Count number of primitive groups to create count buffer.
     uint32_t num_primitive_groups{
-        static_cast<uint32_t>(all_base_primitive_groups.size()) };
+        static_cast<uint32_t>(draw_list.render_groups.size()) };
 
     // Update indirect counts sizing.
     frame_buffer.num_indirect_counts_elems = num_primitive_groups;
@@ -752,19 +777,222 @@ void vk_buffer::upload_changed_per_frame_data(const vk_util::Immediate_submit_su
                       queue,
                       allocator,
                       frame_buffer.indirect_counts_buffer,
-                      sizeof(uint32_t) * frame_buffer.num_indirect_counts_elem_capacity,
-                      sizeof(uint32_t) * new_capacity,
+                      sizeof(uint32_t) * frame_buffer.num_indirect_counts_elem_capacity *
+                          gpu_geo_data::k_num_culling_views,
+                      sizeof(uint32_t) * new_capacity *
+                          gpu_geo_data::k_num_culling_views,
                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
                           VK_BUFFER_USAGE_TRANSFER_DST_BIT |
                           VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
                           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                      VMA_MEMORY_USAGE_GPU_ONLY);
+                      VMA_MEMORY_USAGE_GPU_ONLY,
+                      vk_memory::Memory_category::INDIRECT);
         device_address_info.buffer = frame_buffer.indirect_counts_buffer.buffer;
         frame_buffer.indirect_counts_buffer_address =
             vkGetBufferDeviceAddress(device, &device_address_info);
+
+        // Render group base indices get rewritten below, so no copying needed.
+        destroy_buffer(allocator, frame_buffer.render_group_base_index_buffer);
+        frame_buffer.render_group_base_index_buffer =
+            create_buffer(allocator,
+                          sizeof(uint32_t) * new_capacity,
+                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                              VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                          VMA_MEMORY_USAGE_CPU_TO_GPU,
+                          vk_memory::Memory_category::INDIRECT);
+        device_address_info.buffer = frame_buffer.render_group_base_index_buffer.buffer;
+        frame_buffer.render_group_base_index_buffer_address =
+            vkGetBufferDeviceAddress(device, &device_address_info);
+
+        // Draw counts readback only holds the latest frame's counts.
+        destroy_buffer(allocator, frame_buffer.indirect_counts_readback_buffer);
+        frame_buffer.indirect_counts_readback_buffer =
+            create_buffer(allocator,
+                          sizeof(uint32_t) * new_capacity *
+                              gpu_geo_data::k_num_culling_views,
+                          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VMA_MEMORY_USAGE_GPU_TO_CPU,
+                          vk_memory::Memory_category::INDIRECT);
+
         frame_buffer.num_indirect_counts_elem_capacity = new_capacity;
+        frame_buffer.buffers_version++;
     }
     // @NOTE: Don't populate buffer bc it gets written to.
 
+    // Upload render group base indices.
+    // @NOTE: Only one entry per render group, so not worth chunking.
+    uint32_t* mapped_render_group_base_indices;
+    vmaMapMemory(allocator,
+                 frame_buffer.render_group_base_index_buffer.allocation,
+                 reinterpret_cast<void**>(&mapped_render_group_base_indices));
+    for (uint32_t i = 0; i < num_primitive_groups; i++)
+    {
+        mapped_render_group_base_indices[i] = draw_list.render_groups[i].base_primitive_idx;
+    }
+    vmaUnmapMemory(allocator, frame_buffer.render_group_base_index_buffer.allocation);
+
+    // Snapshot the instance datas for the chunks to pull from.
+    geo_instance::sync_upload_gpu_instance_datas(draw_list);
+
+    // Map buffers for the chunks to write into.
+    // @NOTE: Only the separate culling passes read the primitive group base
+    //   indices and count buffer indices (the fused pass looks up the render
+    //   group instead), so they only get uploaded for those.
+    size_t num_u32s_per_primitive{ upload_primitive_group_indices ? 3u : 1u };
+    out_context.num_upload_bytes =
+        sizeof(uint32_t) * num_primitive_groups +
+        sizeof(gpu_geo_data::GPU_geo_instance_data) * draw_list.num_instances +
+        (sizeof(uint32_t) * num_u32s_per_primitive + sizeof(VkDrawIndexedIndirectCommand)) *
+            draw_list.primitives.size();
+    out_context.draw_list = &draw_list;
+    out_context.frame_buffer = &frame_buffer;
+    out_context.num_chunks = std::max<size_t>(num_chunks, 1);
+    vmaMapMemory(allocator,
+                 frame_buffer.instance_data_buffer.allocation,
+                 reinterpret_cast<void**>(&out_context.mapped_instance_datas));
+    if (upload_primitive_group_indices)
+    {
+        vmaMapMemory(allocator,
+                     frame_buffer.primitive_group_base_index_buffer.allocation,
+                     reinterpret_cast<void**>(&out_context.mapped_primitive_group_base_indices));
+        vmaMapMemory(allocator,
+                     frame_buffer.count_buffer_index_buffer.allocation,
+                     reinterpret_cast<void**>(&out_context.mapped_count_buffer_indices));
+    }
+    vmaMapMemory(allocator,
+                 frame_buffer.indirect_command_buffer.allocation,
+                 reinterpret_cast<void**>(&out_context.mapped_indirect_cmds));
+    vmaMapMemory(allocator,
+                 frame_buffer.material_param_index_per_primitive_buffer.allocation,
+                 reinterpret_cast<void**>(&out_context.mapped_material_param_indices));
+}
+
+void vk_buffer::upload_changed_per_frame_data__chunk(const Per_frame_upload_context& context,
+                                                     size_t chunk_idx)
+{
+    assert(chunk_idx < context.num_chunks);
+    auto& draw_list{ *context.draw_list };
+
+    // Get range of `count` that this chunk covers.
+    auto calc_chunk_range{ [&](size_t count, size_t& out_from_idx, size_t& out_to_idx) {
+        size_t chunk_size{ (count + context.num_chunks - 1) / context.num_chunks };
+        out_from_idx = std::min(chunk_idx * chunk_size, count);
+        out_to_idx = std::min(out_from_idx + chunk_size, count);
+    } };
+
+    // Upload instance data.
+    // @NOTE: Instance data is densely packed in instance buffer order, so
+    //   after pulling in the transforms it's one straight copy.
+    size_t from_idx;
+    size_t to_idx;
+    calc_chunk_range(draw_list.num_instances, from_idx, to_idx);
+    if (from_idx < to_idx)
+    {
+        auto gpu_instance_datas{ geo_instance::get_upload_gpu_instance_datas() };
+        auto transform_reader_handles{ geo_instance::get_dense_transform_reader_handles() };
+        auto batched_transforms{ geo_instance::get_dense_batched_transforms() };
+
+        // Update gpu transform data if there is a transform source.
+        // @NOTE: Batched transforms are already interpolated by
+        //   `transform_batch::interpolate_all_sources()`. Instances of the
+        //   same source are usually next to each other, so the source's
+        //   transforms only get looked up when the source changes.
+        transform_batch::Source_key_t prev_source_key{ transform_batch::k_invalid_source_key };
+        const gpu_geo_data::GPU_instance_transform* interpolated_transforms{ nullptr };
+        uint32_t num_interpolated_transforms{ 0 };
+        for (size_t i = from_idx; i < to_idx; i++)
+        {
+            auto& batched_transform{ batched_transforms[i] };
+            if (batched_transform.source_key != transform_batch::k_invalid_source_key)
+            {
+                if (batched_transform.source_key != prev_source_key)
+                {
+                    interpolated_transforms =
+                        transform_batch::get_interpolated_transforms(batched_transform.source_key,
+                                                                     num_interpolated_transforms);
+                    prev_source_key = batched_transform.source_key;
+                }
+
+                // @NOTE: Keeps the stored transform if the source hasn't
+                //   interpolated this transform (yet).
+                if (batched_transform.transform_idx < num_interpolated_transforms)
+                {
+                    gpu_instance_datas[i].transform =
+                        interpolated_transforms[batched_transform.transform_idx];
+                }
+            }
+            else if (transform_reader_handles[i] != nullptr)
+            {
+                mat4 transform;
+                transform_reader_handles[i]->read_current_transform(
+                    transform, 0.5f);  // @HARDCODE: Per-instance readers don't expose tick timing. Use a batched transform source for real interpolation.
+                gpu_geo_data::set_instance_transform(gpu_instance_datas[i].transform,
+                                                     transform);
+            }
+        }
+
+        memcpy(&context.mapped_instance_datas[from_idx],
+               &gpu_instance_datas[from_idx],
+               sizeof(gpu_geo_data::GPU_geo_instance_data) * (to_idx - from_idx));
+    }
+
+    // Upload indirect cmds and material param indices, and the primitive
+    // group base indices and count buffer indices if they got mapped.
+    calc_chunk_range(draw_list.primitives.size(), from_idx, to_idx);
+    if (from_idx >= to_idx)
+        return;
+
+    // Find render group of first primitive in chunk.
+    auto render_group_it{
+        std::upper_bound(draw_list.render_groups.begin(),
+                         draw_list.render_groups.end(),
+                         static_cast<uint32_t>(from_idx),
+                         [](uint32_t primitive_idx, const auto& render_group) {
+                             return primitive_idx < render_group.base_primitive_idx;
+                         }) };
+    assert(render_group_it != draw_list.render_groups.begin());
+    render_group_it--;
+
+    for (size_t i = from_idx; i < to_idx; i++)
+    {
+        while (i >= render_group_it->base_primitive_idx + render_group_it->num_primitives)
+        {
+            render_group_it++;
+        }
+
+        if (context.mapped_primitive_group_base_indices != nullptr)
+        {
+            context.mapped_primitive_group_base_indices[i] = render_group_it->base_primitive_idx;
+            context.mapped_count_buffer_indices[i] =
+                static_cast<uint32_t>(render_group_it - draw_list.render_groups.begin());
+        }
+
+        auto& prim{ draw_list.primitives[i] };
+        context.mapped_indirect_cmds[i] = VkDrawIndexedIndirectCommand{
+            .indexCount = prim.primitive->index_count,
+            .instanceCount = 1,
+            .firstIndex = prim.primitive->start_index,
+            .vertexOffset = 0,
+            .firstInstance = prim.instance_idx,
+        };
+        context.mapped_material_param_indices[i] = prim.material_param_idx;
+    }
+}
+
+void vk_buffer::end_upload_changed_per_frame_data(VmaAllocator allocator,
+                                                  Per_frame_upload_context& context)
+{
+    auto& frame_buffer{ *context.frame_buffer };
+    vmaUnmapMemory(allocator, frame_buffer.instance_data_buffer.allocation);
+    if (context.mapped_primitive_group_base_indices != nullptr)
+    {
+        vmaUnmapMemory(allocator, frame_buffer.primitive_group_base_index_buffer.allocation);
+        vmaUnmapMemory(allocator, frame_buffer.count_buffer_index_buffer.allocation);
+    }
+    vmaUnmapMemory(allocator, frame_buffer.indirect_command_buffer.allocation);
+    vmaUnmapMemory(allocator, frame_buffer.material_param_index_per_primitive_buffer.allocation);
+    context = Per_frame_upload_context{};
+
     frame_buffer.changes_processed = true;
 }
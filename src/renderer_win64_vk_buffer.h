@@ -11,9 +11,13 @@
 #include "gpu_geo_data.h"
 #include "material_bank.h"
 #include "renderer_win64_vk_buffer__allocated_buffer.h"
+#include "renderer_win64_vk_buffer_registry.h"
+#include "renderer_win64_vk_defragmenter.h"
+#include "renderer_win64_vk_memory_budget.h"
 
 
 namespace vk_util{ struct Immediate_submit_support; }
+namespace geo_instance { struct Draw_list_snapshot; }
 using GPU_vertex = gltf_loader::GPU_vertex;
 
 namespace vk_buffer
@@ -22,7 +26,8 @@ namespace vk_buffer
 Allocated_buffer create_buffer(VmaAllocator allocator,
                                size_t size,
                                VkBufferUsageFlags usage,
-                               VmaMemoryUsage memory_usage);
+                               VmaMemoryUsage memory_usage,
+                               vk_memory::Memory_category category);
 
 void destroy_buffer(VmaAllocator allocator,
                     const Allocated_buffer& buffer);
@@ -35,7 +40,8 @@ bool expand_buffer(const vk_util::Immediate_submit_support& support,
                    size_t old_size,
                    size_t new_size,
                    VkBufferUsageFlags usage,
-                   VmaMemoryUsage memory_usage);
+                   VmaMemoryUsage memory_usage,
+                   vk_memory::Memory_category category);
 
 struct GPU_mesh_buffer
 {
@@ -60,23 +66,16 @@ struct GPU_geo_resource_buffer
     // bc I thought from their context they would definitely be mutable. Perhaps in the future it
     // may be good to have mutable material param sets???? But only if there's a REALLY good reason
     // for it.  -Thea 2025/02/25
-    Allocated_buffer material_param_index_buffer;  // @TODO: add `local_` at beginning.
-    size_t material_param_index_buffer_size;
-    Allocated_buffer material_param_set_buffer;
-    size_t material_param_set_buffer_size;
-    Allocated_buffer bounding_sphere_buffer;  // @NOTE: this one does not change in size!!! Since it's fixed to the 
-    size_t bounding_sphere_buffer_size;
+    //
+    // @NOTE: Uploading again makes new (possibly resized) buffers, which get
+    //   swapped in w/ the buffer registry so the descriptor sets using them
+    //   get rewritten.
+    vk_buffer_registry::buffer_handle_t bounding_sphere_buffer;
 };
 
-// @NOTE: Mutates both `material_param_index_buffer` and `material_param_set_buffer`.
-bool upload_material_param_sets_to_gpu(GPU_geo_resource_buffer& out_resources,
-                                       const vk_util::Immediate_submit_support& support,
-                                       VkDevice device,
-                                       VkQueue queue,
-                                       VmaAllocator allocator,
-                                       const std::vector<material_bank::GPU_material_set>& all_material_sets);
-
-bool upload_bounding_spheres_to_gpu(GPU_geo_resource_buffer& out_resources,
+bool upload_bounding_spheres_to_gpu(const GPU_geo_resource_buffer& resources,
+                                    vk_buffer_registry::Buffer_registry& buffer_registry,
+                                    uint64_t frame_number,
                                     const vk_util::Immediate_submit_support& support,
                                     VkDevice device,
                                     VkQueue queue,
@@ -90,10 +89,13 @@ struct GPU_geo_per_frame_buffer
     std::atomic_size_t num_instance_data_elems{ 0 };
     std::atomic_size_t num_instance_data_elem_capacity{ 0 };
 
-    Allocated_buffer visible_result_buffer;
-    VkDeviceAddress visible_result_buffer_address;
-    std::atomic_size_t num_visible_result_elems{ 0 };
-    std::atomic_size_t num_visible_result_elem_capacity{ 0 };
+    // This frame's and last frame's slots of the visibility history.
+    // @NOTE: Assigned w/ `assign_visibility_history_slots()`.
+    VkBuffer visibility_history_buffer{ VK_NULL_HANDLE };
+    VkDeviceSize visibility_slot_offset{ 0 };
+    VkDeviceAddress visibility_slot_address{ 0 };
+    VkDeviceAddress prev_visibility_slot_address{ 0 };
+    uint32_t num_visibility_words_per_view{ 0 };
 
     Allocated_buffer primitive_group_base_index_buffer;
     VkDeviceAddress primitive_group_base_index_buffer_address;
@@ -109,11 +111,18 @@ struct GPU_geo_per_frame_buffer
     VkDeviceAddress indirect_command_buffer_address;
     Allocated_buffer culled_indirect_command_buffer;
     VkDeviceAddress culled_indirect_command_buffer_address;
+    Allocated_buffer material_param_index_per_primitive_buffer;
+    VkDeviceAddress material_param_index_per_primitive_buffer_address;
+    Allocated_buffer culled_draw_record_buffer;  // @NOTE: Parallel to `culled_indirect_command_buffer`.
+    VkDeviceAddress culled_draw_record_buffer_address;
     std::atomic_size_t num_indirect_cmd_elems{ 0 };
     std::atomic_size_t num_indirect_cmd_elem_capacity{ 0 };
 
     Allocated_buffer indirect_counts_buffer;
     VkDeviceAddress indirect_counts_buffer_address;
+    Allocated_buffer render_group_base_index_buffer;  // @NOTE: Parallel to `indirect_counts_buffer`.
+    VkDeviceAddress render_group_base_index_buffer_address;
+    Allocated_buffer indirect_counts_readback_buffer;  // @NOTE: Same size as `indirect_counts_buffer`.
     std::atomic_size_t num_indirect_counts_elems{ 0 };
     std::atomic_size_t num_indirect_counts_elem_capacity{ 0 };
 
@@ -121,12 +130,83 @@ struct GPU_geo_per_frame_buffer
     const size_t expand_count_elems_interval{ 32 };
 
     std::atomic_bool changes_processed{ true };
+
+    // Bumped whenever any of the buffers above get reallocated
+    // (i.e. a buffer handle or device address changes).
+    std::atomic_uint64_t buffers_version{ 0 };
 };
 
 void initialize_base_sized_per_frame_buffer(VkDevice device,
                                             VmaAllocator allocator,
                                             GPU_geo_per_frame_buffer& frame_buffer);
 
+// Appends the buffers that defragmentation may move while the frame isn't
+// in flight.
+void append_movable_per_frame_buffers(GPU_geo_per_frame_buffer& frame_buffer,
+                                      std::vector<vk_defrag::Movable_buffer>& out_movable_buffers);
+
+// Refetches the device addresses after defragmentation moved any of the
+// buffers, and bumps `buffers_version`.
+void refresh_per_frame_buffer_addresses(VkDevice device,
+                                        GPU_geo_per_frame_buffer& frame_buffer);
+
+// Bit-packed instance visibility of every view (see `k_max_visibility_views`),
+// w/ one slot per frame in flight so that last frame's visibility is still
+// around while this frame's gets written.
+// @NOTE: Indexed by dense instance idx, so after a rebucket compacts the
+//   instances, last frame's bits are only a hint for one frame.
+struct GPU_visibility_history
+{
+    Allocated_buffer buffer;
+    VkDeviceAddress buffer_address{ 0 };
+    uint32_t num_slots{ 0 };
+    uint32_t num_words_per_view{ 0 };
+
+    // Shared by all frames in flight, so when growing the old buffer gets
+    // retired until no frame in flight could still be using it.
+    struct Retired_buffer
+    {
+        Allocated_buffer buffer;
+        size_t retired_frame_number;
+    };
+    std::vector<Retired_buffer> retired_buffers;
+};
+
+void initialize_visibility_history(const vk_util::Immediate_submit_support& support,
+                                   VkDevice device,
+                                   VkQueue queue,
+                                   VmaAllocator allocator,
+                                   uint32_t num_slots,
+                                   GPU_visibility_history& out_history);
+
+// Grows the history to fit `num_instances` and destroys retired buffers that
+// are done being used.
+// @NOTE: `frame_number` is the frame being prepared, whose render fence must
+//   already be waited on.
+void reserve_visibility_history(const vk_util::Immediate_submit_support& support,
+                                VkDevice device,
+                                VkQueue queue,
+                                VmaAllocator allocator,
+                                size_t num_instances,
+                                size_t frame_number,
+                                size_t num_frames_in_flight,
+                                GPU_visibility_history& history);
+
+inline VkDeviceSize get_visibility_slot_offset(const GPU_visibility_history& history,
+                                               uint32_t slot_idx)
+{
+    return (sizeof(uint32_t) *
+            gpu_geo_data::k_max_visibility_views *
+            history.num_words_per_view *
+            slot_idx);
+}
+
+// Points a frame at its own slot and the previous frame's slot.
+void assign_visibility_history_slots(const GPU_visibility_history& history,
+                                     uint32_t slot_idx,
+                                     uint32_t prev_slot_idx,
+                                     GPU_geo_per_frame_buffer& frame_buffer);
+
 // // @NOTE: Returns false if the previous requested change did not finish
 // //        propagating to all the frames. False means "try again later".
 // bool set_new_changed_indices(std::vector<uint32_t>&& changed_indices,
@@ -134,11 +214,39 @@ void initialize_base_sized_per_frame_buffer(VkDevice device,
 
 void flag_update_all_instances(std::vector<GPU_geo_per_frame_buffer*>& all_per_frame_buffers);
 
-void upload_changed_per_frame_data(const vk_util::Immediate_submit_support& support,
-                                   VkDevice device,
-                                   VkQueue queue,
-                                   VmaAllocator allocator,
-                                   GPU_geo_per_frame_buffer& frame_buffer);
+// Upload, split up so that writing the data can run across multiple jobs.
+// @NOTE: Call `begin` (resizes and maps buffers), then the chunk func for
+//   every chunk idx (safe to run concurrently), then `end`.
+struct Per_frame_upload_context
+{
+    const geo_instance::Draw_list_snapshot* draw_list{ nullptr };
+    GPU_geo_per_frame_buffer* frame_buffer{ nullptr };
+    size_t num_chunks{ 0 };
+
+    gpu_geo_data::GPU_geo_instance_data* mapped_instance_datas{ nullptr };
+    uint32_t* mapped_primitive_group_base_indices{ nullptr };  // Null if not uploading them.
+    uint32_t* mapped_count_buffer_indices{ nullptr };          // Null if not uploading them.
+    VkDrawIndexedIndirectCommand* mapped_indirect_cmds{ nullptr };
+    uint32_t* mapped_material_param_indices{ nullptr };
+
+    size_t num_upload_bytes{ 0 };  // Written by begin.
+};
+
+void begin_upload_changed_per_frame_data(const vk_util::Immediate_submit_support& support,
+                                         VkDevice device,
+                                         VkQueue queue,
+                                         VmaAllocator allocator,
+                                         const geo_instance::Draw_list_snapshot& draw_list,
+                                         GPU_geo_per_frame_buffer& frame_buffer,
+                                         bool upload_primitive_group_indices,
+                                         size_t num_chunks,
+                                         Per_frame_upload_context& out_context);
+
+void upload_changed_per_frame_data__chunk(const Per_frame_upload_context& context,
+                                          size_t chunk_idx);
+
+void end_upload_changed_per_frame_data(VmaAllocator allocator,
+                                       Per_frame_upload_context& context);
 
 
 }  // namespace vk_buffer
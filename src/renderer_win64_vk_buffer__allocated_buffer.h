@@ -14,6 +14,10 @@ struct Allocated_buffer
     VkBuffer buffer;
     VmaAllocation allocation;
     VmaAllocationInfo info;
+
+    // Create info, to recreate the buffer when its allocation gets moved.
+    VkDeviceSize size;
+    VkBufferUsageFlags usage;
 };
 
 }  // namespace vk_buffer
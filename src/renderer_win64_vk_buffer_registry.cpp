@@ -0,0 +1,170 @@
+#include "renderer_win64_vk_buffer_registry.h"
+
+#include <cassert>
+#include <iostream>
+#include "cpu_profiler.h"
+#include "renderer_win64_vk_buffer.h"
+
+
+namespace vk_buffer_registry
+{
+
+// Writes the entry's buffer to its subscribed sets of the frames in `frame_mask`.
+static bool write_descriptor_sets(VkDevice device,
+                                  const Buffer_registry::Entry& entry,
+                                  uint32_t frame_mask)
+{
+    VkDescriptorBufferInfo buffer_info{
+        .buffer = entry.buffer.buffer,
+        .offset = 0,
+        .range = entry.buffer.size,
+    };
+
+    bool is_any_set_written{ false };
+    for (auto& subscriber : entry.subscribers)
+    {
+        if (((frame_mask >> subscriber.frame_idx) & 1) == 0)
+            continue;
+
+        VkWriteDescriptorSet buffer_write{
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext = nullptr,
+            .dstSet = subscriber.descriptor_set,
+            .dstBinding = subscriber.binding,
+            .descriptorCount = 1,
+            .descriptorType = subscriber.descriptor_type,
+            .pBufferInfo = &buffer_info,
+        };
+        vkUpdateDescriptorSets(device, 1, &buffer_write, 0, nullptr);
+        is_any_set_written = true;
+    }
+    return is_any_set_written;
+}
+
+}  // namespace vk_buffer_registry
+
+
+void vk_buffer_registry::init_buffer_registry(Buffer_registry& out_registry, uint32_t num_frames_in_flight)
+{
+    assert(num_frames_in_flight < 32);  // Fits `dirty_frame_mask`.
+    out_registry.num_frames_in_flight = num_frames_in_flight;
+}
+
+void vk_buffer_registry::destroy_buffer_registry(Buffer_registry& registry, VmaAllocator allocator)
+{
+    std::lock_guard<std::mutex> lock{ registry.mutex };
+    for (auto& entry : registry.entries)
+        if (entry.has_buffer)
+            vk_buffer::destroy_buffer(allocator, entry.buffer);
+    for (auto& retired_buffer : registry.retired_buffers)
+        vk_buffer::destroy_buffer(allocator, retired_buffer.buffer);
+
+    registry.entries.clear();
+    registry.retired_buffers.clear();
+}
+
+vk_buffer_registry::buffer_handle_t vk_buffer_registry::register_buffer(Buffer_registry& registry)
+{
+    std::lock_guard<std::mutex> lock{ registry.mutex };
+    buffer_handle_t handle{ static_cast<buffer_handle_t>(registry.entries.size()) };
+    registry.entries.emplace_back();
+    return handle;
+}
+
+void vk_buffer_registry::subscribe_descriptor_set(Buffer_registry& registry,
+                                                  buffer_handle_t handle,
+                                                  uint32_t frame_idx,
+                                                  VkDescriptorSet descriptor_set,
+                                                  uint32_t binding,
+                                                  VkDescriptorType descriptor_type)
+{
+    assert(frame_idx < registry.num_frames_in_flight);
+
+    std::lock_guard<std::mutex> lock{ registry.mutex };
+    if (handle >= registry.entries.size())
+    {
+        std::cerr << "ERROR: Subscribing to unregistered buffer handle " << handle << "." << std::endl;
+        assert(false);
+        return;
+    }
+
+    auto& entry{ registry.entries[handle] };
+    entry.subscribers.emplace_back(Buffer_registry::Subscriber{
+        .descriptor_set = descriptor_set,
+        .frame_idx = frame_idx,
+        .binding = binding,
+        .descriptor_type = descriptor_type,
+    });
+    if (entry.has_buffer)
+        entry.dirty_frame_mask |= (1u << frame_idx);
+}
+
+void vk_buffer_registry::replace_buffer(Buffer_registry& registry,
+                                        VkDevice device,
+                                        buffer_handle_t handle,
+                                        const vk_buffer::Allocated_buffer& new_buffer,
+                                        uint64_t frame_number)
+{
+    std::lock_guard<std::mutex> lock{ registry.mutex };
+    if (handle >= registry.entries.size())
+    {
+        std::cerr << "ERROR: Replacing unregistered buffer handle " << handle << "." << std::endl;
+        assert(false);
+        return;
+    }
+
+    auto& entry{ registry.entries[handle] };
+    uint32_t all_frames_mask{ (1u << registry.num_frames_in_flight) - 1 };
+    if (!entry.has_buffer)
+    {
+        // First buffer. Nothing could have used the sets yet, so they get
+        // written right away.
+        entry.buffer = new_buffer;
+        entry.has_buffer = true;
+        write_descriptor_sets(device, entry, all_frames_mask);
+        return;
+    }
+
+    // @NOTE: `frame_number` may have already been flushed, and then recorded
+    //   w/ the old buffer, so it's counted as using it.
+    registry.retired_buffers.emplace_back(Buffer_registry::Retired_buffer{
+        .buffer = entry.buffer,
+        .retire_frame_number = frame_number,
+    });
+
+    entry.buffer = new_buffer;
+    entry.dirty_frame_mask = all_frames_mask;
+}
+
+bool vk_buffer_registry::flush_frame_descriptor_sets(Buffer_registry& registry,
+                                                     VkDevice device,
+                                                     VmaAllocator allocator,
+                                                     uint32_t frame_idx,
+                                                     uint64_t frame_number)
+{
+    std::lock_guard<std::mutex> lock{ registry.mutex };
+
+    // Every frame after the retire frame was flushed before recording, so
+    // once the retire frame's fence has signaled (which it has by the time
+    // its frame idx comes around again) nothing uses the buffer anymore.
+    std::erase_if(registry.retired_buffers, [&](const auto& retired_buffer) {
+        if (frame_number < retired_buffer.retire_frame_number + registry.num_frames_in_flight)
+            return false;
+        vk_buffer::destroy_buffer(allocator, retired_buffer.buffer);
+        return true;
+    });
+
+    uint32_t frame_bit{ 1u << frame_idx };
+    bool is_any_set_rewritten{ false };
+    for (auto& entry : registry.entries)
+    {
+        if ((entry.dirty_frame_mask & frame_bit) == 0)
+            continue;
+        entry.dirty_frame_mask &= ~frame_bit;
+
+        CPU_PROFILER_ZONE("Rewrite Subscribed Descriptor Sets");
+        is_any_set_rewritten |= write_descriptor_sets(device, entry, frame_bit);
+    }
+
+    return is_any_set_rewritten;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#if _WIN64
+
+#include <cinttypes>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+#include "renderer_win64_vk_buffer__allocated_buffer.h"
+
+
+// Buffers that get reallocated (resized or re-uploaded) at runtime, w/ the
+// descriptor sets that point to them.
+// @NOTE: Subscribed descriptor sets are per frame in flight. When a buffer
+//   gets replaced, each frame's sets get rewritten once that frame is done on
+//   the GPU (see `flush_frame_descriptor_sets()`), so nothing in flight ever
+//   sees a set change. The old buffer is kept alive until every frame has
+//   moved off of it.
+namespace vk_buffer_registry
+{
+
+using buffer_handle_t = uint32_t;
+constexpr buffer_handle_t k_invalid_buffer_handle{ (buffer_handle_t)-1 };
+
+struct Buffer_registry
+{
+    uint32_t num_frames_in_flight{ 0 };
+
+    struct Subscriber
+    {
+        VkDescriptorSet descriptor_set;
+        uint32_t frame_idx;
+        uint32_t binding;
+        VkDescriptorType descriptor_type;
+    };
+
+    struct Entry
+    {
+        vk_buffer::Allocated_buffer buffer{};
+        bool has_buffer{ false };
+        uint32_t dirty_frame_mask{ 0 };  // Bit per frame idx w/ sets to rewrite.
+        std::vector<Subscriber> subscribers;
+    };
+
+    struct Retired_buffer
+    {
+        vk_buffer::Allocated_buffer buffer;
+        uint64_t retire_frame_number;
+    };
+
+    // Guarded by `mutex`.
+    std::mutex mutex;
+    std::vector<Entry> entries;  // Indexed by handle.
+    std::vector<Retired_buffer> retired_buffers;
+};
+
+void init_buffer_registry(Buffer_registry& out_registry, uint32_t num_frames_in_flight);
+
+// Destroys the current and retired buffers.
+// @NOTE: The device has to be idle.
+void destroy_buffer_registry(Buffer_registry& registry, VmaAllocator allocator);
+
+// Starts w/o a buffer. Subscribed sets get written once one is set w/
+// `replace_buffer()`, so subscribe before that.
+buffer_handle_t register_buffer(Buffer_registry& registry);
+
+void subscribe_descriptor_set(Buffer_registry& registry,
+                              buffer_handle_t handle,
+                              uint32_t frame_idx,
+                              VkDescriptorSet descriptor_set,
+                              uint32_t binding,
+                              VkDescriptorType descriptor_type);
+
+// Swaps in `new_buffer` (its whole `size` gets bound) and retires the old one.
+// `frame_number` is the frame currently being rendered. Safe to call from any
+// thread.
+// @NOTE: The first buffer of a handle gets written to the subscribed sets
+//   right away instead.
+void replace_buffer(Buffer_registry& registry,
+                    VkDevice device,
+                    buffer_handle_t handle,
+                    const vk_buffer::Allocated_buffer& new_buffer,
+                    uint64_t frame_number);
+
+// Call once the frame's fence has signaled and before recording into it.
+// Rewrites the frame's sets of replaced buffers and destroys retired buffers
+// no frame uses anymore.
+// Returns whether any set got rewritten, which invalidates cmd buffers that
+// were recorded w/ it.
+bool flush_frame_descriptor_sets(Buffer_registry& registry,
+                                 VkDevice device,
+                                 VmaAllocator allocator,
+                                 uint32_t frame_idx,
+                                 uint64_t frame_number);
+
+}  // namespace vk_buffer_registry
+
+#endif  // _WIN64
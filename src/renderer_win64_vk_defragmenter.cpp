@@ -0,0 +1,283 @@
+#include "renderer_win64_vk_defragmenter.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include "cpu_profiler.h"
+#include "renderer_win64_vk_immediate_submit.h"
+
+
+namespace vk_defrag
+{
+
+static bool is_heap_fragmented(const Defragmenter& defragmenter, VmaAllocator allocator)
+{
+    const VkPhysicalDeviceMemoryProperties* memory_props;
+    vmaGetMemoryProperties(allocator, &memory_props);
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets;
+    vmaGetHeapBudgets(allocator, budgets.data());
+
+    for (uint32_t i = 0; i < memory_props->memoryHeapCount; i++)
+    {
+        if ((memory_props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == 0)
+            continue;
+
+        auto& stats{ budgets[i].statistics };
+        uint64_t unused_bytes{ stats.blockBytes - stats.allocationBytes };
+        if (unused_bytes >= defragmenter.min_unused_bytes &&
+            unused_bytes >= stats.blockBytes * defragmenter.min_unused_fraction)
+            return true;
+    }
+    return false;
+}
+
+static bool begin_run(Defragmenter& defragmenter, VmaAllocator allocator)
+{
+    VmaDefragmentationInfo defrag_info{
+        .flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT,
+        .pool = VK_NULL_HANDLE,  // Default pools.
+        .maxBytesPerPass = defragmenter.max_bytes_per_pass,
+        .maxAllocationsPerPass = defragmenter.max_allocations_per_pass,
+    };
+    VkResult err{ vmaBeginDefragmentation(allocator, &defrag_info, &defragmenter.context) };
+    if (err)
+    {
+        std::cerr << "ERROR: Begin defragmentation failed." << std::endl;
+        assert(false);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock{ defragmenter.mutex };
+    defragmenter.is_running = true;
+    defragmenter.run_stats = {};
+    return true;
+}
+
+static void end_run(Defragmenter& defragmenter, VmaAllocator allocator)
+{
+    VmaDefragmentationStats vma_stats;
+    vmaEndDefragmentation(allocator, defragmenter.context, &vma_stats);
+    defragmenter.context = VK_NULL_HANDLE;
+
+    Defrag_stats run_stats;
+    {
+        std::lock_guard<std::mutex> lock{ defragmenter.mutex };
+        auto& stats{ defragmenter.run_stats };
+        stats.num_allocations_moved = vma_stats.allocationsMoved;
+        stats.num_bytes_moved = vma_stats.bytesMoved;
+        stats.num_blocks_freed = vma_stats.deviceMemoryBlocksFreed;
+        stats.num_bytes_freed = vma_stats.bytesFreed;
+
+        auto& total{ defragmenter.total_stats };
+        total.num_passes += stats.num_passes;
+        total.num_ignored_moves += stats.num_ignored_moves;
+        total.num_allocations_moved += stats.num_allocations_moved;
+        total.num_bytes_moved += stats.num_bytes_moved;
+        total.num_blocks_freed += stats.num_blocks_freed;
+        total.num_bytes_freed += stats.num_bytes_freed;
+        defragmenter.num_runs++;
+        defragmenter.is_running = false;
+        run_stats = stats;
+    }
+
+    std::cout
+        << "GPU memory defragmentation: moved " << run_stats.num_allocations_moved
+        << " allocations (" << (run_stats.num_bytes_moved / 1024.0f / 1024.0f) << " MB), freed "
+        << run_stats.num_blocks_freed << " blocks (" << (run_stats.num_bytes_freed / 1024.0f / 1024.0f)
+        << " MB) over " << run_stats.num_passes << " passes." << std::endl;
+}
+
+}  // namespace vk_defrag
+
+
+void vk_defrag::request_defragmentation(Defragmenter& defragmenter)
+{
+    defragmenter.is_run_requested = true;
+}
+
+void vk_defrag::run_defragmentation_pass(Defragmenter& defragmenter,
+                                         const vk_util::Immediate_submit_support& support,
+                                         VkDevice device,
+                                         VkQueue queue,
+                                         VmaAllocator allocator,
+                                         const std::vector<Movable_buffer>& movable_buffers,
+                                         std::vector<vk_buffer::Allocated_buffer*>& out_moved_buffers)
+{
+    out_moved_buffers.clear();
+
+    if (defragmenter.context == VK_NULL_HANDLE)
+    {
+        bool is_requested{ defragmenter.is_run_requested.exchange(false) };
+        if (!is_requested)
+        {
+            if (defragmenter.num_frames_until_check > 0)
+            {
+                defragmenter.num_frames_until_check--;
+                return;
+            }
+            defragmenter.num_frames_until_check = defragmenter.check_interval_frames;
+            if (!is_heap_fragmented(defragmenter, allocator))
+                return;
+        }
+
+        if (!begin_run(defragmenter, allocator))
+            return;
+    }
+
+    CPU_PROFILER_ZONE("Defragmentation Pass");
+
+    VmaDefragmentationPassMoveInfo pass_info;
+    if (vmaBeginDefragmentationPass(allocator, defragmenter.context, &pass_info) == VK_SUCCESS)
+    {
+        // Nothing left to move.
+        end_run(defragmenter, allocator);
+        return;
+    }
+
+    struct Pending_move
+    {
+        vk_buffer::Allocated_buffer* buffer;
+        VkBuffer new_buffer;
+    };
+    std::vector<Pending_move> pending_moves;
+    std::vector<VkBufferCopy> gpu_copies;  // `srcOffset` is the pending move idx.
+    uint32_t num_ignored_moves{ 0 };
+
+    for (uint32_t i = 0; i < pass_info.moveCount; i++)
+    {
+        auto& move{ pass_info.pMoves[i] };
+        auto movable_it{
+            std::find_if(movable_buffers.begin(), movable_buffers.end(), [&](const auto& movable) {
+                return movable.buffer->allocation == move.srcAllocation;
+            }) };
+
+        bool is_movable{ movable_it != movable_buffers.end() };
+        bool needs_gpu_copy{ false };
+        if (is_movable && !movable_it->is_rewritten_before_use)
+        {
+            // Host visible contents get copied w/ the CPU, the rest needs to
+            // be a transfer src.
+            needs_gpu_copy = (movable_it->buffer->info.pMappedData == nullptr);
+            if (needs_gpu_copy && (movable_it->buffer->usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) == 0)
+                is_movable = false;
+        }
+        if (!is_movable)
+        {
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            num_ignored_moves++;
+            continue;
+        }
+
+        auto& buffer{ *movable_it->buffer };
+        if (needs_gpu_copy)
+            buffer.usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+        VkBufferCreateInfo buffer_info{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .pNext = nullptr,
+            .size = buffer.size,
+            .usage = buffer.usage,
+        };
+        VkBuffer new_buffer;
+        VkResult err{ vkCreateBuffer(device, &buffer_info, nullptr, &new_buffer) };
+        if (err == VK_SUCCESS)
+        {
+            err = vmaBindBufferMemory(allocator, move.dstTmpAllocation, new_buffer);
+            if (err)
+                vkDestroyBuffer(device, new_buffer, nullptr);
+        }
+        if (err)
+        {
+            std::cerr << "ERROR: Recreate buffer for defragmentation move failed." << std::endl;
+            assert(false);
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            num_ignored_moves++;
+            continue;
+        }
+
+        if (needs_gpu_copy)
+        {
+            gpu_copies.emplace_back(VkBufferCopy{
+                .srcOffset = pending_moves.size(),
+                .dstOffset = 0,
+                .size = buffer.size,
+            });
+        }
+        else if (!movable_it->is_rewritten_before_use)
+        {
+            void* dst_data;
+            vmaMapMemory(allocator, move.dstTmpAllocation, &dst_data);
+            std::memcpy(dst_data, buffer.info.pMappedData, buffer.size);
+            vmaUnmapMemory(allocator, move.dstTmpAllocation);
+        }
+
+        pending_moves.emplace_back(Pending_move{
+            .buffer = &buffer,
+            .new_buffer = new_buffer,
+        });
+    }
+
+    if (!gpu_copies.empty())
+    {
+        vk_util::immediate_submit(support, device, queue, [&](VkCommandBuffer cmd) {
+            for (auto copy : gpu_copies)
+            {
+                auto& pending_move{ pending_moves[copy.srcOffset] };
+                copy.srcOffset = 0;
+                vkCmdCopyBuffer(cmd, pending_move.buffer->buffer, pending_move.new_buffer, 1, &copy);
+            }
+        });
+    }
+
+    // Swap in the new buffers. The old memory is freed by ending the pass.
+    for (auto& pending_move : pending_moves)
+    {
+        vkDestroyBuffer(device, pending_move.buffer->buffer, nullptr);
+        pending_move.buffer->buffer = pending_move.new_buffer;
+    }
+
+    VkResult pass_result{
+        vmaEndDefragmentationPass(allocator, defragmenter.context, &pass_info) };
+
+    for (auto& pending_move : pending_moves)
+    {
+        vmaGetAllocationInfo(allocator, pending_move.buffer->allocation, &pending_move.buffer->info);
+        out_moved_buffers.emplace_back(pending_move.buffer);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ defragmenter.mutex };
+        defragmenter.run_stats.num_passes++;
+        defragmenter.run_stats.num_ignored_moves += num_ignored_moves;
+    }
+
+    if (pass_result == VK_SUCCESS)
+        end_run(defragmenter, allocator);
+}
+
+void vk_defrag::destroy_defragmenter(Defragmenter& defragmenter, VmaAllocator allocator)
+{
+    if (defragmenter.context != VK_NULL_HANDLE)
+        end_run(defragmenter, allocator);
+}
+
+bool vk_defrag::is_defragmentation_running(Defragmenter& defragmenter)
+{
+    std::lock_guard<std::mutex> lock{ defragmenter.mutex };
+    return defragmenter.is_running;
+}
+
+vk_defrag::Defrag_stats vk_defrag::get_run_stats(Defragmenter& defragmenter)
+{
+    std::lock_guard<std::mutex> lock{ defragmenter.mutex };
+    return defragmenter.run_stats;
+}
+
+vk_defrag::Defrag_stats vk_defrag::get_total_stats(Defragmenter& defragmenter, uint32_t& out_num_runs)
+{
+    std::lock_guard<std::mutex> lock{ defragmenter.mutex };
+    out_num_runs = defragmenter.num_runs;
+    return defragmenter.total_stats;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#if _WIN64
+
+#include <atomic>
+#include <cinttypes>
+#include <cmath>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+#include "renderer_win64_vk_buffer__allocated_buffer.h"
+
+namespace vk_util { struct Immediate_submit_support; }
+
+
+// Incremental VMA defragmentation.
+// @NOTE: A run is split into passes of bounded work (one per frame). Only
+//   buffers handed in as movable get moved, since moving one means
+//   recreating its `VkBuffer`, so its device address and every descriptor
+//   set pointing to it have to get fixed up afterwards. VMA proposes moves for
+//   every allocation, and the rest get ignored (which also marks their memory
+//   blocks as immovable for the rest of the run).
+namespace vk_defrag
+{
+
+struct Movable_buffer
+{
+    vk_buffer::Allocated_buffer* buffer;
+    // Contents get fully rewritten before their next use, so they don't
+    // have to be copied over to the new place.
+    bool is_rewritten_before_use{ false };
+};
+
+struct Defrag_stats
+{
+    uint32_t num_passes{ 0 };
+    uint32_t num_ignored_moves{ 0 };
+    uint32_t num_allocations_moved{ 0 };
+    uint64_t num_bytes_moved{ 0 };
+    uint32_t num_blocks_freed{ 0 };
+    uint64_t num_bytes_freed{ 0 };  // Device memory given back.
+};
+
+struct Defragmenter
+{
+    VmaDefragmentationContext context{ VK_NULL_HANDLE };
+
+    // Work per pass.
+    uint64_t max_bytes_per_pass{ 8 * 1024 * 1024 };
+    uint32_t max_allocations_per_pass{ 16 };
+
+    // Starts a run on its own once the unused space in the device local
+    // heaps' blocks is over both of these.
+    uint32_t check_interval_frames{ 120 };
+    uint32_t num_frames_until_check{ 0 };
+    float_t min_unused_fraction{ 0.25f };
+    uint64_t min_unused_bytes{ 32 * 1024 * 1024 };
+
+    std::atomic_bool is_run_requested{ false };
+
+    // Guarded by `mutex`.
+    std::mutex mutex;
+    bool is_running{ false };
+    Defrag_stats run_stats;   // Run in progress (or latest).
+    Defrag_stats total_stats;
+    uint32_t num_runs{ 0 };
+};
+
+// Starts a run at the next pass, even if the heaps don't look fragmented.
+void request_defragmentation(Defragmenter& defragmenter);
+
+// Does one pass of the current run (starting one if requested or due), w/
+// a blocking submit if moved contents need a GPU copy.
+// Returns the moved buffers, which have their new `VkBuffer` and allocation
+// info. Their device addresses and descriptor sets have to be updated.
+// @NOTE: None of `movable_buffers` can be in use by the GPU or mapped w/
+//   `vmaMapMemory()` during the pass.
+void run_defragmentation_pass(Defragmenter& defragmenter,
+                              const vk_util::Immediate_submit_support& support,
+                              VkDevice device,
+                              VkQueue queue,
+                              VmaAllocator allocator,
+                              const std::vector<Movable_buffer>& movable_buffers,
+                              std::vector<vk_buffer::Allocated_buffer*>& out_moved_buffers);
+
+// Ends a run in progress.
+void destroy_defragmenter(Defragmenter& defragmenter, VmaAllocator allocator);
+
+bool is_defragmentation_running(Defragmenter& defragmenter);
+Defrag_stats get_run_stats(Defragmenter& defragmenter);
+Defrag_stats get_total_stats(Defragmenter& defragmenter, uint32_t& out_num_runs);
+
+}  // namespace vk_defrag
+
+#endif  // _WIN64
@@ -0,0 +1,424 @@
+#include "renderer_win64_vk_gpu_profiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include "cpu_profiler.h"
+
+
+const char* vk_profiler::get_gpu_zone_name(GPU_zone zone)
+{
+    constexpr std::array<const char*, k_num_gpu_zones> k_zone_names{
+        "Clear Background",
+        "Geometry Culling",
+        "Write Draw Cmds",
+        "Shadow Maps",
+        "Z Prepass",
+        "Material Pass",
+        "Blit to Swapchain",
+        "ImGui",
+    };
+    return k_zone_names[static_cast<size_t>(zone)];
+}
+
+const char* vk_profiler::get_gpu_stats_pass_name(GPU_stats_pass pass)
+{
+    constexpr std::array<const char*, k_num_gpu_stats_passes> k_pass_names{
+        "Geometry Culling",
+        "Shadow Maps",
+        "Opaque Geometry",
+    };
+    return k_pass_names[static_cast<size_t>(pass)];
+}
+
+bool vk_profiler::init_gpu_profiler(GPU_profiler& out_profiler,
+                                    VkDevice device,
+                                    const VkPhysicalDeviceProperties& physical_device_props,
+                                    uint32_t queue_timestamp_valid_bits,
+                                    bool is_pipeline_stats_query_enabled,
+                                    uint32_t num_frames_in_flight)
+{
+    out_profiler.pending_frame_numbers.resize(num_frames_in_flight, 0);
+    out_profiler.pending_submit_times_us.resize(num_frames_in_flight, -1.0);
+
+    // Pipeline statistics.
+    out_profiler.is_pipeline_stats_supported = is_pipeline_stats_query_enabled;
+    if (!out_profiler.is_pipeline_stats_supported)
+        std::cout << "NOTE: Pipeline statistics queries unsupported. Render pipeline stats disabled." << std::endl;
+    else
+        out_profiler.pipeline_stats_query_pools.resize(num_frames_in_flight, VK_NULL_HANDLE);
+    for (auto& query_pool : out_profiler.pipeline_stats_query_pools)
+    {
+        VkQueryPoolCreateInfo query_pool_info{
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+            .queryCount = static_cast<uint32_t>(k_num_gpu_stats_passes),
+            .pipelineStatistics = k_pipeline_stats_flags,
+        };
+        VkResult err{ vkCreateQueryPool(device, &query_pool_info, nullptr, &query_pool) };
+        if (err)
+        {
+            std::cerr << "ERROR: Create pipeline statistics query pool failed." << std::endl;
+            assert(false);
+            return false;
+        }
+        vkResetQueryPool(device, query_pool, 0, query_pool_info.queryCount);
+    }
+
+    // Timestamps.
+    out_profiler.is_supported =
+        (physical_device_props.limits.timestampComputeAndGraphics == VK_TRUE &&
+         queue_timestamp_valid_bits > 0);
+    if (!out_profiler.is_supported)
+    {
+        std::cout << "NOTE: Timestamp queries unsupported. GPU pass timings disabled." << std::endl;
+        return true;
+    }
+
+    out_profiler.timestamp_period_ns = physical_device_props.limits.timestampPeriod;
+    out_profiler.timestamp_mask =
+        (queue_timestamp_valid_bits >= 64 ?
+            ~uint64_t(0) :
+            (uint64_t(1) << queue_timestamp_valid_bits) - 1);
+
+    out_profiler.query_pools.resize(num_frames_in_flight, VK_NULL_HANDLE);
+    for (auto& query_pool : out_profiler.query_pools)
+    {
+        VkQueryPoolCreateInfo query_pool_info{
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = static_cast<uint32_t>(k_num_gpu_zones * 2),
+        };
+        VkResult err{ vkCreateQueryPool(device, &query_pool_info, nullptr, &query_pool) };
+        if (err)
+        {
+            std::cerr << "ERROR: Create timestamp query pool failed." << std::endl;
+            assert(false);
+            return false;
+        }
+
+        // Queries have to be reset before their first write.
+        vkResetQueryPool(device, query_pool, 0, query_pool_info.queryCount);
+    }
+
+    return true;
+}
+
+void vk_profiler::destroy_gpu_profiler(const GPU_profiler& profiler, VkDevice device)
+{
+    for (auto query_pool : profiler.query_pools)
+        vkDestroyQueryPool(device, query_pool, nullptr);
+    for (auto query_pool : profiler.pipeline_stats_query_pools)
+        vkDestroyQueryPool(device, query_pool, nullptr);
+}
+
+void vk_profiler::cmd_begin_zone(VkCommandBuffer cmd,
+                                 const GPU_profiler& profiler,
+                                 uint32_t frame_idx,
+                                 GPU_zone zone)
+{
+    if (!profiler.is_supported)
+        return;
+
+    // @NOTE: Waits for all previous cmds, so zones don't overlap each other.
+    vkCmdWriteTimestamp2(cmd,
+                         VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                         profiler.query_pools[frame_idx],
+                         static_cast<uint32_t>(zone) * 2);
+}
+
+void vk_profiler::cmd_end_zone(VkCommandBuffer cmd,
+                               const GPU_profiler& profiler,
+                               uint32_t frame_idx,
+                               GPU_zone zone)
+{
+    if (!profiler.is_supported)
+        return;
+
+    vkCmdWriteTimestamp2(cmd,
+                         VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                         profiler.query_pools[frame_idx],
+                         static_cast<uint32_t>(zone) * 2 + 1);
+}
+
+void vk_profiler::cmd_begin_pipeline_stats(VkCommandBuffer cmd,
+                                           const GPU_profiler& profiler,
+                                           uint32_t frame_idx,
+                                           GPU_stats_pass pass)
+{
+    if (!profiler.is_pipeline_stats_supported)
+        return;
+
+    vkCmdBeginQuery(cmd,
+                    profiler.pipeline_stats_query_pools[frame_idx],
+                    static_cast<uint32_t>(pass),
+                    0);
+}
+
+void vk_profiler::cmd_end_pipeline_stats(VkCommandBuffer cmd,
+                                         const GPU_profiler& profiler,
+                                         uint32_t frame_idx,
+                                         GPU_stats_pass pass)
+{
+    if (!profiler.is_pipeline_stats_supported)
+        return;
+
+    vkCmdEndQuery(cmd,
+                  profiler.pipeline_stats_query_pools[frame_idx],
+                  static_cast<uint32_t>(pass));
+}
+
+// Reads back and resets the pipeline statistics queries of `frame_idx`.
+static void collect_frame_pipeline_stats(vk_profiler::GPU_profiler& profiler,
+                                         VkDevice device,
+                                         uint32_t frame_idx)
+{
+    using namespace vk_profiler;
+
+    // Stats (in `Pipeline_stats` order) and availability of each pass.
+    constexpr size_t k_num_values_per_query{ 5 };
+    std::array<uint64_t, k_num_gpu_stats_passes * k_num_values_per_query> results;
+    VkQueryPool query_pool{ profiler.pipeline_stats_query_pools[frame_idx] };
+    VkResult err{
+        vkGetQueryPoolResults(device,
+                              query_pool,
+                              0,
+                              static_cast<uint32_t>(k_num_gpu_stats_passes),
+                              sizeof(results),
+                              results.data(),
+                              sizeof(uint64_t) * k_num_values_per_query,
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) };
+    vkResetQueryPool(device, query_pool, 0, static_cast<uint32_t>(k_num_gpu_stats_passes));
+    if (err != VK_SUCCESS && err != VK_NOT_READY)
+    {
+        std::cerr << "ERROR: Get pipeline statistics query results failed." << std::endl;
+        assert(false);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock{ profiler.mutex };
+    for (size_t i = 0; i < k_num_gpu_stats_passes; i++)
+    {
+        const uint64_t* values{ &results[i * k_num_values_per_query] };
+        if (values[4] == 0)
+            continue;  // Pass wasn't recorded this frame.
+
+        profiler.latest_pipeline_stats[i] = Pipeline_stats{
+            .vertex_shader_invocations = values[0],
+            .clipping_primitives = values[1],
+            .fragment_shader_invocations = values[2],
+            .compute_shader_invocations = values[3],
+        };
+    }
+}
+
+void vk_profiler::collect_frame_results(GPU_profiler& profiler,
+                                        VkDevice device,
+                                        uint32_t frame_idx)
+{
+    double_t submit_time_us{ profiler.pending_submit_times_us[frame_idx] };
+    if (submit_time_us < 0.0)
+    {
+        // Nothing was submitted w/ this frame's queries.
+        return;
+    }
+    profiler.pending_submit_times_us[frame_idx] = -1.0;
+
+    if (profiler.is_pipeline_stats_supported)
+        collect_frame_pipeline_stats(profiler, device, frame_idx);
+    if (!profiler.is_supported)
+        return;
+
+    // Timestamp and availability pairs.
+    // @NOTE: No `VK_QUERY_RESULT_WAIT_BIT`. Unrecorded zones stay unavailable
+    //   and are skipped (which makes this return `VK_NOT_READY`).
+    std::array<uint64_t, k_num_gpu_zones * 2 * 2> results;
+    VkQueryPool query_pool{ profiler.query_pools[frame_idx] };
+    VkResult err{
+        vkGetQueryPoolResults(device,
+                              query_pool,
+                              0,
+                              static_cast<uint32_t>(k_num_gpu_zones * 2),
+                              sizeof(results),
+                              results.data(),
+                              sizeof(uint64_t) * 2,
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) };
+    vkResetQueryPool(device, query_pool, 0, static_cast<uint32_t>(k_num_gpu_zones * 2));
+    if (err != VK_SUCCESS && err != VK_NOT_READY)
+    {
+        std::cerr << "ERROR: Get timestamp query results failed." << std::endl;
+        assert(false);
+        return;
+    }
+
+    // Place the frame at its submit time (see `export_chrome_trace()`).
+    uint64_t first_tick{ ~uint64_t(0) };
+    uint32_t recorded_zone_mask{ 0 };
+    for (uint32_t i = 0; i < k_num_gpu_zones; i++)
+    {
+        const uint64_t* begin{ &results[i * 4] };
+        const uint64_t* end{ &results[i * 4 + 2] };
+        if (begin[1] != 0 && end[1] != 0)
+        {
+            recorded_zone_mask |= (1u << i);
+            first_tick = std::min(first_tick, begin[0] & profiler.timestamp_mask);
+        }
+    }
+    if (recorded_zone_mask == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock{ profiler.mutex };
+    auto& trace_frame{
+        profiler.trace_frames[profiler.num_trace_frames_written++ % k_num_trace_frames] };
+    trace_frame.frame_number = profiler.pending_frame_numbers[frame_idx];
+    trace_frame.recorded_zone_mask = recorded_zone_mask;
+
+    for (uint32_t i = 0; i < k_num_gpu_zones; i++)
+    {
+        if (((recorded_zone_mask >> i) & 1) == 0)
+            continue;
+
+        uint64_t begin_tick{ results[i * 4] & profiler.timestamp_mask };
+        uint64_t end_tick{ results[i * 4 + 2] & profiler.timestamp_mask };
+        double_t begin_ns{ (begin_tick - first_tick) * profiler.timestamp_period_ns };
+        double_t duration_ns{ (end_tick - begin_tick) * profiler.timestamp_period_ns };
+        trace_frame.begin_us[i] = submit_time_us + begin_ns / 1000.0;
+        trace_frame.end_us[i] = trace_frame.begin_us[i] + duration_ns / 1000.0;
+
+        auto& history{ profiler.zone_histories[i] };
+        history.samples_ms[history.num_samples_written++ % k_num_zone_stat_samples] =
+            static_cast<float_t>(duration_ns / 1000000.0);
+    }
+}
+
+void vk_profiler::mark_frame_submitted(GPU_profiler& profiler,
+                                       uint32_t frame_idx,
+                                       uint64_t frame_number)
+{
+    profiler.pending_frame_numbers[frame_idx] = frame_number;
+    profiler.pending_submit_times_us[frame_idx] = cpu_profiler::now_ns() / 1000.0;
+}
+
+vk_profiler::Zone_stats vk_profiler::get_zone_stats(GPU_profiler& profiler, GPU_zone zone)
+{
+    std::array<float_t, k_num_zone_stat_samples> samples;
+    uint32_t num_samples;
+    {
+        std::lock_guard<std::mutex> lock{ profiler.mutex };
+        auto& history{ profiler.zone_histories[static_cast<size_t>(zone)] };
+        num_samples = std::min(history.num_samples_written, k_num_zone_stat_samples);
+        std::copy_n(history.samples_ms.begin(), num_samples, samples.begin());
+    }
+
+    Zone_stats stats;
+    stats.num_samples = num_samples;
+    if (num_samples == 0)
+        return stats;
+
+    float_t total_ms{ 0.0f };
+    stats.min_ms = samples[0];
+    for (uint32_t i = 0; i < num_samples; i++)
+    {
+        total_ms += samples[i];
+        stats.min_ms = std::min(stats.min_ms, samples[i]);
+    }
+    stats.avg_ms = total_ms / num_samples;
+
+    uint32_t p99_idx{ std::min(num_samples - 1,
+                               static_cast<uint32_t>(std::ceil(num_samples * 0.99f)) - 1) };
+    std::nth_element(samples.begin(), samples.begin() + p99_idx, samples.begin() + num_samples);
+    stats.p99_ms = samples[p99_idx];
+
+    return stats;
+}
+
+void vk_profiler::get_latest_zone_times(GPU_profiler& profiler,
+                                        std::array<float_t, k_num_gpu_zones>& out_zone_ms)
+{
+    out_zone_ms.fill(0.0f);
+
+    std::lock_guard<std::mutex> lock{ profiler.mutex };
+    if (profiler.num_trace_frames_written == 0)
+        return;
+
+    auto& trace_frame{
+        profiler.trace_frames[(profiler.num_trace_frames_written - 1) % k_num_trace_frames] };
+    for (uint32_t zone = 0; zone < k_num_gpu_zones; zone++)
+        if ((trace_frame.recorded_zone_mask >> zone) & 1)
+            out_zone_ms[zone] =
+                static_cast<float_t>((trace_frame.end_us[zone] - trace_frame.begin_us[zone]) / 1000.0);
+}
+
+vk_profiler::Pipeline_stats vk_profiler::get_pipeline_stats(GPU_profiler& profiler,
+                                                            GPU_stats_pass pass)
+{
+    std::lock_guard<std::mutex> lock{ profiler.mutex };
+    return profiler.latest_pipeline_stats[static_cast<size_t>(pass)];
+}
+
+bool vk_profiler::export_chrome_trace(GPU_profiler& profiler, const std::string& file_path)
+{
+    std::ofstream file{ file_path };
+    if (!file.is_open())
+    {
+        std::cerr << "ERROR: Opening trace file \"" << file_path << "\" failed." << std::endl;
+        return false;
+    }
+
+    constexpr uint32_t k_cpu_pid{ 1 };
+    constexpr uint32_t k_gpu_pid{ 2 };
+    bool is_first_event{ true };
+    auto write_event = [&](const char* name,
+                           const char* category,
+                           uint32_t pid,
+                           uint32_t tid,
+                           double_t begin_us,
+                           double_t end_us) {
+        file << (is_first_event ? "\n" : ",\n")
+             << "{\"name\":\"" << name << "\","
+             << "\"cat\":\"" << category << "\","
+             << "\"ph\":\"X\","
+             << "\"pid\":" << pid << ","
+             << "\"tid\":" << tid << ","
+             << "\"ts\":" << begin_us << ","
+             << "\"dur\":" << (end_us - begin_us) << "}";
+        is_first_event = false;
+    };
+
+    file << std::fixed << "{\"traceEvents\":[";
+    file << "\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << k_cpu_pid
+         << ",\"args\":{\"name\":\"CPU\"}},"
+         << "\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << k_gpu_pid
+         << ",\"args\":{\"name\":\"GPU\"}}";
+    is_first_event = false;
+
+    cpu_profiler::write_chrome_trace_events(file, k_cpu_pid, is_first_event);
+
+    {
+        std::lock_guard<std::mutex> lock{ profiler.mutex };
+        uint64_t num_frames{ std::min<uint64_t>(profiler.num_trace_frames_written,
+                                                k_num_trace_frames) };
+        for (uint64_t i = 0; i < num_frames; i++)
+        {
+            auto& trace_frame{ profiler.trace_frames[i] };
+            for (uint32_t zone = 0; zone < k_num_gpu_zones; zone++)
+            {
+                if (((trace_frame.recorded_zone_mask >> zone) & 1) == 0)
+                    continue;
+
+                write_event(get_gpu_zone_name(static_cast<GPU_zone>(zone)),
+                            "gpu",
+                            k_gpu_pid,
+                            0,
+                            trace_frame.begin_us[zone],
+                            trace_frame.end_us[zone]);
+            }
+        }
+    }
+
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return file.good();
+}
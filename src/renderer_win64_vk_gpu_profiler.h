@@ -0,0 +1,160 @@
+#pragma once
+
+#if _WIN64
+
+#include <array>
+#include <cmath>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+
+namespace vk_profiler
+{
+
+// GPU zones, timed w/ a pair of timestamp queries each.
+// @NOTE: Zones that don't get recorded in a frame (e.g. write draw cmds
+//   while fused geometry culling is on) just get no sample that frame.
+enum class GPU_zone : uint8_t
+{
+    CLEAR_BACKGROUND = 0,
+    GEOMETRY_CULLING,
+    WRITE_DRAW_CMDS,
+    SHADOW_MAPS,
+    Z_PREPASS,
+    MATERIAL_PASS,
+    BLIT_TO_SWAPCHAIN,
+    IMGUI,
+    NUM_GPU_ZONES
+};
+constexpr size_t k_num_gpu_zones{ static_cast<size_t>(GPU_zone::NUM_GPU_ZONES) };
+
+const char* get_gpu_zone_name(GPU_zone zone);
+
+// Passes w/ a pipeline statistics query around them.
+// @NOTE: Pipeline statistics queries can't overlap, so these are whole
+//   render pass cmds instead of the finer grained `GPU_zone`s.
+enum class GPU_stats_pass : uint8_t
+{
+    GEOMETRY_CULLING = 0,
+    SHADOW_MAPS,
+    OPAQUE_GEOMETRY,
+    NUM_GPU_STATS_PASSES
+};
+constexpr size_t k_num_gpu_stats_passes{
+    static_cast<size_t>(GPU_stats_pass::NUM_GPU_STATS_PASSES) };
+
+const char* get_gpu_stats_pass_name(GPU_stats_pass pass);
+
+// @NOTE: In the order Vulkan writes the queried statistics in (bit order).
+struct Pipeline_stats
+{
+    uint64_t vertex_shader_invocations{ 0 };
+    uint64_t clipping_primitives{ 0 };
+    uint64_t fragment_shader_invocations{ 0 };
+    uint64_t compute_shader_invocations{ 0 };
+};
+constexpr VkQueryPipelineStatisticFlags k_pipeline_stats_flags{
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT };
+
+constexpr uint32_t k_num_zone_stat_samples{ 512 };  // Per zone, for min/avg/p99.
+constexpr uint32_t k_num_trace_frames{ 256 };       // Latest frames kept for trace export.
+
+struct Zone_stats
+{
+    float_t min_ms{ 0.0f };
+    float_t avg_ms{ 0.0f };
+    float_t p99_ms{ 0.0f };
+    uint32_t num_samples{ 0 };
+};
+
+// Timestamp and pipeline statistics queries of every frame in flight, and
+// the history of their results.
+// @NOTE: Each frame in flight has its own query pools. They get read back
+//   (w/o waiting) and host reset once the frame's fence has signaled, so the
+//   results are `num_frames_in_flight` frames old and never stall the CPU.
+struct GPU_profiler
+{
+    bool is_supported{ false };  // Timestamps.
+    bool is_pipeline_stats_supported{ false };
+    double_t timestamp_period_ns{ 1.0 };
+    uint64_t timestamp_mask{ 0 };
+
+    std::vector<VkQueryPool> query_pools;
+    std::vector<VkQueryPool> pipeline_stats_query_pools;
+    std::vector<uint64_t> pending_frame_numbers;
+    std::vector<double_t> pending_submit_times_us;
+
+    // History (guarded by `mutex`).
+    std::mutex mutex;
+    struct Zone_history
+    {
+        std::array<float_t, k_num_zone_stat_samples> samples_ms;
+        uint32_t num_samples_written{ 0 };
+    };
+    std::array<Zone_history, k_num_gpu_zones> zone_histories;
+
+    struct Trace_frame
+    {
+        uint64_t frame_number;
+        uint32_t recorded_zone_mask;  // Bit per `GPU_zone`.
+        std::array<double_t, k_num_gpu_zones> begin_us;
+        std::array<double_t, k_num_gpu_zones> end_us;
+    };
+    std::array<Trace_frame, k_num_trace_frames> trace_frames;
+    uint64_t num_trace_frames_written{ 0 };
+
+    // Latest frame that recorded each pass.
+    std::array<Pipeline_stats, k_num_gpu_stats_passes> latest_pipeline_stats;
+};
+
+bool init_gpu_profiler(GPU_profiler& out_profiler,
+                       VkDevice device,
+                       const VkPhysicalDeviceProperties& physical_device_props,
+                       uint32_t queue_timestamp_valid_bits,
+                       bool is_pipeline_stats_query_enabled,
+                       uint32_t num_frames_in_flight);
+void destroy_gpu_profiler(const GPU_profiler& profiler, VkDevice device);
+
+void cmd_begin_zone(VkCommandBuffer cmd,
+                    const GPU_profiler& profiler,
+                    uint32_t frame_idx,
+                    GPU_zone zone);
+void cmd_end_zone(VkCommandBuffer cmd,
+                  const GPU_profiler& profiler,
+                  uint32_t frame_idx,
+                  GPU_zone zone);
+
+// @NOTE: Has to begin and end in the same cmd buffer, outside of rendering.
+// @NOTE: No-ops w/o the `pipelineStatisticsQuery` device feature.
+void cmd_begin_pipeline_stats(VkCommandBuffer cmd,
+                              const GPU_profiler& profiler,
+                              uint32_t frame_idx,
+                              GPU_stats_pass pass);
+void cmd_end_pipeline_stats(VkCommandBuffer cmd,
+                            const GPU_profiler& profiler,
+                            uint32_t frame_idx,
+                            GPU_stats_pass pass);
+
+// Call once the frame's fence has signaled and before recording into it again.
+void collect_frame_results(GPU_profiler& profiler, VkDevice device, uint32_t frame_idx);
+void mark_frame_submitted(GPU_profiler& profiler, uint32_t frame_idx, uint64_t frame_number);
+
+Zone_stats get_zone_stats(GPU_profiler& profiler, GPU_zone zone);
+// Zone times of the latest read back frame (0 for zones it didn't record).
+void get_latest_zone_times(GPU_profiler& profiler, std::array<float_t, k_num_gpu_zones>& out_zone_ms);
+Pipeline_stats get_pipeline_stats(GPU_profiler& profiler, GPU_stats_pass pass);
+
+// Writes the kept GPU frames and the CPU profiler's zones as a Chrome trace
+// (`chrome://tracing`, Perfetto) JSON file.
+// @NOTE: There's no GPU/CPU clock calibration, so every GPU frame is
+//   placed starting at the time its cmds were submitted.
+bool export_chrome_trace(GPU_profiler& profiler, const std::string& file_path);
+
+}  // namespace vk_profiler
+
+#endif  // _WIN64
@@ -7,8 +7,11 @@
 
 void vk_util::init_immediate_submit_support(Immediate_submit_support& out_support,
                                             VkDevice device,
-                                            uint32_t graphics_queue_family_idx)
+                                            uint32_t graphics_queue_family_idx,
+                                            std::mutex* queue_mutex)
 {
+    out_support.queue_mutex = queue_mutex;
+
     VkCommandPoolCreateInfo cmd_pool_info{
         .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
         .pNext = nullptr,
@@ -106,7 +109,13 @@ void vk_util::immediate_submit(const Immediate_submit_support& support,
     VkSubmitInfo2 submit_info{
         vk_util::submit_info(&cmd_buffer_submit_info, nullptr, nullptr) };
 
-    err = vkQueueSubmit2(queue, 1, &submit_info, support.fence);
+    if (support.queue_mutex != nullptr)
+    {
+        std::lock_guard<std::mutex> lock{ *support.queue_mutex };
+        err = vkQueueSubmit2(queue, 1, &submit_info, support.fence);
+    }
+    else
+        err = vkQueueSubmit2(queue, 1, &submit_info, support.fence);
     if (err)
     {
         std::cerr << "ERROR: Submit immediate submit failed." << std::endl;
@@ -3,6 +3,7 @@
 #if _WIN64
 
 #include <functional>
+#include <mutex>
 #include <vulkan/vulkan.h>
 
 
@@ -14,11 +15,13 @@ struct Immediate_submit_support
     VkFence fence;
     VkCommandBuffer command_buffer;
     VkCommandPool command_pool;
+    std::mutex* queue_mutex;  // Guards submits to a queue shared with other threads.
 };
 
 void init_immediate_submit_support(Immediate_submit_support& out_support,
                                    VkDevice device,
-                                   uint32_t graphics_queue_family_idx);
+                                   uint32_t graphics_queue_family_idx,
+                                   std::mutex* queue_mutex);
 void destroy_immediate_submit_support(const Immediate_submit_support& support,
                                       VkDevice device);
 
@@ -0,0 +1,270 @@
+#include "renderer_win64_vk_memory_budget.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include "cpu_profiler.h"
+
+
+namespace vk_memory
+{
+
+// @NOTE: Global since `vk_buffer::create_buffer()` and friends don't get
+//   passed any renderer state, and there's only the one allocator anyways.
+static std::array<std::atomic_uint64_t, k_num_memory_categories> s_category_num_bytes{};
+static std::array<std::atomic_uint32_t, k_num_memory_categories> s_category_num_allocations{};
+
+// Category is stored +1 in the user data, so that untagged allocations
+// (null user data) are told apart from `MESH`.
+static void* category_to_user_data(Memory_category category)
+{
+    return reinterpret_cast<void*>(static_cast<uintptr_t>(category) + 1);
+}
+
+static Pressure_level calc_pressure_level(const Memory_budget& budget, float_t fraction)
+{
+    if (fraction >= budget.critical_fraction)
+        return Pressure_level::CRITICAL;
+    if (fraction >= budget.warning_fraction)
+        return Pressure_level::WARNING;
+    return Pressure_level::NORMAL;
+}
+
+}  // namespace vk_memory
+
+
+const char* vk_memory::get_memory_category_name(Memory_category category)
+{
+    constexpr std::array<const char*, k_num_memory_categories> k_category_names{
+        "Mesh",
+        "Instance",
+        "Indirect",
+        "Material",
+        "Texture",
+        "Render Target",
+        "Staging",
+        "Other",
+    };
+    return k_category_names[static_cast<size_t>(category)];
+}
+
+void vk_memory::track_allocation(VmaAllocator allocator,
+                                 VmaAllocation allocation,
+                                 Memory_category category)
+{
+    assert(category < Memory_category::NUM_MEMORY_CATEGORIES);
+    vmaSetAllocationUserData(allocator, allocation, category_to_user_data(category));
+
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, allocation, &info);
+    s_category_num_bytes[static_cast<size_t>(category)] += info.size;
+    s_category_num_allocations[static_cast<size_t>(category)]++;
+}
+
+void vk_memory::untrack_allocation(VmaAllocator allocator, VmaAllocation allocation)
+{
+    if (allocation == VK_NULL_HANDLE)
+        return;
+
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, allocation, &info);
+    if (info.pUserData == nullptr)
+        return;
+
+    size_t category_idx{ reinterpret_cast<uintptr_t>(info.pUserData) - 1 };
+    assert(category_idx < k_num_memory_categories);
+    s_category_num_bytes[category_idx] -= info.size;
+    s_category_num_allocations[category_idx]--;
+    vmaSetAllocationUserData(allocator, allocation, nullptr);
+}
+
+vk_memory::Category_usage vk_memory::get_category_usage(Memory_category category)
+{
+    return Category_usage{
+        .num_bytes = s_category_num_bytes[static_cast<size_t>(category)],
+        .num_allocations = s_category_num_allocations[static_cast<size_t>(category)],
+    };
+}
+
+const char* vk_memory::get_pressure_level_name(Pressure_level level)
+{
+    switch (level)
+    {
+        case Pressure_level::NORMAL:   return "Normal";
+        case Pressure_level::WARNING:  return "Warning";
+        case Pressure_level::CRITICAL: return "Critical";
+    }
+    return "Unknown";
+}
+
+void vk_memory::init_memory_budget(Memory_budget& out_budget,
+                                   VmaAllocator allocator,
+                                   bool is_memory_budget_ext_enabled)
+{
+    if (!is_memory_budget_ext_enabled)
+        std::cerr << "WARNING: `VK_EXT_memory_budget` not supported. Memory budgets are estimated." << std::endl;
+
+    out_budget.num_frames_until_sample = 0;
+    sample_memory_budget(out_budget, allocator);
+}
+
+void vk_memory::tick_memory_budget(Memory_budget& budget, VmaAllocator allocator, uint32_t frame_number)
+{
+    // @NOTE: This is also when VMA refetches the budgets from the driver.
+    vmaSetCurrentFrameIndex(allocator, frame_number);
+
+    if (budget.num_frames_until_sample > 0)
+    {
+        budget.num_frames_until_sample--;
+        return;
+    }
+    budget.num_frames_until_sample = budget.sample_interval_frames;
+    sample_memory_budget(budget, allocator);
+}
+
+void vk_memory::sample_memory_budget(Memory_budget& budget, VmaAllocator allocator)
+{
+    CPU_PROFILER_ZONE("Sample Memory Budget");
+
+    const VkPhysicalDeviceMemoryProperties* memory_props;
+    vmaGetMemoryProperties(allocator, &memory_props);
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> vma_budgets;
+    vmaGetHeapBudgets(allocator, vma_budgets.data());
+
+    Pressure_event event;
+    std::vector<Memory_budget::Callback_entry> callbacks;
+    {
+        std::lock_guard<std::mutex> lock{ budget.mutex };
+
+        budget.heap_samples.resize(memory_props->memoryHeapCount);
+        float_t fullest_fraction{ 0.0f };
+        for (uint32_t i = 0; i < memory_props->memoryHeapCount; i++)
+        {
+            auto& sample{ budget.heap_samples[i] };
+            sample = Heap_sample{
+                .usage_bytes = vma_budgets[i].usage,
+                .budget_bytes = vma_budgets[i].budget,
+                .allocation_bytes = vma_budgets[i].statistics.allocationBytes,
+                .block_bytes = vma_budgets[i].statistics.blockBytes,
+                .is_device_local =
+                    (memory_props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0,
+            };
+            if (!sample.is_device_local || sample.budget_bytes == 0)
+                continue;
+
+            float_t fraction{
+                static_cast<float_t>(static_cast<double_t>(sample.usage_bytes) / sample.budget_bytes) };
+            if (fraction > fullest_fraction)
+            {
+                fullest_fraction = fraction;
+                budget.fullest_heap_idx = i;
+            }
+        }
+
+        Pressure_level new_level{ calc_pressure_level(budget, fullest_fraction) };
+        if (new_level < budget.level)
+        {
+            // Only drop once comfortably under the threshold.
+            new_level = std::min(budget.level,
+                                 calc_pressure_level(budget,
+                                                     fullest_fraction + budget.level_drop_margin));
+        }
+        if (new_level == budget.level)
+            return;
+
+        auto& fullest_sample{ budget.heap_samples[budget.fullest_heap_idx] };
+        event = Pressure_event{
+            .level = new_level,
+            .prev_level = budget.level,
+            .heap_idx = budget.fullest_heap_idx,
+            .usage_bytes = fullest_sample.usage_bytes,
+            .budget_bytes = fullest_sample.budget_bytes,
+        };
+        budget.level = new_level;
+        callbacks = budget.callbacks;
+    }
+
+    if (event.level > event.prev_level)
+        std::cerr
+            << "WARNING: GPU memory pressure " << get_pressure_level_name(event.level)
+            << " (heap " << event.heap_idx << ": "
+            << (event.usage_bytes / 1024.0f / 1024.0f) << " MB usage / "
+            << (event.budget_bytes / 1024.0f / 1024.0f) << " MB budget)." << std::endl;
+
+    for (auto& entry : callbacks)
+        entry.callback(event);
+}
+
+void vk_memory::set_pressure_thresholds(Memory_budget& budget,
+                                        float_t warning_fraction,
+                                        float_t critical_fraction)
+{
+    assert(warning_fraction <= critical_fraction);
+    std::lock_guard<std::mutex> lock{ budget.mutex };
+    budget.warning_fraction = warning_fraction;
+    budget.critical_fraction = critical_fraction;
+}
+
+vk_memory::pressure_callback_key_t vk_memory::add_pressure_callback(Memory_budget& budget,
+                                                                    Pressure_callback_t&& callback)
+{
+    std::lock_guard<std::mutex> lock{ budget.mutex };
+    pressure_callback_key_t key{ budget.next_callback_key++ };
+    budget.callbacks.emplace_back(Memory_budget::Callback_entry{
+        .key = key,
+        .callback = std::move(callback),
+    });
+    return key;
+}
+
+void vk_memory::remove_pressure_callback(Memory_budget& budget, pressure_callback_key_t key)
+{
+    std::lock_guard<std::mutex> lock{ budget.mutex };
+    std::erase_if(budget.callbacks, [key](const auto& entry) {
+        return entry.key == key;
+    });
+}
+
+vk_memory::Pressure_level vk_memory::get_pressure_level(Memory_budget& budget)
+{
+    std::lock_guard<std::mutex> lock{ budget.mutex };
+    return budget.level;
+}
+
+void vk_memory::get_heap_samples(Memory_budget& budget, std::vector<Heap_sample>& out_heap_samples)
+{
+    std::lock_guard<std::mutex> lock{ budget.mutex };
+    out_heap_samples = budget.heap_samples;
+}
+
+void vk_memory::print_memory_report(Memory_budget& budget)
+{
+    std::vector<Heap_sample> heap_samples;
+    get_heap_samples(budget, heap_samples);
+
+    std::cout << "-=-=- GPU Memory Report -=-=-" << std::endl;
+    for (uint32_t i = 0; i < heap_samples.size(); i++)
+    {
+        auto& sample{ heap_samples[i] };
+        std::cout
+            << "# Memory Heap " << i << (sample.is_device_local ? " (device local)" : "") << std::endl
+            << "  " << (sample.allocation_bytes / 1024.0f / 1024.0f) << " MB allocations" << std::endl
+            << "  " << (sample.block_bytes / 1024.0f / 1024.0f) << " MB blocks" << std::endl
+            << "  " << (sample.usage_bytes / 1024.0f / 1024.0f) << " MB usage / "
+                    << (sample.budget_bytes / 1024.0f / 1024.0f) << " MB budget" << std::endl;
+    }
+
+    std::cout << "# Categories" << std::endl;
+    for (size_t i = 0; i < k_num_memory_categories; i++)
+    {
+        auto category{ static_cast<Memory_category>(i) };
+        auto usage{ get_category_usage(category) };
+        std::cout
+            << "  " << get_memory_category_name(category) << ": "
+            << usage.num_allocations << " allocations ("
+            << (usage.num_bytes / 1024.0f / 1024.0f) << " MB)" << std::endl;
+    }
+    std::cout << "Pressure level: " << get_pressure_level_name(get_pressure_level(budget)) << std::endl;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#if _WIN64
+
+#include <cinttypes>
+#include <cmath>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+
+
+namespace vk_memory
+{
+
+// What an allocation is used for, to see where the memory goes.
+enum class Memory_category : uint8_t
+{
+    MESH = 0,
+    INSTANCE,
+    INDIRECT,
+    MATERIAL,
+    TEXTURE,
+    RENDER_TARGET,
+    STAGING,
+    OTHER,
+    NUM_MEMORY_CATEGORIES
+};
+constexpr size_t k_num_memory_categories{
+    static_cast<size_t>(Memory_category::NUM_MEMORY_CATEGORIES) };
+
+const char* get_memory_category_name(Memory_category category);
+
+// Counts the allocation under `category` and tags it w/ the category (as its
+// user data) so that `untrack_allocation()` knows what to subtract.
+// @NOTE: `vk_buffer::create_buffer()`/`destroy_buffer()` already do this.
+void track_allocation(VmaAllocator allocator,
+                      VmaAllocation allocation,
+                      Memory_category category);
+void untrack_allocation(VmaAllocator allocator, VmaAllocation allocation);
+
+struct Category_usage
+{
+    uint64_t num_bytes{ 0 };
+    uint32_t num_allocations{ 0 };
+};
+Category_usage get_category_usage(Memory_category category);
+
+enum class Pressure_level : uint8_t
+{
+    NORMAL = 0,
+    WARNING,
+    CRITICAL,
+};
+
+const char* get_pressure_level_name(Pressure_level level);
+
+struct Heap_sample
+{
+    uint64_t usage_bytes{ 0 };       // Whole process (incl. other APIs/drivers) if the budget ext is there.
+    uint64_t budget_bytes{ 0 };
+    uint64_t allocation_bytes{ 0 };  // VMA allocations.
+    uint64_t block_bytes{ 0 };       // VMA device memory blocks.
+    bool is_device_local{ false };
+};
+
+// Sent whenever the pressure level changes.
+struct Pressure_event
+{
+    Pressure_level level;
+    Pressure_level prev_level;
+    uint32_t heap_idx;  // Device local heap w/ the highest usage/budget.
+    uint64_t usage_bytes;
+    uint64_t budget_bytes;
+};
+using Pressure_callback_t = std::function<void(const Pressure_event& event)>;
+using pressure_callback_key_t = uint32_t;
+
+// Heap budget sampling and the memory pressure level, which goes off the
+// fullest device local heap.
+// @NOTE: W/ `VK_EXT_memory_budget` the budgets come from the driver and
+//   follow what the OS gives this process. W/o it VMA guesses 80% of the
+//   heap size and only counts its own allocations.
+struct Memory_budget
+{
+    uint32_t sample_interval_frames{ 30 };
+    uint32_t num_frames_until_sample{ 0 };
+
+    // Guarded by `mutex`.
+    std::mutex mutex;
+    float_t warning_fraction{ 0.80f };   // Of budget.
+    float_t critical_fraction{ 0.95f };
+    float_t level_drop_margin{ 0.05f };  // Under the threshold to drop a level, so it doesn't flicker.
+    std::vector<Heap_sample> heap_samples;
+    Pressure_level level{ Pressure_level::NORMAL };
+    uint32_t fullest_heap_idx{ 0 };
+
+    struct Callback_entry
+    {
+        pressure_callback_key_t key;
+        Pressure_callback_t callback;
+    };
+    std::vector<Callback_entry> callbacks;
+    pressure_callback_key_t next_callback_key{ 0 };
+};
+
+void init_memory_budget(Memory_budget& out_budget,
+                        VmaAllocator allocator,
+                        bool is_memory_budget_ext_enabled);
+
+// Call once per frame. Samples the heap budgets every `sample_interval_frames`
+// and calls the pressure callbacks (on this thread) if the level changed.
+void tick_memory_budget(Memory_budget& budget, VmaAllocator allocator, uint32_t frame_number);
+void sample_memory_budget(Memory_budget& budget, VmaAllocator allocator);
+
+void set_pressure_thresholds(Memory_budget& budget,
+                             float_t warning_fraction,
+                             float_t critical_fraction);
+
+// @NOTE: Callbacks get called from the sampling thread, w/o any lock held, so
+//   they're free to (un)register callbacks or free up memory.
+pressure_callback_key_t add_pressure_callback(Memory_budget& budget,
+                                              Pressure_callback_t&& callback);
+void remove_pressure_callback(Memory_budget& budget, pressure_callback_key_t key);
+
+Pressure_level get_pressure_level(Memory_budget& budget);
+void get_heap_samples(Memory_budget& budget, std::vector<Heap_sample>& out_heap_samples);
+
+// Prints the latest heap samples and the usage of every category.
+void print_memory_report(Memory_budget& budget);
+
+}  // namespace vk_memory
+
+#endif  // _WIN64
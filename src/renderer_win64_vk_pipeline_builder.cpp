@@ -96,47 +96,50 @@ bool vk_pipeline::load_shader_module_spirv_reflect_extract_material_params(
 
 
     // Check that shader has necessary material param struct.
-    std::vector<SpvReflectDescriptorSet*> descriptor_sets;
+    // @NOTE: Material param datas are read thru a buffer reference in the push
+    //   constants (see `material_bank::GPU_pipeline::bind_pipeline()`).
+    std::vector<SpvReflectBlockVariable*> push_constant_blocks;
     SpvReflectResult result;
 
     uint32_t count;
-    result = shader_module.EnumerateDescriptorSets(&count, nullptr);
+    result = shader_module.EnumeratePushConstantBlocks(&count, nullptr);
     assert(result == SPV_REFLECT_RESULT_SUCCESS);
 
-    descriptor_sets.resize(count);
-    result = shader_module.EnumerateDescriptorSets(&count, descriptor_sets.data());
+    push_constant_blocks.resize(count);
+    result = shader_module.EnumeratePushConstantBlocks(&count, push_constant_blocks.data());
     assert(result == SPV_REFLECT_RESULT_SUCCESS);
 
     bool found{ false };
-    for (auto desc_set : descriptor_sets)
-    for (size_t i = 0; i < desc_set->binding_count; i++)
+    for (auto pc_block : push_constant_blocks)
+    for (size_t i = 0; i < pc_block->member_count; i++)
     {
-        auto binding{ desc_set->bindings[i] };
-        if (binding->descriptor_type == SPV_REFLECT_DESCRIPTOR_TYPE_STORAGE_BUFFER &&
-            std::string(binding->type_description->type_name) ==
+        auto buffer_ref{ &pc_block->members[i] };
+        if ((buffer_ref->type_description->type_flags & SPV_REFLECT_TYPE_FLAG_REF) &&
+            buffer_ref->type_description->type_name != nullptr &&
+            std::string(buffer_ref->type_description->type_name) ==
                 "Material_param_definitions_buffer")
         {
             // @TODO: make these all a bunch of requirements that will crash
             //   the program if not properly defined.
-            assert(binding->type_description->op == SpvOpTypeStruct);
-            assert(binding->type_description->member_count == 1);
-            assert(binding->type_description->members[0].op == SpvOpTypeRuntimeArray);
-            assert(binding->type_description->members[0].struct_type_description->op == SpvOpTypeStruct);
-            assert(std::string(binding->type_description->members[0].struct_type_description->type_name) == "Material_param_definition");
-            assert(std::string(binding->block.name) == "material_param_definitions_buffer");
-            assert(binding->block.member_count == 1);
-            assert(std::string(binding->block.members[0].name) == "definitions");
-            assert(binding->block.members[0].member_count > 0);
+            assert(buffer_ref->type_description->op == SpvOpTypeStruct);
+            assert(buffer_ref->type_description->member_count == 1);
+            assert(buffer_ref->type_description->members[0].op == SpvOpTypeRuntimeArray);
+            assert(buffer_ref->type_description->members[0].struct_type_description->op == SpvOpTypeStruct);
+            assert(std::string(buffer_ref->type_description->members[0].struct_type_description->type_name) == "Material_param_definition");
+            assert(std::string(buffer_ref->name) == "material_param_definitions_buffer");
+            assert(buffer_ref->member_count == 1);
+            assert(std::string(buffer_ref->members[0].name) == "definitions");
+            assert(buffer_ref->members[0].member_count > 0);
 
             // Find total size of param struct.
-            size_t total_padded_size{ binding->block.members[0].padded_size };
+            size_t total_padded_size{ buffer_ref->members[0].padded_size };
 
             // Clear definitions list.
             out_material_param_definitions.clear();
 
             // Iterate thru all struct members.
-            auto& struct_def{ *binding->type_description->members[0].struct_type_description };
-            auto& struct_block{ binding->block.members[0] };
+            auto& struct_def{ *buffer_ref->type_description->members[0].struct_type_description };
+            auto& struct_block{ buffer_ref->members[0] };
             for (size_t j = 0; j < struct_def.member_count; j++)
             {
                 // Decipher param type.
@@ -315,6 +318,16 @@ void vk_pipeline::Graphics_pipeline_builder::set_cull_mode(VkCullModeFlags cull_
     m_rasterizer.frontFace = front_face;
 }
 
+void vk_pipeline::Graphics_pipeline_builder::set_depth_clamp_and_bias(float_t constant_factor,
+                                                                      float_t slope_factor)
+{
+    m_rasterizer.depthClampEnable = VK_TRUE;
+    m_rasterizer.depthBiasEnable = VK_TRUE;
+    m_rasterizer.depthBiasConstantFactor = constant_factor;
+    m_rasterizer.depthBiasClamp = 0.0f;
+    m_rasterizer.depthBiasSlopeFactor = slope_factor;
+}
+
 void vk_pipeline::Graphics_pipeline_builder::disable_blending()
 {
     m_color_blend_attachment.colorWriteMask = (VK_COLOR_COMPONENT_R_BIT |
@@ -388,8 +401,8 @@ void vk_pipeline::Graphics_pipeline_builder::set_equal_nonwriting_depthtest()
 
 VkPipeline vk_pipeline::Graphics_pipeline_builder::build_pipeline(VkDevice device)
 {
-    assert(m_color_attachment_format != VK_FORMAT_UNDEFINED);
-
+    // @NOTE: Pipelines w/o any attachments are allowed (e.g. virtual shadow
+    //   map pipelines, which only write w/ atomics).
     VkPipelineViewportStateCreateInfo viewport_info{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
         .pNext = nullptr,
@@ -402,7 +415,7 @@ VkPipeline vk_pipeline::Graphics_pipeline_builder::build_pipeline(VkDevice devic
         .pNext = nullptr,
         .logicOpEnable = VK_FALSE,
         .logicOp = VK_LOGIC_OP_COPY,
-        .attachmentCount = 1,
+        .attachmentCount = m_render_info.colorAttachmentCount,
         .pAttachments = &m_color_blend_attachment,
     };
 
@@ -34,9 +34,10 @@ public:
     void set_input_topology(VkPrimitiveTopology topology);
     void set_polygon_mode(VkPolygonMode mode);
     void set_cull_mode(VkCullModeFlags cull_mode, VkFrontFace front_face);
+    void set_depth_clamp_and_bias(float_t constant_factor, float_t slope_factor);
     void disable_blending();
     void set_multisampling_none();
-    void set_color_attachment_format(VkFormat format);
+    void set_color_attachment_format(VkFormat format);  // @NOTE: Leave unset for depth only (or no attachments).
     void set_depth_format(VkFormat format);
     void disable_depthtest();
     void set_less_than_writing_depthtest();
@@ -91,14 +91,26 @@ void vk_util::transition_image(VkCommandBuffer cmd,
                                VkImageLayout current_layout,
                                VkImageLayout new_layout)
 {
+    auto is_depth_layout = [](VkImageLayout layout) {
+        return (layout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL ||
+                layout == VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL);
+    };
     VkImageAspectFlags aspect_mask{
         static_cast<VkImageAspectFlags>(
-            (new_layout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL) ?
+            (is_depth_layout(current_layout) || is_depth_layout(new_layout)) ?
                 VK_IMAGE_ASPECT_DEPTH_BIT :
                 VK_IMAGE_ASPECT_COLOR_BIT
         )
     };
+    transition_image(cmd, image, current_layout, new_layout, aspect_mask);
+}
 
+void vk_util::transition_image(VkCommandBuffer cmd,
+                               VkImage image,
+                               VkImageLayout current_layout,
+                               VkImageLayout new_layout,
+                               VkImageAspectFlags aspect_mask)
+{
     VkImageSubresourceRange subresource_range{
         .aspectMask = aspect_mask,
         .baseMipLevel = 0,
@@ -226,7 +238,7 @@ VkRenderingInfo vk_util::rendering_info(VkExtent2D render_extent,
         .pNext = nullptr,
         .renderArea = VkRect2D{ VkOffset2D{ 0, 0 }, render_extent },
         .layerCount = 1,
-        .colorAttachmentCount = 1,
+        .colorAttachmentCount = (color_attachment != nullptr ? 1u : 0u),
         .pColorAttachments = color_attachment,
         .pDepthAttachment = depth_attachment,
         .pStencilAttachment = nullptr,
@@ -32,6 +32,14 @@ void transition_image(VkCommandBuffer cmd,
                       VkImageLayout current_layout,
                       VkImageLayout new_layout);
 
+// @NOTE: For layouts that don't imply the aspect (e.g. transfer layouts of
+//   depth images).
+void transition_image(VkCommandBuffer cmd,
+                      VkImage image,
+                      VkImageLayout current_layout,
+                      VkImageLayout new_layout,
+                      VkImageAspectFlags aspect_mask);
+
 void blit_image_to_image(VkCommandBuffer cmd,
                          VkImage source,
                          VkImage destination,
@@ -0,0 +1,306 @@
+#include "transform_batch.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <mutex>
+#include <vector>
+#include "cpu_profiler.h"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define TRANSFORM_BATCH_USE_SSE 1
+#include <xmmintrin.h>
+#else
+#define TRANSFORM_BATCH_USE_SSE 0
+#endif
+
+
+namespace transform_batch
+{
+
+struct Source_entry
+{
+    bool is_reserved{ false };
+    Source_ifc* source{ nullptr };
+
+    // Interpolation alpha tracking.
+    bool has_tick{ false };
+    uint64_t last_tick_idx{ 0 };
+    float_t time_since_tick{ 0.0f };
+
+    std::vector<gpu_geo_data::GPU_instance_transform> interpolated_transforms;
+};
+
+constexpr size_t k_num_sources{ 64 };
+static std::mutex s_sources_mutex;
+static std::array<Source_entry, k_num_sources> s_sources;
+
+// Interpolates a single transform.
+// @NOTE: Used for the tail that doesn't fill up a SIMD lane group.
+static void interpolate_transform(const Source_ifc::Tick_transforms& prev,
+                                  const Source_ifc::Tick_transforms& curr,
+                                  float_t alpha,
+                                  uint32_t idx,
+                                  gpu_geo_data::GPU_instance_transform& out_transform)
+{
+    auto lerp{ [&](const float_t* from, const float_t* to) {
+        return from[idx] + (to[idx] - from[idx]) * alpha;
+    } };
+
+    // Nlerp w/ shortest path.
+    float_t dot{ prev.rot_x[idx] * curr.rot_x[idx] +
+                 prev.rot_y[idx] * curr.rot_y[idx] +
+                 prev.rot_z[idx] * curr.rot_z[idx] +
+                 prev.rot_w[idx] * curr.rot_w[idx] };
+    float_t sign{ dot < 0.0f ? -1.0f : 1.0f };
+    versor rot{
+        prev.rot_x[idx] + (curr.rot_x[idx] * sign - prev.rot_x[idx]) * alpha,
+        prev.rot_y[idx] + (curr.rot_y[idx] * sign - prev.rot_y[idx]) * alpha,
+        prev.rot_z[idx] + (curr.rot_z[idx] * sign - prev.rot_z[idx]) * alpha,
+        prev.rot_w[idx] + (curr.rot_w[idx] * sign - prev.rot_w[idx]) * alpha,
+    };
+    glm_quat_normalize(rot);
+
+#ifdef GEO_COMPACT_INSTANCE_TRANSFORMS
+    glm_quat_copy(rot, out_transform.rotation);
+    out_transform.position[0] = lerp(prev.pos_x, curr.pos_x);
+    out_transform.position[1] = lerp(prev.pos_y, curr.pos_y);
+    out_transform.position[2] = lerp(prev.pos_z, curr.pos_z);
+    out_transform.position[3] = 0.0f;
+    out_transform.scale[0] = lerp(prev.scale_x, curr.scale_x);
+    out_transform.scale[1] = lerp(prev.scale_y, curr.scale_y);
+    out_transform.scale[2] = lerp(prev.scale_z, curr.scale_z);
+    out_transform.scale[3] = 1.0f;
+#else
+    auto& matrix{ out_transform.matrix };
+    glm_quat_mat4(rot, matrix);
+    glm_vec4_scale(matrix[0], lerp(prev.scale_x, curr.scale_x), matrix[0]);
+    glm_vec4_scale(matrix[1], lerp(prev.scale_y, curr.scale_y), matrix[1]);
+    glm_vec4_scale(matrix[2], lerp(prev.scale_z, curr.scale_z), matrix[2]);
+    matrix[3][0] = lerp(prev.pos_x, curr.pos_x);
+    matrix[3][1] = lerp(prev.pos_y, curr.pos_y);
+    matrix[3][2] = lerp(prev.pos_z, curr.pos_z);
+    matrix[3][3] = 1.0f;
+#endif  // GEO_COMPACT_INSTANCE_TRANSFORMS
+}
+
+}  // namespace transform_batch
+
+
+transform_batch::Source_key_t transform_batch::register_source(Source_ifc* source)
+{
+    assert(source != nullptr);
+
+    std::lock_guard<std::mutex> lock{ s_sources_mutex };
+    for (size_t i = 0; i < k_num_sources; i++)
+    {
+        auto& entry{ s_sources[i] };
+        if (!entry.is_reserved)
+        {
+            entry = Source_entry{};
+            entry.is_reserved = true;
+            entry.source = source;
+            return static_cast<Source_key_t>(i);
+        }
+    }
+
+    // No more room for registering transform sources.
+    assert(false);
+    return k_invalid_source_key;
+}
+
+void transform_batch::unregister_source(Source_key_t key)
+{
+    assert(key < k_num_sources);
+
+    std::lock_guard<std::mutex> lock{ s_sources_mutex };
+    assert(s_sources[key].is_reserved);
+    s_sources[key].is_reserved = false;
+    s_sources[key].source = nullptr;
+}
+
+void transform_batch::interpolate_all_sources(float_t delta_time)
+{
+    CPU_PROFILER_ZONE("Interpolate Transform Batch Sources");
+    std::lock_guard<std::mutex> lock{ s_sources_mutex };
+    for (auto& entry : s_sources)
+    {
+        if (!entry.is_reserved)
+            continue;
+
+        Source_ifc::Tick_pair tick_pair;
+        if (!entry.source->acquire_tick_pair(tick_pair))
+            continue;
+
+        // Calc interpolation alpha.
+        // @NOTE: Rendering stays one tick behind the simulation, so the alpha
+        //   is how far the render time has gotten from the prev to the curr tick.
+        entry.time_since_tick += delta_time;
+        if (!entry.has_tick)
+        {
+            entry.time_since_tick = 0.0f;
+        }
+        else if (tick_pair.curr_tick_idx != entry.last_tick_idx)
+        {
+            uint64_t num_ticks_advanced{ tick_pair.curr_tick_idx - entry.last_tick_idx };
+            entry.time_since_tick -= tick_pair.tick_interval * num_ticks_advanced;
+        }
+        entry.time_since_tick =
+            std::clamp(entry.time_since_tick, 0.0f, tick_pair.tick_interval);
+        entry.has_tick = true;
+        entry.last_tick_idx = tick_pair.curr_tick_idx;
+
+        float_t alpha{ tick_pair.tick_interval > 0.0f ?
+                       entry.time_since_tick / tick_pair.tick_interval :
+                       1.0f };
+
+        entry.interpolated_transforms.resize(tick_pair.num_transforms);
+        interpolate_transforms(tick_pair.prev,
+                               tick_pair.curr,
+                               alpha,
+                               tick_pair.num_transforms,
+                               entry.interpolated_transforms.data());
+
+        entry.source->release_tick_pair();
+    }
+}
+
+const gpu_geo_data::GPU_instance_transform* transform_batch::get_interpolated_transforms(Source_key_t key,
+                                                                                         uint32_t& out_num_transforms)
+{
+    assert(key < k_num_sources);
+
+    std::lock_guard<std::mutex> lock{ s_sources_mutex };
+    auto& entry{ s_sources[key] };
+    assert(entry.is_reserved);
+    out_num_transforms = static_cast<uint32_t>(entry.interpolated_transforms.size());
+    return entry.interpolated_transforms.data();
+}
+
+void transform_batch::interpolate_transforms(const Source_ifc::Tick_transforms& prev,
+                                             const Source_ifc::Tick_transforms& curr,
+                                             float_t alpha,
+                                             uint32_t num_transforms,
+                                             gpu_geo_data::GPU_instance_transform* out_transforms)
+{
+    uint32_t idx{ 0 };
+
+#if TRANSFORM_BATCH_USE_SSE
+    const __m128 alpha4{ _mm_set1_ps(alpha) };
+    const __m128 zero4{ _mm_setzero_ps() };
+    const __m128 one4{ _mm_set1_ps(1.0f) };
+    const __m128 sign_mask4{ _mm_set1_ps(-0.0f) };
+
+    for (; idx + 4 <= num_transforms; idx += 4)
+    {
+        auto lerp4{ [&](const float_t* from, const float_t* to) {
+            __m128 from4{ _mm_loadu_ps(from + idx) };
+            __m128 to4{ _mm_loadu_ps(to + idx) };
+            return _mm_add_ps(from4, _mm_mul_ps(_mm_sub_ps(to4, from4), alpha4));
+        } };
+
+        __m128 pos_x{ lerp4(prev.pos_x, curr.pos_x) };
+        __m128 pos_y{ lerp4(prev.pos_y, curr.pos_y) };
+        __m128 pos_z{ lerp4(prev.pos_z, curr.pos_z) };
+        __m128 scale_x{ lerp4(prev.scale_x, curr.scale_x) };
+        __m128 scale_y{ lerp4(prev.scale_y, curr.scale_y) };
+        __m128 scale_z{ lerp4(prev.scale_z, curr.scale_z) };
+
+        // Nlerp w/ shortest path (flip curr rotation if dot is negative).
+        __m128 prev_x{ _mm_loadu_ps(prev.rot_x + idx) };
+        __m128 prev_y{ _mm_loadu_ps(prev.rot_y + idx) };
+        __m128 prev_z{ _mm_loadu_ps(prev.rot_z + idx) };
+        __m128 prev_w{ _mm_loadu_ps(prev.rot_w + idx) };
+        __m128 curr_x{ _mm_loadu_ps(curr.rot_x + idx) };
+        __m128 curr_y{ _mm_loadu_ps(curr.rot_y + idx) };
+        __m128 curr_z{ _mm_loadu_ps(curr.rot_z + idx) };
+        __m128 curr_w{ _mm_loadu_ps(curr.rot_w + idx) };
+
+        __m128 dot{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(prev_x, curr_x),
+                                          _mm_mul_ps(prev_y, curr_y)),
+                               _mm_add_ps(_mm_mul_ps(prev_z, curr_z),
+                                          _mm_mul_ps(prev_w, curr_w))) };
+        __m128 flip{ _mm_and_ps(dot, sign_mask4) };
+        curr_x = _mm_xor_ps(curr_x, flip);
+        curr_y = _mm_xor_ps(curr_y, flip);
+        curr_z = _mm_xor_ps(curr_z, flip);
+        curr_w = _mm_xor_ps(curr_w, flip);
+
+        __m128 x{ _mm_add_ps(prev_x, _mm_mul_ps(_mm_sub_ps(curr_x, prev_x), alpha4)) };
+        __m128 y{ _mm_add_ps(prev_y, _mm_mul_ps(_mm_sub_ps(curr_y, prev_y), alpha4)) };
+        __m128 z{ _mm_add_ps(prev_z, _mm_mul_ps(_mm_sub_ps(curr_z, prev_z), alpha4)) };
+        __m128 w{ _mm_add_ps(prev_w, _mm_mul_ps(_mm_sub_ps(curr_w, prev_w), alpha4)) };
+
+        __m128 length_sqr{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+                                      _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w))) };
+        __m128 inv_length{ _mm_div_ps(one4, _mm_sqrt_ps(length_sqr)) };
+        x = _mm_mul_ps(x, inv_length);
+        y = _mm_mul_ps(y, inv_length);
+        z = _mm_mul_ps(z, inv_length);
+        w = _mm_mul_ps(w, inv_length);
+
+        // Transpose so that each register is one transform's vec4.
+        auto store_vec4s{ [&](__m128 (&rows)[4], auto get_dest) {
+            _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+            for (uint32_t lane = 0; lane < 4; lane++)
+            {
+                _mm_storeu_ps(get_dest(out_transforms[idx + lane]), rows[lane]);
+            }
+        } };
+
+#ifdef GEO_COMPACT_INSTANCE_TRANSFORMS
+        __m128 rotation[4]{ x, y, z, w };
+        __m128 position[4]{ pos_x, pos_y, pos_z, zero4 };
+        __m128 scale[4]{ scale_x, scale_y, scale_z, one4 };
+        store_vec4s(rotation, [](auto& transform) { return transform.rotation; });
+        store_vec4s(position, [](auto& transform) { return transform.position; });
+        store_vec4s(scale, [](auto& transform) { return transform.scale; });
+#else
+        // Compose TRS (same layout as `glm_quat_mat4()`).
+        __m128 x2{ _mm_add_ps(x, x) };
+        __m128 y2{ _mm_add_ps(y, y) };
+        __m128 z2{ _mm_add_ps(z, z) };
+        __m128 xx{ _mm_mul_ps(x, x2) };
+        __m128 yy{ _mm_mul_ps(y, y2) };
+        __m128 zz{ _mm_mul_ps(z, z2) };
+        __m128 xy{ _mm_mul_ps(x, y2) };
+        __m128 xz{ _mm_mul_ps(x, z2) };
+        __m128 yz{ _mm_mul_ps(y, z2) };
+        __m128 wx{ _mm_mul_ps(w, x2) };
+        __m128 wy{ _mm_mul_ps(w, y2) };
+        __m128 wz{ _mm_mul_ps(w, z2) };
+
+        // Rows of each column, one transform per lane.
+        __m128 col0[4]{
+            _mm_mul_ps(_mm_sub_ps(one4, _mm_add_ps(yy, zz)), scale_x),
+            _mm_mul_ps(_mm_add_ps(xy, wz), scale_x),
+            _mm_mul_ps(_mm_sub_ps(xz, wy), scale_x),
+            zero4,
+        };
+        __m128 col1[4]{
+            _mm_mul_ps(_mm_sub_ps(xy, wz), scale_y),
+            _mm_mul_ps(_mm_sub_ps(one4, _mm_add_ps(xx, zz)), scale_y),
+            _mm_mul_ps(_mm_add_ps(yz, wx), scale_y),
+            zero4,
+        };
+        __m128 col2[4]{
+            _mm_mul_ps(_mm_add_ps(xz, wy), scale_z),
+            _mm_mul_ps(_mm_sub_ps(yz, wx), scale_z),
+            _mm_mul_ps(_mm_sub_ps(one4, _mm_add_ps(xx, yy)), scale_z),
+            zero4,
+        };
+        __m128 col3[4]{ pos_x, pos_y, pos_z, one4 };
+
+        store_vec4s(col0, [](auto& transform) { return transform.matrix[0]; });
+        store_vec4s(col1, [](auto& transform) { return transform.matrix[1]; });
+        store_vec4s(col2, [](auto& transform) { return transform.matrix[2]; });
+        store_vec4s(col3, [](auto& transform) { return transform.matrix[3]; });
+#endif  // GEO_COMPACT_INSTANCE_TRANSFORMS
+    }
+#endif  // TRANSFORM_BATCH_USE_SSE
+
+    for (; idx < num_transforms; idx++)
+    {
+        interpolate_transform(prev, curr, alpha, idx, out_transforms[idx]);
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cinttypes>
+#include "cglm/cglm.h"
+#include "gpu_geo_data.h"
+#include "transform_batch_source.h"
+
+
+namespace transform_batch
+{
+
+Source_key_t register_source(Source_ifc* source);
+
+// @NOTE: All geo instances reading from the source must be unregistered first.
+void unregister_source(Source_key_t key);
+
+// Pulls the latest ticks of every source and interpolates all of their
+// transforms into GPU instance transforms.
+// @NOTE: The interpolation alpha is how far `delta_time` has advanced
+//   since the source's latest tick, so call exactly once per prepared frame.
+void interpolate_all_sources(float_t delta_time);
+
+// Interpolated transforms of a source (valid until the next interpolate).
+// @NOTE: Empty (w/ 0 transforms) until the source's first tick got
+//   interpolated, and the number of transforms can differ from what geo
+//   instances reading from the source expect, so check the idx against
+//   `out_num_transforms`.
+const gpu_geo_data::GPU_instance_transform* get_interpolated_transforms(Source_key_t key,
+                                                                        uint32_t& out_num_transforms);
+
+// Lerps positions and scales, nlerps rotations and writes them out (composed
+// into TRS mat4s if not using compact instance transforms), four transforms
+// at a time w/ SIMD.
+void interpolate_transforms(const Source_ifc::Tick_transforms& prev,
+                            const Source_ifc::Tick_transforms& curr,
+                            float_t alpha,
+                            uint32_t num_transforms,
+                            gpu_geo_data::GPU_instance_transform* out_transforms);
+
+}  // namespace transform_batch